@@ -87,11 +87,53 @@ typedef struct _modbus_backend {
   unsigned int (*is_connected)(modbus_t* ctx);
   void (*close)(modbus_t* ctx);
   int (*flush)(modbus_t* ctx);
-  int (*select)(modbus_t* ctx, fd_set* rset, struct timeval* tv,
-                int msg_length);
+  int (*select)(modbus_t* ctx, struct timeval* tv, int msg_length);
   void (*free)(modbus_t* ctx);
 } modbus_backend_t;
 
+/* Outstanding request of a pipelined client (TCP only). The request is kept
+   to check the confirmation when the response with the same transaction ID
+   arrives. */
+typedef struct _modbus_pending {
+  int in_use;
+  int t_id;
+  uint16_t* dest;
+  uint8_t req[_MIN_REQ_LENGTH];
+} modbus_pending_t;
+
+typedef struct _modbus_pipeline {
+  int window;
+  int nb_pending;
+  modbus_pending_t* pending;
+} modbus_pipeline_t;
+
+typedef enum { _STEP_FUNCTION, _STEP_META, _STEP_DATA } _step_t;
+
+/* Progress of the message being received. The frame is read step by step
+   (function, meta then data), each step giving the length of the next one,
+   so the reception can be suspended when no byte is available and resumed
+   later from the same state. */
+typedef struct _modbus_rx {
+  _step_t step;
+  unsigned int length_to_read;
+  int msg_length;
+} modbus_rx_t;
+
+/* Request of the non-blocking API (one in flight per context) */
+typedef struct _modbus_async {
+  int in_use;
+  int function;
+  uint16_t* dest;
+  uint8_t req[MODBUS_MAX_ADU_LENGTH];
+  uint8_t rsp[MODBUS_MAX_ADU_LENGTH];
+  modbus_rx_t rx;
+  /* Monotonic time (in microseconds) at which the response times out */
+  int64_t deadline;
+  /* Result of the completed request and its errno */
+  int rc;
+  int error;
+} modbus_async_t;
+
 struct _modbus {
   /* Slave address */
   int slave;
@@ -105,11 +147,19 @@ struct _modbus {
   struct timeval indication_timeout;
   const modbus_backend_t* backend;
   void* backend_data;
+  /* NULL unless a pipeline window has been set */
+  modbus_pipeline_t* pipeline;
+  /* NULL until the first non-blocking request */
+  modbus_async_t* async;
 };
 
 void _modbus_init_common(modbus_t* ctx);
 void _error_print(modbus_t* ctx, const char* context);
 int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type);
+int _modbus_wait_fd(modbus_t* ctx, int s, int for_write, struct timeval* tv);
+void _modbus_rx_init(modbus_t* ctx, modbus_rx_t* rx);
+int _modbus_rx_advance(modbus_t* ctx, modbus_rx_t* rx, uint8_t* msg,
+                       msg_type_t msg_type, int nb_received);
 
 #ifndef HAVE_STRLCPY
 size_t strlcpy(char* dest, const char* src, size_t dest_size);
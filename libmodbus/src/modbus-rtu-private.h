@@ -25,6 +25,14 @@
 
 #define _MODBUS_RTU_CHECKSUM_LENGTH 2
 
+/* Adaptive timing: half-octave latency buckets from 250 us (the last one
+ * holds everything above 8 s), learned timeout after enough responses and
+ * counters halved when they reach the aging limit to follow the slave */
+#define _MODBUS_RTU_LATENCY_BUCKETS     32
+#define _MODBUS_RTU_LATENCY_MIN_SAMPLES 20
+#define _MODBUS_RTU_LATENCY_AGING       512
+#define _MODBUS_RTU_MAX_SLAVE           247
+
 #if defined(_WIN32)
 #if !defined(ENOTSUP)
 #define ENOTSUP WSAEOPNOTSUPP
@@ -43,6 +51,16 @@ struct win32_ser {
 };
 #endif /* _WIN32 */
 
+/* Response latency of one slave, measured from the end of the request on the
+ * wire to the first byte of the response */
+typedef struct _modbus_rtu_latency {
+    uint32_t buckets[_MODBUS_RTU_LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t timeouts;
+    /* Learned response timeout in us, 0 until enough samples */
+    uint32_t timeout;
+} modbus_rtu_latency_t;
+
 typedef struct _modbus_rtu {
     /* Device: "/dev/ttyS0", "/dev/ttyUSB0" or "/dev/tty.USA19*" on Mac OS X. */
     char *device;
@@ -67,9 +85,23 @@ typedef struct _modbus_rtu {
 #if HAVE_DECL_TIOCM_RTS
     int rts;
     int rts_delay;
-    int onebyte_time;
     void (*set_rts)(modbus_t *ctx, int on);
 #endif
+    /* Estimated time in us to send one byte */
+    int onebyte_time;
+    /* Silent interval between two frames (t3.5) in us */
+    int t35_time;
+    /* MODBUS_RTU_TIMING_STATIC or MODBUS_RTU_TIMING_ADAPTIVE */
+    int timing_mode;
+    /* Monotonic time (us) from which the line is silent for t3.5 */
+    int64_t bus_idle_at;
+    /* Estimated end of the last request on the wire (us) */
+    int64_t tx_end;
+    /* Slave of the request waiting for the first byte of its response, -1 if
+     * none */
+    int awaiting_slave;
+    /* Per-slave latencies, allocated when the adaptive mode is enabled */
+    modbus_rtu_latency_t *latency;
     /* To handle many slaves on the same link */
     int confirmation_to_ignore;
 } modbus_rtu_t;
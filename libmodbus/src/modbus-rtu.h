@@ -38,6 +38,34 @@ MODBUS_API int modbus_rtu_set_custom_rts(modbus_t *ctx,
 MODBUS_API int modbus_rtu_set_rts_delay(modbus_t *ctx, int us);
 MODBUS_API int modbus_rtu_get_rts_delay(modbus_t *ctx);
 
+/* Adaptive timing (master only): t3.5 silent interval enforced before each
+ * request, response timeout of each slave learned from its latencies */
+#define MODBUS_RTU_TIMING_STATIC   0
+#define MODBUS_RTU_TIMING_ADAPTIVE 1
+
+MODBUS_API int modbus_rtu_set_timing_mode(modbus_t *ctx, int mode);
+MODBUS_API int modbus_rtu_get_timing_mode(modbus_t *ctx);
+MODBUS_API int modbus_rtu_get_frame_gap(modbus_t *ctx);
+
+MODBUS_API int modbus_rtu_get_slave_timeout(modbus_t *ctx, int slave, uint32_t *to_usec);
+MODBUS_API int modbus_rtu_get_slave_latency(modbus_t *ctx,
+                                            int slave,
+                                            double quantile,
+                                            uint32_t *usec,
+                                            uint32_t *samples,
+                                            uint32_t *timeouts);
+MODBUS_API int modbus_rtu_reset_slave_latency(modbus_t *ctx, int slave);
+
+/* CRC-16 of RTU frames (low-order byte first on the wire). The CRC can be
+ * updated as bytes arrive: start from MODBUS_RTU_CRC16_INIT and feed each
+ * chunk; a complete frame including its CRC gives 0. */
+#define MODBUS_RTU_CRC16_INIT 0xFFFF
+
+MODBUS_API uint16_t modbus_rtu_crc16_update(uint16_t crc,
+                                            const uint8_t *data,
+                                            int length);
+MODBUS_API uint16_t modbus_rtu_crc16(const uint8_t *data, int length);
+
 MODBUS_END_DECLS
 
 #endif /* MODBUS_RTU_H */
@@ -38,4 +38,48 @@ typedef struct _modbus_tcp_pi {
     char *service;
 } modbus_tcp_pi_t;
 
+/* Connections accepted per wake-up of the listening socket, so that a burst
+   of connections does not starve the connected clients */
+#define _MODBUS_SERVER_MAX_ACCEPTS 64
+#define _MODBUS_SERVER_MAX_EVENTS  64
+/* Responses a client may leave unread before being disconnected */
+#define _MODBUS_SERVER_MAX_TX_BACKLOG 65536
+/* Retry of accept() paused on EMFILE/ENFILE when no connection closes */
+#define _MODBUS_SERVER_ACCEPT_RETRY_MS 100
+
+/* Connection of a modbus_server_t, the slot is free when fd is -1 */
+typedef struct _modbus_server_conn {
+    int fd;
+    /* Start of the next request, never more than one ADU */
+    int rx_length;
+    uint8_t rx[MODBUS_TCP_MAX_ADU_LENGTH];
+    /* Responses not yet accepted by the socket, allocated on first use */
+    uint8_t *tx;
+    int tx_offset;
+    int tx_length;
+    int tx_size;
+} modbus_server_conn_t;
+
+struct _modbus_server {
+    modbus_t *ctx;
+    /* Listening socket, owned by the caller */
+    int s;
+    int epfd;
+    /* Readable once modbus_server_stop() has been called */
+    int stop_fd;
+    /* Connections, updated with atomic operations */
+    int nb_connections;
+    /* Accept stopped on EMFILE/ENFILE until a connection is closed or
+       retry_fd expires */
+    int accept_paused;
+    int retry_fd;
+    /* Next slot to try, only used by the thread owning the listening socket */
+    int next_slot;
+    int max_connections;
+    modbus_server_conn_t *conns;
+    modbus_mapping_t *mb_mapping;
+    modbus_server_callback_t callback;
+    void *user_data;
+};
+
 #endif /* MODBUS_TCP_PRIVATE_H */
@@ -53,6 +53,14 @@
 # include <netdb.h>
 #endif
 
+#if defined(__linux__)
+# define HAVE_MODBUS_SERVER
+# include <fcntl.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/timerfd.h>
+#endif
+
 #if !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -260,8 +268,8 @@ static int _modbus_tcp_set_ipv4_options(int s) {
   return 0;
 }
 
-static int _connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen,
-                    const struct timeval* ro_tv) {
+static int _connect(modbus_t* ctx, int sockfd, const struct sockaddr* addr,
+                    socklen_t addrlen, const struct timeval* ro_tv) {
   int rc = connect(sockfd, addr, addrlen);
 
 #ifdef OS_WIN32
@@ -274,15 +282,12 @@ static int _connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen,
 #else
   if (rc == -1 && errno == EINPROGRESS) {
 #endif
-    fd_set wset;
     int optval;
     socklen_t optlen = sizeof(optval);
     struct timeval tv = *ro_tv;
 
     /* Wait to be available in writing */
-    FD_ZERO(&wset);
-    FD_SET(sockfd, &wset);
-    rc = select(sockfd + 1, NULL, &wset, NULL, &tv);
+    rc = _modbus_wait_fd(ctx, sockfd, TRUE, &tv);
     if (rc < 0) {
       /* Fail */
       return -1;
@@ -356,7 +361,7 @@ static int _modbus_tcp_connect(modbus_t* ctx) {
     return -1;
   }
 
-  rc = _connect(ctx->s, (struct sockaddr*)&addr, sizeof(addr),
+  rc = _connect(ctx, ctx->s, (struct sockaddr*)&addr, sizeof(addr),
                 &ctx->response_timeout);
   if (rc == -1) {
     close(ctx->s);
@@ -427,7 +432,7 @@ static int _modbus_tcp_pi_connect(modbus_t* ctx) {
       printf("Connecting to [%s]:%s\n", ctx_tcp_pi->node, ctx_tcp_pi->service);
     }
 
-    rc = _connect(s, ai_ptr->ai_addr, ai_ptr->ai_addrlen,
+    rc = _connect(ctx, s, ai_ptr->ai_addr, ai_ptr->ai_addrlen,
                   &ctx->response_timeout);
     if (rc == -1) {
       close(s);
@@ -763,20 +768,12 @@ int modbus_tcp_pi_accept(modbus_t* ctx, int* s) {
   return ctx->s;
 }
 
-static int _modbus_tcp_select(modbus_t* ctx, fd_set* rset, struct timeval* tv,
+static int _modbus_tcp_select(modbus_t* ctx, struct timeval* tv,
                               int length_to_read) {
-  int s_rc;
-  while ((s_rc = select(ctx->s + 1, rset, NULL, NULL, tv)) == -1) {
-    if (errno == EINTR) {
-      if (ctx->debug) {
-        fprintf(stderr, "A non blocked signal was caught\n");
-      }
-      /* Necessary after an error */
-      FD_ZERO(rset);
-      FD_SET(ctx->s, rset);
-    } else {
-      return -1;
-    }
+  int s_rc = _modbus_wait_fd(ctx, ctx->s, FALSE, tv);
+
+  if (s_rc == -1) {
+    return -1;
   }
 
   if (s_rc == 0) {
@@ -972,3 +969,527 @@ modbus_t* modbus_new_tcp_pi(const char* node, const char* service) {
 
   return ctx;
 }
+
+#ifdef HAVE_MODBUS_SERVER
+
+/* The listening socket and the stop event are told apart from the connections
+   by the address given to epoll */
+static int _server_arm(modbus_server_t* server, int op, int fd, void* ptr,
+                       uint32_t events) {
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = ptr;
+  return epoll_ctl(server->epfd, op, fd, &ev);
+}
+
+static int _server_arm_listen(modbus_server_t* server) {
+  return _server_arm(server, EPOLL_CTL_MOD, server->s, &server->s,
+                     EPOLLIN | EPOLLONESHOT);
+}
+
+/* A connection is disarmed while a thread serves it: no other thread of the
+   pool can receive its events */
+static int _server_arm_conn(modbus_server_t* server, modbus_server_conn_t* conn,
+                            int op) {
+  uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+
+  if (conn->tx_offset < conn->tx_length) {
+    events |= EPOLLOUT;
+  }
+  return _server_arm(server, op, conn->fd, conn, events);
+}
+
+static void _server_close_conn(modbus_server_t* server,
+                               modbus_server_conn_t* conn) {
+  if (server->ctx->debug) {
+    printf("Connection closed on socket %d\n", conn->fd);
+  }
+  /* Closing the descriptor removes it from the epoll set */
+  close(conn->fd);
+  free(conn->tx);
+  conn->tx = NULL;
+  conn->tx_size = 0;
+  /* The slot is free before the count drops: a thread that sees room for a
+     new connection always finds a free slot */
+  __atomic_store_n(&conn->fd, -1, __ATOMIC_RELEASE);
+  __atomic_sub_fetch(&server->nb_connections, 1, __ATOMIC_ACQ_REL);
+
+  if (__atomic_exchange_n(&server->accept_paused, 0, __ATOMIC_ACQ_REL)) {
+    _server_arm_listen(server);
+  }
+}
+
+/* Resumes accept after a while even if no connection is closed, the
+   descriptors may be held by the rest of the process */
+static int _server_arm_retry(modbus_server_t* server) {
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = _MODBUS_SERVER_ACCEPT_RETRY_MS / 1000;
+  its.it_value.tv_nsec = (_MODBUS_SERVER_ACCEPT_RETRY_MS % 1000) * 1000000;
+  if (timerfd_settime(server->retry_fd, 0, &its, NULL) == -1) {
+    return -1;
+  }
+  return _server_arm(server, EPOLL_CTL_MOD, server->retry_fd,
+                     &server->retry_fd, EPOLLIN | EPOLLONESHOT);
+}
+
+static void _server_accept(modbus_server_t* server) {
+  int i;
+
+  for (i = 0; i < _MODBUS_SERVER_MAX_ACCEPTS; i++) {
+    modbus_server_conn_t* conn;
+    int enable = 1;
+    int nb_connections =
+        __atomic_load_n(&server->nb_connections, __ATOMIC_ACQUIRE);
+    int fd = accept4(server->s, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno == EMFILE || errno == ENFILE) {
+        /* Level-triggered, the socket would wake us up again at once */
+        if (server->ctx->debug) {
+          fprintf(stderr, "Out of descriptors, accept paused\n");
+        }
+        __atomic_store_n(&server->accept_paused, 1, __ATOMIC_RELEASE);
+        /* A connection closed since accept4() failed has not seen the flag:
+           resume at once */
+        if (__atomic_load_n(&server->nb_connections, __ATOMIC_ACQUIRE) <
+                nb_connections &&
+            __atomic_exchange_n(&server->accept_paused, 0, __ATOMIC_ACQ_REL)) {
+          break;
+        }
+        if (_server_arm_retry(server) == -1 &&
+            __atomic_exchange_n(&server->accept_paused, 0, __ATOMIC_ACQ_REL)) {
+          break;
+        }
+        return;
+      }
+      break;
+    }
+
+    if (__atomic_load_n(&server->nb_connections, __ATOMIC_ACQUIRE) >=
+        server->max_connections) {
+      /* Refused at once rather than left waiting in the backlog */
+      if (server->ctx->debug) {
+        fprintf(stderr, "Too many connections, socket %d refused\n", fd);
+      }
+      close(fd);
+      continue;
+    }
+
+    while (__atomic_load_n(&server->conns[server->next_slot].fd,
+                           __ATOMIC_ACQUIRE) != -1) {
+      server->next_slot = (server->next_slot + 1) % server->max_connections;
+    }
+    conn = &server->conns[server->next_slot];
+    server->next_slot = (server->next_slot + 1) % server->max_connections;
+
+    /* One small response per request, Nagle would hold the next ones back */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    conn->rx_length = 0;
+    conn->tx_offset = 0;
+    conn->tx_length = 0;
+    conn->fd = fd;
+    __atomic_add_fetch(&server->nb_connections, 1, __ATOMIC_ACQ_REL);
+
+    if (_server_arm_conn(server, conn, EPOLL_CTL_ADD) == -1) {
+      _server_close_conn(server, conn);
+      continue;
+    }
+    if (server->ctx->debug) {
+      printf("New connection on socket %d\n", fd);
+    }
+  }
+
+  _server_arm_listen(server);
+}
+
+/* Sends the response or queues what the socket does not take */
+static int _server_send(modbus_server_conn_t* conn, const uint8_t* rsp,
+                        int rsp_length) {
+  if (conn->tx_offset == conn->tx_length) {
+    ssize_t rc = send(conn->fd, rsp, rsp_length, MSG_NOSIGNAL);
+
+    if (rc == rsp_length) {
+      return 0;
+    }
+    if (rc == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return -1;
+      }
+      rc = 0;
+    }
+    rsp += rc;
+    rsp_length -= rc;
+    conn->tx_offset = 0;
+    conn->tx_length = 0;
+  }
+
+  if (conn->tx_length - conn->tx_offset + rsp_length >
+      _MODBUS_SERVER_MAX_TX_BACKLOG) {
+    /* The client does not read its responses */
+    errno = ENOBUFS;
+    return -1;
+  }
+  if (conn->tx_length + rsp_length > conn->tx_size) {
+    /* Sent bytes are dropped before growing the buffer */
+    if (conn->tx_offset > 0) {
+      memmove(conn->tx, conn->tx + conn->tx_offset,
+              conn->tx_length - conn->tx_offset);
+      conn->tx_length -= conn->tx_offset;
+      conn->tx_offset = 0;
+    }
+    if (conn->tx_length + rsp_length > conn->tx_size) {
+      int size = conn->tx_size == 0 ? 1024 : conn->tx_size * 2;
+      uint8_t* tx;
+
+      while (size < conn->tx_length + rsp_length) {
+        size *= 2;
+      }
+      tx = realloc(conn->tx, size);
+      if (tx == NULL) {
+        return -1;
+      }
+      conn->tx = tx;
+      conn->tx_size = size;
+    }
+  }
+  memcpy(conn->tx + conn->tx_length, rsp, rsp_length);
+  conn->tx_length += rsp_length;
+  return 0;
+}
+
+static int _server_flush(modbus_server_conn_t* conn) {
+  while (conn->tx_offset < conn->tx_length) {
+    ssize_t rc = send(conn->fd, conn->tx + conn->tx_offset,
+                      conn->tx_length - conn->tx_offset, MSG_NOSIGNAL);
+    if (rc == -1) {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    conn->tx_offset += rc;
+  }
+  conn->tx_offset = 0;
+  conn->tx_length = 0;
+  return 0;
+}
+
+static int _server_handle(modbus_server_t* server, modbus_server_conn_t* conn,
+                          const uint8_t* req, int req_length) {
+  uint8_t rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+  int rsp_length;
+  int i;
+
+  if (server->ctx->debug) {
+    for (i = 0; i < req_length; i++) printf("<%.2X>", req[i]);
+    printf("\n");
+  }
+
+  if (server->callback != NULL) {
+    rsp_length =
+        server->callback(server->ctx, req, req_length, rsp, server->user_data);
+    if (rsp_length == -1) {
+      return -1;
+    }
+  } else {
+    /* As modbus_reply(): no response to a request it can't handle */
+    rsp_length = modbus_build_reply(server->ctx, req, req_length,
+                                    server->mb_mapping, rsp);
+  }
+  if (rsp_length <= 0) {
+    return 0;
+  }
+
+  if (server->ctx->debug) {
+    for (i = 0; i < rsp_length; i++) printf("[%.2X]", rsp[i]);
+    printf("\n");
+  }
+  return _server_send(conn, rsp, rsp_length);
+}
+
+/* Reads the available bytes and replies to every complete request. Returns -1
+   when the connection must be closed. */
+static int _server_receive(modbus_server_t* server,
+                           modbus_server_conn_t* conn) {
+  for (;;) {
+    int room = MODBUS_TCP_MAX_ADU_LENGTH - conn->rx_length;
+    ssize_t rc = recv(conn->fd, conn->rx + conn->rx_length, room, 0);
+    int offset = 0;
+
+    if (rc == 0) {
+      errno = ECONNRESET;
+      return -1;
+    }
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    conn->rx_length += rc;
+
+    /* Several requests may arrive together (pipelined client) */
+    while (conn->rx_length - offset >= _MODBUS_TCP_HEADER_LENGTH) {
+      const uint8_t* req = conn->rx + offset;
+      int length = (req[4] << 8) | req[5];
+
+      /* Protocol identifier 0, unit + function at least, one ADU at most */
+      if (req[2] != 0 || req[3] != 0 || length < 2 ||
+          length > MODBUS_TCP_MAX_ADU_LENGTH - _MODBUS_TCP_HEADER_LENGTH + 1) {
+        errno = EMBBADDATA;
+        return -1;
+      }
+      length += _MODBUS_TCP_HEADER_LENGTH - 1;
+      if (conn->rx_length - offset < length) {
+        break;
+      }
+      if (_server_handle(server, conn, req, length) == -1) {
+        return -1;
+      }
+      offset += length;
+    }
+    if (offset > 0) {
+      memmove(conn->rx, conn->rx + offset, conn->rx_length - offset);
+      conn->rx_length -= offset;
+    }
+
+    if (rc < room) {
+      /* Drained, the connection is re-armed in level-triggered mode */
+      return 0;
+    }
+  }
+}
+
+modbus_server_t* modbus_server_new(modbus_t* ctx, int s, int max_connections) {
+  modbus_server_t* server;
+  int flags;
+  int i;
+
+  if (ctx == NULL || ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_TCP ||
+      s < 0 || max_connections <= 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  server = (modbus_server_t*)calloc(1, sizeof(modbus_server_t));
+  if (server == NULL) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  server->ctx = ctx;
+  server->s = s;
+  server->max_connections = max_connections;
+  server->epfd = epoll_create1(EPOLL_CLOEXEC);
+  server->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  server->retry_fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  server->conns = (modbus_server_conn_t*)calloc(max_connections,
+                                                sizeof(modbus_server_conn_t));
+  for (i = 0; server->conns != NULL && i < max_connections; i++) {
+    server->conns[i].fd = -1;
+  }
+  if (server->epfd == -1 || server->stop_fd == -1 || server->retry_fd == -1 ||
+      server->conns == NULL) {
+    modbus_server_free(server);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  /* The stop event stays readable to wake up every thread of the pool */
+  flags = fcntl(s, F_GETFL, 0);
+  if (flags == -1 || fcntl(s, F_SETFL, flags | O_NONBLOCK) == -1 ||
+      _server_arm(server, EPOLL_CTL_ADD, server->stop_fd, &server->stop_fd,
+                  EPOLLIN) == -1 ||
+      _server_arm(server, EPOLL_CTL_ADD, server->retry_fd, &server->retry_fd,
+                  EPOLLIN | EPOLLONESHOT) == -1 ||
+      _server_arm(server, EPOLL_CTL_ADD, s, &server->s,
+                  EPOLLIN | EPOLLONESHOT) == -1) {
+    int saved_errno = errno;
+
+    modbus_server_free(server);
+    errno = saved_errno;
+    return NULL;
+  }
+
+  return server;
+}
+
+int modbus_server_set_mapping(modbus_server_t* server,
+                              modbus_mapping_t* mb_mapping) {
+  if (server == NULL || mb_mapping == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  server->mb_mapping = mb_mapping;
+  return 0;
+}
+
+int modbus_server_set_callback(modbus_server_t* server,
+                               modbus_server_callback_t callback,
+                               void* user_data) {
+  if (server == NULL || callback == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  server->callback = callback;
+  server->user_data = user_data;
+  return 0;
+}
+
+/* Accepts, receives and replies until modbus_server_stop(). Returns 0 once
+   stopped or -1 if epoll_wait() fails. */
+int modbus_server_run(modbus_server_t* server) {
+  struct epoll_event events[_MODBUS_SERVER_MAX_EVENTS];
+  int stopped = FALSE;
+
+  if (server == NULL ||
+      (server->callback == NULL && server->mb_mapping == NULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  while (!stopped) {
+    int i;
+    int nb = epoll_wait(server->epfd, events, _MODBUS_SERVER_MAX_EVENTS, -1);
+
+    if (nb == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+
+    for (i = 0; i < nb; i++) {
+      void* ptr = events[i].data.ptr;
+      modbus_server_conn_t* conn;
+      int rc = 0;
+
+      if (ptr == &server->stop_fd) {
+        stopped = TRUE;
+        continue;
+      }
+      if (ptr == &server->s) {
+        _server_accept(server);
+        continue;
+      }
+      if (ptr == &server->retry_fd) {
+        uint64_t expirations;
+
+        if (read(server->retry_fd, &expirations, sizeof(expirations)) > 0 &&
+            __atomic_exchange_n(&server->accept_paused, 0, __ATOMIC_ACQ_REL)) {
+          _server_arm_listen(server);
+        }
+        continue;
+      }
+
+      conn = (modbus_server_conn_t*)ptr;
+      if (events[i].events & EPOLLOUT) {
+        rc = _server_flush(conn);
+      }
+      if (rc == 0 && (events[i].events & ~EPOLLOUT)) {
+        /* Hang-up and errors are reported by recv() */
+        rc = _server_receive(server, conn);
+      }
+      if (rc == -1 || _server_arm_conn(server, conn, EPOLL_CTL_MOD) == -1) {
+        _server_close_conn(server, conn);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Async-signal-safe, every modbus_server_run() returns */
+void modbus_server_stop(modbus_server_t* server) {
+  uint64_t one = 1;
+
+  if (server != NULL && write(server->stop_fd, &one, sizeof(one)) == -1 &&
+      server->ctx->debug) {
+    fprintf(stderr, "Unable to stop the server\n");
+  }
+}
+
+int modbus_server_get_connections(modbus_server_t* server) {
+  if (server == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return __atomic_load_n(&server->nb_connections, __ATOMIC_ACQUIRE);
+}
+
+/* To be called once every modbus_server_run() has returned. The listening
+   socket and the context are left to the caller. */
+void modbus_server_free(modbus_server_t* server) {
+  int i;
+
+  if (server == NULL) {
+    return;
+  }
+  for (i = 0; server->conns != NULL && i < server->max_connections; i++) {
+    if (server->conns[i].fd != -1) {
+      close(server->conns[i].fd);
+      free(server->conns[i].tx);
+    }
+  }
+  free(server->conns);
+  if (server->epfd != -1) {
+    close(server->epfd);
+  }
+  if (server->stop_fd != -1) {
+    close(server->stop_fd);
+  }
+  if (server->retry_fd != -1) {
+    close(server->retry_fd);
+  }
+  free(server);
+}
+
+#else /* HAVE_MODBUS_SERVER */
+
+modbus_server_t* modbus_server_new(modbus_t* ctx, int s, int max_connections) {
+  (void)ctx;
+  (void)s;
+  (void)max_connections;
+  errno = ENOSYS;
+  return NULL;
+}
+
+int modbus_server_set_mapping(modbus_server_t* server,
+                              modbus_mapping_t* mb_mapping) {
+  (void)server;
+  (void)mb_mapping;
+  errno = ENOSYS;
+  return -1;
+}
+
+int modbus_server_set_callback(modbus_server_t* server,
+                               modbus_server_callback_t callback,
+                               void* user_data) {
+  (void)server;
+  (void)callback;
+  (void)user_data;
+  errno = ENOSYS;
+  return -1;
+}
+
+int modbus_server_run(modbus_server_t* server) {
+  (void)server;
+  errno = ENOSYS;
+  return -1;
+}
+
+void modbus_server_stop(modbus_server_t* server) { (void)server; }
+
+int modbus_server_get_connections(modbus_server_t* server) {
+  (void)server;
+  errno = ENOSYS;
+  return -1;
+}
+
+void modbus_server_free(modbus_server_t* server) { (void)server; }
+
+#endif /* HAVE_MODBUS_SERVER */
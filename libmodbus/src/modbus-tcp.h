@@ -47,6 +47,35 @@ MODBUS_API modbus_t *modbus_new_tcp_pi(const char *node, const char *service);
 MODBUS_API int modbus_tcp_pi_listen(modbus_t *ctx, int nb_connection);
 MODBUS_API int modbus_tcp_pi_accept(modbus_t *ctx, int *s);
 
+/* Multi-client server (Linux): one epoll set holds the listening socket and
+ * every connection, each with its own receive and send buffers, so a single
+ * thread serves thousands of clients. Several threads may call
+ * modbus_server_run() on the same server to form a worker pool: a connection
+ * is then served by one thread at a time but the callback (or the mapping)
+ * must be thread-safe. */
+typedef struct _modbus_server modbus_server_t;
+
+/* Called for each complete request (MBAP header included). Writes the response
+ * into rsp (MODBUS_TCP_MAX_ADU_LENGTH bytes) with modbus_build_reply() or
+ * modbus_build_reply_exception() and returns its length, 0 to send nothing or
+ * -1 to close the connection. */
+typedef int (*modbus_server_callback_t)(modbus_t *ctx,
+                                        const uint8_t *req,
+                                        int req_length,
+                                        uint8_t *rsp,
+                                        void *user_data);
+
+MODBUS_API modbus_server_t *modbus_server_new(modbus_t *ctx, int s, int max_connections);
+MODBUS_API int modbus_server_set_mapping(modbus_server_t *server,
+                                         modbus_mapping_t *mb_mapping);
+MODBUS_API int modbus_server_set_callback(modbus_server_t *server,
+                                          modbus_server_callback_t callback,
+                                          void *user_data);
+MODBUS_API int modbus_server_run(modbus_server_t *server);
+MODBUS_API void modbus_server_stop(modbus_server_t *server);
+MODBUS_API int modbus_server_get_connections(modbus_server_t *server);
+MODBUS_API void modbus_server_free(modbus_server_t *server);
+
 MODBUS_END_DECLS
 
 #endif /* MODBUS_TCP_H */
@@ -7,6 +7,9 @@
  * http://libmodbus.org/
  */
 
+/* Before any system header so that _GNU_SOURCE declares ppoll() */
+#include "../config.h"
+
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
@@ -17,8 +20,10 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
-#include "../config.h"
 #include "modbus-private.h"
 #include "modbus.h"
 
@@ -34,8 +39,6 @@ const unsigned int libmodbus_version_micro = LIBMODBUS_VERSION_MICRO;
 #define MAX_MESSAGE_LENGTH 260
 
 /* 3 steps are used to parse the query */
-typedef enum { _STEP_FUNCTION, _STEP_META, _STEP_DATA } _step_t;
-
 const char* modbus_strerror(int errnum) {
   switch (errnum) {
     case EMBXILFUN:
@@ -330,6 +333,55 @@ static int compute_data_length_after_meta(modbus_t* ctx, uint8_t* msg,
   return length;
 }
 
+/* Starts the reception of a message. At the first step, we want to reach the
+   function code because all packets contain this information. */
+void _modbus_rx_init(modbus_t* ctx, modbus_rx_t* rx) {
+  rx->step = _STEP_FUNCTION;
+  rx->length_to_read = ctx->backend->header_length + 1;
+  rx->msg_length = 0;
+}
+
+/* Accounts for nb_received bytes stored at msg + rx->msg_length and, when the
+   current step is complete, computes the length of the next one. The message
+   is complete when rx->length_to_read drops to 0.
+
+   Returns -1 and sets errno to EMBBADDATA if the announced length doesn't fit
+   in an ADU. */
+int _modbus_rx_advance(modbus_t* ctx, modbus_rx_t* rx, uint8_t* msg,
+                       msg_type_t msg_type, int nb_received) {
+  /* Sums bytes received */
+  rx->msg_length += nb_received;
+  /* Computes remaining bytes */
+  rx->length_to_read -= nb_received;
+
+  if (rx->length_to_read == 0) {
+    switch (rx->step) {
+      case _STEP_FUNCTION:
+        /* Function code position */
+        rx->length_to_read = compute_meta_length_after_function(
+            msg[ctx->backend->header_length], msg_type);
+        if (rx->length_to_read != 0) {
+          rx->step = _STEP_META;
+          break;
+        } /* else switches straight to the next step */
+      case _STEP_META:
+        rx->length_to_read = compute_data_length_after_meta(ctx, msg, msg_type);
+        if ((rx->msg_length + rx->length_to_read) >
+            ctx->backend->max_adu_length) {
+          errno = EMBBADDATA;
+          _error_print(ctx, "too many data");
+          return -1;
+        }
+        rx->step = _STEP_DATA;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return 0;
+}
+
 /* Waits a response from a modbus server or a request from a modbus client.
    This function blocks if there is no replies (3 timeouts).
 
@@ -344,12 +396,9 @@ static int compute_data_length_after_meta(modbus_t* ctx, uint8_t* msg,
 
 int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
   int rc;
-  fd_set rset;
   struct timeval tv;
   struct timeval* p_tv;
-  unsigned int length_to_read;
-  int msg_length = 0;
-  _step_t step;
+  modbus_rx_t rx;
 #ifdef _WIN32
   int wsa_err;
 #endif
@@ -369,15 +418,8 @@ int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
     return -1;
   }
 
-  /* Add a file descriptor to the set */
-  FD_ZERO(&rset);
-  FD_SET(ctx->s, &rset);
-
-  /* We need to analyse the message step by step.  At the first step, we want
-   * to reach the function code because all packets contain this
-   * information. */
-  step = _STEP_FUNCTION;
-  length_to_read = ctx->backend->header_length + 1;
+  /* We need to analyse the message step by step */
+  _modbus_rx_init(ctx, &rx);
 
   if (msg_type == MSG_INDICATION) {
     /* Wait for a message, we don't know when the message will be received */
@@ -399,8 +441,8 @@ int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
     p_tv = &tv;
   }
 
-  while (length_to_read != 0) {
-    rc = ctx->backend->select(ctx, &rset, p_tv, length_to_read);
+  while (rx.length_to_read != 0) {
+    rc = ctx->backend->select(ctx, p_tv, rx.length_to_read);
     if (rc == -1) {
       _error_print(ctx, "select");
       if (ctx->error_recovery & MODBUS_ERROR_RECOVERY_LINK) {
@@ -428,7 +470,7 @@ int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
       return -1;
     }
 
-    rc = ctx->backend->recv(ctx, msg + msg_length, length_to_read);
+    rc = ctx->backend->recv(ctx, msg + rx.msg_length, rx.length_to_read);
     if (rc == 0) {
       errno = ECONNRESET;
       rc = -1;
@@ -462,39 +504,12 @@ int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
     /* Display the hex code of each character received */
     if (ctx->debug) {
       int i;
-      for (i = 0; i < rc; i++) printf("<%.2X>", msg[msg_length + i]);
+      for (i = 0; i < rc; i++) printf("<%.2X>", msg[rx.msg_length + i]);
     }
 
-    /* Sums bytes received */
-    msg_length += rc;
-    /* Computes remaining bytes */
-    length_to_read -= rc;
-
-    if (length_to_read == 0) {
-      switch (step) {
-        case _STEP_FUNCTION:
-          /* Function code position */
-          length_to_read = compute_meta_length_after_function(
-              msg[ctx->backend->header_length], msg_type);
-          if (length_to_read != 0) {
-            step = _STEP_META;
-            break;
-          } /* else switches straight to the next step */
-        case _STEP_META:
-          length_to_read = compute_data_length_after_meta(ctx, msg, msg_type);
-          if ((msg_length + length_to_read) > ctx->backend->max_adu_length) {
-            errno = EMBBADDATA;
-            _error_print(ctx, "too many data");
-            return -1;
-          }
-          step = _STEP_DATA;
-          break;
-        default:
-          break;
-      }
-    }
+    if (_modbus_rx_advance(ctx, &rx, msg, msg_type, rc) == -1) return -1;
 
-    if (length_to_read > 0 &&
+    if (rx.length_to_read > 0 &&
         (ctx->byte_timeout.tv_sec > 0 || ctx->byte_timeout.tv_usec > 0)) {
       /* If there is no character in the buffer, the allowed timeout
          interval between two consecutive bytes is defined by
@@ -509,7 +524,7 @@ int _modbus_receive_msg(modbus_t* ctx, uint8_t* msg, msg_type_t msg_type) {
 
   if (ctx->debug) printf("\n");
 
-  return ctx->backend->check_integrity(ctx, msg, msg_length);
+  return ctx->backend->check_integrity(ctx, msg, rx.msg_length);
 }
 
 /* Receive the request from a modbus master */
@@ -747,27 +762,27 @@ static int response_exception(modbus_t* ctx, sft_t* sft, int exception_code,
   return rsp_length;
 }
 
-/* Send a response to the received request.
-   Analyses the request and constructs a response.
+/* Analyses the request and constructs the response in rsp (at least
+   MAX_MESSAGE_LENGTH bytes), without the checksum.
 
    If an error occurs, this function construct the response
-   accordingly.
+   accordingly. The input is only flushed after an invalid request when
+   flush is TRUE: a server that does not own the descriptor of ctx (see
+   modbus_server_run()) must not sleep nor read on it.
+
+   Returns the length of the response, 0 when no response must be sent
+   (broadcast in RTU) or -1 with errno set.
 */
-int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
-                 modbus_mapping_t* mb_mapping) {
+static int build_reply(modbus_t* ctx, const uint8_t* req, int req_length,
+                       modbus_mapping_t* mb_mapping, uint8_t* rsp,
+                       unsigned int flush) {
   unsigned int offset;
   int slave;
   int function;
   uint16_t address;
-  uint8_t rsp[MAX_MESSAGE_LENGTH];
   int rsp_length = 0;
   sft_t sft;
 
-  if (ctx == NULL) {
-    errno = EINVAL;
-    return -1;
-  }
-
   offset = ctx->backend->header_length;
   slave = req[offset - 1];
   function = req[offset];
@@ -795,7 +810,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
 
       if (nb < 1 || MODBUS_MAX_READ_BITS < nb) {
         rsp_length = response_exception(
-            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, TRUE,
+            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, flush,
             "Illegal nb of values %d in %s (max %d)\n", nb, name,
             MODBUS_MAX_READ_BITS);
       } else if (mapping_address < 0 || (mapping_address + nb) > nb_bits) {
@@ -828,7 +843,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
 
       if (nb < 1 || MODBUS_MAX_READ_REGISTERS < nb) {
         rsp_length = response_exception(
-            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, TRUE,
+            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, flush,
             "Illegal nb of values %d in %s (max %d)\n", nb, name,
             MODBUS_MAX_READ_REGISTERS);
       } else if (mapping_address < 0 || (mapping_address + nb) > nb_registers) {
@@ -921,7 +936,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
          * invalid address (eg. nb is 0 but the request contains values to
          * write) so it's necessary to flush. */
         rsp_length = response_exception(
-            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, TRUE,
+            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, flush,
             "Illegal number of values %d in write_bits (max %d)\n", nb,
             MODBUS_MAX_WRITE_BITS);
       } else if (mapping_address < 0 ||
@@ -948,7 +963,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
 
       if (nb < 1 || MODBUS_MAX_WRITE_REGISTERS < nb || nb_bytes != nb * 2) {
         rsp_length = response_exception(
-            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, TRUE,
+            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, flush,
             "Illegal number of values %d in write_registers (max %d)\n", nb,
             MODBUS_MAX_WRITE_REGISTERS);
       } else if (mapping_address < 0 ||
@@ -1036,7 +1051,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
       if (nb_write < 1 || MODBUS_MAX_WR_WRITE_REGISTERS < nb_write || nb < 1 ||
           MODBUS_MAX_WR_READ_REGISTERS < nb || nb_write_bytes != nb_write * 2) {
         rsp_length = response_exception(
-            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, TRUE,
+            ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, rsp, flush,
             "Illegal nb of values (W%d, R%d) in write_and_read_registers (max "
             "W%d, "
             "R%d)\n",
@@ -1077,7 +1092,7 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
 
     default:
       rsp_length = response_exception(
-          ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, rsp, TRUE,
+          ctx, &sft, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, rsp, flush,
           "Unknown Modbus function code: 0x%0X\n", function);
       break;
   }
@@ -1089,23 +1104,64 @@ int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
       !(ctx->quirks & MODBUS_QUIRK_REPLY_TO_BROADCAST)) {
     return 0;
   }
-  return send_msg(ctx, rsp, rsp_length);
+  return rsp_length;
 }
 
-int modbus_reply_exception(modbus_t* ctx, const uint8_t* req,
-                           unsigned int exception_code) {
-  unsigned int offset;
-  int slave;
-  int function;
+/* Send a response to the received request.
+   Analyses the request and constructs a response.
+
+   If an error occurs, this function construct the response
+   accordingly.
+*/
+int modbus_reply(modbus_t* ctx, const uint8_t* req, int req_length,
+                 modbus_mapping_t* mb_mapping) {
   uint8_t rsp[MAX_MESSAGE_LENGTH];
   int rsp_length;
-  sft_t sft;
 
   if (ctx == NULL) {
     errno = EINVAL;
     return -1;
   }
 
+  rsp_length = build_reply(ctx, req, req_length, mb_mapping, rsp, TRUE);
+  if (rsp_length <= 0) {
+    return rsp_length;
+  }
+  return send_msg(ctx, rsp, rsp_length);
+}
+
+/* Same response as modbus_reply() but written into rsp (at least
+   MODBUS_MAX_ADU_LENGTH bytes) instead of being sent, checksum included, so
+   that the caller sends it on its own descriptor. Nothing is read nor flushed
+   on ctx.
+
+   Returns the length of the response, 0 when no response must be sent or -1
+   with errno set. */
+int modbus_build_reply(modbus_t* ctx, const uint8_t* req, int req_length,
+                       modbus_mapping_t* mb_mapping, uint8_t* rsp) {
+  int rsp_length;
+
+  if (ctx == NULL || req == NULL || rsp == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  rsp_length = build_reply(ctx, req, req_length, mb_mapping, rsp, FALSE);
+  if (rsp_length <= 0) {
+    return rsp_length;
+  }
+  return ctx->backend->send_msg_pre(rsp, rsp_length);
+}
+
+/* Builds the exception response to req in rsp, without the checksum */
+static int build_reply_exception(modbus_t* ctx, const uint8_t* req,
+                                 unsigned int exception_code, uint8_t* rsp) {
+  unsigned int offset;
+  int slave;
+  int function;
+  int rsp_length;
+  sft_t sft;
+
   offset = ctx->backend->header_length;
   slave = req[offset - 1];
   function = req[offset];
@@ -1118,13 +1174,47 @@ int modbus_reply_exception(modbus_t* ctx, const uint8_t* req,
   /* Positive exception code */
   if (exception_code < MODBUS_EXCEPTION_MAX) {
     rsp[rsp_length++] = exception_code;
-    return send_msg(ctx, rsp, rsp_length);
+    return rsp_length;
   } else {
     errno = EINVAL;
     return -1;
   }
 }
 
+int modbus_reply_exception(modbus_t* ctx, const uint8_t* req,
+                           unsigned int exception_code) {
+  uint8_t rsp[MAX_MESSAGE_LENGTH];
+  int rsp_length;
+
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  rsp_length = build_reply_exception(ctx, req, exception_code, rsp);
+  if (rsp_length == -1) {
+    return -1;
+  }
+  return send_msg(ctx, rsp, rsp_length);
+}
+
+/* Exception counterpart of modbus_build_reply() */
+int modbus_build_reply_exception(modbus_t* ctx, const uint8_t* req,
+                                 unsigned int exception_code, uint8_t* rsp) {
+  int rsp_length;
+
+  if (ctx == NULL || req == NULL || rsp == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  rsp_length = build_reply_exception(ctx, req, exception_code, rsp);
+  if (rsp_length == -1) {
+    return -1;
+  }
+  return ctx->backend->send_msg_pre(rsp, rsp_length);
+}
+
 /* Reads IO status */
 static int read_io_status(modbus_t* ctx, int function, int addr, int nb,
                           uint8_t* dest) {
@@ -1308,6 +1398,604 @@ int modbus_read_input_registers(modbus_t* ctx, int addr, int nb,
   return status;
 }
 
+/* Sets the number of requests allowed in flight on the connection. A window
+   of 0 disables the pipeline mode. Only available with the TCP backends
+   because the responses are matched by transaction ID. */
+int modbus_set_pipeline_window(modbus_t* ctx, int window) {
+  modbus_pipeline_t* pipeline;
+
+  if (ctx == NULL || window < 0 || window > MODBUS_MAX_PIPELINE_WINDOW ||
+      ctx->backend->backend_type != _MODBUS_BACKEND_TYPE_TCP) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ctx->pipeline != NULL) {
+    if (ctx->pipeline->nb_pending > 0) {
+      /* Can't resize while responses are expected */
+      errno = EBUSY;
+      return -1;
+    }
+    free(ctx->pipeline->pending);
+    free(ctx->pipeline);
+    ctx->pipeline = NULL;
+  }
+
+  if (window == 0) return 0;
+
+  pipeline = (modbus_pipeline_t*)malloc(sizeof(modbus_pipeline_t));
+  if (pipeline == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  pipeline->pending =
+      (modbus_pending_t*)calloc(window, sizeof(modbus_pending_t));
+  if (pipeline->pending == NULL) {
+    free(pipeline);
+    errno = ENOMEM;
+    return -1;
+  }
+  pipeline->window = window;
+  pipeline->nb_pending = 0;
+  ctx->pipeline = pipeline;
+
+  return 0;
+}
+
+int modbus_get_pipeline_window(modbus_t* ctx) {
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return ctx->pipeline != NULL ? ctx->pipeline->window : 0;
+}
+
+/* Sends a read request without waiting for the response. The values will be
+   written to dest by modbus_pipeline_receive() so dest must stay valid until
+   the response has been received or discarded.
+
+   Returns the transaction ID of the request, or -1 with errno set to EBUSY
+   when the window is full. */
+static int pipeline_send_read(modbus_t* ctx, int function, int addr, int nb,
+                              uint16_t* dest) {
+  modbus_pipeline_t* pipeline;
+  modbus_pending_t* pending = NULL;
+  int req_length;
+  int rc;
+  int i;
+
+  if (ctx == NULL || dest == NULL || ctx->pipeline == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (nb > MODBUS_MAX_READ_REGISTERS) {
+    if (ctx->debug) {
+      fprintf(stderr, "ERROR Too many registers requested (%d > %d)\n", nb,
+              MODBUS_MAX_READ_REGISTERS);
+    }
+    errno = EMBMDATA;
+    return -1;
+  }
+
+  pipeline = ctx->pipeline;
+  for (i = 0; i < pipeline->window; i++) {
+    if (!pipeline->pending[i].in_use) {
+      pending = &pipeline->pending[i];
+      break;
+    }
+  }
+
+  if (pending == NULL) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  req_length =
+      ctx->backend->build_request_basis(ctx, function, addr, nb, pending->req);
+
+  rc = send_msg(ctx, pending->req, req_length);
+  if (rc == -1) return -1;
+
+  pending->in_use = TRUE;
+  pending->t_id = ctx->backend->get_response_tid(pending->req);
+  pending->dest = dest;
+  pipeline->nb_pending++;
+
+  return pending->t_id;
+}
+
+int modbus_pipeline_send_read_registers(modbus_t* ctx, int addr, int nb,
+                                        uint16_t* dest) {
+  return pipeline_send_read(ctx, MODBUS_FC_READ_HOLDING_REGISTERS, addr, nb,
+                            dest);
+}
+
+int modbus_pipeline_send_read_input_registers(modbus_t* ctx, int addr, int nb,
+                                              uint16_t* dest) {
+  return pipeline_send_read(ctx, MODBUS_FC_READ_INPUT_REGISTERS, addr, nb,
+                            dest);
+}
+
+/* Receives the next response, whatever the request it answers. The
+   transaction ID of the completed request is stored in tid (if not NULL) and
+   the values are written to the dest given when the request was sent.
+
+   Returns the number of values read. On an exception or invalid response the
+   request is completed too: -1 is returned with errno set and tid filled. On
+   a timeout, tid is set to -1 and the requests stay pending (see
+   modbus_pipeline_discard()). */
+int modbus_pipeline_receive(modbus_t* ctx, int* tid) {
+  modbus_pipeline_t* pipeline;
+  modbus_pending_t* pending = NULL;
+  uint8_t rsp[MAX_MESSAGE_LENGTH];
+  unsigned int offset;
+  int rsp_tid;
+  int rc;
+  int i;
+
+  if (tid != NULL) *tid = -1;
+
+  if (ctx == NULL || ctx->pipeline == NULL ||
+      ctx->pipeline->nb_pending == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pipeline = ctx->pipeline;
+
+  rc = _modbus_receive_msg(ctx, rsp, MSG_CONFIRMATION);
+  if (rc == -1) return -1;
+
+  rsp_tid = ctx->backend->get_response_tid(rsp);
+  for (i = 0; i < pipeline->window; i++) {
+    if (pipeline->pending[i].in_use && pipeline->pending[i].t_id == rsp_tid) {
+      pending = &pipeline->pending[i];
+      break;
+    }
+  }
+
+  if (pending == NULL) {
+    if (ctx->debug) {
+      fprintf(stderr, "Response with unexpected transaction ID 0x%X\n",
+              rsp_tid);
+    }
+    errno = EMBBADDATA;
+    return -1;
+  }
+
+  pending->in_use = FALSE;
+  pipeline->nb_pending--;
+  if (tid != NULL) *tid = rsp_tid;
+
+  rc = check_confirmation(ctx, pending->req, rsp, rc);
+  if (rc == -1) return -1;
+
+  offset = ctx->backend->header_length;
+  for (i = 0; i < rc; i++) {
+    pending->dest[i] =
+        (rsp[offset + 2 + (i << 1)] << 8) | rsp[offset + 3 + (i << 1)];
+  }
+
+  return rc;
+}
+
+/* Returns the number of requests waiting for a response */
+int modbus_pipeline_pending(modbus_t* ctx) {
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return ctx->pipeline != NULL ? ctx->pipeline->nb_pending : 0;
+}
+
+/* Forgets all the pending requests (i.e. after a timeout) and flushes the
+   late responses still in the socket. Returns the number of requests
+   discarded. */
+int modbus_pipeline_discard(modbus_t* ctx) {
+  int nb_pending;
+  int i;
+
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ctx->pipeline == NULL) return 0;
+
+  nb_pending = ctx->pipeline->nb_pending;
+  for (i = 0; i < ctx->pipeline->window; i++) {
+    ctx->pipeline->pending[i].in_use = FALSE;
+  }
+  ctx->pipeline->nb_pending = 0;
+
+  if (nb_pending > 0 && modbus_get_socket(ctx) >= 0) modbus_flush(ctx);
+
+  return nb_pending;
+}
+
+/* Monotonic clock in microseconds, for the deadlines of the non-blocking
+   requests */
+static int64_t _modbus_monotonic_us(void) {
+#ifdef _WIN32
+  return (int64_t)GetTickCount64() * 1000;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/* Waits until the descriptor is readable, or writable when for_write is TRUE,
+   like select() on this single descriptor but without fd_set: FD_SET() on a
+   descriptor >= FD_SETSIZE writes past the set, which a server with many
+   connections reaches quickly. As Linux's select(), tv (NULL to wait forever)
+   is updated with the time left and the wait resumes after a signal.
+
+   Returns 1 when the descriptor is ready, 0 on timeout or -1 with errno
+   set. */
+int _modbus_wait_fd(modbus_t* ctx, int s, int for_write, struct timeval* tv) {
+#ifdef _WIN32
+  /* A Winsock fd_set is a list of sockets, not a bitmap */
+  fd_set set;
+
+  FD_ZERO(&set);
+  FD_SET(s, &set);
+  return select(s + 1, for_write ? NULL : &set, for_write ? &set : NULL, NULL,
+                tv);
+#else
+  struct pollfd pfd;
+  int64_t deadline = 0;
+  int64_t remaining = 0;
+  int rc;
+
+  pfd.fd = s;
+  pfd.events = for_write ? POLLOUT : POLLIN;
+  if (tv != NULL) {
+    deadline = _modbus_monotonic_us() + (int64_t)tv->tv_sec * 1000000 +
+               tv->tv_usec;
+  }
+
+  for (;;) {
+#ifdef __linux__
+    struct timespec ts;
+
+    if (tv != NULL) {
+      remaining = deadline - _modbus_monotonic_us();
+      if (remaining < 0) {
+        remaining = 0;
+      }
+      ts.tv_sec = remaining / 1000000;
+      ts.tv_nsec = (remaining % 1000000) * 1000;
+    }
+    rc = ppoll(&pfd, 1, tv != NULL ? &ts : NULL, NULL);
+#else
+    int timeout_ms = -1;
+
+    if (tv != NULL) {
+      remaining = deadline - _modbus_monotonic_us();
+      if (remaining < 0) {
+        remaining = 0;
+      }
+      /* Rounded up, poll() must not report a timeout too soon */
+      remaining = (remaining + 999) / 1000;
+      timeout_ms = remaining > INT_MAX ? INT_MAX : (int)remaining;
+    }
+    rc = poll(&pfd, 1, timeout_ms);
+#endif
+    if (rc != -1 || errno != EINTR) {
+      break;
+    }
+    if (ctx->debug) {
+      fprintf(stderr, "A non blocked signal was caught\n");
+    }
+  }
+
+  if (tv != NULL) {
+    remaining = deadline - _modbus_monotonic_us();
+    if (remaining < 0 || rc == 0) {
+      remaining = 0;
+    }
+    tv->tv_sec = remaining / 1000000;
+    tv->tv_usec = remaining % 1000000;
+  }
+  /* POLLHUP and POLLERR count as readable, as with select() the next read
+     reports the error */
+  return rc > 0 ? 1 : rc;
+#endif
+}
+
+/* Returns the slot of the non-blocking request, allocated on first use, or
+   NULL with errno set to EBUSY if a request is still in flight */
+static modbus_async_t* async_acquire(modbus_t* ctx) {
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (ctx->async == NULL) {
+    ctx->async = (modbus_async_t*)malloc(sizeof(modbus_async_t));
+    if (ctx->async == NULL) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    memset(ctx->async, 0, sizeof(modbus_async_t));
+  }
+
+  if (ctx->async->in_use) {
+    errno = EBUSY;
+    return NULL;
+  }
+
+  return ctx->async;
+}
+
+/* Sends the request built in async->req and arms the response timeout */
+static int async_start(modbus_t* ctx, int function, int req_length,
+                       uint16_t* dest) {
+  modbus_async_t* async = ctx->async;
+  int rc;
+
+  rc = send_msg(ctx, async->req, req_length);
+  if (rc == -1) return -1;
+
+  async->in_use = TRUE;
+  async->function = function;
+  async->dest = dest;
+  async->rc = -1;
+  async->error = 0;
+  _modbus_rx_init(ctx, &async->rx);
+  async->deadline = _modbus_monotonic_us() +
+                    (int64_t)ctx->response_timeout.tv_sec * 1000000 +
+                    ctx->response_timeout.tv_usec;
+
+  return rc;
+}
+
+static int async_complete(modbus_t* ctx, int rc) {
+  ctx->async->in_use = FALSE;
+  ctx->async->rc = rc;
+  ctx->async->error = (rc == -1) ? errno : 0;
+
+  return 1;
+}
+
+static int async_send_read(modbus_t* ctx, int function, int addr, int nb,
+                           uint16_t* dest) {
+  modbus_async_t* async;
+  int req_length;
+
+  if (ctx != NULL && dest == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  async = async_acquire(ctx);
+  if (async == NULL) return -1;
+
+  if (nb > MODBUS_MAX_READ_REGISTERS) {
+    if (ctx->debug) {
+      fprintf(stderr, "ERROR Too many registers requested (%d > %d)\n", nb,
+              MODBUS_MAX_READ_REGISTERS);
+    }
+    errno = EMBMDATA;
+    return -1;
+  }
+
+  req_length =
+      ctx->backend->build_request_basis(ctx, function, addr, nb, async->req);
+
+  return async_start(ctx, function, req_length, dest);
+}
+
+/* Sends a request to read holding registers and returns without waiting for
+   the response. The values are written to dest by modbus_async_process() so
+   the array must stay valid until the request completes. */
+int modbus_async_send_read_registers(modbus_t* ctx, int addr, int nb,
+                                     uint16_t* dest) {
+  return async_send_read(ctx, MODBUS_FC_READ_HOLDING_REGISTERS, addr, nb,
+                         dest);
+}
+
+int modbus_async_send_read_input_registers(modbus_t* ctx, int addr, int nb,
+                                           uint16_t* dest) {
+  return async_send_read(ctx, MODBUS_FC_READ_INPUT_REGISTERS, addr, nb, dest);
+}
+
+int modbus_async_send_write_register(modbus_t* ctx, int addr,
+                                     const uint16_t value) {
+  modbus_async_t* async;
+  int req_length;
+
+  async = async_acquire(ctx);
+  if (async == NULL) return -1;
+
+  req_length = ctx->backend->build_request_basis(
+      ctx, MODBUS_FC_WRITE_SINGLE_REGISTER, addr, (int)value, async->req);
+
+  return async_start(ctx, MODBUS_FC_WRITE_SINGLE_REGISTER, req_length, NULL);
+}
+
+int modbus_async_send_write_registers(modbus_t* ctx, int addr, int nb,
+                                      const uint16_t* src) {
+  modbus_async_t* async;
+  int req_length;
+  int i;
+
+  if (ctx != NULL && src == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  async = async_acquire(ctx);
+  if (async == NULL) return -1;
+
+  if (nb > MODBUS_MAX_WRITE_REGISTERS) {
+    if (ctx->debug) {
+      fprintf(stderr, "ERROR Trying to write to too many registers (%d > %d)\n",
+              nb, MODBUS_MAX_WRITE_REGISTERS);
+    }
+    errno = EMBMDATA;
+    return -1;
+  }
+
+  req_length = ctx->backend->build_request_basis(
+      ctx, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, addr, nb, async->req);
+  async->req[req_length++] = nb * 2;
+
+  for (i = 0; i < nb; i++) {
+    async->req[req_length++] = src[i] >> 8;
+    async->req[req_length++] = src[i] & 0x00FF;
+  }
+
+  return async_start(ctx, MODBUS_FC_WRITE_MULTIPLE_REGISTERS, req_length,
+                     NULL);
+}
+
+/* Reads the bytes of the response available on the socket (or serial line)
+   without blocking. To be called when modbus_get_socket() is readable or when
+   the delay given by modbus_async_timeout() has elapsed.
+
+   Returns 0 if the response is still incomplete and 1 once the request is
+   completed, successfully or not: its result is then given by
+   modbus_async_result(). Returns -1 with errno set to EINVAL if no request is
+   in flight. */
+int modbus_async_process(modbus_t* ctx) {
+  modbus_async_t* async;
+  struct timeval tv;
+  int rc;
+  int i;
+
+  if (ctx == NULL || ctx->async == NULL || !ctx->async->in_use) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  async = ctx->async;
+
+  while (async->rx.length_to_read != 0) {
+    /* Only polls the descriptor, the wait is done by the caller */
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+
+    rc = ctx->backend->select(ctx, &tv, async->rx.length_to_read);
+    if (rc == -1) {
+      if (errno != ETIMEDOUT) {
+        _error_print(ctx, "select");
+        return async_complete(ctx, -1);
+      }
+      if (_modbus_monotonic_us() < async->deadline) {
+        /* Nothing more to read for now */
+        return 0;
+      }
+      _error_print(ctx, "select");
+      /* Drops the rest of a late response */
+      modbus_flush(ctx);
+      errno = ETIMEDOUT;
+      return async_complete(ctx, -1);
+    }
+
+    rc = ctx->backend->recv(ctx, async->rsp + async->rx.msg_length,
+                            async->rx.length_to_read);
+    if (rc == 0) {
+      errno = ECONNRESET;
+      rc = -1;
+    }
+
+    if (rc == -1) {
+      _error_print(ctx, "read");
+      return async_complete(ctx, -1);
+    }
+
+    if (ctx->debug) {
+      for (i = 0; i < rc; i++) {
+        printf("<%.2X>", async->rsp[async->rx.msg_length + i]);
+      }
+    }
+
+    if (_modbus_rx_advance(ctx, &async->rx, async->rsp, MSG_CONFIRMATION,
+                           rc) == -1) {
+      return async_complete(ctx, -1);
+    }
+
+    if (async->rx.length_to_read > 0 &&
+        (ctx->byte_timeout.tv_sec > 0 || ctx->byte_timeout.tv_usec > 0)) {
+      /* Same rule as _modbus_receive_msg(): once a byte is received, the
+         next one must come before the byte timeout */
+      async->deadline = _modbus_monotonic_us() +
+                        (int64_t)ctx->byte_timeout.tv_sec * 1000000 +
+                        ctx->byte_timeout.tv_usec;
+    }
+  }
+
+  if (ctx->debug) printf("\n");
+
+  rc = ctx->backend->check_integrity(ctx, async->rsp, async->rx.msg_length);
+  if (rc != -1) rc = check_confirmation(ctx, async->req, async->rsp, rc);
+
+  if (rc != -1 && async->dest != NULL) {
+    unsigned int offset = ctx->backend->header_length;
+
+    for (i = 0; i < rc; i++) {
+      async->dest[i] = (async->rsp[offset + 2 + (i << 1)] << 8) |
+                       async->rsp[offset + 3 + (i << 1)];
+    }
+  }
+
+  return async_complete(ctx, rc);
+}
+
+/* Returns the result of the last completed non-blocking request, as the
+   equivalent blocking call would (number of values, or -1 with errno set) */
+int modbus_async_result(modbus_t* ctx) {
+  if (ctx == NULL || ctx->async == NULL || ctx->async->in_use) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ctx->async->rc == -1) errno = ctx->async->error;
+
+  return ctx->async->rc;
+}
+
+/* Returns TRUE while a non-blocking request waits for its response */
+int modbus_async_pending(modbus_t* ctx) {
+  if (ctx == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return ctx->async != NULL && ctx->async->in_use;
+}
+
+/* Returns the delay in milliseconds before the request in flight times out
+   (0 if already expired), to be used as timeout of select/poll/epoll_wait.
+   Returns -1 if no request is in flight. */
+int modbus_async_timeout(modbus_t* ctx) {
+  int64_t remaining;
+
+  if (ctx == NULL || ctx->async == NULL || !ctx->async->in_use) return -1;
+
+  remaining = ctx->async->deadline - _modbus_monotonic_us();
+  if (remaining <= 0) return 0;
+
+  /* Rounded up so the deadline has passed when the caller wakes up */
+  return (int)((remaining + 999) / 1000);
+}
+
+/* Abandons the request in flight, a late response is flushed */
+void modbus_async_cancel(modbus_t* ctx) {
+  if (ctx == NULL || ctx->async == NULL || !ctx->async->in_use) return;
+
+  ctx->async->in_use = FALSE;
+  ctx->async->rc = -1;
+  ctx->async->error = ECANCELED;
+  if (modbus_get_socket(ctx) >= 0) modbus_flush(ctx);
+}
+
 /* Write a value to the specified register of the remote device.
    Used by write_bit and write_register */
 static int write_single(modbus_t* ctx, int function, int addr,
@@ -1628,6 +2316,9 @@ void _modbus_init_common(modbus_t* ctx) {
 
   ctx->indication_timeout.tv_sec = 0;
   ctx->indication_timeout.tv_usec = 0;
+
+  ctx->pipeline = NULL;
+  ctx->async = NULL;
 }
 
 /* Define the slave number */
@@ -1803,11 +2494,21 @@ void modbus_close(modbus_t* ctx) {
   if (ctx == NULL) return;
 
   ctx->backend->close(ctx);
+
+  /* The responses of the pending requests are lost with the connection */
+  if (ctx->pipeline != NULL) modbus_pipeline_discard(ctx);
+  if (ctx->async != NULL) ctx->async->in_use = FALSE;
 }
 
 void modbus_free(modbus_t* ctx) {
   if (ctx == NULL) return;
 
+  if (ctx->pipeline != NULL) {
+    free(ctx->pipeline->pending);
+    free(ctx->pipeline);
+  }
+  free(ctx->async);
+
   ctx->backend->free(ctx);
 }
 
@@ -242,6 +242,44 @@ MODBUS_API int modbus_write_and_read_registers(modbus_t *ctx,
                                                uint16_t *dest);
 MODBUS_API int modbus_report_slave_id(modbus_t *ctx, int max_dest, uint8_t *dest);
 
+/* Pipelined requests (TCP only): up to 'window' requests are sent before the
+ * responses are read back, responses are matched by transaction ID. */
+#define MODBUS_MAX_PIPELINE_WINDOW 64
+
+MODBUS_API int modbus_set_pipeline_window(modbus_t *ctx, int window);
+MODBUS_API int modbus_get_pipeline_window(modbus_t *ctx);
+MODBUS_API int
+modbus_pipeline_send_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+MODBUS_API int modbus_pipeline_send_read_input_registers(modbus_t *ctx,
+                                                         int addr,
+                                                         int nb,
+                                                         uint16_t *dest);
+MODBUS_API int modbus_pipeline_receive(modbus_t *ctx, int *tid);
+MODBUS_API int modbus_pipeline_pending(modbus_t *ctx);
+MODBUS_API int modbus_pipeline_discard(modbus_t *ctx);
+
+/* Non-blocking requests (one in flight per context): the request is sent at
+ * once, modbus_async_process() reads the response when the descriptor given
+ * by modbus_get_socket() is readable, so a single event loop can drive many
+ * contexts. */
+MODBUS_API int
+modbus_async_send_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+MODBUS_API int modbus_async_send_read_input_registers(modbus_t *ctx,
+                                                      int addr,
+                                                      int nb,
+                                                      uint16_t *dest);
+MODBUS_API int
+modbus_async_send_write_register(modbus_t *ctx, int addr, const uint16_t value);
+MODBUS_API int modbus_async_send_write_registers(modbus_t *ctx,
+                                                 int addr,
+                                                 int nb,
+                                                 const uint16_t *src);
+MODBUS_API int modbus_async_process(modbus_t *ctx);
+MODBUS_API int modbus_async_result(modbus_t *ctx);
+MODBUS_API int modbus_async_pending(modbus_t *ctx);
+MODBUS_API int modbus_async_timeout(modbus_t *ctx);
+MODBUS_API void modbus_async_cancel(modbus_t *ctx);
+
 MODBUS_API modbus_mapping_t *
 modbus_mapping_new_start_address(unsigned int start_bits,
                                  unsigned int nb_bits,
@@ -276,6 +314,17 @@ MODBUS_API int modbus_reply(modbus_t *ctx,
                             modbus_mapping_t *mb_mapping);
 MODBUS_API int
 modbus_reply_exception(modbus_t *ctx, const uint8_t *req, unsigned int exception_code);
+/* Same responses written into rsp (MODBUS_MAX_ADU_LENGTH bytes) instead of
+ * being sent, for servers that own the connections (see modbus_server_run) */
+MODBUS_API int modbus_build_reply(modbus_t *ctx,
+                                  const uint8_t *req,
+                                  int req_length,
+                                  modbus_mapping_t *mb_mapping,
+                                  uint8_t *rsp);
+MODBUS_API int modbus_build_reply_exception(modbus_t *ctx,
+                                            const uint8_t *req,
+                                            unsigned int exception_code,
+                                            uint8_t *rsp);
 MODBUS_API int modbus_enable_quirks(modbus_t *ctx, unsigned int quirks_mask);
 MODBUS_API int modbus_disable_quirks(modbus_t *ctx, unsigned int quirks_mask);
 
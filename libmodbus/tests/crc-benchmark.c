@@ -0,0 +1,143 @@
+/*
+ * Copyright © Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <modbus.h>
+
+/* Compares modbus_rtu_crc16() with the byte-wise two-table CRC used by
+ * previous versions of libmodbus on typical RTU frame sizes. */
+
+#define NB_BUFFERS 64
+#define MIN_DURATION_NS 200000000LL /* 0.2 s per measure */
+
+static uint8_t table_hi[256];
+static uint8_t table_lo[256];
+
+/* Same tables and loop as the historical crc16() of modbus-rtu.c */
+static void legacy_init(void)
+{
+    int i;
+    int bit;
+
+    for (i = 0; i < 256; i++) {
+        uint16_t crc = i;
+
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        table_hi[i] = crc & 0xFF;
+        table_lo[i] = crc >> 8;
+    }
+}
+
+static uint16_t legacy_crc16(const uint8_t *buffer, int buffer_length)
+{
+    uint8_t crc_hi = 0xFF;
+    uint8_t crc_lo = 0xFF;
+    unsigned int i;
+
+    while (buffer_length--) {
+        i = crc_lo ^ *buffer++;
+        crc_lo = crc_hi ^ table_hi[i];
+        crc_hi = table_lo[i];
+    }
+
+    return (crc_hi << 8 | crc_lo);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Returns the mean time in ns to compute the CRC of one frame */
+static double measure(uint16_t (*crc16)(const uint8_t *, int),
+                      uint8_t buffers[][MODBUS_RTU_MAX_ADU_LENGTH],
+                      int length,
+                      uint16_t *sink)
+{
+    int64_t start = now_ns();
+    int64_t elapsed;
+    long nb_frames = 0;
+    int i;
+
+    do {
+        for (i = 0; i < 1000; i++) {
+            *sink ^= crc16(buffers[i % NB_BUFFERS], length);
+        }
+        nb_frames += 1000;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_DURATION_NS);
+
+    return (double) elapsed / nb_frames;
+}
+
+int main(void)
+{
+    static uint8_t buffers[NB_BUFFERS][MODBUS_RTU_MAX_ADU_LENGTH];
+    const int lengths[] = {6, 8, 16, 64, 128, 254};
+    uint16_t sink = 0;
+    unsigned int n;
+    int i;
+    int j;
+
+    legacy_init();
+    srand(1);
+    for (i = 0; i < NB_BUFFERS; i++) {
+        for (j = 0; j < MODBUS_RTU_MAX_ADU_LENGTH; j++) {
+            buffers[i][j] = rand() & 0xFF;
+        }
+    }
+
+    /* Same results for every length and when fed in arbitrary chunks */
+    for (i = 0; i < NB_BUFFERS; i++) {
+        for (j = 0; j <= MODBUS_RTU_MAX_ADU_LENGTH; j++) {
+            uint16_t expected = legacy_crc16(buffers[i], j);
+            uint16_t crc = MODBUS_RTU_CRC16_INIT;
+            int offset = 0;
+
+            if (modbus_rtu_crc16(buffers[i], j) != expected) {
+                printf("CRC mismatch (buffer %d, length %d)\n", i, j);
+                return 1;
+            }
+            while (offset < j) {
+                int chunk = 1 + rand() % 11;
+
+                if (chunk > j - offset) {
+                    chunk = j - offset;
+                }
+                crc = modbus_rtu_crc16_update(crc, buffers[i] + offset, chunk);
+                offset += chunk;
+            }
+            if (crc != expected) {
+                printf("Incremental CRC mismatch (buffer %d, length %d)\n", i, j);
+                return 1;
+            }
+        }
+    }
+
+    printf("Frame length   byte-wise     sliced        speedup\n");
+    for (n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++) {
+        double legacy = measure(legacy_crc16, buffers, lengths[n], &sink);
+        double sliced = measure(modbus_rtu_crc16, buffers, lengths[n], &sink);
+
+        printf("%-14d %-8.1f ns   %-8.1f ns   x%.2f\n",
+               lengths[n],
+               legacy,
+               sliced,
+               legacy / sliced);
+    }
+    printf("(checksum %04X)\n", sink);
+
+    return 0;
+}
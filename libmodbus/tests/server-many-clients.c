@@ -0,0 +1,207 @@
+/*
+ * Copyright © Stéphane Raimbault <stephane.raimbault@gmail.com>
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <modbus.h>
+
+/* Serves a mapping with modbus_server_run() in a child process and connects
+ * thousands of clients to it: every client sends its request before any
+ * response is read, so the server really holds all of them at once. Client
+ * descriptors go past FD_SETSIZE, which the receive path of libmodbus must
+ * handle without fd_set. */
+
+#define SERVER_PORT     1503
+#define NB_CLIENTS      2000
+#define NB_ROUNDS       5
+#define NB_REGISTERS    10
+#define MAX_CONNECTIONS NB_CLIENTS
+
+static modbus_server_t *server = NULL;
+
+static void stop_server(int signum)
+{
+    (void) signum;
+    modbus_server_stop(server);
+}
+
+static int run_server(int ready_fd)
+{
+    modbus_t *ctx;
+    modbus_mapping_t *mb_mapping;
+    int s;
+    int rc;
+    int i;
+
+    ctx = modbus_new_tcp("127.0.0.1", SERVER_PORT);
+    mb_mapping = modbus_mapping_new(0, 0, NB_REGISTERS, 0);
+    if (ctx == NULL || mb_mapping == NULL) {
+        return 1;
+    }
+    for (i = 0; i < NB_REGISTERS; i++) {
+        mb_mapping->tab_registers[i] = 0x100 + i;
+    }
+
+    s = modbus_tcp_listen(ctx, 1024);
+    server = s == -1 ? NULL : modbus_server_new(ctx, s, MAX_CONNECTIONS);
+    if (server == NULL || modbus_server_set_mapping(server, mb_mapping) == -1) {
+        fprintf(stderr, "Unable to start the server: %s\n", modbus_strerror(errno));
+        return 1;
+    }
+
+    signal(SIGTERM, stop_server);
+    if (write(ready_fd, "r", 1) != 1) {
+        return 1;
+    }
+    close(ready_fd);
+
+    rc = modbus_server_run(server);
+
+    modbus_server_free(server);
+    close(s);
+    modbus_mapping_free(mb_mapping);
+    modbus_free(ctx);
+    return rc == 0 ? 0 : 1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    static modbus_t *clients[NB_CLIENTS];
+    /* Read holding registers 0..NB_REGISTERS, unit 1 */
+    const uint8_t raw_req[] = {0x01, 0x03, 0x00, 0x00, 0x00, NB_REGISTERS};
+    uint8_t rsp[MODBUS_TCP_MAX_ADU_LENGTH];
+    struct rlimit limit;
+    modbus_t *extra;
+    uint16_t value;
+    int ready[2];
+    int status;
+    int nb_fail = 0;
+    int max_fd = 0;
+    double start;
+    pid_t pid;
+    int round;
+    int i;
+    char c;
+
+    /* Both ends of every connection live in this test */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 2 * NB_CLIENTS + 64) {
+        limit.rlim_cur =
+            limit.rlim_max < 2 * NB_CLIENTS + 64 ? limit.rlim_max : 2 * NB_CLIENTS + 64;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < NB_CLIENTS + 64) {
+        printf("SKIPPED: %d descriptors needed, limit is %lu\n",
+               NB_CLIENTS + 64,
+               (unsigned long) limit.rlim_cur);
+        return 0;
+    }
+
+    if (pipe(ready) == -1) {
+        return 1;
+    }
+    pid = fork();
+    if (pid == 0) {
+        close(ready[0]);
+        return run_server(ready[1]);
+    }
+    close(ready[1]);
+    if (pid == -1 || read(ready[0], &c, 1) != 1) {
+        fprintf(stderr, "Server not started\n");
+        return 1;
+    }
+    close(ready[0]);
+
+    for (i = 0; i < NB_CLIENTS; i++) {
+        clients[i] = modbus_new_tcp("127.0.0.1", SERVER_PORT);
+        if (clients[i] == NULL || modbus_connect(clients[i]) == -1) {
+            fprintf(stderr, "Client %d: %s\n", i, modbus_strerror(errno));
+            nb_fail++;
+            break;
+        }
+        if (modbus_get_socket(clients[i]) > max_fd) {
+            max_fd = modbus_get_socket(clients[i]);
+        }
+    }
+    printf("%d clients connected, highest descriptor %d (FD_SETSIZE %d)\n",
+           i,
+           max_fd,
+           FD_SETSIZE);
+
+    start = now_s();
+    for (round = 0; nb_fail == 0 && round < NB_ROUNDS; round++) {
+        for (i = 0; i < NB_CLIENTS; i++) {
+            if (modbus_send_raw_request(clients[i], raw_req, sizeof(raw_req)) == -1) {
+                nb_fail++;
+            }
+        }
+        for (i = 0; i < NB_CLIENTS; i++) {
+            int rc = modbus_receive_confirmation(clients[i], rsp);
+
+            /* MBAP (7) + function + byte count, then the values */
+            if (rc != 9 + 2 * NB_REGISTERS || rsp[9] != 0x01 ||
+                rsp[8 + 2 * NB_REGISTERS] != NB_REGISTERS - 1) {
+                fprintf(stderr, "Client %d: bad response (%d)\n", i, rc);
+                nb_fail++;
+                break;
+            }
+        }
+    }
+    if (nb_fail == 0) {
+        printf("%d requests in %.3f s\n",
+               NB_CLIENTS * NB_ROUNDS,
+               now_s() - start);
+    }
+
+    /* A write seen by another connection */
+    if (nb_fail == 0 &&
+        (modbus_write_register(clients[0], 3, 0xBEEF) != 1 ||
+         modbus_read_registers(clients[NB_CLIENTS - 1], 3, 1, &value) != 1 ||
+         value != 0xBEEF)) {
+        fprintf(stderr, "Write not visible from another connection\n");
+        nb_fail++;
+    }
+
+    /* Over the limit, the connection is closed at once */
+    extra = modbus_new_tcp("127.0.0.1", SERVER_PORT);
+    if (nb_fail == 0 && modbus_connect(extra) == 0 &&
+        modbus_read_registers(extra, 0, 1, &value) != -1) {
+        fprintf(stderr, "Connection over the limit accepted\n");
+        nb_fail++;
+    }
+    modbus_close(extra);
+    modbus_free(extra);
+
+    for (i = 0; i < NB_CLIENTS && clients[i] != NULL; i++) {
+        modbus_close(clients[i]);
+        modbus_free(clients[i]);
+    }
+
+    kill(pid, SIGTERM);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Server did not stop cleanly\n");
+        nb_fail++;
+    }
+
+    printf("%s\n", nb_fail == 0 ? "ALL TESTS PASS WITH SUCCESS." : "FAILED");
+    return nb_fail == 0 ? 0 : 1;
+}
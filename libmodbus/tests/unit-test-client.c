@@ -319,6 +319,161 @@ int main(int argc, char *argv[])
     ASSERT_TRUE(
         tab_rp_registers[0] == 0x17, "FAILED (%0X != %0X)\n", tab_rp_registers[0], 0x17);
 
+    /** PIPELINE **/
+    if (use_backend == TCP || use_backend == TCP_PI) {
+        uint16_t tab_pipeline_registers[8];
+        uint16_t tab_pipeline_input[8];
+        int tid_registers;
+        int tid_input;
+        int tid_received;
+        int nb_received = 0;
+
+        printf("\nTEST PIPELINE\n");
+        printf("1/4 modbus_set_pipeline_window: ");
+        rc = modbus_set_pipeline_window(ctx, 2);
+        ASSERT_TRUE(rc == 0 && modbus_get_pipeline_window(ctx) == 2, "");
+
+        printf("2/4 modbus_pipeline_send_read_*: ");
+        tid_registers = modbus_pipeline_send_read_registers(
+            ctx, UT_REGISTERS_ADDRESS, UT_REGISTERS_NB, tab_pipeline_registers);
+        tid_input = modbus_pipeline_send_read_input_registers(
+            ctx, UT_INPUT_REGISTERS_ADDRESS, UT_INPUT_REGISTERS_NB, tab_pipeline_input);
+        ASSERT_TRUE(tid_registers != -1 && tid_input != -1 &&
+                        tid_registers != tid_input &&
+                        modbus_pipeline_pending(ctx) == 2,
+                    "");
+
+        printf("3/4 modbus_pipeline_send_read_registers with full window: ");
+        rc = modbus_pipeline_send_read_registers(
+            ctx, UT_REGISTERS_ADDRESS, UT_REGISTERS_NB, tab_pipeline_registers);
+        ASSERT_TRUE(rc == -1 && errno == EBUSY, "");
+
+        printf("4/4 modbus_pipeline_receive: ");
+        while (modbus_pipeline_pending(ctx) > 0) {
+            rc = modbus_pipeline_receive(ctx, &tid_received);
+            if (tid_received == tid_registers) {
+                ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+            } else {
+                ASSERT_TRUE(tid_received == tid_input && rc == UT_INPUT_REGISTERS_NB,
+                            "FAILED (tid %d, nb points %d)\n",
+                            tid_received,
+                            rc);
+            }
+            nb_received++;
+        }
+        ASSERT_TRUE(nb_received == 2, "FAILED (%d responses)\n", nb_received);
+        ASSERT_TRUE(tab_pipeline_registers[0] == 0x17,
+                    "FAILED (%0X != %0X)\n",
+                    tab_pipeline_registers[0],
+                    0x17);
+        ASSERT_TRUE(tab_pipeline_input[0] == UT_INPUT_REGISTERS_TAB[0],
+                    "FAILED (%0X != %0X)\n",
+                    tab_pipeline_input[0],
+                    UT_INPUT_REGISTERS_TAB[0]);
+    }
+
+    /** NON-BLOCKING **/
+    {
+        uint16_t tab_async_registers[8];
+        fd_set rset;
+        struct timeval tv;
+        int s = modbus_get_socket(ctx);
+
+        printf("\nTEST NON-BLOCKING\n");
+        printf("1/3 modbus_async_send_read_registers: ");
+        rc = modbus_async_send_read_registers(
+            ctx, UT_REGISTERS_ADDRESS, UT_REGISTERS_NB, tab_async_registers);
+        ASSERT_TRUE(rc != -1 && modbus_async_pending(ctx) == 1, "");
+
+        printf("2/3 modbus_async_send_read_registers while pending: ");
+        rc = modbus_async_send_read_registers(
+            ctx, UT_REGISTERS_ADDRESS, UT_REGISTERS_NB, tab_async_registers);
+        ASSERT_TRUE(rc == -1 && errno == EBUSY, "");
+
+        printf("3/3 modbus_async_process: ");
+        do {
+            int timeout_ms = modbus_async_timeout(ctx);
+
+            FD_ZERO(&rset);
+            FD_SET(s, &rset);
+            tv.tv_sec = timeout_ms / 1000;
+            tv.tv_usec = (timeout_ms % 1000) * 1000;
+            select(s + 1, &rset, NULL, NULL, &tv);
+            rc = modbus_async_process(ctx);
+        } while (rc == 0);
+        ASSERT_TRUE(rc == 1 && !modbus_async_pending(ctx), "");
+        rc = modbus_async_result(ctx);
+        ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+        ASSERT_TRUE(tab_async_registers[0] == 0x17,
+                    "FAILED (%0X != %0X)\n",
+                    tab_async_registers[0],
+                    0x17);
+    }
+
+    /** RTU CRC **/
+    printf("\nTEST RTU CRC\n");
+    {
+        /* CRC-16/MODBUS check value of "123456789" and a read request frame
+         * 01 03 00 00 00 0A whose CRC is C5 CD on the wire */
+        const uint8_t check[] = "123456789";
+        uint8_t frame[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+        uint16_t crc = MODBUS_RTU_CRC16_INIT;
+
+        printf("1/3 modbus_rtu_crc16: ");
+        ASSERT_TRUE(modbus_rtu_crc16(check, 9) == 0x4B37 &&
+                        modbus_rtu_crc16(frame, 6) == 0xCDC5,
+                    "FAILED (0x%04X)\n",
+                    modbus_rtu_crc16(check, 9));
+
+        printf("2/3 modbus_rtu_crc16_update byte by byte: ");
+        for (i = 0; i < 9; i++) {
+            crc = modbus_rtu_crc16_update(crc, check + i, 1);
+        }
+        ASSERT_TRUE(crc == 0x4B37, "FAILED (0x%04X)\n", crc);
+
+        printf("3/3 Frame with its CRC gives 0: ");
+        ASSERT_TRUE(modbus_rtu_crc16(frame, sizeof(frame)) == 0, "");
+    }
+
+    /** RTU ADAPTIVE TIMING **/
+    printf("\nTEST RTU ADAPTIVE TIMING\n");
+    if (use_backend == RTU) {
+        uint32_t latency_usec;
+        uint32_t nb_samples;
+        uint32_t timeout_usec;
+
+        printf("1/3 modbus_rtu_set_timing_mode: ");
+        rc = modbus_rtu_set_timing_mode(ctx, MODBUS_RTU_TIMING_ADAPTIVE);
+        ASSERT_TRUE(rc == 0 && modbus_rtu_get_timing_mode(ctx) ==
+                                   MODBUS_RTU_TIMING_ADAPTIVE &&
+                        modbus_rtu_get_frame_gap(ctx) > 0,
+                    "");
+
+        printf("2/3 Latencies of the slave are learned: ");
+        for (i = 0; i < 25; i++) {
+            rc = modbus_read_registers(
+                ctx, UT_REGISTERS_ADDRESS, UT_REGISTERS_NB, tab_rp_registers);
+            ASSERT_TRUE(rc == UT_REGISTERS_NB, "FAILED (nb points %d)\n", rc);
+        }
+        rc = modbus_rtu_get_slave_latency(
+            ctx, SERVER_ID, 0.99, &latency_usec, &nb_samples, NULL);
+        ASSERT_TRUE(rc == 0 && nb_samples == 25 && latency_usec > 0,
+                    "FAILED (%d samples)\n",
+                    nb_samples);
+
+        printf("3/3 Learned timeout below the response timeout: ");
+        rc = modbus_rtu_get_slave_timeout(ctx, SERVER_ID, &timeout_usec);
+        ASSERT_TRUE(rc == 0 && timeout_usec <= old_response_to_sec * 1000000 +
+                                                   old_response_to_usec,
+                    "FAILED (%u us)\n",
+                    timeout_usec);
+        modbus_rtu_set_timing_mode(ctx, MODBUS_RTU_TIMING_STATIC);
+    } else {
+        printf("1/1 modbus_rtu_set_timing_mode refused: ");
+        rc = modbus_rtu_set_timing_mode(ctx, MODBUS_RTU_TIMING_ADAPTIVE);
+        ASSERT_TRUE(rc == -1 && errno == EINVAL, "");
+    }
+
     printf("\nTEST FLOATS\n");
     /** FLOAT **/
     printf("1/4 Set/get float ABCD: ");
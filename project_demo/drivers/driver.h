@@ -1,13 +1,13 @@
 #pragma once
-#include <map>
 #include <string>
 
-using MeterData = std::map<std::string, float>;
+#include "meter_driver/include/sample.h"
 
 class Driver {
  public:
   virtual ~Driver() = default;
   virtual bool connect() = 0;
-  virtual MeterData readData() = 0;
+  // Ghi gia tri moi vao sample tai cho (xem Sample)
+  virtual bool readData(Sample& sample) = 0;
   virtual std::string getDeviceID() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <modbus.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "comm_metrics.h"
+
+// 1. Custom Deleter cho modbus_t*
+struct ModbusDeleter {
+  void operator()(modbus_t* ctx) const {
+    if (ctx) {
+      modbus_close(ctx);
+      modbus_free(ctx);
+      std::cout << "[INFO] Modbus context da dong va giai phong." << std::endl;
+    }
+  }
+};
+// 2. Alias cho unique_ptr an toan
+using ModbusContextPtr = std::unique_ptr<modbus_t, ModbusDeleter>;
+
+/**
+ * @brief Mot thread duy nhat so huu modbus context cua mot bus vat ly
+ *
+ * Moi cong RTU (/dev/ttyS3, /dev/ttyS4...) hoac endpoint TCP co mot
+ * BusExecutor rieng. Cac thread khac khong goi libmodbus truc tiep ma day
+ * job vao hang doi MPSC lock-free; thread cua bus lay job ra va chay tuan tu.
+ * Vi vay khong can mutex quanh bus, va cac bus doc lap chay song song tren
+ * cac core khac nhau.
+ */
+class BusExecutor {
+ public:
+  typedef std::function<void(modbus_t*)> Job;
+
+  // Nhan quyen so huu ctx (da connect), thread bat dau chay ngay
+  BusExecutor(const std::string& name, ModbusContextPtr ctx);
+  ~BusExecutor();
+
+  BusExecutor(const BusExecutor&) = delete;
+  BusExecutor& operator=(const BusExecutor&) = delete;
+
+  const std::string& name() const { return name_; }
+  // Thoi gian ban cua bus (tong thoi gian chay job)
+  const std::shared_ptr<BusMetrics>& metrics() const { return metrics_; }
+
+  // Day job vao hang doi, tra ve false neu executor da dung
+  bool post(Job job);
+
+  // Chay fn tren thread cua bus va cho ket qua (dong bo). Node, ket qua va
+  // trang thai cho deu nam tren stack cua thread goi: khong cap phat heap.
+  template <typename Fn>
+  auto call(Fn fn) -> decltype(fn(static_cast<modbus_t*>(nullptr)));
+
+  // Dung thread sau khi chay het cac job con trong hang doi
+  void stop();
+
+  bool onBusThread() const {
+    return std::this_thread::get_id() == worker_.get_id();
+  }
+
+ private:
+  // Thread goi call() ngu tren day cho toi khi job chay xong
+  struct Waiter {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+  };
+
+  // Hang doi MPSC intrusive (Vyukov): producer chi dung atomic exchange.
+  // Node cua post() cap phat tren heap (chua job); node cua call() nam tren
+  // stack cua caller (chua invoke/arg/waiter) va khong bi delete.
+  struct Node {
+    std::atomic<Node*> next;
+    Job job;
+    void (*invoke)(modbus_t*, void*) = nullptr;
+    void* arg = nullptr;
+    Waiter* waiter = nullptr;
+  };
+
+  // Ket qua cua call(), rieng truong hop void
+  template <typename Result>
+  struct CallResult {
+    Result value;
+    template <typename Fn>
+    void run(Fn& fn, modbus_t* ctx) {
+      value = fn(ctx);
+    }
+    Result get() { return std::move(value); }
+  };
+
+  template <typename Fn, typename Result>
+  struct CallFrame {
+    Fn* fn;
+    CallResult<Result> result;
+    std::exception_ptr error;
+
+    static void invoke(modbus_t* ctx, void* arg) {
+      CallFrame* frame = static_cast<CallFrame*>(arg);
+      try {
+        frame->result.run(*frame->fn, ctx);
+      } catch (...) {
+        frame->error = std::current_exception();
+      }
+    }
+  };
+
+  bool enqueue(Node* node);
+  void push(Node* node);
+  Node* pop();
+  // Cho node tiep theo; nullptr khi da stop() va hang doi da het
+  Node* waitNode();
+  // Chay node; false neu job da huy executor (khong duoc cham member nua)
+  bool runNode(Node* node);
+  void workerLoop();
+
+  std::string name_;
+  ModbusContextPtr ctx_;
+  std::shared_ptr<BusMetrics> metrics_;
+
+  std::atomic<Node*> head_;  // producer ghi
+  Node* tail_;               // chi thread cua bus doc
+  Node stub_;
+
+  std::atomic<bool> stopping_;
+  // Producer dang giua enqueue(): thread cua bus chi thoat khi = 0, nen node
+  // da qua kiem tra stopping_ luon duoc chay
+  std::atomic<int> producers_;
+  std::atomic<bool> sleeping_;
+  std::mutex sleep_mutex_;  // chi dung de ngu/danh thuc, khong bao ve bus
+  std::condition_variable wakeup_;
+  std::thread worker_;
+  // Co tren stack cua workerLoop, dat khi executor bi huy tu chinh job cua
+  // bus; chi thread cua bus doc/ghi
+  bool* destroyed_ = nullptr;
+};
+
+template <>
+struct BusExecutor::CallResult<void> {
+  template <typename Fn>
+  void run(Fn& fn, modbus_t* ctx) {
+    fn(ctx);
+  }
+  void get() {}
+};
+
+template <typename Fn>
+auto BusExecutor::call(Fn fn) -> decltype(fn(static_cast<modbus_t*>(nullptr))) {
+  typedef decltype(fn(static_cast<modbus_t*>(nullptr))) Result;
+
+  // Goi tu chinh thread cua bus (job long nhau): chay truc tiep
+  if (onBusThread()) return fn(ctx_.get());
+
+  CallFrame<Fn, Result> frame;
+  frame.fn = &fn;
+
+  Waiter waiter;
+  Node node;
+  node.invoke = &CallFrame<Fn, Result>::invoke;
+  node.arg = &frame;
+  node.waiter = &waiter;
+
+  if (!enqueue(&node)) {
+    throw std::runtime_error("Bus " + name_ + " da dung.");
+  }
+  {
+    std::unique_lock<std::mutex> lock(waiter.mutex);
+    waiter.cv.wait(lock, [&waiter] { return waiter.done; });
+  }
+
+  if (frame.error) std::rethrow_exception(frame.error);
+  return frame.result.get();
+}
+
+/**
+ * @brief Bang tra cuu BusExecutor theo ten cong/endpoint
+ *
+ * Cac thiet bi cung cau hinh serial_port (hoac cung ip:port) dung chung mot
+ * executor; executor bi huy khi thiet bi cuoi cung giai phong no.
+ */
+class BusRegistry {
+ public:
+  typedef std::function<ModbusContextPtr()> ContextFactory;
+
+  static BusRegistry& instance();
+
+  // Tra ve executor cua key, tao moi bang factory neu chua ton tai
+  std::shared_ptr<BusExecutor> acquire(const std::string& key,
+                                       ContextFactory factory);
+
+ private:
+  std::mutex mutex_;  // chi khoa khi tao/tra cuu, khong khoa khi doc bus
+  std::map<std::string, std::weak_ptr<BusExecutor> > buses_;
+};
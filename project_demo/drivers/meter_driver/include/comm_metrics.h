@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Histogram do tre kieu HDR: 16 o tuyen tinh trong moi quang tam (x2)
+ *
+ * Gia tri (us) < 16 duoc dem chinh xac, gia tri lon hon sai so <= 6.25%, toi
+ * da ~18 phut. record() chi la ba phep cong atomic relaxed, khong khoa va
+ * khong cap phat; nhieu thread co the ghi cung luc voi mot thread doc.
+ */
+class LatencyHistogram {
+ public:
+  static const int kSubBits = 4;
+  static const std::size_t kSubBuckets = 1u << kSubBits;
+  static const int kMaxBit = 30;  // bit cao nhat cua gia tri con phan biet
+  static const std::size_t kBuckets =
+      kSubBuckets + (kMaxBit - kSubBits + 1) * kSubBuckets;
+
+  // Ban sao khong atomic de tinh percentile va xuat ra ngoai
+  struct Snapshot {
+    std::vector<std::uint64_t> counts;
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+
+    // Gia tri (us) ma q (0..1) so mau nho hon hoac bang; 0 neu chua co mau
+    std::uint64_t percentile(double q) const;
+    // So mau chac chan <= value (o cat ngang bien khong duoc tinh)
+    std::uint64_t countAtOrBelow(std::uint64_t value) const;
+  };
+
+  LatencyHistogram();
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void record(std::uint64_t value_us) {
+    buckets_[bucketOf(value_us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value_us, std::memory_order_relaxed);
+  }
+
+  Snapshot snapshot() const;
+
+  static std::size_t bucketOf(std::uint64_t value);
+  // Gia tri lon nhat thuoc o index
+  static std::uint64_t bucketUpper(std::size_t index);
+
+ private:
+  std::atomic<std::uint64_t> buckets_[kBuckets];
+  std::atomic<std::uint64_t> count_;
+  std::atomic<std::uint64_t> sum_;
+};
+
+/**
+ * @brief So lieu truyen thong cua mot thiet bi (mot slave tren mot bus)
+ *
+ * Driver giu con tro va chi tang bo dem tren thread cua bus. Loi duoc phan
+ * loai theo errno cua libmodbus: ETIMEDOUT, loi toan ven (CRC, slave/du lieu
+ * sai - tu check_integrity/check_confirmation), exception cua slave va loi
+ * khac.
+ */
+struct DeviceMetrics {
+  DeviceMetrics(const std::string& device_id, const std::string& bus_name)
+      : device(device_id), bus(bus_name) {}
+
+  // Mot lan thu request: rtt tinh ca khi loi (thoi gian bus bi chiem)
+  void recordAttempt(bool ok, int error, std::uint64_t rtt_us);
+  void recordRetry() { retries.fetch_add(1, std::memory_order_relaxed); }
+
+  const std::string device;
+  const std::string bus;
+
+  std::atomic<std::uint64_t> requests{0};
+  std::atomic<std::uint64_t> responses{0};
+  std::atomic<std::uint64_t> timeouts{0};
+  std::atomic<std::uint64_t> integrity_errors{0};
+  std::atomic<std::uint64_t> exceptions{0};
+  std::atomic<std::uint64_t> other_errors{0};
+  std::atomic<std::uint64_t> retries{0};
+  std::atomic<std::uint64_t> busy_us{0};  // tong thoi gian chiem bus
+  LatencyHistogram rtt;                   // chi request thanh cong
+};
+
+/**
+ * @brief Thoi gian ban cua mot bus (BusExecutor), de tinh ti le su dung
+ */
+struct BusMetrics {
+  explicit BusMetrics(const std::string& bus_name) : bus(bus_name) {}
+
+  void recordJob(std::uint64_t busy) {
+    jobs.fetch_add(1, std::memory_order_relaxed);
+    busy_us.fetch_add(busy, std::memory_order_relaxed);
+  }
+
+  const std::string bus;
+  std::atomic<std::uint64_t> jobs{0};
+  std::atomic<std::uint64_t> busy_us{0};
+};
+
+/**
+ * @brief Bang dang ky so lieu cua moi thiet bi va bus trong tien trinh
+ *
+ * Mutex chi khoa khi dang ky (mot lan luc tao driver/bus) va khi chup
+ * snapshot; duong nong giu shared_ptr va khong bao gio cham vao mutex.
+ */
+class CommMetrics {
+ public:
+  struct DeviceSnapshot {
+    std::string device;
+    std::string bus;
+    std::uint64_t requests;
+    std::uint64_t responses;
+    std::uint64_t timeouts;
+    std::uint64_t integrity_errors;
+    std::uint64_t exceptions;
+    std::uint64_t other_errors;
+    std::uint64_t retries;
+    std::uint64_t busy_us;
+    LatencyHistogram::Snapshot rtt;
+  };
+
+  struct BusSnapshot {
+    std::string bus;
+    std::uint64_t jobs;
+    std::uint64_t busy_us;
+  };
+
+  struct Snapshot {
+    std::int64_t time_us = 0;  // steady_clock
+    std::int64_t unix_ms = 0;
+    std::vector<DeviceSnapshot> devices;
+    std::vector<BusSnapshot> buses;
+  };
+
+  static CommMetrics& instance();
+
+  // Tra ve so lieu cua device/bus, tao moi neu chua co
+  std::shared_ptr<DeviceMetrics> device(const std::string& device_id,
+                                        const std::string& bus);
+  std::shared_ptr<BusMetrics> bus(const std::string& name);
+
+  Snapshot snapshot() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<DeviceMetrics> > devices_;
+  std::map<std::string, std::shared_ptr<BusMetrics> > buses_;
+};
+
+/**
+ * @brief Xuat so lieu dinh ky: JSON cho topic ZMQ va file text Prometheus
+ *
+ * Giu snapshot lan truoc de tinh ti le su dung bus trong khoang giua hai lan
+ * update(). Ghi file theo kieu tam + rename de textfile collector cua
+ * node_exporter khong doc phai file dang ghi do.
+ */
+class MetricsReport {
+ public:
+  // Chup snapshot moi tu CommMetrics::instance()
+  void update();
+
+  std::string json() const;
+  std::string prometheus() const;
+  bool writePrometheusFile(const std::string& path) const;
+
+ private:
+  // Ti le thoi gian ban cua bus trong khoang vua qua (0..1)
+  double utilization(const CommMetrics::BusSnapshot& bus) const;
+
+  CommMetrics::Snapshot current_;
+  CommMetrics::Snapshot previous_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meter_config.h"
+
+/**
+ * @brief Theo doi file cau hinh bang inotify va nap lai o thread nen
+ *
+ * Theo doi thu muc chua file (khong phai inode cua file) vi trinh soan thao
+ * va cong cu deploy thuong ghi file tam roi rename de len file cu. Sau su kien
+ * cuoi cung cua mot file, cho them mot khoang yen lang (debounce) roi moi
+ * parse + validate; chi cau hinh hop le moi duoc dua toi handler. Handler
+ * chay tren thread cua watcher, khong phai thread doc bus.
+ */
+class ConfigWatcher {
+ public:
+  typedef std::function<void(const MeterConfig&)> Handler;
+
+  explicit ConfigWatcher(
+      std::chrono::milliseconds debounce = std::chrono::milliseconds(300));
+  ~ConfigWatcher();
+
+  ConfigWatcher(const ConfigWatcher&) = delete;
+  ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+  // Dang ky file (goi truoc start()), moi file mot handler rieng: chi thiet
+  // bi cua file vua doi bi nap lai
+  bool watch(const std::string& path, Handler handler);
+
+  bool start();
+  void stop();
+
+ private:
+  struct Entry {
+    std::string directory;
+    std::string file_name;
+    std::string path;
+    Handler handler;
+    int wd = -1;
+    bool pending = false;
+    std::chrono::steady_clock::time_point due;
+  };
+
+  void run();
+  void load(Entry& entry);
+
+  std::chrono::milliseconds debounce_;
+  int inotify_fd_;
+  int stop_fd_;  // eventfd de danh thuc poll() khi stop()
+  std::vector<Entry> entries_;
+  std::thread worker_;
+  std::atomic<bool> running_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "read_plan.h"
+
+struct DecodeOp;
+
+// Ham giai ma da duoc chon san theo (kieu, thu tu byte) khi bien dich
+typedef double (*DecodeFn)(const std::uint16_t* words, const DecodeOp& op);
+
+// Mot lenh cua chuong trinh giai ma: doc word tai `word` trong buffer cua
+// block, ghi gia tri da scale vao values[slot]
+struct DecodeOp {
+  DecodeFn fn;
+  std::uint16_t word;
+  std::uint16_t slot;
+  std::uint8_t shift;  // truong bit: (raw >> shift) & mask
+  std::uint64_t mask;
+  double scale;
+  double offset;
+};
+
+/**
+ * @brief Chuong trinh giai ma phang, bien dich mot lan tu ReadPlan
+ *
+ * Moi tag duoc chuyen thanh mot DecodeOp tro toi ham giai ma chuyen biet cho
+ * kieu du lieu va thu tu byte cua no. Khi doc xong mot block, run() chi chay
+ * tuan tu cac op cua block do tren buffer: khong switch theo kieu, khong tra
+ * map theo ten. Gia tri cua tag duoc ghi vao mang values theo slot (thu tu
+ * trong tagNames()).
+ */
+class DecodeProgram {
+ public:
+  DecodeProgram() = default;
+
+  static DecodeProgram compile(const ReadPlan& plan);
+
+  // Giai ma block thu block_index cua plan tu buffer vao values[slot]
+  void run(std::size_t block_index, const std::uint16_t* buffer,
+           double* values) const {
+    const DecodeOp* op = ops_.data() + block_begin_[block_index];
+    const DecodeOp* end = ops_.data() + block_begin_[block_index + 1];
+    for (; op != end; ++op) {
+      values[op->slot] = op->fn(buffer + op->word, *op);
+    }
+  }
+
+  // Cac op cua mot block, vd de biet slot nao vua duoc cap nhat
+  const DecodeOp* blockBegin(std::size_t block_index) const {
+    return ops_.data() + block_begin_[block_index];
+  }
+  const DecodeOp* blockEnd(std::size_t block_index) const {
+    return ops_.data() + block_begin_[block_index + 1];
+  }
+
+  // Ten tag theo slot
+  const std::vector<std::string>& tagNames() const { return names_; }
+  std::size_t tagCount() const { return names_.size(); }
+
+ private:
+  std::vector<DecodeOp> ops_;
+  // Op cua block i nam trong [block_begin_[i], block_begin_[i + 1])
+  std::vector<std::size_t> block_begin_;
+  std::vector<std::string> names_;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "meter_config.h"
+#include "meter_driver.h"
+
+/**
+ * @brief Model thiet bi dung chung (vd mot dong dong ho): ban do thanh ghi,
+ *        lop chu ky mac dinh va ke hoach doc da bien dich
+ *
+ * Chi bien dich mot lan khi nap cau hinh, moi thiet bi cung profile tro toi
+ * cung model nen bo nho va thoi gian khoi dong khong tang theo so thiet bi.
+ */
+struct DeviceProfile {
+  std::string name;
+  MeterConfig defaults;  // device_id/serial_port/slave_id bo trong
+  DeviceModelPtr model;
+};
+
+typedef std::shared_ptr<const DeviceProfile> DeviceProfilePtr;
+
+/**
+ * @brief Mot thiet bi tren gateway: slave ID, bus va cac gia tri ghi de
+ *
+ * config la ban sao nong cua profile->defaults (ban do thanh ghi dung chung)
+ * cong them device_id, slave_id va cac truong ghi de (poll_interval_ms,
+ * poll_classes, report_by_exception, max_silence_ms). serial_port/baudrate
+ * lay tu bus.
+ */
+struct DeviceInstance {
+  MeterConfig config;
+  std::string bus;
+  DeviceProfilePtr profile;
+};
+
+/**
+ * @brief Cau hinh cap gateway: nhieu bus (RTU/TCP), profile va thiet bi
+ *
+ * {
+ *   "buses":    { "<ten>": { "type": "rtu", "port": "/dev/ttyS3", ... } },
+ *   "profiles": { "<ten>": { "poll_interval_ms": ..., "registers": {...} } },
+ *   "devices":  [ { "device_id": "1", "bus": "<ten>", "profile": "<ten>",
+ *                   "slave_id": 1, ...ghi de... } ]
+ * }
+ *
+ * Thiet bi khong duoc khai bao registers/max_register_gap rieng (se mat
+ * ke hoach dung chung): can thanh ghi khac thi tao profile khac.
+ */
+class GatewayConfig {
+ public:
+  std::map<std::string, BusConfig> buses;
+  std::map<std::string, DeviceProfilePtr> profiles;
+  std::vector<DeviceInstance> devices;
+
+  bool loadFromJson(const std::string& filename);
+  bool validate() const;
+
+  // Mo moi bus mot lan roi tao driver cho tung thiet bi. Thiet bi cua bus
+  // khong mo duoc bi bo qua (co log), cac bus khac van chay. instances (neu
+  // co) nhan thiet bi ung voi tung driver, cung thu tu.
+  std::vector<std::unique_ptr<MeterDriver> > createDrivers(
+      std::vector<const DeviceInstance*>* instances = nullptr) const;
+
+ private:
+  bool parseProfiles(const cJSON* object);
+  bool parseDevices(const cJSON* array);
+};
@@ -3,30 +3,113 @@
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 
 extern "C" {
 #include "../../../components/libcjson/cJSON.h"
 }
 
+// Kieu du lieu cua mot diem do (tag)
+enum class DataType : std::uint8_t {
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kInt64,
+  kFloat32,
+  kFloat64
+};
+
+// Thu tu byte/word giong cac ham modbus_get_float_abcd/badc/cdab/dcba:
+// ABCD = big-endian, BADC = dao byte trong word, CDAB = dao thu tu word,
+// DCBA = dao ca hai
+enum class WordOrder : std::uint8_t { kABCD, kBADC, kCDAB, kDCBA };
+
+// So word (16 bit) ma mot kieu chiem
+int wordsForType(DataType type);
+bool parseDataType(const std::string& text, DataType* type);
+bool parseWordOrder(const std::string& text, WordOrder* order);
+
 struct RegisterConfig {
   std::string name;
   std::uint16_t address;
-  double scale;
+  std::uint16_t quantity = 1;  // so word lien tiep cua tag
+  double scale = 1.0;
+  // gia tri = raw * scale + offset
+  double offset = 0.0;
+  DataType type = DataType::kUint16;
+  WordOrder order = WordOrder::kABCD;
+  // Truong bit (chi voi uint16/uint32): bit_width = 0 -> lay ca gia tri
+  std::uint8_t bit_offset = 0;
+  std::uint8_t bit_width = 0;
+  // Nhom chu ky doc (vd "power", "energy"); rong = lop mac dinh
+  // (poll_interval_ms)
+  std::string poll_class;
+  // Report-by-exception: chi publish khi lech so voi lan gui truoc qua
+  // max(deadband, deadband_pct% * |gia tri truoc|); 0 = moi thay doi
+  double deadband = 0.0;
+  double deadband_pct = 0.0;
   // viet them cac truong can thiet o day, neu muon cau hinh them tham so cho
   // moi register
 };
 
+typedef std::map<std::string, RegisterConfig> RegisterMap;
+// Ban do thanh ghi chi doc sau khi nap, dung chung giua cac thiet bi cung model
+typedef std::shared_ptr<const RegisterMap> RegisterMapPtr;
+
+/**
+ * @brief Mot bus vat ly trong cau hinh gateway: cong RTU hoac endpoint TCP
+ */
+struct BusConfig {
+  enum class Type { kRtu, kTcp };
+
+  std::string name;
+  Type type = Type::kRtu;
+  // RTU
+  std::string port;
+  int baudrate = 9600;
+  char parity = 'N';
+  int data_bits = 8;
+  int stop_bits = 1;
+  // TCP
+  std::string host;
+  int tcp_port = 502;
+
+  // Khoa trong BusRegistry: duong dan cong RTU hoac host:port
+  std::string key() const;
+  bool parseJson(const cJSON* object);
+  bool validate() const;
+};
+
 class MeterConfig {
  public:
   std::string device_id;
   std::string serial_port;
-  int baudrate;
-  int slave_id;
-  int poll_interval_ms;
-  std::map<std::string, RegisterConfig> registers;
+  int baudrate = 0;
+  int slave_id = 0;
+  int poll_interval_ms = 0;
+  // So word trong toi da duoc phep doc kem khi gom cac tag vao cung mot block
+  int max_register_gap = 8;
+  // Cac lop chu ky doc: [ten lop, chu ky (ms)]
+  std::map<std::string, int> poll_classes;
+  // Chi publish tag thay doi (frame sparse); tag khong doi van duoc gui lai
+  // sau max_silence_ms (0 = khong heartbeat)
+  bool report_by_exception = false;
+  int max_silence_ms = 60000;
+  RegisterMapPtr registers = std::make_shared<RegisterMap>();
+
+  // Chu ky (ms) cua mot lop, lop rong/khong khai bao dung poll_interval_ms
+  int pollIntervalFor(const std::string& poll_class) const {
+    std::map<std::string, int>::const_iterator it =
+        poll_classes.find(poll_class);
+    return it != poll_classes.end() ? it->second : poll_interval_ms;
+  }
 
   bool loadFromJson(const std::string& filename);
+  // Doc cac truong co mat trong object, truong vang mat giu gia tri hien tai
+  // (dung de ap gia tri ghi de cua thiet bi len profile)
+  bool parseJson(const cJSON* object);
 
   bool validate() const {
     if (slave_id < 1 || slave_id > 247) {
@@ -38,13 +121,84 @@ class MeterConfig {
       std::cerr << "[VALIDATION FAIL] Baudrate phai la so duong." << std::endl;
       return false;
     }
-    if (registers.empty()) {
+    return validateModel();
+  }
+
+  // Phan khong phu thuoc ket noi: thanh ghi, lop chu ky, deadband
+  bool validateModel() const {
+    if (registers->empty()) {
       std::cerr << "[VALIDATION FAIL] Khong co thanh ghi nao duoc cau hinh."
                 << std::endl;
       return false;
     }
+    if (poll_interval_ms <= 0) {
+      std::cerr << "[VALIDATION FAIL] poll_interval_ms phai la so duong."
+                << std::endl;
+      return false;
+    }
+    if (max_silence_ms < 0) {
+      std::cerr << "[VALIDATION FAIL] max_silence_ms khong duoc am."
+                << std::endl;
+      return false;
+    }
+    for (const auto& pair : poll_classes) {
+      if (pair.second <= 0) {
+        std::cerr << "[VALIDATION FAIL] Chu ky cua lop " << pair.first
+                  << " phai la so duong." << std::endl;
+        return false;
+      }
+    }
+    for (const auto& pair : *registers) {
+      const RegisterConfig& reg = pair.second;
+      if (!reg.poll_class.empty() && !poll_classes.count(reg.poll_class)) {
+        std::cerr << "[VALIDATION FAIL] Thanh ghi " << reg.name
+                  << " dung lop chu ky chua khai bao: " << reg.poll_class
+                  << std::endl;
+        return false;
+      }
+      if (reg.quantity < 1 || reg.quantity > 125 ||
+          reg.address + reg.quantity > 65536) {
+        std::cerr << "[VALIDATION FAIL] Thanh ghi " << reg.name
+                  << " co quantity (" << reg.quantity
+                  << ") khong hop le, phai trong khoang [1, 125]."
+                  << std::endl;
+        return false;
+      }
+      if (reg.deadband < 0.0 || reg.deadband_pct < 0.0) {
+        std::cerr << "[VALIDATION FAIL] Deadband cua thanh ghi " << reg.name
+                  << " khong duoc am." << std::endl;
+        return false;
+      }
+      if (reg.quantity < wordsForType(reg.type)) {
+        std::cerr << "[VALIDATION FAIL] Thanh ghi " << reg.name << " can "
+                  << wordsForType(reg.type) << " word cho kieu du lieu."
+                  << std::endl;
+        return false;
+      }
+      if (reg.bit_width > 0) {
+        const int type_bits = 16 * wordsForType(reg.type);
+        if ((reg.type != DataType::kUint16 &&
+             reg.type != DataType::kUint32) ||
+            reg.bit_offset + reg.bit_width > type_bits) {
+          std::cerr << "[VALIDATION FAIL] Truong bit cua thanh ghi "
+                    << reg.name << " khong hop le (chi dung voi uint16/uint32)."
+                    << std::endl;
+          return false;
+        }
+      }
+    }
     return true;
   }
 };
 
+// So sanh tung truong (dung khi nap lai cau hinh de biet co gi thay doi)
+bool operator==(const RegisterConfig& lhs, const RegisterConfig& rhs);
+bool operator==(const MeterConfig& lhs, const MeterConfig& rhs);
+inline bool operator!=(const RegisterConfig& lhs, const RegisterConfig& rhs) {
+  return !(lhs == rhs);
+}
+inline bool operator!=(const MeterConfig& lhs, const MeterConfig& rhs) {
+  return !(lhs == rhs);
+}
+
 std::string readFileToString(const std::string& filename);
\ No newline at end of file
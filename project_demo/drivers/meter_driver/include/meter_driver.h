@@ -4,48 +4,139 @@
 // hoặc dùng cú pháp tương đối
 #include <modbus.h>
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
+#include "bus_executor.h"
+#include "comm_metrics.h"
+#include "decode_program.h"
 #include "meter_config.h"
+#include "read_plan.h"
+#include "sample.h"
 
-// Kết quả đọc dữ liệu cuối cùng: [Tên thanh ghi, Giá trị thực]
-using MeterData = std::map<std::string, double>;
-
-// 1. Custom Deleter cho modbus_t*
-struct ModbusDeleter {
-  void operator()(modbus_t* ctx) const {
-    if (ctx) {
-      modbus_close(ctx);
-      modbus_free(ctx);
-      std::cout << "[INFO] Modbus context da dong va giai phong." << std::endl;
-    }
-  }
+/**
+ * @brief Phan bien dich tu ban do thanh ghi (block + chuong trinh giai ma)
+ *
+ * Chi phu thuoc vao thanh ghi va max_register_gap nen cac thiet bi cung mot
+ * model (profile trong cau hinh gateway) dung chung mot ban.
+ */
+struct DeviceModel {
+  DeviceModel(const RegisterMap& registers, int max_register_gap);
+
+  ReadPlan plan;
+  DecodeProgram decoder;
+  std::vector<std::uint16_t> tag_blocks;  // Block cua tung slot
+};
+
+typedef std::shared_ptr<const DeviceModel> DeviceModelPtr;
+
+/**
+ * @brief Ke hoach doc bat bien cua mot thiet bi: cau hinh, block, chuong trinh
+ *        giai ma va schema sinh ra tu cau hinh do
+ *
+ * Khi nap lai cau hinh, driver dung ke hoach moi o thread khac roi thay ca khoi
+ * bang mot phep gan atomic (kieu RCU): chu ky doc dang chay giu shared_ptr cua
+ * ke hoach cu toi khi xong, chu ky sau dung ke hoach moi.
+ */
+struct DriverPlan {
+  explicit DriverPlan(const MeterConfig& meter_config);
+  // Dung model da bien dich san (khong xay lai block/decoder)
+  DriverPlan(const MeterConfig& meter_config, DeviceModelPtr device_model);
+
+  MeterConfig config;
+  DeviceModelPtr model;
+  const ReadPlan& plan;          // = model->plan
+  const DecodeProgram& decoder;  // = model->decoder
+  SampleSchemaPtr schema;        // Tag theo slot cua decoder
 };
-// 2. Alias cho unique_ptr an toan
-using ModbusContextPtr = std::unique_ptr<modbus_t, ModbusDeleter>;
+
+typedef std::shared_ptr<const DriverPlan> DriverPlanPtr;
 
 class MeterDriver {
  public:
-  // Constructor sử dụng Dependency Injection
+  enum class ReloadResult { kUnchanged, kApplied, kRejected };
+  // Goi tren thread cua bus sau moi lan doc block: words la gia tri tho cua
+  // block (nullptr neu doc that bai), chi hop le trong luc goi
+  typedef std::function<void(const ReadBlock&, const std::uint16_t* words)>
+      BlockObserver;
+
+  // Constructor sử dụng Dependency Injection. Bus được lấy từ BusRegistry
+  // theo serial_port, các driver cùng cổng dùng chung một BusExecutor.
   MeterDriver(const MeterConfig& config);
+  // Dùng một bus đã tạo sẵn (nhiều thiết bị trên cùng một bus)
+  MeterDriver(const MeterConfig& config, std::shared_ptr<BusExecutor> bus);
+  // Thiết bị trong cấu hình gateway: model dùng chung với thiết bị cùng loại
+  MeterDriver(const MeterConfig& config, DeviceModelPtr model,
+              std::shared_ptr<BusExecutor> bus);
+
+  // Lay (hoac tao va ket noi) executor cua bus tu BusRegistry; nullptr neu
+  // khong mo duoc
+  static std::shared_ptr<BusExecutor> openBus(const BusConfig& bus);
   // Destructor mac dinh tu lo viec giai phong tai nguyen
 
-  MeterData readAllAndScaleData();
+  // Sample rong theo schema cua driver: tao mot lan, dung lai moi chu ky.
+  // Sample cu duoc tu cap phat lai o lan doc dau tien sau khi doi schema.
+  Sample makeSample() const { return Sample(current()->schema); }
+  SampleSchemaPtr schema() const { return current()->schema; }
+
+  // Doc va ghi gia tri vao sample tai cho (khong cap phat). Tra ve true neu
+  // moi block deu doc thanh cong; tag cua block loi bi xoa bit quality.
+  bool readAllAndScaleData(Sample& sample);
+
+  // Chi doc cac block thuoc mot lop chu ky (dung voi PollScheduler)
+  bool readPollClass(const std::string& poll_class, Sample& sample);
+
+  // Ke hoach dang dung; giu shared_ptr tra ve trong suot lan su dung
+  DriverPlanPtr current() const { return std::atomic_load(&plan_); }
+  // Tang moi lan ke hoach duoc thay: so sanh so nay re hon goi current()
+  std::uint64_t generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Ap dung cau hinh moi (goi tu thread bat ky, vd ConfigWatcher)
+   *
+   * Chi thay ke hoach doc khi tag/lop chu ky/slave ID thay doi. Doi cong,
+   * baudrate hay device_id can tao lai bus nen bi tu choi (can khoi dong
+   * lai); bus va thiet bi khac tren cung bus khong bi anh huong.
+   */
+  ReloadResult reload(const MeterConfig& config);
+  const std::shared_ptr<DeviceMetrics>& metrics() const { return metrics_; }
+
+  // Dat observer (vd RegisterMirror) tu thread bat ky; co hieu luc tu block
+  // doc tiep theo
+  void setBlockObserver(BlockObserver observer);
 
  private:
-  ModbusContextPtr ctx_;
-  MeterConfig config_;
-  std::mutex modbus_lock_;  // Mutex cho Thread Safety
+  // Chi doc/ghi qua std::atomic_load/atomic_store
+  DriverPlanPtr plan_;
+  std::atomic<std::uint64_t> generation_;
+  // Buffer dung chung cho moi block, chi duoc dung (va doi kich thuoc) tren
+  // thread cua bus
+  std::vector<std::uint16_t> block_buffer_;
+  // Thread cua bus so huu modbus context, thay cho mutex quanh bus
+  std::shared_ptr<BusExecutor> bus_;
+  // Bo dem truyen thong, chi tang tren thread cua bus
+  std::shared_ptr<DeviceMetrics> metrics_;
+  // Chi doc/ghi tren thread cua bus
+  BlockObserver block_observer_;
+
+  bool establishConnection(const MeterConfig& config);
 
-  bool establishConnection();
+  // Chạy trên thread của bus: đọc các block thỏa mãn filter
+  bool readBlocks(modbus_t* ctx, const std::string* poll_class,
+                  Sample& sample);
 
-  // Đọc một thanh ghi với (Retry)
-  double readAndScaleRegister(const RegisterConfig& reg);
+  // Đọc một block thanh ghi liên tục vào block_buffer_ (Retry)
+  bool readBlock(modbus_t* ctx, const ReadBlock& block);
+  bool readAndScaleBlock(modbus_t* ctx, const DriverPlan& plan,
+                         std::size_t block_index, Sample& sample);
 
   // Xử lý chuyển đổi địa chỉ
   std::uint16_t getModbusAddress(std::uint16_t register_address) const;
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Bo lap lich doc theo deadline, khong troi chu ky (drift-free)
+ *
+ * Moi task co chu ky rieng (vd 200 ms cho cong suat, 10 s cho dien nang,
+ * 1 h cho thong tin nameplate). Deadline ke tiep = deadline truoc + chu ky,
+ * khong phu thuoc thoi gian doc nen chu ky khong bi troi. Cac task cua nhieu
+ * thiet bi tren cung mot bus duoc xep trong mot min-heap theo deadline va chay
+ * tuan tu tren mot thread. Neu mot task bi tre qua mot chu ky thi cac chu ky
+ * bi bo lo duoc dem va bao qua MissHandler.
+ */
+class PollScheduler {
+ public:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<void()> Task;
+  // (ten task, so chu ky bi bo lo, do tre so voi deadline)
+  typedef std::function<void(const std::string&, std::uint64_t,
+                             std::chrono::microseconds)>
+      MissHandler;
+
+  struct TaskStats {
+    std::string name;
+    std::chrono::milliseconds period;
+    std::uint64_t runs;
+    std::uint64_t missed;            // so chu ky bi bo lo
+    std::chrono::microseconds max_lateness;  // tre lon nhat khi bat dau chay
+  };
+
+  PollScheduler() = default;
+  PollScheduler(const PollScheduler&) = delete;
+  PollScheduler& operator=(const PollScheduler&) = delete;
+
+  // Them task; phase dich deadline dau tien de trai deu cac task cung chu ky
+  int addTask(const std::string& name, std::chrono::milliseconds period,
+              Task task,
+              std::chrono::milliseconds phase = std::chrono::milliseconds(0));
+
+  // Doi chu ky cua task (vd sau khi nap lai cau hinh); ap dung tu deadline
+  // ke tiep. Tra ve false neu task_id khong ton tai.
+  bool setPeriod(int task_id, std::chrono::milliseconds period);
+
+  // Co the goi khi run() dang chay: handler moi ap dung tu lan bo lo ke tiep
+  void setMissHandler(MissHandler handler);
+
+  // Chay vong lap cho toi khi stop() duoc goi (goi tu thread cua bus)
+  void run();
+  void stop();
+
+  std::vector<TaskStats> stats() const;
+
+ private:
+  struct Entry {
+    Clock::time_point deadline;
+    int task_id;
+    bool operator>(const Entry& other) const {
+      return deadline > other.deadline ||
+             (deadline == other.deadline && task_id > other.task_id);
+    }
+  };
+
+  struct TaskSlot {
+    TaskStats stats;
+    Task task;
+  };
+
+  void runDue(Entry entry);
+
+  std::deque<TaskSlot> tasks_;  // deque: con tro toi slot khong bi doi
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > heap_;
+  MissHandler miss_handler_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "meter_config.h"
+
+// So thanh ghi toi da cua mot lenh FC03/FC04 (MODBUS_MAX_READ_REGISTERS)
+const int kMaxReadRegisters = 125;
+
+// Mot thanh ghi (tag) nam trong block, vi tri tinh tu dau block
+struct BlockEntry {
+  std::string name;
+  std::uint16_t offset;    // vi tri word dau tien trong buffer cua block
+  std::uint16_t quantity;  // so word cua tag
+  double scale;
+  double value_offset;
+  DataType type;
+  WordOrder order;
+  std::uint8_t bit_offset;
+  std::uint8_t bit_width;
+};
+
+// Mot lenh doc lien tuc tren bus: [start_address, start_address + count)
+struct ReadBlock {
+  std::string poll_class;  // block khong bao gio trai qua hai lop chu ky
+  std::uint16_t start_address;
+  std::uint16_t count;
+  std::vector<BlockEntry> entries;
+};
+
+/**
+ * @brief Ke hoach doc: gom cac RegisterConfig thanh cac block lien tuc
+ *
+ * Duoc xay dung mot lan khi nap cau hinh. Moi chu ky chi can gui mot lenh
+ * cho moi block roi cat gia tri cua tung tag ra tu buffer cua block. Cac tag
+ * thuoc lop chu ky khac nhau (poll_class) duoc gom vao cac block rieng.
+ */
+class ReadPlan {
+ public:
+  ReadPlan() = default;
+
+  static ReadPlan build(const std::map<std::string, RegisterConfig>& registers,
+                        int max_gap, int max_block = kMaxReadRegisters);
+
+  const std::vector<ReadBlock>& blocks() const { return blocks_; }
+
+  // Kich thuoc block lon nhat, dung de cap phat buffer doc mot lan
+  std::size_t maxBlockSize() const { return max_block_size_; }
+
+  // Tong so word thuc su duoc doc moi chu ky (ke ca cac lo hong)
+  std::size_t totalRegisters() const;
+
+  // Danh sach cac lop chu ky co it nhat mot block, theo thu tu trong plan
+  std::vector<std::string> pollClasses() const;
+
+ private:
+  std::vector<ReadBlock> blocks_;
+  std::size_t max_block_size_ = 0;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <modbus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "read_plan.h"
+
+/**
+ * @brief Anh thanh ghi cua mot thiet bi trong modbus_mapping_t
+ *
+ * Thread cua bus ghi nguyen van moi block doc duoc vao holding register tai
+ * dung dia chi cua dong ho (vung anh tu noi rong khi gap block moi); thread
+ * cua MirrorServer tra loi FC03 tu anh nay ma khong cham toi bus. Input
+ * register tai status_address la khoi trang thai, cap nhat truoc moi lan tra
+ * loi:
+ *
+ *   +0  tuoi (ms) cua block cu nhat, 0xFFFF = chua doc duoc hoac >= 65.535 s
+ *   +1  tuoi (s) cua block cu nhat, bao hoa 0xFFFF
+ *   +2  so block co lan doc gan nhat that bai
+ *   +3  so lan cap nhat block thanh cong, 32 bit (word cao truoc)
+ */
+class RegisterMirror {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  enum StatusRegister {
+    kStatusAgeMs = 0,
+    kStatusAgeSeconds = 1,
+    kStatusFailedBlocks = 2,
+    kStatusUpdatesHigh = 3,
+    kStatusUpdatesLow = 4,
+    kStatusRegisters = 5
+  };
+
+  explicit RegisterMirror(std::uint16_t status_address = 0);
+  ~RegisterMirror();
+
+  RegisterMirror(const RegisterMirror&) = delete;
+  RegisterMirror& operator=(const RegisterMirror&) = delete;
+
+  // Goi tu thread cua bus sau moi lan doc block; words == nullptr khi doc
+  // that bai (gia tri cu duoc giu, tuoi tiep tuc tang)
+  void update(const ReadBlock& block, const std::uint16_t* words);
+
+  // Ke hoach doc vua doi: quen cac block cu de tuoi chi tinh tren block moi.
+  // Gia tri trong anh duoc giu.
+  void resetBlocks();
+
+  /**
+   * @brief Tra loi mot request FC03/FC04 tu anh (thread cua server)
+   *
+   * Cap nhat khoi trang thai roi goi modbus_reply duoi mutex cua anh; socket
+   * cua ctx phai non-blocking de client cham khong giu thread cua bus.
+   */
+  int reply(modbus_t* ctx, const std::uint8_t* query, int length);
+
+ private:
+  struct BlockStamp {
+    std::uint16_t start;
+    std::uint16_t count;
+    Clock::time_point updated;  // time_point() = chua doc duoc lan nao
+    bool ok;
+  };
+
+  // Noi rong vung holding register de chua [start, end); chi goi khi giu mutex
+  bool cover(std::uint32_t start, std::uint32_t end);
+  void refreshStatus(Clock::time_point now);
+
+  std::uint16_t status_address_;
+  std::mutex mutex_;
+  modbus_mapping_t* mapping_;
+  std::vector<BlockStamp> blocks_;
+  std::uint32_t updates_ = 0;
+};
+
+/**
+ * @brief Modbus TCP slave cuc bo phuc vu cac RegisterMirror theo unit ID
+ *
+ * Mot thread poll() tren socket listen va moi client; request chi doc anh
+ * trong RAM nen tra loi ngay tren thread nay, khong them tai nao cho bus
+ * RS-485. Chi nhan FC03 (anh thanh ghi) va FC04 (khoi trang thai); function
+ * khac -> exception illegal function, unit khong co anh -> gateway path.
+ * Socket client khong chan, byte nhan duoc gom vao bo dem rieng cua client
+ * va chi frame MBAP day du moi duoc tra loi: client gui nua frame khong giu
+ * thread cua cac client khac.
+ */
+class MirrorServer {
+ public:
+  struct Options {
+    std::string host = "0.0.0.0";
+    int port = 1502;
+    int max_clients = 64;
+  };
+
+  explicit MirrorServer(const Options& options);
+  ~MirrorServer();
+
+  MirrorServer(const MirrorServer&) = delete;
+  MirrorServer& operator=(const MirrorServer&) = delete;
+
+  // false neu unit khong hop le hoac da co anh
+  bool addMirror(int unit, RegisterMirror* mirror);
+
+  bool open();
+  // Vong lap chinh, tra ve khi stop == true
+  void run(const std::atomic<bool>& stop);
+
+  std::uint64_t requests() const { return requests_.load(); }
+
+ private:
+  struct Client {
+    int fd;
+    std::vector<std::uint8_t> rx;  // dau frame tiep theo, chua du mot ADU
+  };
+
+  void acceptClient();
+  bool serve(Client& client);
+  bool handle(int fd, std::uint8_t* query, int length);
+
+  Options options_;
+  modbus_t* ctx_;
+  int server_fd_;
+  std::vector<Client> clients_;
+  RegisterMirror* mirrors_[256];
+  std::atomic<std::uint64_t> requests_;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Bang tag (schema) cua mot thiet bi, xay dung mot lan khi nap cau hinh
+ *
+ * Tag duoc danh so 0..size()-1 theo thu tu slot cua DecodeProgram. Moi tag
+ * thuoc mot block doc; cac tag cung block co chung thoi diem lay mau.
+ * id() la ma bam cua danh sach tag, thay doi khi cau hinh thay doi.
+ */
+class SampleSchema {
+ public:
+  SampleSchema(const std::string& device_id,
+               const std::vector<std::string>& tag_names,
+               const std::vector<std::uint16_t>& tag_blocks,
+               std::size_t block_count);
+
+  const std::string& deviceId() const { return device_id_; }
+  std::uint32_t id() const { return id_; }
+
+  std::size_t size() const { return names_.size(); }
+  std::size_t blockCount() const { return block_count_; }
+
+  const std::string& name(std::size_t tag) const { return names_[tag]; }
+  std::uint16_t blockOf(std::size_t tag) const { return tag_blocks_[tag]; }
+
+  // Tra ve chi so tag theo ten, -1 neu khong co. Chi dung khi khoi tao
+  // (tim tuyen tinh), khong dung trong vong doc.
+  int find(const std::string& name) const;
+
+ private:
+  std::string device_id_;
+  std::vector<std::string> names_;
+  std::vector<std::uint16_t> tag_blocks_;
+  std::size_t block_count_;
+  std::uint32_t id_;
+};
+
+typedef std::shared_ptr<const SampleSchema> SampleSchemaPtr;
+
+/**
+ * @brief Ban ghi gia tri phang cua mot thiet bi, cap phat mot lan
+ *
+ * Driver ghi thang vao mang values theo chi so tag; bit quality cua tag bat
+ * khi block chua no doc thanh cong o lan doc gan nhat. Moi block co mot
+ * timestamp (us tu epoch) luc lay mau. Publisher, luu tru va canh bao doc
+ * truc tiep cac mang nay, khong can cap phat hay tra cuu theo ten.
+ */
+struct Sample {
+  SampleSchemaPtr schema;
+  std::vector<double> values;
+  std::vector<std::uint64_t> quality;        // bitmask, 1 bit moi tag
+  std::vector<std::int64_t> block_time_us;  // timestamp moi block
+
+  Sample() = default;
+  explicit Sample(SampleSchemaPtr sample_schema) { reset(sample_schema); }
+
+  // Cap phat cac mang theo schema va xoa toan bo quality
+  void reset(SampleSchemaPtr sample_schema);
+
+  std::size_t size() const { return values.size(); }
+
+  bool good(std::size_t tag) const {
+    return (quality[tag >> 6] >> (tag & 63)) & 1;
+  }
+  void setGood(std::size_t tag, bool is_good) {
+    const std::uint64_t bit = std::uint64_t(1) << (tag & 63);
+    if (is_good) {
+      quality[tag >> 6] |= bit;
+    } else {
+      quality[tag >> 6] &= ~bit;
+    }
+  }
+
+  // Thoi diem lay mau cua tag (timestamp cua block chua no)
+  std::int64_t timestampOf(std::size_t tag) const {
+    return block_time_us[schema->blockOf(tag)];
+  }
+};
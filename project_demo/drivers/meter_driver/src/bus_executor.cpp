@@ -0,0 +1,197 @@
+#include "bus_executor.h"
+
+#include <chrono>
+
+namespace {
+
+std::uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+BusExecutor::BusExecutor(const std::string& name, ModbusContextPtr ctx)
+    : name_(name),
+      ctx_(std::move(ctx)),
+      metrics_(CommMetrics::instance().bus(name)),
+      head_(&stub_),
+      tail_(&stub_),
+      stopping_(false),
+      producers_(0),
+      sleeping_(false) {
+  stub_.next.store(nullptr);
+  worker_ = std::thread(&BusExecutor::workerLoop, this);
+}
+
+BusExecutor::~BusExecutor() {
+  stop();
+  if (worker_.joinable()) {
+    // Chu so huu cuoi cung bo executor ngay trong job cua bus: khong join
+    // duoc chinh minh. Chay not hang doi, bao workerLoop thoat ma khong cham
+    // member nua roi tach thread
+    while (Node* node = waitNode()) runNode(node);
+    *destroyed_ = true;
+    worker_.detach();
+  }
+}
+
+bool BusExecutor::post(Job job) {
+  if (stopping_.load()) return false;
+
+  Node* node = new Node;
+  node->job = std::move(job);
+  if (!enqueue(node)) {
+    delete node;
+    return false;
+  }
+  return true;
+}
+
+bool BusExecutor::enqueue(Node* node) {
+  // Kiem tra stopping_ ben trong producers_: stop() khong the de thread cua
+  // bus thoat giua luc kiem tra va push
+  producers_.fetch_add(1);
+  const bool accepted = !stopping_.load();
+  if (accepted) push(node);
+  producers_.fetch_sub(1);
+
+  // Chi lay mutex khi thread cua bus dang ngu (ke ca khi tu choi: thread
+  // dang dung co the dang cho producers_ ve 0)
+  if (sleeping_.load()) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wakeup_.notify_one();
+  }
+  return accepted;
+}
+
+void BusExecutor::stop() {
+  if (stopping_.exchange(true)) {
+    if (worker_.joinable() && !onBusThread()) worker_.join();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    wakeup_.notify_one();
+  }
+  if (worker_.joinable() && !onBusThread()) worker_.join();
+}
+
+void BusExecutor::push(Node* node) {
+  node->next.store(nullptr);
+  Node* prev = head_.exchange(node);
+  prev->next.store(node);
+}
+
+/**
+ * @brief Lay mot node ra khoi hang doi (chi goi tu thread cua bus)
+ * @return Node chua job, hoac nullptr neu hang doi rong (hoac mot producer
+ *         chua noi xong node - job do se duoc lay o lan goi sau)
+ */
+BusExecutor::Node* BusExecutor::pop() {
+  Node* tail = tail_;
+  Node* next = tail->next.load();
+
+  if (tail == &stub_) {
+    if (next == nullptr) return nullptr;
+    tail_ = next;
+    tail = next;
+    next = next->next.load();
+  }
+
+  if (next != nullptr) {
+    tail_ = next;
+    return tail;
+  }
+
+  if (tail != head_.load()) return nullptr;
+
+  push(&stub_);
+  next = tail->next.load();
+  if (next != nullptr) {
+    tail_ = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+BusExecutor::Node* BusExecutor::waitNode() {
+  for (;;) {
+    Node* node = pop();
+    if (node != nullptr) return node;
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleeping_.store(true);
+    node = pop();  // kiem tra lai sau khi bao dang ngu
+    if (node == nullptr) {
+      if (stopping_.load() && producers_.load() == 0) {
+        // Khong con producer giua chung: pop() rong la hang doi da het
+        node = pop();
+        if (node == nullptr) {
+          sleeping_.store(false);
+          return nullptr;
+        }
+      } else {
+        wakeup_.wait(lock);
+      }
+    }
+    sleeping_.store(false);
+    if (node != nullptr) return node;
+  }
+}
+
+bool BusExecutor::runNode(Node* node) {
+  // Job co the bo owner cuoi cung cua executor: sau job chi doc co nay
+  bool* destroyed = destroyed_;
+  const std::uint64_t started = nowUs();
+  if (node->waiter != nullptr) {
+    // Node cua call(): sau khi bao xong, caller co the huy node ngay
+    node->invoke(ctx_.get(), node->arg);
+    const bool alive = destroyed == nullptr || !*destroyed;
+    if (alive) metrics_->recordJob(nowUs() - started);
+    Waiter* waiter = node->waiter;
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    waiter->done = true;
+    waiter->cv.notify_one();
+    return alive;
+  }
+
+  try {
+    node->job(ctx_.get());
+  } catch (const std::exception& e) {
+    std::cerr << "[BUS " << name_ << "] Job loi: " << e.what() << std::endl;
+  }
+  delete node;
+  if (destroyed != nullptr && *destroyed) return false;
+  metrics_->recordJob(nowUs() - started);
+  return true;
+}
+
+void BusExecutor::workerLoop() {
+  bool destroyed = false;
+  destroyed_ = &destroyed;
+  while (Node* node = waitNode()) {
+    if (!runNode(node)) return;
+  }
+}
+
+BusRegistry& BusRegistry::instance() {
+  static BusRegistry registry;
+  return registry;
+}
+
+std::shared_ptr<BusExecutor> BusRegistry::acquire(const std::string& key,
+                                                  ContextFactory factory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::shared_ptr<BusExecutor> bus = buses_[key].lock();
+  if (bus) return bus;
+
+  ModbusContextPtr ctx = factory();
+  if (!ctx) return std::shared_ptr<BusExecutor>();
+
+  bus = std::make_shared<BusExecutor>(key, std::move(ctx));
+  buses_[key] = bus;
+  return bus;
+}
@@ -0,0 +1,379 @@
+#include "comm_metrics.h"
+
+#include <errno.h>
+#include <modbus.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+// Bien le (giay) cua histogram Prometheus, gop tu cac o HDR
+const double kRttBounds[] = {0.001, 0.002, 0.005, 0.01, 0.02, 0.05,
+                             0.1,   0.2,   0.5,   1.0,  2.0,  5.0};
+
+std::string escapeLabel(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') escaped += '\\';
+    if (c == '\n') {
+      escaped += "\\n";
+      continue;
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+void appendf(std::string& out, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void appendf(std::string& out, const char* format, ...) {
+  char line[512];
+  va_list args;
+  va_start(args, format);
+  const int size = std::vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (size > 0) {
+    out.append(line, static_cast<std::size_t>(size) < sizeof(line)
+                         ? static_cast<std::size_t>(size)
+                         : sizeof(line) - 1);
+  }
+}
+
+// Mot dong "# HELP" + "# TYPE" va gia tri cua moi thiet bi
+template <typename Getter>
+void appendDeviceFamily(std::string& out, const char* name, const char* help,
+                        const char* type,
+                        const std::vector<CommMetrics::DeviceSnapshot>& devices,
+                        Getter get) {
+  appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  for (const CommMetrics::DeviceSnapshot& device : devices) {
+    appendf(out, "%s{device=\"%s\",bus=\"%s\"} %llu\n", name,
+            escapeLabel(device.device).c_str(),
+            escapeLabel(device.bus).c_str(),
+            static_cast<unsigned long long>(get(device)));
+  }
+}
+
+}  // namespace
+
+/* ================== LatencyHistogram ================== */
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_(0) {
+  for (std::size_t i = 0; i < kBuckets; ++i) buckets_[i].store(0);
+}
+
+/**
+ * @brief Chỉ số ô của giá trị: 16 ô đầu chính xác, sau đó mỗi quãng tám
+ *        [2^b, 2^(b+1)) chia 16 ô bằng nhau
+ */
+std::size_t LatencyHistogram::bucketOf(std::uint64_t value) {
+  if (value < kSubBuckets) return static_cast<std::size_t>(value);
+
+  int bit = 63 - __builtin_clzll(value);
+  if (bit > kMaxBit) return kBuckets - 1;
+  const int shift = bit - kSubBits;
+  const std::size_t sub =
+      static_cast<std::size_t>(value >> shift) - kSubBuckets;
+  return static_cast<std::size_t>(bit - kSubBits + 1) * kSubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpper(std::size_t index) {
+  if (index < kSubBuckets) return index;
+
+  const int shift = static_cast<int>(index / kSubBuckets) - 1;
+  const std::uint64_t sub = index % kSubBuckets;
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Chụp trạng thái hiện tại (relaxed: các bộ đếm có thể lệch nhau vài
+ *        mẫu đang ghi dở, đủ cho giám sát)
+ */
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snapshot;
+  snapshot.counts.resize(kBuckets);
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    snapshot.counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+std::uint64_t LatencyHistogram::Snapshot::percentile(double q) const {
+  std::uint64_t total = 0;
+  for (std::uint64_t count : counts) total += count;
+  if (total == 0) return 0;
+
+  std::uint64_t rank = static_cast<std::uint64_t>(q * total + 0.5);
+  if (rank == 0) rank = 1;
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    seen += counts[i];
+    if (seen >= rank) return bucketUpper(i);
+  }
+  return bucketUpper(counts.size() - 1);
+}
+
+std::uint64_t LatencyHistogram::Snapshot::countAtOrBelow(
+    std::uint64_t value) const {
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < counts.size() && bucketUpper(i) <= value; ++i) {
+    total += counts[i];
+  }
+  return total;
+}
+
+/* ================== DeviceMetrics ================== */
+
+/**
+ * @brief Ghi nhận một lần thử request và phân loại lỗi theo errno của libmodbus
+ * @param error errno sau khi modbus_read_* thất bại (bỏ qua nếu ok)
+ */
+void DeviceMetrics::recordAttempt(bool ok, int error, std::uint64_t rtt_us) {
+  requests.fetch_add(1, std::memory_order_relaxed);
+  busy_us.fetch_add(rtt_us, std::memory_order_relaxed);
+  if (ok) {
+    responses.fetch_add(1, std::memory_order_relaxed);
+    rtt.record(rtt_us);
+    return;
+  }
+
+  if (error == ETIMEDOUT) {
+    timeouts.fetch_add(1, std::memory_order_relaxed);
+  } else if (error >= EMBXILFUN && error <= EMBXGTAR) {
+    exceptions.fetch_add(1, std::memory_order_relaxed);
+  } else if (error == EMBBADCRC || error == EMBBADDATA ||
+             error == EMBBADEXC || error == EMBUNKEXC ||
+             error == EMBBADSLAVE) {
+    integrity_errors.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    other_errors.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/* ================== CommMetrics ================== */
+
+CommMetrics& CommMetrics::instance() {
+  static CommMetrics metrics;
+  return metrics;
+}
+
+std::shared_ptr<DeviceMetrics> CommMetrics::device(const std::string& device_id,
+                                                   const std::string& bus) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<DeviceMetrics>& metrics = devices_[device_id];
+  if (!metrics) metrics = std::make_shared<DeviceMetrics>(device_id, bus);
+  return metrics;
+}
+
+std::shared_ptr<BusMetrics> CommMetrics::bus(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<BusMetrics>& metrics = buses_[name];
+  if (!metrics) metrics = std::make_shared<BusMetrics>(name);
+  return metrics;
+}
+
+CommMetrics::Snapshot CommMetrics::snapshot() const {
+  Snapshot snapshot;
+  snapshot.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+  snapshot.unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& entry : devices_) {
+    const DeviceMetrics& metrics = *entry.second;
+    DeviceSnapshot device;
+    device.device = metrics.device;
+    device.bus = metrics.bus;
+    device.requests = metrics.requests.load(std::memory_order_relaxed);
+    device.responses = metrics.responses.load(std::memory_order_relaxed);
+    device.timeouts = metrics.timeouts.load(std::memory_order_relaxed);
+    device.integrity_errors =
+        metrics.integrity_errors.load(std::memory_order_relaxed);
+    device.exceptions = metrics.exceptions.load(std::memory_order_relaxed);
+    device.other_errors = metrics.other_errors.load(std::memory_order_relaxed);
+    device.retries = metrics.retries.load(std::memory_order_relaxed);
+    device.busy_us = metrics.busy_us.load(std::memory_order_relaxed);
+    device.rtt = metrics.rtt.snapshot();
+    snapshot.devices.push_back(device);
+  }
+  for (const auto& entry : buses_) {
+    BusSnapshot bus;
+    bus.bus = entry.second->bus;
+    bus.jobs = entry.second->jobs.load(std::memory_order_relaxed);
+    bus.busy_us = entry.second->busy_us.load(std::memory_order_relaxed);
+    snapshot.buses.push_back(bus);
+  }
+  return snapshot;
+}
+
+/* ================== MetricsReport ================== */
+
+void MetricsReport::update() {
+  previous_.devices.swap(current_.devices);
+  previous_.buses.swap(current_.buses);
+  previous_.time_us = current_.time_us;
+  previous_.unix_ms = current_.unix_ms;
+  current_ = CommMetrics::instance().snapshot();
+}
+
+double MetricsReport::utilization(const CommMetrics::BusSnapshot& bus) const {
+  if (previous_.time_us == 0 || current_.time_us <= previous_.time_us) {
+    return 0.0;
+  }
+  std::uint64_t previous_busy = 0;
+  for (const CommMetrics::BusSnapshot& old : previous_.buses) {
+    if (old.bus == bus.bus) previous_busy = old.busy_us;
+  }
+  const double ratio =
+      static_cast<double>(bus.busy_us - previous_busy) /
+      static_cast<double>(current_.time_us - previous_.time_us);
+  return ratio > 1.0 ? 1.0 : ratio;
+}
+
+/**
+ * @brief Tài liệu JSON cho topic metrics/comm: bộ đếm tích lũy, percentile
+ *        RTT (us) và tỉ lệ sử dụng bus trong khoảng vừa qua
+ */
+std::string MetricsReport::json() const {
+  std::string out;
+  appendf(out, "{\"time_ms\":%lld,\"devices\":[",
+          static_cast<long long>(current_.unix_ms));
+  for (std::size_t i = 0; i < current_.devices.size(); ++i) {
+    const CommMetrics::DeviceSnapshot& d = current_.devices[i];
+    appendf(out,
+            "%s{\"device\":\"%s\",\"bus\":\"%s\",\"requests\":%llu,"
+            "\"responses\":%llu,\"timeouts\":%llu,\"integrity_errors\":%llu,"
+            "\"exceptions\":%llu,\"other_errors\":%llu,\"retries\":%llu,"
+            "\"busy_us\":%llu,",
+            i == 0 ? "" : ",", escapeLabel(d.device).c_str(),
+            escapeLabel(d.bus).c_str(),
+            static_cast<unsigned long long>(d.requests),
+            static_cast<unsigned long long>(d.responses),
+            static_cast<unsigned long long>(d.timeouts),
+            static_cast<unsigned long long>(d.integrity_errors),
+            static_cast<unsigned long long>(d.exceptions),
+            static_cast<unsigned long long>(d.other_errors),
+            static_cast<unsigned long long>(d.retries),
+            static_cast<unsigned long long>(d.busy_us));
+    appendf(out,
+            "\"rtt_us\":{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,"
+            "\"p90\":%llu,\"p99\":%llu,\"max\":%llu}}",
+            static_cast<unsigned long long>(d.rtt.count),
+            static_cast<unsigned long long>(
+                d.rtt.count ? d.rtt.sum / d.rtt.count : 0),
+            static_cast<unsigned long long>(d.rtt.percentile(0.5)),
+            static_cast<unsigned long long>(d.rtt.percentile(0.9)),
+            static_cast<unsigned long long>(d.rtt.percentile(0.99)),
+            static_cast<unsigned long long>(d.rtt.percentile(1.0)));
+  }
+  out += "],\"buses\":[";
+  for (std::size_t i = 0; i < current_.buses.size(); ++i) {
+    const CommMetrics::BusSnapshot& b = current_.buses[i];
+    appendf(out,
+            "%s{\"bus\":\"%s\",\"jobs\":%llu,\"busy_us\":%llu,"
+            "\"utilization\":%.4f}",
+            i == 0 ? "" : ",", escapeLabel(b.bus).c_str(),
+            static_cast<unsigned long long>(b.jobs),
+            static_cast<unsigned long long>(b.busy_us), utilization(b));
+  }
+  out += "]}";
+  return out;
+}
+
+/**
+ * @brief Định dạng text exposition của Prometheus (counter tích lũy, histogram
+ *        RTT gộp về các biên le cố định, gauge tỉ lệ sử dụng bus)
+ */
+std::string MetricsReport::prometheus() const {
+  typedef CommMetrics::DeviceSnapshot Device;
+  const std::vector<Device>& devices = current_.devices;
+  std::string out;
+
+  appendDeviceFamily(out, "modbus_requests_total", "Request Modbus da gui",
+                     "counter", devices,
+                     [](const Device& d) { return d.requests; });
+  appendDeviceFamily(out, "modbus_responses_total", "Phan hoi hop le",
+                     "counter", devices,
+                     [](const Device& d) { return d.responses; });
+  appendDeviceFamily(out, "modbus_timeouts_total", "Request het thoi gian cho",
+                     "counter", devices,
+                     [](const Device& d) { return d.timeouts; });
+  appendDeviceFamily(out, "modbus_integrity_errors_total",
+                     "Phan hoi sai CRC, slave hoac du lieu", "counter",
+                     devices,
+                     [](const Device& d) { return d.integrity_errors; });
+  appendDeviceFamily(out, "modbus_exceptions_total",
+                     "Phan hoi exception cua slave", "counter", devices,
+                     [](const Device& d) { return d.exceptions; });
+  appendDeviceFamily(out, "modbus_other_errors_total", "Loi truyen thong khac",
+                     "counter", devices,
+                     [](const Device& d) { return d.other_errors; });
+  appendDeviceFamily(out, "modbus_retries_total", "Lan doc lai sau loi",
+                     "counter", devices,
+                     [](const Device& d) { return d.retries; });
+
+  appendf(out,
+          "# HELP modbus_busy_seconds_total Thoi gian thiet bi chiem bus\n"
+          "# TYPE modbus_busy_seconds_total counter\n");
+  for (const Device& d : devices) {
+    appendf(out, "modbus_busy_seconds_total{device=\"%s\",bus=\"%s\"} %.6f\n",
+            escapeLabel(d.device).c_str(), escapeLabel(d.bus).c_str(),
+            d.busy_us / 1e6);
+  }
+
+  appendf(out,
+          "# HELP modbus_rtt_seconds Thoi gian request/response thanh cong\n"
+          "# TYPE modbus_rtt_seconds histogram\n");
+  for (const Device& d : devices) {
+    const std::string labels = "device=\"" + escapeLabel(d.device) +
+                               "\",bus=\"" + escapeLabel(d.bus) + "\"";
+    for (double bound : kRttBounds) {
+      appendf(out, "modbus_rtt_seconds_bucket{%s,le=\"%g\"} %llu\n",
+              labels.c_str(), bound,
+              static_cast<unsigned long long>(d.rtt.countAtOrBelow(
+                  static_cast<std::uint64_t>(bound * 1e6))));
+    }
+    appendf(out, "modbus_rtt_seconds_bucket{%s,le=\"+Inf\"} %llu\n",
+            labels.c_str(), static_cast<unsigned long long>(d.rtt.count));
+    appendf(out, "modbus_rtt_seconds_sum{%s} %.6f\n", labels.c_str(),
+            d.rtt.sum / 1e6);
+    appendf(out, "modbus_rtt_seconds_count{%s} %llu\n", labels.c_str(),
+            static_cast<unsigned long long>(d.rtt.count));
+  }
+
+  appendf(out,
+          "# HELP modbus_bus_busy_seconds_total Thoi gian bus ban\n"
+          "# TYPE modbus_bus_busy_seconds_total counter\n");
+  for (const CommMetrics::BusSnapshot& b : current_.buses) {
+    appendf(out, "modbus_bus_busy_seconds_total{bus=\"%s\"} %.6f\n",
+            escapeLabel(b.bus).c_str(), b.busy_us / 1e6);
+  }
+  appendf(out,
+          "# HELP modbus_bus_utilization Ti le bus ban giua hai lan xuat\n"
+          "# TYPE modbus_bus_utilization gauge\n");
+  for (const CommMetrics::BusSnapshot& b : current_.buses) {
+    appendf(out, "modbus_bus_utilization{bus=\"%s\"} %.4f\n",
+            escapeLabel(b.bus).c_str(), utilization(b));
+  }
+  return out;
+}
+
+bool MetricsReport::writePrometheusFile(const std::string& path) const {
+  const std::string tmp = path + ".tmp";
+  std::FILE* file = std::fopen(tmp.c_str(), "w");
+  if (file == nullptr) return false;
+
+  const std::string text = prometheus();
+  bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+  ok = std::fclose(file) == 0 && ok;
+  return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,155 @@
+#include "config_watcher.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Ghi xong (IN_CLOSE_WRITE) hoac file moi duoc rename de len (IN_MOVED_TO)
+const std::uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+}  // namespace
+
+ConfigWatcher::ConfigWatcher(std::chrono::milliseconds debounce)
+    : debounce_(debounce),
+      inotify_fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      stop_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      running_(false) {
+  if (inotify_fd_ < 0 || stop_fd_ < 0) {
+    std::cerr << "[FAIL] ConfigWatcher: khong tao duoc inotify/eventfd: "
+              << std::strerror(errno) << std::endl;
+  }
+}
+
+ConfigWatcher::~ConfigWatcher() {
+  stop();
+  if (inotify_fd_ >= 0) close(inotify_fd_);
+  if (stop_fd_ >= 0) close(stop_fd_);
+}
+
+bool ConfigWatcher::watch(const std::string& path, Handler handler) {
+  if (inotify_fd_ < 0 || running_.load()) return false;
+
+  Entry entry;
+  entry.path = path;
+  const std::string::size_type slash = path.rfind('/');
+  entry.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+  if (entry.directory.empty()) entry.directory = "/";
+  entry.file_name = slash == std::string::npos ? path : path.substr(slash + 1);
+  entry.handler = handler;
+
+  // Nhieu file cung thu muc dung chung mot watch descriptor
+  entry.wd = inotify_add_watch(inotify_fd_, entry.directory.c_str(),
+                               kWatchMask);
+  if (entry.wd < 0) {
+    std::cerr << "[FAIL] ConfigWatcher: khong theo doi duoc "
+              << entry.directory << ": " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  entries_.push_back(entry);
+  return true;
+}
+
+bool ConfigWatcher::start() {
+  if (inotify_fd_ < 0 || stop_fd_ < 0 || running_.exchange(true)) {
+    return false;
+  }
+  worker_ = std::thread(&ConfigWatcher::run, this);
+  return true;
+}
+
+void ConfigWatcher::stop() {
+  if (!running_.exchange(false)) return;
+  const std::uint64_t one = 1;
+  if (write(stop_fd_, &one, sizeof(one)) < 0) {
+    std::cerr << "[WARN] ConfigWatcher: khong danh thuc duoc thread"
+              << std::endl;
+  }
+  if (worker_.joinable()) worker_.join();
+}
+
+/**
+ * @brief Vòng lặp của watcher: gom sự kiện inotify, hết debounce thì nạp lại
+ */
+void ConfigWatcher::run() {
+  // Du cho nhieu su kien, canh theo struct inotify_event
+  alignas(struct inotify_event) char buffer[4096];
+
+  while (running_.load()) {
+    // Ngu toi han debounce som nhat (hoac vo han neu khong co file cho nap)
+    int timeout_ms = -1;
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    for (const Entry& entry : entries_) {
+      if (!entry.pending) continue;
+      const long long wait_ms =
+          std::chrono::duration_cast<std::chrono::milliseconds>(entry.due -
+                                                                now)
+              .count();
+      const int clamped = wait_ms < 0 ? 0 : static_cast<int>(wait_ms);
+      if (timeout_ms < 0 || clamped < timeout_ms) timeout_ms = clamped;
+    }
+
+    pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+    if (poll(fds, 2, timeout_ms) < 0 && errno != EINTR) {
+      std::cerr << "[FAIL] ConfigWatcher: poll loi: " << std::strerror(errno)
+                << std::endl;
+      break;
+    }
+    if (fds[1].revents & POLLIN) break;
+
+    if (fds[0].revents & POLLIN) {
+      for (;;) {
+        const ssize_t size = read(inotify_fd_, buffer, sizeof(buffer));
+        if (size <= 0) break;
+        for (ssize_t offset = 0; offset < size;) {
+          const struct inotify_event* event =
+              reinterpret_cast<const struct inotify_event*>(buffer + offset);
+          offset += sizeof(struct inotify_event) + event->len;
+          if (event->len == 0) continue;
+          for (Entry& entry : entries_) {
+            if (entry.wd == event->wd && entry.file_name == event->name) {
+              entry.pending = true;
+              entry.due = std::chrono::steady_clock::now() + debounce_;
+            }
+          }
+        }
+      }
+    }
+
+    const std::chrono::steady_clock::time_point after =
+        std::chrono::steady_clock::now();
+    for (Entry& entry : entries_) {
+      if (entry.pending && entry.due <= after) {
+        entry.pending = false;
+        load(entry);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Parse + validate file; cấu hình lỗi bị bỏ qua và hệ thống giữ cấu
+ *        hình đang chạy
+ */
+void ConfigWatcher::load(Entry& entry) {
+  MeterConfig config;
+  if (!config.loadFromJson(entry.path) || !config.validate()) {
+    std::cerr << "[WARN] ConfigWatcher: " << entry.path
+              << " khong hop le, giu cau hinh dang chay" << std::endl;
+    return;
+  }
+  try {
+    entry.handler(config);
+  } catch (const std::exception& e) {
+    std::cerr << "[WARN] ConfigWatcher: nap lai " << entry.path
+              << " that bai: " << e.what() << std::endl;
+  }
+}
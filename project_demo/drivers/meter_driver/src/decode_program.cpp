@@ -0,0 +1,117 @@
+#include "decode_program.h"
+
+#include <cstring>
+
+namespace {
+
+// Ghep kWords word thanh mot so nguyen big-endian theo thu tu byte da chon.
+// Cac tham so la hang so khi bien dich nen vong lap duoc trai phang.
+template <int kWords, bool kSwapWords, bool kSwapBytes>
+inline std::uint64_t assemble(const std::uint16_t* words) {
+  std::uint64_t raw = 0;
+  for (int i = 0; i < kWords; ++i) {
+    std::uint16_t word = words[kSwapWords ? kWords - 1 - i : i];
+    if (kSwapBytes) {
+      word = static_cast<std::uint16_t>((word >> 8) | (word << 8));
+    }
+    raw = (raw << 16) | word;
+  }
+  return raw;
+}
+
+template <typename T, int kWords, bool kSwapWords, bool kSwapBytes>
+double decodeInteger(const std::uint16_t* words, const DecodeOp& op) {
+  std::uint64_t raw =
+      (assemble<kWords, kSwapWords, kSwapBytes>(words) >> op.shift) & op.mask;
+  return static_cast<double>(static_cast<T>(raw)) * op.scale + op.offset;
+}
+
+template <bool kSwapWords, bool kSwapBytes>
+double decodeFloat32(const std::uint16_t* words, const DecodeOp& op) {
+  std::uint32_t raw = static_cast<std::uint32_t>(
+      assemble<2, kSwapWords, kSwapBytes>(words));
+  float value;
+  std::memcpy(&value, &raw, sizeof(value));
+  return static_cast<double>(value) * op.scale + op.offset;
+}
+
+template <bool kSwapWords, bool kSwapBytes>
+double decodeFloat64(const std::uint16_t* words, const DecodeOp& op) {
+  std::uint64_t raw = assemble<4, kSwapWords, kSwapBytes>(words);
+  double value;
+  std::memcpy(&value, &raw, sizeof(value));
+  return value * op.scale + op.offset;
+}
+
+template <bool kSwapWords, bool kSwapBytes>
+DecodeFn selectForOrder(DataType type) {
+  switch (type) {
+    case DataType::kInt16:
+      return &decodeInteger<std::int16_t, 1, kSwapWords, kSwapBytes>;
+    case DataType::kUint16:
+      return &decodeInteger<std::uint16_t, 1, kSwapWords, kSwapBytes>;
+    case DataType::kInt32:
+      return &decodeInteger<std::int32_t, 2, kSwapWords, kSwapBytes>;
+    case DataType::kUint32:
+      return &decodeInteger<std::uint32_t, 2, kSwapWords, kSwapBytes>;
+    case DataType::kInt64:
+      return &decodeInteger<std::int64_t, 4, kSwapWords, kSwapBytes>;
+    case DataType::kFloat32:
+      return &decodeFloat32<kSwapWords, kSwapBytes>;
+    case DataType::kFloat64:
+      return &decodeFloat64<kSwapWords, kSwapBytes>;
+  }
+  return &decodeInteger<std::uint16_t, 1, kSwapWords, kSwapBytes>;
+}
+
+DecodeFn selectDecoder(DataType type, WordOrder order) {
+  switch (order) {
+    case WordOrder::kABCD:
+      return selectForOrder<false, false>(type);
+    case WordOrder::kBADC:
+      return selectForOrder<false, true>(type);
+    case WordOrder::kCDAB:
+      return selectForOrder<true, false>(type);
+    case WordOrder::kDCBA:
+      return selectForOrder<true, true>(type);
+  }
+  return selectForOrder<false, false>(type);
+}
+
+}  // namespace
+
+/**
+ * @brief Biên dịch ReadPlan thành chương trình giải mã phẳng
+ * @param plan Kế hoạch đọc đã gom block
+ * @return Chương trình có một DecodeOp cho mỗi tag, nhóm theo block
+ *
+ * Mọi quyết định phụ thuộc cấu hình (kiểu, thứ tự byte, trường bit) được
+ * thực hiện ở đây một lần; run() chỉ gọi con trỏ hàm đã chọn sẵn.
+ */
+DecodeProgram DecodeProgram::compile(const ReadPlan& plan) {
+  DecodeProgram program;
+  program.block_begin_.push_back(0);
+
+  for (const ReadBlock& block : plan.blocks()) {
+    for (const BlockEntry& entry : block.entries) {
+      DecodeOp op;
+      op.fn = selectDecoder(entry.type, entry.order);
+      op.word = entry.offset;
+      op.slot = static_cast<std::uint16_t>(program.names_.size());
+      if (entry.bit_width > 0 && entry.bit_width < 64) {
+        op.shift = entry.bit_offset;
+        op.mask = (std::uint64_t(1) << entry.bit_width) - 1;
+      } else {
+        op.shift = 0;
+        op.mask = ~std::uint64_t(0);
+      }
+      op.scale = entry.scale;
+      op.offset = entry.value_offset;
+
+      program.ops_.push_back(op);
+      program.names_.push_back(entry.name);
+    }
+    program.block_begin_.push_back(program.ops_.size());
+  }
+  return program;
+}
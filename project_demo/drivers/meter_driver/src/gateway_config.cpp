@@ -0,0 +1,215 @@
+#include "gateway_config.h"
+
+#include <iostream>
+#include <set>
+#include <utility>
+
+/**
+ * @brief Tải cấu hình gateway (bus, profile, thiết bị) từ file JSON
+ * @param filename Đường dẫn tệp JSON
+ * @return true nếu phân tích thành công (chưa validate)
+ *
+ * Mỗi profile được biên dịch thành DeviceModel đúng một lần; thiết bị chỉ
+ * sao chép phần cấu hình nhỏ và trỏ tới model của profile.
+ */
+bool GatewayConfig::loadFromJson(const std::string& filename) {
+  std::string json_content = readFileToString(filename);
+  if (json_content.empty()) {
+    std::cerr << "ERROR: Khong the doc file hoac file rong: " << filename
+              << std::endl;
+    return false;
+  }
+
+  cJSON* root = cJSON_Parse(json_content.c_str());
+  if (root == nullptr) {
+    const char* error_ptr = cJSON_GetErrorPtr();
+    if (error_ptr != nullptr) {
+      std::cerr << "ERROR: Loi phan tich JSON truoc: " << error_ptr
+                << std::endl;
+    }
+    return false;
+  }
+
+  bool success = true;
+  cJSON* json_buses = cJSON_GetObjectItemCaseSensitive(root, "buses");
+  if (cJSON_IsObject(json_buses)) {
+    for (cJSON* item = json_buses->child; item != nullptr; item = item->next) {
+      BusConfig bus;
+      bus.name = item->string;
+      if (!bus.parseJson(item)) success = false;
+      buses[bus.name] = bus;
+    }
+  }
+
+  if (success) {
+    success = parseProfiles(cJSON_GetObjectItemCaseSensitive(root, "profiles"));
+  }
+  if (success) {
+    success = parseDevices(cJSON_GetObjectItemCaseSensitive(root, "devices"));
+  }
+  cJSON_Delete(root);
+
+  if (success) {
+    std::cout << "[INFO] Tai cau hinh gateway: " << buses.size() << " bus, "
+              << profiles.size() << " profile, " << devices.size()
+              << " thiet bi" << std::endl;
+  }
+  return success;
+}
+
+bool GatewayConfig::parseProfiles(const cJSON* object) {
+  if (!cJSON_IsObject(object)) return true;
+
+  for (cJSON* item = object->child; item != nullptr; item = item->next) {
+    std::shared_ptr<DeviceProfile> profile = std::make_shared<DeviceProfile>();
+    profile->name = item->string;
+    if (!profile->defaults.parseJson(item)) return false;
+    profile->model =
+        std::make_shared<DeviceModel>(*profile->defaults.registers,
+                                      profile->defaults.max_register_gap);
+    profiles[profile->name] = profile;
+  }
+  return true;
+}
+
+bool GatewayConfig::parseDevices(const cJSON* array) {
+  if (!cJSON_IsArray(array)) return true;
+
+  devices.reserve(cJSON_GetArraySize(array));
+  for (cJSON* item = array->child; item != nullptr; item = item->next) {
+    cJSON* id = cJSON_GetObjectItemCaseSensitive(item, "device_id");
+    const std::string device_id = cJSON_IsString(id) ? id->valuestring : "";
+
+    // Thanh ghi rieng se lam mat ke hoach doc dung chung cua profile
+    if (cJSON_GetObjectItemCaseSensitive(item, "registers") != nullptr ||
+        cJSON_GetObjectItemCaseSensitive(item, "max_register_gap") !=
+            nullptr) {
+      std::cerr << "ERROR: Thiet bi " << device_id
+                << " khong duoc khai bao registers/max_register_gap rieng, "
+                   "hay tao profile moi"
+                << std::endl;
+      return false;
+    }
+
+    cJSON* profile_name = cJSON_GetObjectItemCaseSensitive(item, "profile");
+    std::map<std::string, DeviceProfilePtr>::const_iterator profile =
+        cJSON_IsString(profile_name) ? profiles.find(profile_name->valuestring)
+                                     : profiles.end();
+    if (profile == profiles.end()) {
+      std::cerr << "ERROR: Thiet bi " << device_id
+                << " tham chieu profile khong ton tai" << std::endl;
+      return false;
+    }
+
+    cJSON* bus_name = cJSON_GetObjectItemCaseSensitive(item, "bus");
+    std::map<std::string, BusConfig>::const_iterator bus =
+        cJSON_IsString(bus_name) ? buses.find(bus_name->valuestring)
+                                 : buses.end();
+    if (bus == buses.end()) {
+      std::cerr << "ERROR: Thiet bi " << device_id
+                << " tham chieu bus khong ton tai" << std::endl;
+      return false;
+    }
+
+    DeviceInstance device;
+    device.profile = profile->second;
+    device.bus = bus->first;
+    device.config = profile->second->defaults;
+    if (!device.config.parseJson(item)) return false;
+    device.config.serial_port = bus->second.key();
+    device.config.baudrate = bus->second.type == BusConfig::Type::kRtu
+                                 ? bus->second.baudrate
+                                 : 0;
+    devices.push_back(std::move(device));
+  }
+  return true;
+}
+
+/**
+ * @brief Kiểm tra bus, profile và thiết bị
+ *
+ * Profile được kiểm tra đầy đủ một lần; với từng thiết bị chỉ kiểm tra phần
+ * riêng (ID, slave, giá trị ghi đè) để chi phí không tỉ lệ với số thanh ghi.
+ */
+bool GatewayConfig::validate() const {
+  if (devices.empty()) {
+    std::cerr << "[VALIDATION FAIL] Khong co thiet bi nao duoc cau hinh."
+              << std::endl;
+    return false;
+  }
+  for (const auto& pair : buses) {
+    if (!pair.second.validate()) return false;
+  }
+  for (const auto& pair : profiles) {
+    if (!pair.second->defaults.validateModel()) {
+      std::cerr << "[VALIDATION FAIL] Profile " << pair.first
+                << " khong hop le." << std::endl;
+      return false;
+    }
+  }
+
+  std::set<std::string> ids;
+  std::set<std::pair<std::string, int> > slaves;
+  for (const DeviceInstance& device : devices) {
+    const MeterConfig& config = device.config;
+    const BusConfig& bus = buses.find(device.bus)->second;
+
+    if (config.device_id.empty() || !ids.insert(config.device_id).second) {
+      std::cerr << "[VALIDATION FAIL] device_id '" << config.device_id
+                << "' rong hoac bi trung." << std::endl;
+      return false;
+    }
+    // TCP cho phep unit ID 0 va 248-255 (gateway phia sau)
+    const int max_slave = bus.type == BusConfig::Type::kTcp ? 255 : 247;
+    const int min_slave = bus.type == BusConfig::Type::kTcp ? 0 : 1;
+    if (config.slave_id < min_slave || config.slave_id > max_slave) {
+      std::cerr << "[VALIDATION FAIL] Slave ID (" << config.slave_id
+                << ") cua thiet bi " << config.device_id
+                << " nam ngoai khoang cho phep." << std::endl;
+      return false;
+    }
+    if (!slaves.insert(std::make_pair(device.bus, config.slave_id)).second) {
+      std::cerr << "[VALIDATION FAIL] Slave ID " << config.slave_id
+                << " bi trung tren bus " << device.bus << "." << std::endl;
+      return false;
+    }
+    if (config.poll_interval_ms <= 0 || config.max_silence_ms < 0) {
+      std::cerr << "[VALIDATION FAIL] Chu ky cua thiet bi "
+                << config.device_id << " khong hop le." << std::endl;
+      return false;
+    }
+    for (const auto& pair : config.poll_classes) {
+      if (pair.second <= 0) {
+        std::cerr << "[VALIDATION FAIL] Chu ky cua lop " << pair.first
+                  << " (thiet bi " << config.device_id
+                  << ") phai la so duong." << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::vector<std::unique_ptr<MeterDriver> > GatewayConfig::createDrivers(
+    std::vector<const DeviceInstance*>* instances) const {
+  std::map<std::string, std::shared_ptr<BusExecutor> > opened;
+  for (const auto& pair : buses) {
+    opened[pair.first] = MeterDriver::openBus(pair.second);
+    if (!opened[pair.first]) {
+      std::cerr << "[WARN] Khong mo duoc bus " << pair.first
+                << ", bo qua cac thiet bi tren bus nay" << std::endl;
+    }
+  }
+
+  std::vector<std::unique_ptr<MeterDriver> > drivers;
+  drivers.reserve(devices.size());
+  if (instances != nullptr) instances->clear();
+  for (const DeviceInstance& device : devices) {
+    const std::shared_ptr<BusExecutor>& bus = opened[device.bus];
+    if (!bus) continue;
+    drivers.emplace_back(
+        new MeterDriver(device.config, device.profile->model, bus));
+    if (instances != nullptr) instances->push_back(&device);
+  }
+  return drivers;
+}
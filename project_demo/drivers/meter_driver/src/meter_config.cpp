@@ -20,6 +20,158 @@ std::string readFileToString(const std::string& filename) {
   return buffer.str();
 }
 
+int wordsForType(DataType type) {
+  switch (type) {
+    case DataType::kInt16:
+    case DataType::kUint16:
+      return 1;
+    case DataType::kInt32:
+    case DataType::kUint32:
+    case DataType::kFloat32:
+      return 2;
+    case DataType::kInt64:
+    case DataType::kFloat64:
+      return 4;
+  }
+  return 1;
+}
+
+/**
+ * @brief Chuyển tên kiểu trong JSON ("int16", "float32"...) thành DataType
+ * @return false nếu tên kiểu không hợp lệ
+ */
+bool parseDataType(const std::string& text, DataType* type) {
+  static const struct {
+    const char* name;
+    DataType type;
+  } kTypes[] = {{"int16", DataType::kInt16},     {"uint16", DataType::kUint16},
+                {"int32", DataType::kInt32},     {"uint32", DataType::kUint32},
+                {"int64", DataType::kInt64},     {"float32", DataType::kFloat32},
+                {"float64", DataType::kFloat64}};
+  for (const auto& item : kTypes) {
+    if (text == item.name) {
+      *type = item.type;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Chuyển thứ tự byte trong JSON ("ABCD", "CDAB"...) thành WordOrder
+ * @return false nếu thứ tự không hợp lệ
+ */
+bool parseWordOrder(const std::string& text, WordOrder* order) {
+  if (text == "ABCD") {
+    *order = WordOrder::kABCD;
+  } else if (text == "BADC") {
+    *order = WordOrder::kBADC;
+  } else if (text == "CDAB") {
+    *order = WordOrder::kCDAB;
+  } else if (text == "DCBA") {
+    *order = WordOrder::kDCBA;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool operator==(const RegisterConfig& lhs, const RegisterConfig& rhs) {
+  return lhs.name == rhs.name && lhs.address == rhs.address &&
+         lhs.quantity == rhs.quantity && lhs.scale == rhs.scale &&
+         lhs.offset == rhs.offset && lhs.type == rhs.type &&
+         lhs.order == rhs.order && lhs.bit_offset == rhs.bit_offset &&
+         lhs.bit_width == rhs.bit_width && lhs.poll_class == rhs.poll_class &&
+         lhs.deadband == rhs.deadband && lhs.deadband_pct == rhs.deadband_pct;
+}
+
+bool operator==(const MeterConfig& lhs, const MeterConfig& rhs) {
+  return lhs.device_id == rhs.device_id &&
+         lhs.serial_port == rhs.serial_port && lhs.baudrate == rhs.baudrate &&
+         lhs.slave_id == rhs.slave_id &&
+         lhs.poll_interval_ms == rhs.poll_interval_ms &&
+         lhs.max_register_gap == rhs.max_register_gap &&
+         lhs.poll_classes == rhs.poll_classes &&
+         lhs.report_by_exception == rhs.report_by_exception &&
+         lhs.max_silence_ms == rhs.max_silence_ms &&
+         (lhs.registers == rhs.registers ||
+          *lhs.registers == *rhs.registers);
+}
+
+std::string BusConfig::key() const {
+  if (type == Type::kTcp) return host + ":" + std::to_string(tcp_port);
+  return port;
+}
+
+/**
+ * @brief Đọc một bus trong cấu hình gateway
+ *
+ * RTU: { "type": "rtu", "port": "/dev/ttyS3", "baudrate": 9600, "parity":
+ * "N", "data_bits": 8, "stop_bits": 1 }
+ * TCP: { "type": "tcp", "host": "192.168.1.10", "port": 502 }
+ */
+bool BusConfig::parseJson(const cJSON* object) {
+  cJSON* kind = cJSON_GetObjectItemCaseSensitive(object, "type");
+  if (cJSON_IsString(kind)) {
+    const std::string text = kind->valuestring;
+    if (text == "tcp") {
+      type = Type::kTcp;
+    } else if (text == "rtu") {
+      type = Type::kRtu;
+    } else {
+      std::cerr << "ERROR: Kieu bus khong hop le cho " << name << ": " << text
+                << std::endl;
+      return false;
+    }
+  }
+
+  cJSON* port_item = cJSON_GetObjectItemCaseSensitive(object, "port");
+  if (type == Type::kTcp) {
+    cJSON* host_item = cJSON_GetObjectItemCaseSensitive(object, "host");
+    if (cJSON_IsString(host_item)) host = host_item->valuestring;
+    if (cJSON_IsNumber(port_item)) tcp_port = port_item->valueint;
+    return true;
+  }
+
+  if (cJSON_IsString(port_item)) port = port_item->valuestring;
+  cJSON* br = cJSON_GetObjectItemCaseSensitive(object, "baudrate");
+  if (cJSON_IsNumber(br)) baudrate = br->valueint;
+  cJSON* par = cJSON_GetObjectItemCaseSensitive(object, "parity");
+  if (cJSON_IsString(par) && par->valuestring[0] != '\0') {
+    parity = par->valuestring[0];
+  }
+  cJSON* bits = cJSON_GetObjectItemCaseSensitive(object, "data_bits");
+  if (cJSON_IsNumber(bits)) data_bits = bits->valueint;
+  cJSON* stop = cJSON_GetObjectItemCaseSensitive(object, "stop_bits");
+  if (cJSON_IsNumber(stop)) stop_bits = stop->valueint;
+  return true;
+}
+
+bool BusConfig::validate() const {
+  if (type == Type::kTcp) {
+    if (host.empty() || tcp_port < 1 || tcp_port > 65535) {
+      std::cerr << "[VALIDATION FAIL] Bus " << name
+                << " can host va port trong khoang [1, 65535]." << std::endl;
+      return false;
+    }
+    return true;
+  }
+  if (port.empty() || baudrate <= 0) {
+    std::cerr << "[VALIDATION FAIL] Bus " << name
+              << " can port va baudrate duong." << std::endl;
+    return false;
+  }
+  if ((parity != 'N' && parity != 'E' && parity != 'O') || data_bits < 5 ||
+      data_bits > 8 || (stop_bits != 1 && stop_bits != 2)) {
+    std::cerr << "[VALIDATION FAIL] Bus " << name
+              << " co khung truyen khong hop le (parity N/E/O, 5-8 data bit, "
+                 "1-2 stop bit)."
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
 /**
  * @brief Tải cấu hình thiết bị đồng hồ từ file JSON
  * @param filename Đường dẫn tệp JSON chứa cấu hình
@@ -29,7 +181,13 @@ std::string readFileToString(const std::string& filename) {
  * - Đọc file JSON từ đường dẫn được cấp
  * - Phân tích các trường cấu hình: device_id, serial_port, baudrate, slave_id,
  * poll_interval_ms
- * - Xử lý danh sách các register với địa chỉ và hệ số scale
+ * - Xử lý danh sách các register với địa chỉ, số word và hệ số scale
+ * - Đọc max_register_gap dùng cho việc gom block (ReadPlan)
+ * - Đọc poll_classes: chu kỳ đọc riêng cho từng nhóm thanh ghi
+ * - Đọc kiểu dữ liệu (type), thứ tự byte (order), offset và trường bit của
+ * từng register; quantity mặc định bằng số word của kiểu
+ * - Đọc report_by_exception, max_silence_ms và deadband/deadband_pct của
+ * từng register
  */
 bool MeterConfig::loadFromJson(const std::string& filename) {
   std::string json_content = readFileToString(filename);
@@ -51,32 +209,72 @@ bool MeterConfig::loadFromJson(const std::string& filename) {
     return false;
   }
 
+  const bool success = parseJson(root);
+  cJSON_Delete(root);
+
+  if (success) {
+    std::cout << "[INFO] Tai cau hinh thanh cong cho: " << device_id
+              << std::endl;
+  }
+  return success;
+}
+
+/**
+ * @brief Đọc các trường cấu hình từ một object JSON đã phân tích
+ * @param object Object gốc của file, hoặc profile/thiết bị trong cấu hình
+ *        gateway
+ * @return false nếu có trường không hợp lệ
+ *
+ * Chỉ ghi đè các trường có mặt; poll_classes được gộp theo tên lớp, còn
+ * registers (nếu có) thay cả bản đồ thanh ghi.
+ */
+bool MeterConfig::parseJson(const cJSON* object) {
   bool success = true;
   try {
     // Trích xuất ID thiết bị tu root JSON
-    cJSON* id = cJSON_GetObjectItemCaseSensitive(root, "device_id");
+    cJSON* id = cJSON_GetObjectItemCaseSensitive(object, "device_id");
     if (cJSON_IsString(id))
       device_id =
           id->valuestring;  // neu dung la tra ve String thi ID = gia tri do
 
     // Trích xuất cổng serial
-    cJSON* port = cJSON_GetObjectItemCaseSensitive(root, "serial_port");
+    cJSON* port = cJSON_GetObjectItemCaseSensitive(object, "serial_port");
     if (cJSON_IsString(port)) serial_port = port->valuestring;
 
     // Trích xuất tốc độ baud
-    cJSON* br = cJSON_GetObjectItemCaseSensitive(root, "baudrate");
+    cJSON* br = cJSON_GetObjectItemCaseSensitive(object, "baudrate");
     if (cJSON_IsNumber(br)) baudrate = br->valueint;
 
     // Trích xuất ID slave Modbus
-    cJSON* sid = cJSON_GetObjectItemCaseSensitive(root, "slave_id");
+    cJSON* sid = cJSON_GetObjectItemCaseSensitive(object, "slave_id");
     if (cJSON_IsNumber(sid)) slave_id = sid->valueint;
 
     // Trích xuất khoảng thời gian polling (ms)
-    cJSON* poll = cJSON_GetObjectItemCaseSensitive(root, "poll_interval_ms");
+    cJSON* poll = cJSON_GetObjectItemCaseSensitive(object, "poll_interval_ms");
     if (cJSON_IsNumber(poll)) poll_interval_ms = poll->valueint;
 
+    // Khoảng trống tối đa khi gom thanh ghi thành block (tùy chọn)
+    cJSON* gap = cJSON_GetObjectItemCaseSensitive(object, "max_register_gap");
+    if (cJSON_IsNumber(gap)) max_register_gap = gap->valueint;
+
+    // Report-by-exception và chu kỳ heartbeat (tùy chọn)
+    cJSON* rbe =
+        cJSON_GetObjectItemCaseSensitive(object, "report_by_exception");
+    if (cJSON_IsBool(rbe)) report_by_exception = cJSON_IsTrue(rbe);
+    cJSON* silence = cJSON_GetObjectItemCaseSensitive(object, "max_silence_ms");
+    if (cJSON_IsNumber(silence)) max_silence_ms = silence->valueint;
+
+    // Các lớp chu kỳ đọc: { "power": 200, "energy": 10000, ... }
+    cJSON* classes = cJSON_GetObjectItemCaseSensitive(object, "poll_classes");
+    if (cJSON_IsObject(classes)) {
+      for (cJSON* item = classes->child; item != nullptr; item = item->next) {
+        if (cJSON_IsNumber(item)) poll_classes[item->string] = item->valueint;
+      }
+    }
+
     // Trích xuất danh sách các register
-    cJSON* json_registers = cJSON_GetObjectItemCaseSensitive(root, "registers");
+    cJSON* json_registers =
+        cJSON_GetObjectItemCaseSensitive(object, "registers");
 
     // lay danh sach register neu la object
     if (cJSON_IsObject(
@@ -85,6 +283,7 @@ bool MeterConfig::loadFromJson(const std::string& filename) {
           json_registers->child;  // tro toi cac truong con trong doi tuong
 
       // Duyệt qua tất cả các register trong JSON
+      std::shared_ptr<RegisterMap> parsed = std::make_shared<RegisterMap>();
       while (register_item != nullptr) {
         RegisterConfig
             reg;  // lay cua truc struct de luu tru cau hinh tung register
@@ -101,21 +300,68 @@ bool MeterConfig::loadFromJson(const std::string& filename) {
         cJSON* scale = cJSON_GetObjectItemCaseSensitive(register_info, "scale");
         if (cJSON_IsNumber(scale)) reg.scale = scale->valuedouble;
 
+        // Độ lệch cộng thêm sau khi nhân scale (tùy chọn)
+        cJSON* offset =
+            cJSON_GetObjectItemCaseSensitive(register_info, "offset");
+        if (cJSON_IsNumber(offset)) reg.offset = offset->valuedouble;
+
+        // Kiểu dữ liệu và thứ tự byte (mặc định uint16, ABCD)
+        cJSON* type = cJSON_GetObjectItemCaseSensitive(register_info, "type");
+        if (cJSON_IsString(type) &&
+            !parseDataType(type->valuestring, &reg.type)) {
+          std::cerr << "ERROR: Kieu du lieu khong hop le cho " << reg.name
+                    << ": " << type->valuestring << std::endl;
+          success = false;
+        }
+        cJSON* order = cJSON_GetObjectItemCaseSensitive(register_info, "order");
+        if (cJSON_IsString(order) &&
+            !parseWordOrder(order->valuestring, &reg.order)) {
+          std::cerr << "ERROR: Thu tu byte khong hop le cho " << reg.name
+                    << ": " << order->valuestring << std::endl;
+          success = false;
+        }
+
+        // Số word liên tiếp của thanh ghi (mặc định theo kiểu dữ liệu)
+        reg.quantity = static_cast<std::uint16_t>(wordsForType(reg.type));
+        cJSON* quantity =
+            cJSON_GetObjectItemCaseSensitive(register_info, "quantity");
+        if (cJSON_IsNumber(quantity))
+          reg.quantity = (std::uint16_t)quantity->valueint;
+
+        // Trường bit: lấy bit_width bit bắt đầu từ bit_offset (tùy chọn)
+        cJSON* bit_offset =
+            cJSON_GetObjectItemCaseSensitive(register_info, "bit_offset");
+        if (cJSON_IsNumber(bit_offset))
+          reg.bit_offset = (std::uint8_t)bit_offset->valueint;
+        cJSON* bit_width =
+            cJSON_GetObjectItemCaseSensitive(register_info, "bit_width");
+        if (cJSON_IsNumber(bit_width))
+          reg.bit_width = (std::uint8_t)bit_width->valueint;
+
+        // Lớp chu kỳ đọc của thanh ghi (tùy chọn)
+        cJSON* poll_class =
+            cJSON_GetObjectItemCaseSensitive(register_info, "poll_class");
+        if (cJSON_IsString(poll_class)) reg.poll_class = poll_class->valuestring;
+
+        // Deadband tuyệt đối / phần trăm cho report-by-exception (tùy chọn)
+        cJSON* deadband =
+            cJSON_GetObjectItemCaseSensitive(register_info, "deadband");
+        if (cJSON_IsNumber(deadband)) reg.deadband = deadband->valuedouble;
+        cJSON* deadband_pct =
+            cJSON_GetObjectItemCaseSensitive(register_info, "deadband_pct");
+        if (cJSON_IsNumber(deadband_pct))
+          reg.deadband_pct = deadband_pct->valuedouble;
+
         // Lưu cấu hình register vào bản đồ
-        registers[reg.name] = reg;
+        (*parsed)[reg.name] = reg;
         register_item = register_item->next;
       }
+      registers = parsed;
     }
   } catch (...) {
     std::cerr << "ERROR: Loi truy cap du lieu JSON voi cJSON." << std::endl;
     success = false;
   }
 
-  cJSON_Delete(root);
-
-  if (success) {
-    std::cout << "[INFO] Tai cau hinh thanh cong cho: " << device_id
-              << std::endl;
-  }
   return success;
-}
\ No newline at end of file
+}
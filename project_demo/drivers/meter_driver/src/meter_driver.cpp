@@ -6,42 +6,137 @@
 
 extern int errno;
 
-MeterDriver::MeterDriver(const MeterConfig& config) : config_(config) {
-  if (!establishConnection()) {
-    throw std::runtime_error(
-        "Khoi tao Driver that bai. Khong the ket noi Modbus.");
+MeterDriver::MeterDriver(const MeterConfig& config)
+    : MeterDriver(config, std::shared_ptr<BusExecutor>()) {}
+
+DeviceModel::DeviceModel(const RegisterMap& registers, int max_register_gap)
+    : plan(ReadPlan::build(registers, max_register_gap)),
+      decoder(DecodeProgram::compile(plan)),
+      tag_blocks(decoder.tagCount()) {
+  for (std::size_t i = 0; i < plan.blocks().size(); ++i) {
+    for (const DecodeOp* op = decoder.blockBegin(i); op != decoder.blockEnd(i);
+         ++op) {
+      tag_blocks[op->slot] = static_cast<std::uint16_t>(i);
+    }
   }
-  std::cout << "[INFO] Driver " << config_.device_id << " đã sẵn sàng."
-            << std::endl;
+  std::cout << "[INFO] Ke hoach doc: " << registers.size() << " tags -> "
+            << plan.blocks().size() << " block(s), " << plan.totalRegisters()
+            << " registers/chu ky" << std::endl;
 }
 
-bool MeterDriver::establishConnection() {
-  modbus_t* temp_ctx =
-      modbus_new_rtu(config_.serial_port.c_str(), config_.baudrate, 'N', 8, 1);
-
-  ctx_.reset(temp_ctx);
+DriverPlan::DriverPlan(const MeterConfig& meter_config)
+    : DriverPlan(meter_config,
+                 std::make_shared<DeviceModel>(*meter_config.registers,
+                                               meter_config.max_register_gap)) {
+}
 
-  if (!ctx_) {
-    std::cerr << "[FAIL] Khong the tao Modbus context: "
-              << modbus_strerror(errno) << std::endl;
-    return false;
+DriverPlan::DriverPlan(const MeterConfig& meter_config,
+                       DeviceModelPtr device_model)
+    : config(meter_config),
+      model(device_model),
+      plan(model->plan),
+      decoder(model->decoder),
+      schema(std::make_shared<SampleSchema>(
+          config.device_id, decoder.tagNames(), model->tag_blocks,
+          plan.blocks().size())) {}
+
+MeterDriver::MeterDriver(const MeterConfig& config,
+                         std::shared_ptr<BusExecutor> bus)
+    : MeterDriver(config, DeviceModelPtr(), bus) {}
+
+MeterDriver::MeterDriver(const MeterConfig& config, DeviceModelPtr model,
+                         std::shared_ptr<BusExecutor> bus)
+    : plan_(model ? std::make_shared<DriverPlan>(config, model)
+                  : std::make_shared<DriverPlan>(config)),
+      generation_(0),
+      bus_(bus) {
+  block_buffer_.resize(plan_->plan.maxBlockSize());
+
+  if (!bus_ && !establishConnection(config)) {
+    throw std::runtime_error(
+        "Khoi tao Driver that bai. Khong the ket noi Modbus.");
   }
+  metrics_ = CommMetrics::instance().device(config.device_id, bus_->name());
+  std::cout << "[INFO] Driver " << config.device_id << " đã sẵn sàng (bus "
+            << bus_->name() << ")." << std::endl;
+}
 
-  if (modbus_set_slave(ctx_.get(), config_.slave_id) == -1) {
-    std::cerr << "[FAIL] Khong the thiet lap Slave ID " << config_.slave_id
-              << ": " << modbus_strerror(errno) << std::endl;
-    ctx_.reset(nullptr);
-    return false;
+/**
+ * @brief So sánh cấu hình mới với kế hoạch đang chạy và thay kế hoạch nếu cần
+ * @return kUnchanged nếu không có gì ảnh hưởng tới việc đọc, kRejected nếu
+ *         thay đổi cần tạo lại bus
+ */
+MeterDriver::ReloadResult MeterDriver::reload(const MeterConfig& config) {
+  const DriverPlanPtr running = current();
+  const MeterConfig& old = running->config;
+
+  if (config.device_id != old.device_id ||
+      config.serial_port != old.serial_port ||
+      config.baudrate != old.baudrate) {
+    std::cerr << "[WARN] Driver " << old.device_id
+              << ": doi device_id/serial_port/baudrate can khoi dong lai, "
+                 "giu cau hinh cu"
+              << std::endl;
+    return ReloadResult::kRejected;
   }
+  if (config == old) return ReloadResult::kUnchanged;
+
+  // Dung ke hoach moi tren thread goi, thread cua bus khong phai cho. Chi
+  // doi chu ky/deadband: giu model (va block) dang dung chung
+  const bool same_model =
+      config.max_register_gap == old.max_register_gap &&
+      (config.registers == old.registers ||
+       *config.registers == *old.registers);
+  DriverPlanPtr next =
+      same_model ? std::make_shared<DriverPlan>(config, running->model)
+                 : std::make_shared<DriverPlan>(config);
+  std::atomic_store(&plan_, next);
+  generation_.fetch_add(1, std::memory_order_release);
+  std::cout << "[INFO] Driver " << config.device_id
+            << ": ap dung cau hinh moi (schema " << next->schema->id() << ")"
+            << std::endl;
+  return ReloadResult::kApplied;
+}
 
-  if (modbus_connect(ctx_.get()) == -1) {
-    std::cerr << "[FAIL] Khong the ket noi Modbus toi " << config_.serial_port
-              << ": " << modbus_strerror(errno) << std::endl;
-    ctx_.reset(nullptr);
-    return false;
-  }
+bool MeterDriver::establishConnection(const MeterConfig& config) {
+  BusConfig bus;
+  bus.name = config.serial_port;
+  bus.port = config.serial_port;
+  bus.baudrate = config.baudrate;
+  bus_ = openBus(bus);
+  return bus_ != nullptr;
+}
 
-  return true;
+std::shared_ptr<BusExecutor> MeterDriver::openBus(const BusConfig& bus) {
+  // Context chi duoc tao mot lan cho moi cong, thread cua bus so huu no
+  return BusRegistry::instance().acquire(
+      bus.key(), [&bus]() -> ModbusContextPtr {
+        const bool rtu = bus.type == BusConfig::Type::kRtu;
+        ModbusContextPtr ctx(
+            rtu ? modbus_new_rtu(bus.port.c_str(), bus.baudrate, bus.parity,
+                                 bus.data_bits, bus.stop_bits)
+                : modbus_new_tcp(bus.host.c_str(), bus.tcp_port));
+        if (!ctx) {
+          std::cerr << "[FAIL] Khong the tao Modbus context: "
+                    << modbus_strerror(errno) << std::endl;
+          return ModbusContextPtr();
+        }
+
+        // Bus RS-485 dung chung: chen t3.5 dung theo baud thay vi sleep co
+        // dinh, timeout moi slave hoc tu p99 do tre thuc te
+        if (rtu && modbus_rtu_set_timing_mode(
+                       ctx.get(), MODBUS_RTU_TIMING_ADAPTIVE) == -1) {
+          std::cerr << "[WARN] Khong bat duoc timing thich ung: "
+                    << modbus_strerror(errno) << std::endl;
+        }
+
+        if (modbus_connect(ctx.get()) == -1) {
+          std::cerr << "[FAIL] Khong the ket noi Modbus toi " << bus.key()
+                    << ": " << modbus_strerror(errno) << std::endl;
+          return ModbusContextPtr();
+        }
+        return ctx;
+      });
 }
 
 std::uint16_t MeterDriver::getModbusAddress(
@@ -49,81 +144,115 @@ std::uint16_t MeterDriver::getModbusAddress(
   return register_address;
 }
 
-double MeterDriver::readAndScaleRegister(const RegisterConfig& reg) {
-  if (!ctx_) return -999.0;
-
-  std::lock_guard<std::mutex> lock(modbus_lock_);
+bool MeterDriver::readBlock(modbus_t* ctx, const ReadBlock& block) {
+  if (!ctx) return false;
 
   const int MAX_RETRIES = 3;
-  const int num_registers = 100;
-  std::uint16_t raw_data[num_registers];
-
-  std::uint16_t modbus_addr = getModbusAddress(reg.address);
+  std::uint16_t modbus_addr = getModbusAddress(block.start_address);
 
   for (int retry = 0; retry < MAX_RETRIES; ++retry) {
-    int num_read =
-        modbus_read_registers(ctx_.get(), modbus_addr, num_registers, raw_data);
-
-    std::cout << "[INFO] Ham doc (Holding): " << num_read << " registers"
-              << std::endl;
-
-    if (num_read == num_registers) {
-      std::uint16_t raw_value = raw_data[0];
-      double real_value = (double)raw_value * reg.scale;
-
-      std::cout << "[INFO] Thanh ghi Holding " << reg.address
-                << " | Raw: " << raw_value << " | Scale: " << reg.scale
-                << " | Ket qua: " << real_value << std::endl;
-
-      return real_value;
+    if (retry > 0) metrics_->recordRetry();
+
+    const std::chrono::steady_clock::time_point started =
+        std::chrono::steady_clock::now();
+    int num_read = modbus_read_registers(ctx, modbus_addr, block.count,
+                                         block_buffer_.data());
+    const int error = errno;
+    const std::uint64_t rtt_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started)
+            .count();
+
+    metrics_->recordAttempt(num_read == block.count, error, rtt_us);
+    if (num_read == block.count) return true;
+
+    std::cerr << "[WARN] Doc block " << block.start_address << " ("
+              << block.count << " registers) that bai (Thu #" << retry + 1
+              << "): " << modbus_strerror(error) << std::endl;
+
+    // Che do thich ung: libmodbus tu giu khoang lang t3.5 truoc request sau,
+    // chi can bo phan hoi den muon con trong bo dem
+    if (modbus_rtu_get_timing_mode(ctx) == MODBUS_RTU_TIMING_ADAPTIVE) {
+      modbus_flush(ctx);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
     }
-
-    std::cerr << "[WARN] Doc thanh ghi " << reg.address << " that bai (Thu #"
-              << retry + 1 << ")..." << std::endl;
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(20));
   }
 
-  return -999.0;
+  return false;
 }
 
-MeterData MeterDriver::readAllAndScaleData() {
-  MeterData results;
-
-  std::cout << "\n--- BAT DAU DOC VA SCALE DU LIEU (" << config_.device_id
-            << ") ---" << std::endl;
+bool MeterDriver::readAllAndScaleData(Sample& sample) {
+  std::cout << "\n--- BAT DAU DOC VA SCALE DU LIEU ("
+            << current()->config.device_id << ") ---" << std::endl;
 
-  for (const auto& pair : config_.registers) {
-    const RegisterConfig& reg = pair.second;
-
-    double value = readAndScaleRegister(reg);
-
-    if (value > -999.0) {
-      results[reg.name] = value;
-      std::cout << "[READ SCALED] " << reg.name << ": " << value << std::endl;
-    }
-  }
+  return bus_->call([this, &sample](modbus_t* ctx) {
+    return readBlocks(ctx, nullptr, sample);
+  });
+}
 
-  return results;
+bool MeterDriver::readPollClass(const std::string& poll_class,
+                                Sample& sample) {
+  return bus_->call([this, &poll_class, &sample](modbus_t* ctx) {
+    return readBlocks(ctx, &poll_class, sample);
+  });
 }
 
-// rewrite constructor line
-MeterData MeterDriver::readRawData() {
-  MeterData results;
+void MeterDriver::setBlockObserver(BlockObserver observer) {
+  // Gan tren thread cua bus: khong dua voi chu ky doc dang chay
+  bus_->call([this, &observer](modbus_t*) {
+    block_observer_ = std::move(observer);
+    return true;
+  });
+}
 
-  std::cout << "\n--- BAT DAU DOC DU LIEU THO NGUYEN (" << config_.device_id
-            << ") ---" << std::endl;
+bool MeterDriver::readBlocks(modbus_t* ctx, const std::string* poll_class,
+                             Sample& sample) {
+  // Ke hoach duoc giu nguyen trong ca luot doc, ke ca khi reload() chay song
+  // song
+  const DriverPlanPtr plan = current();
+  if (sample.schema != plan->schema) sample.reset(plan->schema);
+  if (block_buffer_.size() < plan->plan.maxBlockSize()) {
+    block_buffer_.resize(plan->plan.maxBlockSize());
+  }
 
-  for (const auto& pair : config_.registers) {
-    const RegisterConfig& reg = pair.second;
+  // Nhieu thiet bi dung chung bus: dat slave ID truoc moi luot doc
+  if (modbus_set_slave(ctx, plan->config.slave_id) == -1) {
+    std::cerr << "[FAIL] Khong the thiet lap Slave ID "
+              << plan->config.slave_id << ": " << modbus_strerror(errno)
+              << std::endl;
+    return false;
+  }
 
-    double value = readRawRegister(reg);
+  bool all_ok = true;
+  const std::vector<ReadBlock>& blocks = plan->plan.blocks();
+  for (std::size_t i = 0; i < blocks.size(); ++i) {
+    if (poll_class != nullptr && blocks[i].poll_class != *poll_class) continue;
+    if (!readAndScaleBlock(ctx, *plan, i, sample)) all_ok = false;
+  }
+  return all_ok;
+}
 
-    if (value > -999.0) {
-      results[reg.name] = value;
-      std::cout << "[READ RAW] " << reg.name << ": " << value << std::endl;
-    }
+bool MeterDriver::readAndScaleBlock(modbus_t* ctx, const DriverPlan& plan,
+                                    std::size_t block_index, Sample& sample) {
+  // Moi block la mot transaction, gia tri cua tung tag duoc giai ma tu buffer
+  // thang vao sample.values
+  const ReadBlock& block = plan.plan.blocks()[block_index];
+  const bool ok = readBlock(ctx, block);
+  if (block_observer_) {
+    block_observer_(block, ok ? block_buffer_.data() : nullptr);
+  }
+  if (ok) {
+    plan.decoder.run(block_index, block_buffer_.data(), sample.values.data());
+    sample.block_time_us[block_index] =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
   }
 
-  return results;
+  for (const DecodeOp* op = plan.decoder.blockBegin(block_index);
+       op != plan.decoder.blockEnd(block_index); ++op) {
+    sample.setGood(op->slot, ok);
+  }
+  return ok;
 }
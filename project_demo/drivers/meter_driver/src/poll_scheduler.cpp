@@ -0,0 +1,141 @@
+#include "poll_scheduler.h"
+
+#include <iostream>
+#include <utility>
+
+int PollScheduler::addTask(const std::string& name,
+                           std::chrono::milliseconds period, Task task,
+                           std::chrono::milliseconds phase) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (period.count() <= 0) period = std::chrono::milliseconds(1);
+
+  TaskSlot slot;
+  slot.stats.name = name;
+  slot.stats.period = period;
+  slot.stats.runs = 0;
+  slot.stats.missed = 0;
+  slot.stats.max_lateness = std::chrono::microseconds(0);
+  slot.task = task;
+  tasks_.push_back(slot);
+
+  Entry entry;
+  entry.deadline = Clock::now() + phase;
+  entry.task_id = static_cast<int>(tasks_.size() - 1);
+  heap_.push(entry);
+  cv_.notify_all();  // task moi co the co deadline som hon
+  return entry.task_id;
+}
+
+/**
+ * @brief Vong lap chinh: ngu toi deadline som nhat, chay task, xep lai heap
+ *
+ * Chi thread goi run() thao tac tren bus, nen cac task cua nhieu thiet bi
+ * chia se mot bus duoc xen ke ma khong can khoa bus.
+ */
+void PollScheduler::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (!stopped_) {
+    if (heap_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+
+    Entry next = heap_.top();
+    if (Clock::now() < next.deadline) {
+      cv_.wait_until(lock, next.deadline);
+      continue;  // kiem tra lai stopped_ va task moi them vao
+    }
+
+    heap_.pop();
+    lock.unlock();
+    runDue(next);
+    lock.lock();
+  }
+}
+
+void PollScheduler::setMissHandler(MissHandler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  miss_handler_ = std::move(handler);
+}
+
+void PollScheduler::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  cv_.notify_all();
+}
+
+bool PollScheduler::setPeriod(int task_id, std::chrono::milliseconds period) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (task_id < 0 || static_cast<std::size_t>(task_id) >= tasks_.size()) {
+    return false;
+  }
+  if (period.count() <= 0) period = std::chrono::milliseconds(1);
+  tasks_[task_id].stats.period = period;
+  return true;
+}
+
+void PollScheduler::runDue(Entry entry) {
+  TaskSlot* slot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot = &tasks_[entry.task_id];
+  }
+
+  Clock::time_point start = Clock::now();
+  std::chrono::microseconds lateness =
+      std::chrono::duration_cast<std::chrono::microseconds>(start -
+                                                            entry.deadline);
+
+  if (slot->task) slot->task();
+
+  Clock::time_point now = Clock::now();
+  std::uint64_t missed = 0;
+
+  // Chi sao chep handler/ten khi co deadline bi lo: chu ky binh thuong khong
+  // cap phat gi tren heap
+  MissHandler handler;
+  std::string name;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Deadline ke tiep tinh tu deadline cu -> khong troi chu ky. Neu da qua
+    // mot hoac nhieu chu ky thi bo qua chung va bao missed deadline. Chu ky
+    // doc sau khi chay task vi task co the vua goi setPeriod().
+    const std::chrono::milliseconds period = slot->stats.period;
+    Clock::time_point next = entry.deadline + period;
+    if (next <= now) {
+      missed = static_cast<std::uint64_t>((now - next) / period) + 1;
+      next += period * missed;
+    }
+
+    slot->stats.runs++;
+    slot->stats.missed += missed;
+    if (lateness > slot->stats.max_lateness) {
+      slot->stats.max_lateness = lateness;
+    }
+    entry.deadline = next;
+    heap_.push(entry);
+    if (missed > 0) {
+      handler = miss_handler_;
+      name = slot->stats.name;
+    }
+  }
+
+  if (missed > 0) {
+    if (handler) {
+      handler(name, missed, lateness);
+    } else {
+      std::cerr << "[SCHED] Task " << name << " lo " << missed
+                << " deadline (tre " << lateness.count() << " us)"
+                << std::endl;
+    }
+  }
+}
+
+std::vector<PollScheduler::TaskStats> PollScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<TaskStats> result;
+  result.reserve(tasks_.size());
+  for (const auto& slot : tasks_) result.push_back(slot.stats);
+  return result;
+}
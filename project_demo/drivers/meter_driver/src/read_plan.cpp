@@ -0,0 +1,103 @@
+#include "read_plan.h"
+
+#include <algorithm>
+
+/**
+ * @brief Gom cac thanh ghi thanh cac block doc lien tuc
+ * @param registers Danh sach thanh ghi trong MeterConfig
+ * @param max_gap So word trong toi da cho phep giua hai tag trong cung block
+ * @param max_block So thanh ghi toi da cua mot block (<= 125 cho FC03/FC04)
+ * @return Ke hoach doc da sap xep theo (poll_class, dia chi)
+ *
+ * Thuat toan tham lam: sap xep tag theo dia chi, mo rong block hien tai khi
+ * khoang trong <= max_gap va block moi van nam trong gioi han max_block;
+ * nguoc lai mo block moi. Doc them vai word trong re hon nhieu so voi mot
+ * transaction rieng tren bus RTU.
+ */
+ReadPlan ReadPlan::build(const std::map<std::string, RegisterConfig>& registers,
+                         int max_gap, int max_block) {
+  ReadPlan plan;
+  if (max_gap < 0) max_gap = 0;
+  if (max_block <= 0 || max_block > kMaxReadRegisters) {
+    max_block = kMaxReadRegisters;
+  }
+
+  std::vector<const RegisterConfig*> sorted;
+  sorted.reserve(registers.size());
+  for (const auto& pair : registers) {
+    sorted.push_back(&pair.second);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const RegisterConfig* a, const RegisterConfig* b) {
+              if (a->poll_class != b->poll_class) {
+                return a->poll_class < b->poll_class;
+              }
+              return a->address < b->address;
+            });
+
+  ReadBlock* current = nullptr;
+  for (const RegisterConfig* reg : sorted) {
+    const int quantity = reg->quantity > 0 ? reg->quantity : 1;
+    const int reg_end = reg->address + quantity;  // exclusive
+
+    if (current != nullptr && current->poll_class != reg->poll_class) {
+      current = nullptr;
+    }
+
+    if (current != nullptr) {
+      const int block_end = current->start_address + current->count;
+      const int gap = reg->address - block_end;
+      const int new_count =
+          std::max(block_end, reg_end) - current->start_address;
+      if (gap > max_gap || new_count > max_block) {
+        current = nullptr;
+      } else {
+        current->count = static_cast<std::uint16_t>(new_count);
+      }
+    }
+
+    if (current == nullptr) {
+      ReadBlock block;
+      block.poll_class = reg->poll_class;
+      block.start_address = reg->address;
+      block.count = static_cast<std::uint16_t>(quantity);
+      plan.blocks_.push_back(block);
+      current = &plan.blocks_.back();
+    }
+
+    BlockEntry entry;
+    entry.name = reg->name;
+    entry.offset =
+        static_cast<std::uint16_t>(reg->address - current->start_address);
+    entry.quantity = static_cast<std::uint16_t>(quantity);
+    entry.scale = reg->scale;
+    entry.value_offset = reg->offset;
+    entry.type = reg->type;
+    entry.order = reg->order;
+    entry.bit_offset = reg->bit_offset;
+    entry.bit_width = reg->bit_width;
+    current->entries.push_back(entry);
+  }
+
+  for (const auto& block : plan.blocks_) {
+    plan.max_block_size_ =
+        std::max(plan.max_block_size_, static_cast<std::size_t>(block.count));
+  }
+  return plan;
+}
+
+std::size_t ReadPlan::totalRegisters() const {
+  std::size_t total = 0;
+  for (const auto& block : blocks_) total += block.count;
+  return total;
+}
+
+std::vector<std::string> ReadPlan::pollClasses() const {
+  std::vector<std::string> classes;
+  for (const auto& block : blocks_) {
+    if (classes.empty() || classes.back() != block.poll_class) {
+      classes.push_back(block.poll_class);
+    }
+  }
+  return classes;
+}
@@ -0,0 +1,298 @@
+#include "register_mirror.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Chu ky kiem tra co dung khi khong co su kien
+const int kStopCheckMs = 200;
+// Do dai header MBAP (transaction, protocol, length, unit)
+const int kMbapLength = 7;
+
+std::uint16_t saturate(std::int64_t value) {
+  return static_cast<std::uint16_t>(std::min<std::int64_t>(value, 0xFFFF));
+}
+
+}  // namespace
+
+RegisterMirror::RegisterMirror(std::uint16_t status_address)
+    : status_address_(status_address),
+      mapping_(modbus_mapping_new_start_address(0, 0, 0, 0, 0, 0,
+                                                status_address,
+                                                kStatusRegisters)) {
+  if (mapping_ == nullptr) {
+    std::cerr << "[FAIL] Khong cap phat duoc anh thanh ghi: "
+              << modbus_strerror(errno) << std::endl;
+  }
+}
+
+RegisterMirror::~RegisterMirror() {
+  if (mapping_ != nullptr) modbus_mapping_free(mapping_);
+}
+
+/**
+ * @brief Mở rộng vùng holding register để chứa [start, end)
+ *
+ * Ảnh mới bao cả vùng cũ; giá trị và khối trạng thái được chép sang. Chỉ xảy
+ * ra ở chu kỳ đầu và khi kế hoạch đọc đổi nên không nằm trên đường nóng.
+ */
+bool RegisterMirror::cover(std::uint32_t start, std::uint32_t end) {
+  if (mapping_ == nullptr) return false;
+  std::uint32_t old_start = mapping_->start_registers;
+  std::uint32_t old_end = old_start + mapping_->nb_registers;
+  if (mapping_->nb_registers > 0 && start >= old_start && end <= old_end) {
+    return true;
+  }
+  if (mapping_->nb_registers == 0) old_start = old_end = start;
+
+  const std::uint32_t new_start = std::min(start, old_start);
+  const std::uint32_t new_end = std::max(end, old_end);
+  modbus_mapping_t* grown = modbus_mapping_new_start_address(
+      0, 0, 0, 0, new_start, new_end - new_start, status_address_,
+      kStatusRegisters);
+  if (grown == nullptr) {
+    std::cerr << "[FAIL] Khong mo rong duoc anh thanh ghi toi [" << new_start
+              << ", " << new_end << ")" << std::endl;
+    return false;
+  }
+  if (mapping_->nb_registers > 0) {
+    std::memcpy(grown->tab_registers + (old_start - new_start),
+                mapping_->tab_registers,
+                mapping_->nb_registers * sizeof(std::uint16_t));
+  }
+  std::memcpy(grown->tab_input_registers, mapping_->tab_input_registers,
+              kStatusRegisters * sizeof(std::uint16_t));
+  modbus_mapping_free(mapping_);
+  mapping_ = grown;
+  return true;
+}
+
+void RegisterMirror::update(const ReadBlock& block,
+                            const std::uint16_t* words) {
+  const Clock::time_point now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  BlockStamp* stamp = nullptr;
+  for (BlockStamp& candidate : blocks_) {
+    if (candidate.start == block.start_address &&
+        candidate.count == block.count) {
+      stamp = &candidate;
+      break;
+    }
+  }
+  if (stamp == nullptr) {
+    BlockStamp fresh = {block.start_address, block.count, Clock::time_point(),
+                        false};
+    blocks_.push_back(fresh);
+    stamp = &blocks_.back();
+  }
+
+  stamp->ok = words != nullptr;
+  if (words == nullptr ||
+      !cover(block.start_address,
+             static_cast<std::uint32_t>(block.start_address) + block.count)) {
+    return;
+  }
+  const int offset = block.start_address - mapping_->start_registers;
+  std::memcpy(mapping_->tab_registers + offset, words,
+              block.count * sizeof(std::uint16_t));
+  stamp->updated = now;
+  ++updates_;
+}
+
+void RegisterMirror::resetBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  blocks_.clear();
+}
+
+void RegisterMirror::refreshStatus(Clock::time_point now) {
+  std::int64_t stalest_ms = blocks_.empty() ? 0xFFFF : 0;
+  std::uint16_t failed = 0;
+  for (const BlockStamp& stamp : blocks_) {
+    if (!stamp.ok) ++failed;
+    const std::int64_t age_ms =
+        stamp.updated == Clock::time_point()
+            ? std::int64_t(0xFFFF) * 1000
+            : std::chrono::duration_cast<std::chrono::milliseconds>(
+                  now - stamp.updated)
+                  .count();
+    stalest_ms = std::max(stalest_ms, age_ms);
+  }
+
+  std::uint16_t* status = mapping_->tab_input_registers;
+  status[kStatusAgeMs] = saturate(stalest_ms);
+  status[kStatusAgeSeconds] = saturate(stalest_ms / 1000);
+  status[kStatusFailedBlocks] = failed;
+  status[kStatusUpdatesHigh] = static_cast<std::uint16_t>(updates_ >> 16);
+  status[kStatusUpdatesLow] = static_cast<std::uint16_t>(updates_ & 0xFFFF);
+}
+
+int RegisterMirror::reply(modbus_t* ctx, const std::uint8_t* query,
+                          int length) {
+  const Clock::time_point now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mapping_ == nullptr) {
+    return modbus_reply_exception(ctx, query,
+                                  MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE);
+  }
+  refreshStatus(now);
+  return modbus_reply(ctx, query, length, mapping_);
+}
+
+MirrorServer::MirrorServer(const Options& options)
+    : options_(options),
+      ctx_(modbus_new_tcp(options.host.c_str(), options.port)),
+      server_fd_(-1),
+      requests_(0) {
+  std::fill(mirrors_, mirrors_ + 256, nullptr);
+}
+
+MirrorServer::~MirrorServer() {
+  for (const Client& client : clients_) close(client.fd);
+  if (server_fd_ != -1) close(server_fd_);
+  // Socket cua ctx la client cuoi cung da dung: da dong o tren
+  if (ctx_ != nullptr) modbus_free(ctx_);
+}
+
+bool MirrorServer::addMirror(int unit, RegisterMirror* mirror) {
+  if (unit < 1 || unit > 255 || mirrors_[unit] != nullptr) {
+    std::cerr << "ERROR: Unit " << unit << " khong hop le hoac da co anh"
+              << std::endl;
+    return false;
+  }
+  mirrors_[unit] = mirror;
+  return true;
+}
+
+bool MirrorServer::open() {
+  if (ctx_ == nullptr) {
+    std::cerr << "[FAIL] Khong tao duoc context cho mirror server"
+              << std::endl;
+    return false;
+  }
+  server_fd_ = modbus_tcp_listen(ctx_, options_.max_clients);
+  if (server_fd_ == -1) {
+    std::cerr << "[FAIL] Khong listen duoc " << options_.host << ":"
+              << options_.port << ": " << modbus_strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void MirrorServer::run(const std::atomic<bool>& stop) {
+  std::vector<pollfd> fds;
+  while (!stop.load()) {
+    fds.clear();
+    fds.push_back(pollfd{server_fd_, POLLIN, 0});
+    for (const Client& client : clients_) {
+      fds.push_back(pollfd{client.fd, POLLIN, 0});
+    }
+
+    const int rc = poll(fds.data(), fds.size(), kStopCheckMs);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[FAIL] poll: " << std::strerror(errno) << std::endl;
+      return;
+    }
+    if (rc == 0) continue;
+
+    // Duyet nguoc de xoa client khong lam lech chi so cac client con lai
+    for (std::size_t i = clients_.size(); i-- > 0;) {
+      if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+          !serve(clients_[i])) {
+        close(clients_[i].fd);
+        clients_.erase(clients_.begin() + i);
+      }
+    }
+    if (fds[0].revents & POLLIN) acceptClient();
+  }
+}
+
+void MirrorServer::acceptClient() {
+  const int fd = modbus_tcp_accept(ctx_, &server_fd_);
+  if (fd == -1) return;
+  if (static_cast<int>(clients_.size()) >= options_.max_clients) {
+    std::cerr << "[WARN] Mirror server da du " << options_.max_clients
+              << " client, tu choi ket noi moi" << std::endl;
+    close(fd);
+    return;
+  }
+  // Tra loi duoc gui khi dang giu mutex cua anh: client khong doc thi
+  // send() bao EAGAIN va client bi dong, thread cua bus khong phai cho
+  const int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    close(fd);
+    return;
+  }
+  Client client;
+  client.fd = fd;
+  clients_.push_back(client);
+}
+
+/**
+ * @brief Đọc hết dữ liệu sẵn có của client và trả lời các frame MBAP đủ
+ * @return false nếu client đã đóng kết nối, gửi frame hỏng hoặc không nhận
+ *         kịp trả lời
+ *
+ * Phần cuối chưa đủ một frame được giữ lại tới lần poll sau.
+ */
+bool MirrorServer::serve(Client& client) {
+  std::uint8_t buffer[1024];
+  for (;;) {
+    const ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) return false;
+    client.rx.insert(client.rx.end(), buffer, buffer + n);
+    if (static_cast<std::size_t>(n) < sizeof(buffer)) break;
+  }
+
+  std::size_t offset = 0;
+  while (client.rx.size() - offset >= static_cast<std::size_t>(kMbapLength)) {
+    std::uint8_t* adu = client.rx.data() + offset;
+    const int protocol = (adu[2] << 8) | adu[3];
+    const int length = (adu[4] << 8) | adu[5];  // unit + PDU
+    // PDU it nhat co function, ADU khong qua MODBUS_TCP_MAX_ADU_LENGTH
+    if (protocol != 0 || length < 2 ||
+        length + kMbapLength - 1 > MODBUS_TCP_MAX_ADU_LENGTH) {
+      return false;
+    }
+    const int total = kMbapLength - 1 + length;
+    if (client.rx.size() - offset < static_cast<std::size_t>(total)) break;
+    if (!handle(client.fd, adu, total)) return false;
+    offset += total;
+  }
+  client.rx.erase(client.rx.begin(), client.rx.begin() + offset);
+  return true;
+}
+
+/**
+ * @brief Trả lời một request đủ frame từ ảnh của unit tương ứng
+ * @return false nếu không gửi được trả lời
+ */
+bool MirrorServer::handle(int fd, std::uint8_t* query, int length) {
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  modbus_set_socket(ctx_, fd);
+  RegisterMirror* mirror = mirrors_[query[kMbapLength - 1]];
+  const std::uint8_t function = query[kMbapLength];
+  int rc;
+  if (mirror == nullptr) {
+    rc = modbus_reply_exception(ctx_, query, MODBUS_EXCEPTION_GATEWAY_PATH);
+  } else if (function != MODBUS_FC_READ_HOLDING_REGISTERS &&
+             function != MODBUS_FC_READ_INPUT_REGISTERS) {
+    // Anh chi doc: lenh ghi phai di qua driver/gateway toi dong ho that
+    rc = modbus_reply_exception(ctx_, query,
+                                MODBUS_EXCEPTION_ILLEGAL_FUNCTION);
+  } else {
+    rc = mirror->reply(ctx_, query, length);
+  }
+  return rc != -1;
+}
@@ -0,0 +1,42 @@
+#include "sample.h"
+
+/**
+ * @brief Tạo schema và tính mã băm (FNV-1a) của danh sách tag
+ * @param device_id Mã thiết bị nguồn
+ * @param tag_names Tên tag theo thứ tự chỉ số
+ * @param tag_blocks Chỉ số block đọc của từng tag
+ * @param block_count Số block của kế hoạch đọc
+ */
+SampleSchema::SampleSchema(const std::string& device_id,
+                           const std::vector<std::string>& tag_names,
+                           const std::vector<std::uint16_t>& tag_blocks,
+                           std::size_t block_count)
+    : device_id_(device_id),
+      names_(tag_names),
+      tag_blocks_(tag_blocks),
+      block_count_(block_count),
+      id_(2166136261u) {
+  for (const std::string& name : names_) {
+    for (char c : name) {
+      id_ ^= static_cast<std::uint8_t>(c);
+      id_ *= 16777619u;
+    }
+    id_ *= 16777619u;  // phan cach giua cac ten ("ab","c" khac "a","bc")
+  }
+}
+
+int SampleSchema::find(const std::string& name) const {
+  for (std::size_t i = 0; i < names_.size(); ++i) {
+    if (names_[i] == name) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void Sample::reset(SampleSchemaPtr sample_schema) {
+  schema = sample_schema;
+  const std::size_t tags = schema ? schema->size() : 0;
+  const std::size_t blocks = schema ? schema->blockCount() : 0;
+  values.assign(tags, 0.0);
+  quality.assign((tags + 63) / 64, 0);
+  block_time_us.assign(blocks, 0);
+}
@@ -5,8 +5,9 @@
 #include <memory>  // Cho std::unique_ptr
 #include <thread>
 
-#include "./drivers/meter_driver/meter_config.h"
-#include "./drivers/meter_driver/meter_driver.h"
+#include "meter_config.h"
+#include "meter_driver.h"
+#include "poll_scheduler.h"
 
 using namespace std;
 
@@ -31,21 +32,45 @@ int main() {
     cout << "\n--- 2. Khoi tao Meter Driver va Ket noi Modbus ---" << endl;
     unique_ptr<MeterDriver> driver(new MeterDriver(config));
 
-    // 3. Vòng lặp đọc dữ liệu (Polling Loop)
+    // 3. Vòng lặp đọc dữ liệu: mỗi lớp chu kỳ là một task trong scheduler
     cout << "\n--- 3. Bat dau Vong lap Doc du lieu (Polling) ---" << endl;
 
-    for (int i = 0; i < 100; ++i) {
-      cout << "\n[POLLING] Chu ky doc #" << i + 1 << endl;
+    PollScheduler scheduler;
+    int cycle = 0;
+    // Cap phat mot lan, moi chu ky driver ghi de gia tri tai cho
+    Sample sample = driver->makeSample();
+    const int MAX_CYCLES = 100;
 
-      MeterData data = driver->readAllAndScaleData();
+    for (const string& poll_class : driver->current()->plan.pollClasses()) {
+      int period_ms = config.pollIntervalFor(poll_class);
+      string task_name = poll_class.empty() ? "default" : poll_class;
 
-      cout << "[RESULT FINAL] Du lieu thiet bi: ";
-      for (const auto& pair : data) {
-        cout << pair.first << "=" << pair.second << " | ";
-      }
-      cout << endl;
+      scheduler.addTask(
+          task_name, chrono::milliseconds(period_ms),
+          [&, poll_class, task_name]() {
+            cout << "\n[POLLING] Chu ky doc #" << ++cycle << " (" << task_name
+                 << ")" << endl;
 
-      this_thread::sleep_for(chrono::milliseconds(config.poll_interval_ms));
+            driver->readPollClass(poll_class, sample);
+
+            cout << "[RESULT FINAL] Du lieu thiet bi: ";
+            for (size_t tag = 0; tag < sample.size(); ++tag) {
+              if (!sample.good(tag)) continue;
+              cout << sample.schema->name(tag) << "=" << sample.values[tag]
+                   << " | ";
+            }
+            cout << endl;
+
+            if (cycle >= MAX_CYCLES) scheduler.stop();
+          });
+    }
+
+    scheduler.run();
+
+    for (const auto& st : scheduler.stats()) {
+      cout << "[SCHED] " << st.name << ": " << st.runs << " lan doc, "
+           << st.missed << " deadline bi lo, tre max "
+           << st.max_lateness.count() << " us" << endl;
     }
 
   } catch (const runtime_error& e) {
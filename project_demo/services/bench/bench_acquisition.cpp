@@ -0,0 +1,732 @@
+// Benchmark dau-cuoi cua duong thu thap: MeterDriver -> telemetry::Encoder
+// -> ZmqTransport -> subscriber, chay voi slave gia lap (mb_simulator) trong
+// mot process con de CPU/cap phat do duoc chi la cua duong thu thap.
+//
+//   bench_acquisition [--config meter_config.json] [--devices 8] [--buses 2]
+//                     [--baud 115200] [--no-pace] [--latency-ms 2]
+//                     [--period-ms 200] [--cycles 50] [--warmup 5]
+//                     [--zmq-port 5590] [--out bench_acquisition.json]
+//                     [--baseline baseline.json] [--update-baseline]
+//
+// Moi chu ky, moi bus doc lan luot cac thiet bi cua no (cac bus song song),
+// encode va publish tung thiet bi. Ket qua (JSON):
+//   tags_per_second      tag doc duoc / tong thoi gian chu ky (nang luc,
+//                        khong phu thuoc period)
+//   cycle_jitter_us_*    do tre bat dau chu ky so voi lich
+//   cycle_time_us_*      thoi gian mot chu ky (moi bus xong)
+//   cpu_us_per_cycle     CPU (user + sys) cua process trong mot chu ky
+//   allocs_per_cycle     so lan goi operator new trong mot chu ky
+//   publish_latency_us_* tu luc doc xong mot thiet bi toi luc subscriber nhan
+//   frames_lost          frame publish ma subscriber khong nhan duoc
+//
+// Baseline ghi kem cau hinh (devices, buses, baud, pace, latency, period);
+// lan chay co cau hinh khac khong duoc so voi baseline do.
+//
+// Exit: 0 = dat, 1 = loi khi chay hoac baseline khac cau hinh, 2 = hoi quy
+// so voi baseline.
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zmq.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "comm_metrics.h"
+#include "meter_driver.h"
+#include "mb_simulator/sim_bus.h"
+#include "mb_simulator/sim_slave.h"
+#include "telemetry.h"
+#include "transport/zmq/zmq.h"
+
+using namespace std;
+
+/* ================== DEM CAP PHAT ================== */
+namespace {
+atomic<uint64_t> g_allocations(0);
+}  // namespace
+
+// Thay moi dang operator new/delete (ke ca nothrow va mang) de moi cap phat
+// deu duoc dem va cap malloc/free luon khop. noinline: de GCC khong bao nham
+// mismatched-new-delete khi inline free()
+__attribute__((noinline)) void* operator new(size_t size) {
+  g_allocations.fetch_add(1, memory_order_relaxed);
+  void* p = malloc(size != 0 ? size : 1);
+  if (p == nullptr) throw bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void* operator new(size_t size,
+                                             const nothrow_t&) noexcept {
+  g_allocations.fetch_add(1, memory_order_relaxed);
+  return malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  string config = "meter_config.json";
+  int devices = 8;
+  int buses = 2;
+  int baud = 115200;
+  bool pace = true;
+  double latency_ms = 2.0;
+  int period_ms = 200;
+  int cycles = 50;
+  int warmup = 5;
+  int zmq_port = 5590;
+  string out = "bench_acquisition.json";
+  string baseline;
+  bool update_baseline = false;
+};
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--no-pace") {
+      options.pace = false;
+    } else if (arg == "--update-baseline") {
+      options.update_baseline = true;
+    } else if (arg == "--config" && has_value) {
+      options.config = argv[++i];
+    } else if (arg == "--devices" && has_value) {
+      options.devices = atoi(argv[++i]);
+    } else if (arg == "--buses" && has_value) {
+      options.buses = atoi(argv[++i]);
+    } else if (arg == "--baud" && has_value) {
+      options.baud = atoi(argv[++i]);
+    } else if (arg == "--latency-ms" && has_value) {
+      options.latency_ms = atof(argv[++i]);
+    } else if (arg == "--period-ms" && has_value) {
+      options.period_ms = atoi(argv[++i]);
+    } else if (arg == "--cycles" && has_value) {
+      options.cycles = atoi(argv[++i]);
+    } else if (arg == "--warmup" && has_value) {
+      options.warmup = atoi(argv[++i]);
+    } else if (arg == "--zmq-port" && has_value) {
+      options.zmq_port = atoi(argv[++i]);
+    } else if (arg == "--out" && has_value) {
+      options.out = argv[++i];
+    } else if (arg == "--baseline" && has_value) {
+      options.baseline = argv[++i];
+    } else {
+      cerr << "Tham so khong hop le: " << arg << endl;
+      return false;
+    }
+  }
+  if (options.devices < 1 || options.buses < 1 ||
+      options.devices > options.buses * 247 || options.cycles <= 0 ||
+      options.warmup < 0 || options.warmup >= options.cycles ||
+      options.period_ms < 0) {
+    cerr << "Cau hinh benchmark khong hop le" << endl;
+    return false;
+  }
+  return true;
+}
+
+/* ================== SLAVE GIA LAP (PROCESS CON) ================== */
+volatile sig_atomic_t g_child_stop = 0;
+
+void onChildSignal(int) { g_child_stop = 1; }
+
+// Mot waveform cho moi thanh ghi cua cau hinh: gia tri doi moi chu ky de
+// encoder delta khong bi lam "qua de"
+SlaveProfilePtr makeProfile(const MeterConfig& config, double latency_ms) {
+  shared_ptr<SlaveProfile> profile = make_shared<SlaveProfile>();
+  int first = 65536;
+  int last = 0;
+  for (const auto& pair : *config.registers) {
+    const RegisterConfig& reg = pair.second;
+    first = min<int>(first, reg.address);
+    last = max<int>(last, reg.address + reg.quantity);
+
+    Waveform wave;
+    wave.address = reg.address;
+    wave.type = reg.type;
+    wave.order = reg.order;
+    wave.shape = Waveform::Shape::kSine;
+    wave.offset = 100.0;
+    wave.amplitude = 10.0;
+    wave.period_s = 10.0;
+    wave.scale = reg.scale;
+    profile->waveforms.push_back(wave);
+  }
+  profile->start_address = first;
+  profile->count = last - first;
+  profile->latency.mean_ms = latency_ms;
+  return profile;
+}
+
+string linkPath(int bus) {
+  return "/tmp/bench_acq_" + to_string(getpid()) + "_" + to_string(bus);
+}
+
+/**
+ * @brief Fork process con chạy các bus RTU giả lập, chờ tới khi sẵn sàng
+ * @return pid của process con, -1 nếu lỗi
+ */
+pid_t startSimulator(const Options& options, const MeterConfig& config,
+                     const vector<string>& links) {
+  int ready[2];
+  if (pipe(ready) < 0) return -1;
+
+  const pid_t pid = fork();
+  if (pid != 0) {
+    close(ready[1]);
+    char byte = 0;
+    const bool ok = pid > 0 && read(ready[0], &byte, 1) == 1 && byte == 1;
+    close(ready[0]);
+    if (!ok && pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, nullptr, 0);
+    }
+    return ok ? pid : -1;
+  }
+
+  // Process con
+  close(ready[0]);
+  signal(SIGTERM, onChildSignal);
+  signal(SIGINT, SIG_IGN);
+
+  const SlaveProfilePtr profile = makeProfile(config, options.latency_ms);
+  vector<unique_ptr<RtuBusSim> > buses;
+  char status = 1;
+  for (int b = 0; b < options.buses && status == 1; ++b) {
+    RtuBusSim::Options bus_options;
+    bus_options.name = "bench" + to_string(b);
+    bus_options.link_path = links[b];
+    bus_options.baudrate = options.baud;
+    bus_options.pace = options.pace;
+    unique_ptr<RtuBusSim> bus(new RtuBusSim(bus_options));
+    if (!bus->open()) status = 0;
+    for (int i = b; status == 1 && i < options.devices; i += options.buses) {
+      if (!bus->addSlave(i / options.buses + 1, profile)) status = 0;
+    }
+    if (status == 1) bus->start(static_cast<uint32_t>(b + 1));
+    buses.push_back(move(bus));
+  }
+
+  if (write(ready[1], &status, 1) != 1) status = 0;
+  close(ready[1]);
+  while (status == 1 && !g_child_stop) usleep(100 * 1000);
+
+  for (auto& bus : buses) bus->stop();
+  buses.clear();
+  _exit(0);
+}
+
+/* ================== DUONG THU THAP ================== */
+uint64_t nowUs() {
+  return chrono::duration_cast<chrono::microseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t cpuUs() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+             1000000 +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Mot thiet bi: driver, sample, encoder va buffer dung lai moi chu ky
+struct Device {
+  unique_ptr<MeterDriver> driver;
+  Sample sample;
+  telemetry::Encoder encoder;
+  telemetry::Payload payload;
+  string topic;
+  atomic<uint64_t> acquired_us;
+
+  Device(MeterDriver* meter, const MeterConfig& config)
+      : driver(meter),
+        sample(meter->makeSample()),
+        encoder(telemetry::makeSchema(*meter->schema(), config), true),
+        topic(telemetry::dataTopic(config.device_id)),
+        acquired_us(0) {}
+};
+
+/**
+ * @brief Rào chắn fork-join: thread chính mở một chu kỳ, mỗi bus chạy phần
+ *        của nó trên thread riêng rồi báo xong
+ */
+class CycleBarrier {
+ public:
+  explicit CycleBarrier(int workers) : workers_(workers) {}
+
+  // Thread chinh: bat dau chu ky va cho moi bus xong
+  void runCycle() {
+    unique_lock<mutex> lock(mutex_);
+    ++cycle_;
+    pending_ = workers_;
+    start_.notify_all();
+    done_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+  // Thread cua bus: cho chu ky moi; false khi dung
+  bool waitCycle(uint64_t* seen) {
+    unique_lock<mutex> lock(mutex_);
+    start_.wait(lock, [this, seen] { return stop_ || cycle_ != *seen; });
+    *seen = cycle_;
+    return !stop_;
+  }
+
+  void finishCycle() {
+    lock_guard<mutex> lock(mutex_);
+    if (--pending_ == 0) done_.notify_one();
+  }
+
+  void stop() {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+    start_.notify_all();
+  }
+
+ private:
+  mutex mutex_;
+  condition_variable start_;
+  condition_variable done_;
+  int workers_;
+  int pending_ = 0;
+  uint64_t cycle_ = 0;
+  bool stop_ = false;
+};
+
+void busWorker(CycleBarrier* barrier, vector<Device*> devices,
+               vector<string> poll_classes, transport::Transport* transport,
+               atomic<uint64_t>* good_tags, atomic<uint64_t>* published) {
+  uint64_t seen = 0;
+  while (barrier->waitCycle(&seen)) {
+    uint64_t good = 0;
+    for (Device* device : devices) {
+      for (const string& poll_class : poll_classes) {
+        device->driver->readPollClass(poll_class, device->sample);
+      }
+      for (size_t tag = 0; tag < device->sample.size(); ++tag) {
+        if (device->sample.good(tag)) ++good;
+      }
+      device->acquired_us.store(nowUs(), memory_order_relaxed);
+      if (device->encoder.encode(device->sample, device->payload) &&
+          transport->send(device->topic, device->payload)) {
+        published->fetch_add(1, memory_order_relaxed);
+      }
+    }
+    good_tags->fetch_add(good, memory_order_relaxed);
+    barrier->finishCycle();
+  }
+}
+
+// Subscriber do do tre publish: topic -> thiet bi -> thoi diem doc xong
+void subscriberLoop(void* socket, const map<string, Device*>* by_topic,
+                    LatencyHistogram* latency, atomic<bool>* measuring,
+                    atomic<uint64_t>* received, atomic<bool>* running) {
+  char topic[256];
+  char payload[4096];
+  while (running->load()) {
+    const int size = zmq_recv(socket, topic, sizeof(topic) - 1, 0);
+    if (size < 0) continue;  // ZMQ_RCVTIMEO
+    const uint64_t now = nowUs();
+    int more = 0;
+    size_t more_size = sizeof(more);
+    zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size);
+    if (more) zmq_recv(socket, payload, sizeof(payload), 0);
+
+    topic[min<int>(size, sizeof(topic) - 1)] = '\0';
+    map<string, Device*>::const_iterator it = by_topic->find(topic);
+    if (it == by_topic->end() || !measuring->load()) continue;
+    latency->record(now - it->second->acquired_us.load(memory_order_relaxed));
+    received->fetch_add(1, memory_order_relaxed);
+  }
+}
+
+/* ================== KET QUA / BASELINE ================== */
+typedef map<string, double> Results;
+
+// Huong tot cua tung chi so (khi tao baseline moi)
+bool higherIsBetter(const string& metric) {
+  return metric == "tags_per_second";
+}
+
+void addPercentiles(Results& results, const string& prefix,
+                    const LatencyHistogram& histogram) {
+  const LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+  results[prefix + "_p50"] = static_cast<double>(snapshot.percentile(0.50));
+  results[prefix + "_p90"] = static_cast<double>(snapshot.percentile(0.90));
+  results[prefix + "_p99"] = static_cast<double>(snapshot.percentile(0.99));
+  results[prefix + "_max"] = static_cast<double>(snapshot.percentile(1.0));
+}
+
+string resultsJson(const Options& options, const Results& results,
+                   const vector<string>& regressions) {
+  ostringstream out;
+  out << "{\"config\":{\"devices\":" << options.devices
+      << ",\"buses\":" << options.buses << ",\"baud\":" << options.baud
+      << ",\"pace\":" << (options.pace ? "true" : "false")
+      << ",\"latency_ms\":" << options.latency_ms
+      << ",\"period_ms\":" << options.period_ms
+      << ",\"cycles\":" << options.cycles << ",\"warmup\":" << options.warmup
+      << "},\"results\":{";
+  bool first = true;
+  for (const auto& pair : results) {
+    out << (first ? "" : ",") << "\"" << pair.first << "\":" << pair.second;
+    first = false;
+  }
+  out << "},\"regressions\":[";
+  for (size_t i = 0; i < regressions.size(); ++i) {
+    out << (i ? "," : "") << "\"" << regressions[i] << "\"";
+  }
+  out << "]}";
+  return out.str();
+}
+
+// Tham so quyet dinh ket qua; cycles/warmup chi doi so mau nen khong ghi
+cJSON* baselineConfig(const Options& options) {
+  cJSON* config = cJSON_CreateObject();
+  cJSON_AddNumberToObject(config, "devices", options.devices);
+  cJSON_AddNumberToObject(config, "buses", options.buses);
+  cJSON_AddNumberToObject(config, "baud", options.baud);
+  cJSON_AddBoolToObject(config, "pace", options.pace);
+  cJSON_AddNumberToObject(config, "latency_ms", options.latency_ms);
+  cJSON_AddNumberToObject(config, "period_ms", options.period_ms);
+  return config;
+}
+
+/**
+ * @brief So kết quả với baseline
+ *
+ * {"config": {"devices": 8, ...}, "tolerance_pct": 15,
+ *  "metrics": {"tags_per_second": {"value": 900, "higher_is_better": true,
+ *  "tolerance_pct": 10, "tolerance_abs": 0}}}
+ * Chỉ số xấu hơn value quá tolerance_pct% (+ tolerance_abs) là hồi quy.
+ * Baseline đo với cấu hình khác (hoặc không ghi cấu hình) bị từ chối thay vì
+ * báo hồi quy/đạt sai.
+ */
+bool checkBaseline(const string& filename, const Options& options,
+                   const Results& results, vector<string>& regressions) {
+  const string content = readFileToString(filename);
+  cJSON* root = content.empty() ? nullptr : cJSON_Parse(content.c_str());
+  if (root == nullptr) {
+    cerr << "[FAIL] Khong doc duoc baseline " << filename << endl;
+    return false;
+  }
+
+  cJSON* saved = cJSON_GetObjectItemCaseSensitive(root, "config");
+  cJSON* current = baselineConfig(options);
+  if (!cJSON_Compare(saved, current, 1)) {
+    char* saved_text = saved ? cJSON_PrintUnformatted(saved) : nullptr;
+    char* current_text = cJSON_PrintUnformatted(current);
+    cerr << "[FAIL] Baseline " << filename << " do voi cau hinh "
+         << (saved_text ? saved_text : "(khong ghi)") << ", lan chay nay "
+         << (current_text ? current_text : "?")
+         << ": chay lai dung tham so hoac --update-baseline" << endl;
+    free(saved_text);
+    free(current_text);
+    cJSON_Delete(current);
+    cJSON_Delete(root);
+    return false;
+  }
+  cJSON_Delete(current);
+  cJSON* tolerance = cJSON_GetObjectItemCaseSensitive(root, "tolerance_pct");
+  const double default_pct =
+      cJSON_IsNumber(tolerance) ? tolerance->valuedouble : 15.0;
+
+  cJSON* metrics = cJSON_GetObjectItemCaseSensitive(root, "metrics");
+  for (cJSON* item = cJSON_IsObject(metrics) ? metrics->child : nullptr;
+       item != nullptr; item = item->next) {
+    Results::const_iterator result = results.find(item->string);
+    cJSON* value = cJSON_GetObjectItemCaseSensitive(item, "value");
+    if (result == results.end() || !cJSON_IsNumber(value)) continue;
+
+    cJSON* higher = cJSON_GetObjectItemCaseSensitive(item, "higher_is_better");
+    cJSON* pct = cJSON_GetObjectItemCaseSensitive(item, "tolerance_pct");
+    cJSON* abs_tol = cJSON_GetObjectItemCaseSensitive(item, "tolerance_abs");
+    const bool higher_better = cJSON_IsBool(higher)
+                                   ? cJSON_IsTrue(higher) != 0
+                                   : higherIsBetter(item->string);
+    const double margin =
+        value->valuedouble *
+            (cJSON_IsNumber(pct) ? pct->valuedouble : default_pct) / 100.0 +
+        (cJSON_IsNumber(abs_tol) ? abs_tol->valuedouble : 0.0);
+
+    const bool regressed =
+        higher_better ? result->second < value->valuedouble - margin
+                      : result->second > value->valuedouble + margin;
+    if (regressed) {
+      ostringstream message;
+      message << item->string << " " << result->second << " (baseline "
+              << value->valuedouble << ")";
+      regressions.push_back(message.str());
+    }
+  }
+  cJSON_Delete(root);
+  return true;
+}
+
+/**
+ * @brief Ghi kết quả làm baseline mới
+ *
+ * Baseline đã có thì chỉ thay "value" và cấu hình, giữ nguyên ngưỡng chỉnh
+ * tay của từng chỉ số; chỉ số chưa có được thêm với chiều tốt mặc định.
+ */
+bool writeBaseline(const string& filename, const Options& options,
+                   const Results& results) {
+  const string content = readFileToString(filename);
+  cJSON* root = content.empty() ? nullptr : cJSON_Parse(content.c_str());
+  if (root == nullptr) {
+    root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "tolerance_pct", 15);
+  }
+  cJSON_DeleteItemFromObjectCaseSensitive(root, "config");
+  cJSON_AddItemToObject(root, "config", baselineConfig(options));
+  cJSON* metrics = cJSON_GetObjectItemCaseSensitive(root, "metrics");
+  if (!cJSON_IsObject(metrics)) {
+    cJSON_DeleteItemFromObjectCaseSensitive(root, "metrics");
+    metrics = cJSON_AddObjectToObject(root, "metrics");
+  }
+
+  for (const auto& pair : results) {
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(metrics, pair.first.c_str());
+    if (item == nullptr) {
+      item = cJSON_AddObjectToObject(metrics, pair.first.c_str());
+      cJSON_AddBoolToObject(item, "higher_is_better",
+                            higherIsBetter(pair.first));
+    }
+    cJSON_DeleteItemFromObjectCaseSensitive(item, "value");
+    cJSON_AddNumberToObject(item, "value", pair.second);
+  }
+
+  char* text = cJSON_Print(root);
+  cJSON_Delete(root);
+  if (text == nullptr) return false;
+  ofstream out(filename.c_str());
+  out << text << "\n";
+  free(text);
+  return static_cast<bool>(out);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) return 1;
+
+  MeterConfig profile;
+  if (!profile.loadFromJson(options.config) || !profile.validateModel()) {
+    cerr << "[FATAL] Cau hinh thanh ghi khong hop le: " << options.config
+         << endl;
+    return 1;
+  }
+
+  // Fork truoc khi co thread nao (ZMQ, BusExecutor)
+  vector<string> links;
+  for (int b = 0; b < options.buses; ++b) links.push_back(linkPath(b));
+  const pid_t simulator = startSimulator(options, profile, links);
+  if (simulator < 0) {
+    cerr << "[FATAL] Khong khoi dong duoc slave gia lap" << endl;
+    return 1;
+  }
+
+  int status = 1;
+  {
+    /* Subscriber (bind) va ZmqTransport (connect) */
+    void* context = zmq_ctx_new();
+    void* subscriber = zmq_socket(context, ZMQ_SUB);
+    const int timeout_ms = 100;
+    zmq_setsockopt(subscriber, ZMQ_RCVTIMEO, &timeout_ms, sizeof(timeout_ms));
+    zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
+    const string endpoint =
+        "tcp://127.0.0.1:" + to_string(options.zmq_port);
+    const string unused =
+        "tcp://127.0.0.1:" + to_string(options.zmq_port + 1);
+    if (zmq_bind(subscriber, endpoint.c_str()) != 0) {
+      cerr << "[FATAL] Khong bind duoc " << endpoint << endl;
+    }
+    transport::ZmqTransport transport(endpoint, unused);
+
+    /* Thiet bi: model bien dich mot lan, dung chung */
+    const DeviceModelPtr model =
+        make_shared<DeviceModel>(*profile.registers, profile.max_register_gap);
+    vector<shared_ptr<BusExecutor> > buses;
+    for (int b = 0; b < options.buses; ++b) {
+      BusConfig bus;
+      bus.name = bus.port = links[b];
+      bus.baudrate = options.baud;
+      buses.push_back(MeterDriver::openBus(bus));
+    }
+
+    vector<unique_ptr<Device> > devices;
+    map<string, Device*> by_topic;
+    vector<vector<Device*> > per_bus(options.buses);
+    bool ready = transport.open();
+    for (int i = 0; ready && i < options.devices; ++i) {
+      const int b = i % options.buses;
+      if (!buses[b]) {
+        ready = false;
+        break;
+      }
+      MeterConfig config = profile;
+      config.device_id = "bench" + to_string(i);
+      config.serial_port = links[b];
+      config.baudrate = options.baud;
+      config.slave_id = i / options.buses + 1;
+      devices.emplace_back(
+          new Device(new MeterDriver(config, model, buses[b]), config));
+      by_topic[devices.back()->topic] = devices.back().get();
+      per_bus[b].push_back(devices.back().get());
+    }
+
+    if (ready) {
+      LatencyHistogram jitter;
+      LatencyHistogram cycle_time;
+      LatencyHistogram publish_latency;
+      atomic<bool> measuring(false);
+      atomic<bool> running(true);
+      atomic<uint64_t> good_tags(0);
+      atomic<uint64_t> published(0);
+      atomic<uint64_t> received(0);
+
+      thread sub_thread(subscriberLoop, subscriber, &by_topic,
+                        &publish_latency, &measuring, &received, &running);
+
+      // Cho subscriber ket noi xong (slow joiner) truoc khi do
+      const telemetry::Payload probe(1, 0);
+      for (int i = 0; i < 50; ++i) {
+        transport.send("bench/probe", probe);
+        this_thread::sleep_for(chrono::milliseconds(20));
+      }
+
+      CycleBarrier barrier(options.buses);
+      vector<thread> workers;
+      const vector<string> poll_classes = model->plan.pollClasses();
+      for (int b = 0; b < options.buses; ++b) {
+        workers.push_back(thread(busWorker, &barrier, per_bus[b],
+                                 poll_classes, &transport, &good_tags,
+                                 &published));
+      }
+
+      uint64_t cpu_start = 0;
+      uint64_t alloc_start = 0;
+      uint64_t tags_start = 0;
+      uint64_t published_start = 0;
+      uint64_t busy_us = 0;
+      const chrono::microseconds period(options.period_ms * 1000LL);
+      Clock::time_point scheduled = Clock::now();
+      for (int cycle = 0; cycle < options.cycles; ++cycle) {
+        if (cycle == options.warmup) {
+          measuring.store(true);
+          cpu_start = cpuUs();
+          alloc_start = g_allocations.load();
+          tags_start = good_tags.load();
+          published_start = published.load();
+        }
+        this_thread::sleep_until(scheduled);
+        const Clock::time_point started = Clock::now();
+        barrier.runCycle();
+        const Clock::time_point finished = Clock::now();
+
+        if (cycle >= options.warmup) {
+          jitter.record(chrono::duration_cast<chrono::microseconds>(
+                            started - scheduled)
+                            .count());
+          const uint64_t took =
+              chrono::duration_cast<chrono::microseconds>(finished - started)
+                  .count();
+          cycle_time.record(took);
+          busy_us += took;
+        }
+        // Tre hon ca mot chu ky: bat dau lai lich tu bay gio
+        scheduled += period;
+        if (scheduled < finished) scheduled = finished;
+      }
+      const uint64_t cpu_used = cpuUs() - cpu_start;
+      const uint64_t allocs = g_allocations.load() - alloc_start;
+      const uint64_t tags = good_tags.load() - tags_start;
+      const uint64_t sent = published.load() - published_start;
+
+      barrier.stop();
+      for (thread& worker : workers) worker.join();
+      this_thread::sleep_for(chrono::milliseconds(200));  // frame cuoi
+      running.store(false);
+      sub_thread.join();
+
+      const double measured = options.cycles - options.warmup;
+      Results results;
+      results["tags_per_second"] =
+          busy_us > 0 ? tags * 1e6 / static_cast<double>(busy_us) : 0.0;
+      results["cpu_us_per_cycle"] = cpu_used / measured;
+      results["allocs_per_cycle"] = allocs / measured;
+      results["frames_lost"] =
+          sent > received.load() ? static_cast<double>(sent - received.load())
+                                 : 0.0;
+      addPercentiles(results, "cycle_jitter_us", jitter);
+      addPercentiles(results, "cycle_time_us", cycle_time);
+      addPercentiles(results, "publish_latency_us", publish_latency);
+
+      vector<string> regressions;
+      bool baseline_ok = true;
+      if (!options.baseline.empty()) {
+        if (options.update_baseline) {
+          baseline_ok = writeBaseline(options.baseline, options, results);
+          cout << "[BENCH] Ghi baseline " << options.baseline << endl;
+        } else {
+          baseline_ok = checkBaseline(options.baseline, options, results,
+                                      regressions);
+        }
+      }
+
+      const string json = resultsJson(options, results, regressions);
+      ofstream(options.out.c_str()) << json << "\n";
+      cout << "[BENCH] " << json << endl;
+      for (const string& regression : regressions) {
+        cerr << "[REGRESSION] " << regression << endl;
+      }
+      status = !baseline_ok ? 1 : (regressions.empty() ? 0 : 2);
+    } else {
+      cerr << "[FATAL] Khong mo duoc bus/transport" << endl;
+    }
+
+    devices.clear();
+    buses.clear();
+    transport.close();
+    zmq_close(subscriber);
+    zmq_ctx_destroy(context);
+  }
+
+  kill(simulator, SIGTERM);
+  waitpid(simulator, nullptr, 0);
+  return status;
+}
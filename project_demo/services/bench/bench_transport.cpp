@@ -0,0 +1,228 @@
+// Benchmark kenh ZMQ theo loai dia chi EndpointRegistry chon: inproc (cung
+// tien trinh), ipc (cung may), tcp (may khac, o day qua loopback). Moi loai
+// mot cap PUB (bind) / SUB (connect) trong cung context cua registry.
+//
+//   bench_transport [--messages 200000] [--size 64] [--samples 5000]
+//                   [--tcp-port 5592] [--out bench_transport.json]
+//
+// Ket qua (JSON, moi loai mot muc):
+//   latency_ns_*      mot tin gui roi nhan tren cung thread (khong xep hang)
+//   msgs_per_second   gui/nhan tung dot 500 tin
+//   cpu_ns_per_msg    CPU (user + sys) ca process, gom ca I/O thread cua ZMQ
+// HWM tat (0): PUB chi biet SUB da doc khi xu ly lenh (vai ms mot lan) nen voi
+// HWM mac dinh van rot tin du gui xen ke; bench do chi phi kenh, khong do HWM.
+//
+// Exit: 0 = chay xong, 1 = loi.
+#include <sys/resource.h>
+#include <unistd.h>
+#include <zmq.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "comm_metrics.h"
+#include "transport/zmq/endpoint_registry.h"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+typedef map<string, double> Results;
+using transport::EndpointRegistry;
+
+const int kBurst = 500;
+
+struct Options {
+  int messages = 200000;
+  int size = 64;
+  int samples = 5000;
+  int tcp_port = 5592;
+  string out = "bench_transport.json";
+};
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--messages" && has_value) {
+      options.messages = atoi(argv[++i]);
+    } else if (arg == "--size" && has_value) {
+      options.size = atoi(argv[++i]);
+    } else if (arg == "--samples" && has_value) {
+      options.samples = atoi(argv[++i]);
+    } else if (arg == "--tcp-port" && has_value) {
+      options.tcp_port = atoi(argv[++i]);
+    } else if (arg == "--out" && has_value) {
+      options.out = argv[++i];
+    } else {
+      cerr << "Tham so khong hop le: " << arg << endl;
+      return false;
+    }
+  }
+  if (options.messages < kBurst || options.size < 1 || options.samples < 1) {
+    cerr << "Cau hinh benchmark khong hop le" << endl;
+    return false;
+  }
+  return true;
+}
+
+uint64_t nowNs() {
+  return chrono::duration_cast<chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t cpuNs() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+              1000000 +
+          usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) *
+         1000;
+}
+
+/**
+ * @brief Đo một loại kênh: độ trễ từng tin rồi thông lượng theo đợt
+ * @return false nếu không bind/connect được hoặc subscriber không nhận
+ */
+bool runScheme(const EndpointRegistry& registry, const string& service,
+               const Options& options, Results& results) {
+  void* publisher = zmq_socket(registry.rawContext(), ZMQ_PUB);
+  void* subscriber = zmq_socket(registry.rawContext(), ZMQ_SUB);
+  const int timeout_ms = 100;
+  const int no_hwm = 0;
+  zmq_setsockopt(publisher, ZMQ_SNDHWM, &no_hwm, sizeof(no_hwm));
+  zmq_setsockopt(subscriber, ZMQ_RCVHWM, &no_hwm, sizeof(no_hwm));
+  zmq_setsockopt(subscriber, ZMQ_RCVTIMEO, &timeout_ms, sizeof(timeout_ms));
+  zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
+
+  bool ok = registry.bind(publisher, service) &&
+            registry.connect(subscriber, service);
+  vector<char> buffer(options.size, 'x');
+  vector<char> received(options.size + 1);
+
+  // Cho subscriber ket noi xong (slow joiner)
+  bool joined = false;
+  for (int i = 0; ok && i < 50 && !joined; ++i) {
+    zmq_send(publisher, buffer.data(), buffer.size(), 0);
+    joined = zmq_recv(subscriber, received.data(), received.size(), 0) > 0;
+  }
+  // Bo cac tin do con tren duong truyen (cho het timeout mot lan)
+  while (joined &&
+         zmq_recv(subscriber, received.data(), received.size(), 0) > 0) {
+  }
+  if (ok && !joined) {
+    cerr << "[FAIL] " << service << ": subscriber khong nhan duoc tin" << endl;
+  }
+  ok = ok && joined;
+
+  LatencyHistogram latency;
+  for (int i = 0; ok && i < options.samples; ++i) {
+    const uint64_t start = nowNs();
+    zmq_send(publisher, buffer.data(), buffer.size(), 0);
+    if (zmq_recv(subscriber, received.data(), received.size(), 0) < 0) {
+      ok = false;
+      break;
+    }
+    latency.record(nowNs() - start);
+  }
+
+  uint64_t delivered = 0;
+  const uint64_t cpu_start = cpuNs();
+  const uint64_t wall_start = nowNs();
+  for (int sent = 0; ok && sent < options.messages; sent += kBurst) {
+    for (int i = 0; i < kBurst; ++i) {
+      zmq_send(publisher, buffer.data(), buffer.size(), 0);
+    }
+    for (int i = 0; i < kBurst; ++i) {
+      if (zmq_recv(subscriber, received.data(), received.size(), 0) < 0) break;
+      ++delivered;
+    }
+  }
+  const uint64_t wall_ns = nowNs() - wall_start;
+  const uint64_t cpu_ns = cpuNs() - cpu_start;
+
+  if (ok) {
+    const LatencyHistogram::Snapshot snapshot = latency.snapshot();
+    const string prefix = EndpointRegistry::schemeName(
+                              registry.schemeFor(service)) +
+                          string(".");
+    results[prefix + "latency_ns_p50"] = snapshot.percentile(0.50);
+    results[prefix + "latency_ns_p99"] = snapshot.percentile(0.99);
+    results[prefix + "latency_ns_max"] = snapshot.percentile(1.0);
+    results[prefix + "msgs_per_second"] =
+        wall_ns > 0 ? delivered * 1e9 / wall_ns : 0.0;
+    results[prefix + "cpu_ns_per_msg"] =
+        delivered > 0 ? static_cast<double>(cpu_ns) / delivered : 0.0;
+    results[prefix + "lost"] =
+        static_cast<double>(options.messages / kBurst * kBurst - delivered);
+  }
+
+  zmq_close(subscriber);
+  zmq_close(publisher);
+  return ok;
+}
+
+string resultsJson(const Options& options, const Results& results) {
+  ostringstream out;
+  out << "{\"config\":{\"messages\":" << options.messages
+      << ",\"size\":" << options.size << ",\"samples\":" << options.samples
+      << "},\"results\":{";
+  bool first = true;
+  for (const auto& pair : results) {
+    out << (first ? "" : ",") << "\"" << pair.first << "\":" << pair.second;
+    first = false;
+  }
+  out << "}}";
+  return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseArgs(argc, argv, options)) return 1;
+
+  // Ba dich vu, moi dich vu registry chon mot loai kenh cho tien trinh nay
+  EndpointRegistry registry("bench_transport");
+  const string ipc_dir = "/tmp/bench_transport_" + to_string(getpid());
+  registry.setIpcDir(ipc_dir);
+  EndpointRegistry::Service same_process;
+  same_process.process = "bench_transport";
+  registry.add("bench_inproc", same_process);
+  EndpointRegistry::Service same_host;
+  same_host.process = "bench_peer";
+  registry.add("bench_ipc", same_host);
+  EndpointRegistry::Service other_host;
+  other_host.host = "127.0.0.1";
+  other_host.port = options.tcp_port;
+  registry.add("bench_tcp", other_host);
+
+  Results results;
+  bool ok = true;
+  const char* services[] = {"bench_inproc", "bench_ipc", "bench_tcp"};
+  for (const char* service : services) {
+    ok = runScheme(registry, service, options, results) && ok;
+    // ZMQ chi xoa file socket ipc khi huy context, xoa ngay tai day
+    for (const string& endpoint : registry.bindEndpoints(service)) {
+      if (endpoint.compare(0, 6, "ipc://") == 0) {
+        unlink(endpoint.c_str() + 6);
+      }
+    }
+  }
+  rmdir(ipc_dir.c_str());
+
+  const string json = resultsJson(options, results);
+  ofstream(options.out.c_str()) << json << "\n";
+  cout << "[BENCH] " << json << endl;
+  return ok ? 0 : 1;
+}
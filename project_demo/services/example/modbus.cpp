@@ -1,59 +1,264 @@
+#include <unistd.h>
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "config_watcher.h"
+#include "gateway_config.h"
 #include "meter_driver.h"
+#include "poll_scheduler.h"
+#include "register_mirror.h"
+#include "rollup.h"
+#include "telemetry.h"
+#include "transport/zmq/endpoint_registry.h"
 #include "zmq.h"
 
 using namespace std;
 
 /* ================== BIẾN DÙNG CHUNG ================== */
-mutex driver_mutex;
 atomic<bool> running(true);
+// Socket PUB khong thread-safe: thread polling cua moi bus gui duoi khoa nay
+mutex publisher_mutex;
 
 /* ================== LUỒNG POLLING ================== */
-void pollingThread(MeterDriver* meter, void* publisher, int poll_interval_ms) {
-  int cycle = 0;
+// Có gateway_config.json (configures/plugins/meter/) thì nạp mọi bus, profile
+// và thiết bị trong một tiến trình; không có thì chạy một đồng hồ theo
+// meter_config.json như trước. Mỗi bus một PollScheduler chạy trên thread
+// riêng, mỗi thiết bị × lớp chu kỳ (poll_class) là một task, deadline tính
+// từ deadline trước nên thời gian đọc không làm trôi chu kỳ. Task các thiết bị
+// cùng bus được lệch pha đều trong MAX_PHASE_MS (hoặc chu kỳ nếu ngắn hơn)
+// để không dồn cục; schema gửi ngay, trước frame dữ liệu đầu tiên.
+// Dữ liệu gửi dạng frame nhị phân (telemetry.h) trên topic telemetry/<id>,
+// schema gửi trên topic telemetry/schema/<id> và nhắc lại định kỳ.
+// Tổng hợp 1m/15m/1h tính ngay sau mỗi lần đọc, cửa sổ đóng được publish trên
+// topic rollup/<độ phân giải>/<id>; trạng thái tích lũy lưu định kỳ để khởi
+// động lại không mất cửa sổ đang mở.
+// Sửa meter_config.json khi đang chạy: ConfigWatcher nạp lại ở nền, driver
+// thay kế hoạch đọc giữa hai chu kỳ, task của lớp chu kỳ mới được thêm vào.
+// gateway_config.json chưa nạp lại nóng: sửa thì khởi động lại.
+const string GATEWAY_CONFIG_FILE = "gateway_config.json";
+const string METER_CONFIG_FILE = "meter_config.json";
+const int MAX_PHASE_MS = 1000;
+const int SCHEMA_REPEAT_MS = 10000;
+const int ROLLUP_CHECKPOINT_MS = 60000;
+// Chế độ gateway: mỗi thiết bị một file rollup_checkpoint_<device_id>.bin
+const string ROLLUP_CHECKPOINT_FILE = "rollup_checkpoint.bin";
+// Số liệu truyền thông (RTT, timeout, lỗi, retry, tỉ lệ bus bận) của mọi thiết
+// bị: JSON trên topic metrics/comm và file text cho textfile collector của
+// node_exporter
+const int METRICS_INTERVAL_MS = 10000;
+const string METRICS_TOPIC = "metrics/comm";
+const string METRICS_PROM_FILE = "comm_metrics.prom";
+// Ảnh thanh ghi của đồng hồ phục vụ qua Modbus TCP (unit = slave ID): client
+// SCADA/HMI đọc FC03 từ RAM thay vì chiếm bus RS-485, tuổi dữ liệu ở input
+// register MIRROR_STATUS_ADDRESS (register_mirror.h). Slave ID trùng giữa các
+// bus chỉ thiết bị đầu tiên có ảnh.
+const int MIRROR_PORT = 1502;
+const uint16_t MIRROR_STATUS_ADDRESS = 0;
+// Địa chỉ ZMQ theo tên dịch vụ (endpoint_registry.h): cùng tiến trình ->
+// inproc, cùng board -> ipc, máy khác -> tcp. Thiếu file thì dùng mặc định
+// telemetry tcp 5555, control tcp 5556 như trước. control khai báo host
+// 127.0.0.1 (ép tcp) vì publisher lệnh bên ngoài chỉ bind tcp 5556.
+const string PROCESS_NAME = "modbus_app";
+const string ENDPOINTS_FILE = "endpoints.json";
 
-  while (running) {
-    cycle++;
+void publishBytes(void* publisher, const string& topic, const void* data,
+                  size_t size) {
+  lock_guard<mutex> lock(publisher_mutex);
+  zmq_send(publisher, topic.data(), topic.size(), ZMQ_SNDMORE);
+  zmq_send(publisher, data, size, 0);
+}
+
+void publishFrame(void* publisher, const string& topic,
+                  const telemetry::Payload& payload) {
+  publishBytes(publisher, topic, payload.data(), payload.size());
+}
+
+/**
+ * @brief Encoder va bo tong hop sinh ra tu ke hoach doc cua driver
+ *
+ * Dung lai toan bo khi driver nap cau hinh moi (schema moi): consumer nhan
+ * schema moi ngay lap tuc, cac cua so tong hop dang mo cua schema cu bi bo.
+ */
+struct Pipeline {
+  explicit Pipeline(const DriverPlan& plan)
+      : encoder(telemetry::makeSchema(*plan.schema, plan.config), true),
+        rollup(*plan.schema, encoder.schema(),
+               telemetry::defaultResolutions()),
+        data_topic(telemetry::dataTopic(plan.config.device_id)),
+        schema_topic(telemetry::schemaTopic(plan.config.device_id)) {
+    if (plan.config.report_by_exception) {
+      // Chi gui tag vuot deadband; chu ky khong co thay doi thi khong publish
+      encoder.setExceptionReporting(
+          telemetry::makeDeadbands(*plan.schema, plan.config),
+          static_cast<int64_t>(plan.config.max_silence_ms) * 1000);
+    }
+    for (size_t i = 0; i < rollup.resolutionCount(); ++i) {
+      const string& name = rollup.resolution(i).name;
+      rollup_encoders.push_back(telemetry::Encoder(rollup.schema(), false));
+      rollup_topics.push_back(
+          telemetry::rollupTopic(name, plan.config.device_id));
+      rollup_schema_topics.push_back(
+          telemetry::rollupSchemaTopic(name, plan.config.device_id));
+    }
+  }
 
-    MeterData data;
-    {
-      lock_guard<mutex> lock(driver_mutex);
-      data = meter->readAllAndScaleData();
-      // data = meter->readRawData();
+  void publishSchemas(void* publisher, telemetry::Payload& payload) {
+    telemetry::encodeSchema(encoder.schema(), payload);
+    publishFrame(publisher, schema_topic, payload);
+    telemetry::encodeSchema(rollup.schema(), payload);
+    for (const string& topic : rollup_schema_topics) {
+      publishFrame(publisher, topic, payload);
     }
+  }
 
-    stringstream ss;
-    ss << "{ \"cycle\": " << cycle << ", \"data\": { ";
+  telemetry::Encoder encoder;
+  telemetry::RollupStage rollup;
+  string data_topic;
+  string schema_topic;
+  vector<telemetry::Encoder> rollup_encoders;
+  vector<string> rollup_topics;
+  vector<string> rollup_schema_topics;
+};
 
-    for (auto it = data.begin(); it != data.end(); ++it) {
-      ss << "\"" << it->first << "\":" << it->second;
-      if (next(it) != data.end()) ss << ", ";
+/**
+ * @brief Các task đọc của một thiết bị trong PollScheduler của bus
+ *
+ * Task của một thiết bị chạy tuần tự trên thread của bus nên dùng chung
+ * sample, encoder và buffer: chu kỳ đọc + publish không cấp phát. offset
+ * (0..1) lệch pha deadline đầu tiên, tính trên min(chu kỳ, MAX_PHASE_MS).
+ */
+class DevicePoller {
+ public:
+  DevicePoller(MeterDriver* meter, RegisterMirror* mirror, void* publisher,
+               const string& checkpoint_file)
+      : meter_(meter),
+        mirror_(mirror),
+        publisher_(publisher),
+        checkpoint_file_(checkpoint_file),
+        sample_(meter->makeSample()),
+        generation_(meter->generation()),
+        pipeline_(*meter->current()),
+        name_(meter->current()->config.device_id) {
+    if (pipeline_.rollup.loadCheckpoint(checkpoint_file_)) {
+      cout << "[ROLLUP] Nap lai trang thai tu " << checkpoint_file_ << endl;
     }
-    ss << " } }";
+  }
 
-    string msg = ss.str();
-    zmq_send(publisher, msg.c_str(), msg.size(), 0);
+  DevicePoller(const DevicePoller&) = delete;
+  DevicePoller& operator=(const DevicePoller&) = delete;
 
-    cout << "[POLLING] " << msg << endl;
+  void schedule(PollScheduler* scheduler, double offset) {
+    scheduler_ = scheduler;
+    offset_ = offset;
+    scheduler->addTask(name_ + "/schema",
+                       chrono::milliseconds(SCHEMA_REPEAT_MS), [this]() {
+                         pipeline_.publishSchemas(publisher_, payload_);
+                       });
+    addTask("rollup_checkpoint", ROLLUP_CHECKPOINT_MS, [this]() {
+      if (!saveCheckpoint()) {
+        cerr << "[ROLLUP] Khong luu duoc checkpoint " << checkpoint_file_
+             << endl;
+      }
+    });
+    scheduleClasses(*meter_->current());
+  }
+
+  // Chi goi khi thread cua bus da dung
+  bool saveCheckpoint() const {
+    return pipeline_.rollup.saveCheckpoint(checkpoint_file_);
+  }
 
-    this_thread::sleep_for(chrono::milliseconds(poll_interval_ms));
+ private:
+  int addTask(const string& task, int period_ms, PollScheduler::Task run) {
+    const int64_t phase_ms =
+        static_cast<int64_t>(min(period_ms, MAX_PHASE_MS) * offset_);
+    return scheduler_->addTask(name_ + "/" + task,
+                               chrono::milliseconds(period_ms), run,
+                               chrono::milliseconds(phase_ms));
   }
 
-  cout << "[POLLING] Thread stopped\n";
+  void poll(const string& poll_class) {
+    // Driver vua nap cau hinh moi (ConfigWatcher): dung lai encoder/rollup
+    // giua hai chu ky, truoc khi doc theo ke hoach moi
+    if (meter_->generation() != generation_) {
+      generation_ = meter_->generation();
+      const DriverPlanPtr plan = meter_->current();
+      pipeline_ = Pipeline(*plan);
+      if (mirror_ != nullptr) mirror_->resetBlocks();
+      pipeline_.publishSchemas(publisher_, payload_);
+      scheduleClasses(*plan);
+    }
+
+    // Driver chuyen job sang thread cua bus, khong can khoa o day
+    meter_->readPollClass(poll_class, sample_);
+    if (pipeline_.encoder.encode(sample_, payload_)) {
+      publishFrame(publisher_, pipeline_.data_topic, payload_);
+    }
+    pipeline_.rollup.update(
+        sample_, [this](size_t resolution, const Sample& window) {
+          pipeline_.rollup_encoders[resolution].encode(window, payload_);
+          publishFrame(publisher_, pipeline_.rollup_topics[resolution],
+                       payload_);
+        });
+  }
+
+  // Lop chu ky -> task; lop bi xoa khoi cau hinh giu task nhung khong con
+  // block nao de doc
+  void scheduleClasses(const DriverPlan& plan) {
+    for (const string& poll_class : plan.plan.pollClasses()) {
+      const int period_ms = plan.config.pollIntervalFor(poll_class);
+      map<string, int>::const_iterator it = class_tasks_.find(poll_class);
+      if (it != class_tasks_.end()) {
+        scheduler_->setPeriod(it->second, chrono::milliseconds(period_ms));
+        continue;
+      }
+      class_tasks_[poll_class] =
+          addTask(poll_class.empty() ? "default" : poll_class, period_ms,
+                  [this, poll_class]() { poll(poll_class); });
+    }
+  }
+
+  MeterDriver* meter_;
+  RegisterMirror* mirror_;  // nullptr: thiet bi khong co anh
+  void* publisher_;
+  string checkpoint_file_;
+  Sample sample_;
+  telemetry::Payload payload_;
+  uint64_t generation_;
+  Pipeline pipeline_;
+  string name_;
+  PollScheduler* scheduler_ = nullptr;
+  double offset_ = 0.0;
+  map<string, int> class_tasks_;
+};
+
+void pollingThread(PollScheduler* scheduler, string bus) {
+  scheduler->setMissHandler([bus](const string& name, uint64_t missed,
+                                  chrono::microseconds lateness) {
+    cerr << "[POLLING] " << bus << " " << name << " lo " << missed
+         << " deadline (tre " << lateness.count() << " us)" << endl;
+  });
+
+  scheduler->run();
+
+  cout << "[POLLING] Thread " << bus << " stopped\n";
 }
 
 /* ================== LUỒNG ĐIỀU KHIỂN ================== */
-void controlThread(MeterDriver* driver, void* context) {
-  void* subscriber = zmq_socket(context, ZMQ_SUB);
-  zmq_connect(subscriber, "tcp://localhost:5556");
+void controlThread(const vector<unique_ptr<PollScheduler> >* schedulers,
+                   const transport::EndpointRegistry* endpoints) {
+  void* subscriber = zmq_socket(endpoints->rawContext(), ZMQ_SUB);
+  endpoints->connect(subscriber, "control");
   zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "", 0);
 
   char buffer[256];
@@ -69,6 +274,7 @@ void controlThread(MeterDriver* driver, void* context) {
 
     if (cmd == "STOP") {
       running = false;
+      for (const auto& scheduler : *schedulers) scheduler->stop();
       cout << "[CONTROL] Stop system\n";
     }
   }
@@ -77,44 +283,199 @@ void controlThread(MeterDriver* driver, void* context) {
 }
 
 /* ================== MAIN ================== */
-int main() {
-  const string CONFIG_FILE = "meter_config.json";
+// Mot driver va bus cua no (ten bus trong gateway_config.json)
+struct DeviceEntry {
+  unique_ptr<MeterDriver> driver;
+  string bus;
+};
 
-  /* Load config */
-  MeterConfig config;
-  if (!config.loadFromJson(CONFIG_FILE)) {
-    cerr << "[FATAL] Cannot load config\n";
-    return 1;
+/**
+ * @brief Tạo driver: mọi thiết bị của gateway_config.json nếu có file, không
+ *        thì một đồng hồ theo meter_config.json
+ * @return false nếu file cấu hình không hợp lệ hoặc không có thiết bị nào
+ */
+bool createDevices(vector<DeviceEntry>& devices, bool* gateway) {
+  *gateway = access(GATEWAY_CONFIG_FILE.c_str(), F_OK) == 0;
+  if (!*gateway) {
+    MeterConfig config;
+    if (!config.loadFromJson(METER_CONFIG_FILE)) return false;
+    DeviceEntry entry;
+    entry.driver.reset(new MeterDriver(config));
+    entry.bus = config.serial_port;
+    devices.push_back(move(entry));
+    return true;
   }
 
-  /* ZMQ context */
-  void* context = zmq_ctx_new();
+  GatewayConfig gateway_config;
+  if (!gateway_config.loadFromJson(GATEWAY_CONFIG_FILE) ||
+      !gateway_config.validate()) {
+    return false;
+  }
+  vector<const DeviceInstance*> instances;
+  vector<unique_ptr<MeterDriver> > drivers =
+      gateway_config.createDrivers(&instances);
+  for (size_t i = 0; i < drivers.size(); ++i) {
+    DeviceEntry entry;
+    entry.driver = move(drivers[i]);
+    entry.bus = instances[i]->bus;
+    devices.push_back(move(entry));
+  }
+  cout << "[SYSTEM] " << GATEWAY_CONFIG_FILE << ": " << devices.size() << "/"
+       << gateway_config.devices.size() << " thiet bi tren "
+       << gateway_config.buses.size() << " bus\n";
+  return !devices.empty();
+}
+
+int main() {
+  /* ZMQ: context dung chung + dia chi theo ten dich vu */
+  transport::EndpointRegistry endpoints(PROCESS_NAME);
+  if (!endpoints.loadFromJson(ENDPOINTS_FILE)) {
+    transport::EndpointRegistry::Service telemetry;
+    telemetry.process = PROCESS_NAME;
+    telemetry.port = 5555;
+    endpoints.add("telemetry", telemetry);
+    transport::EndpointRegistry::Service control;
+    control.host = "127.0.0.1";  // IP -> tcp, nhu dia chi cu
+    control.port = 5556;
+    endpoints.add("control", control);
+    cerr << "[WARN] Khong doc duoc " << ENDPOINTS_FILE
+         << ", dung endpoint mac dinh\n";
+  }
 
   /* Publisher socket */
-  void* publisher = zmq_socket(context, ZMQ_PUB);
-  if (zmq_bind(publisher, "tcp://*:5555") != 0) {
+  void* publisher = zmq_socket(endpoints.rawContext(), ZMQ_PUB);
+  if (!endpoints.bind(publisher, "telemetry")) {
     cerr << "[FATAL] ZMQ bind failed\n";
+    zmq_close(publisher);  // de context cua endpoints huy duoc
+    return 1;
+  }
+
+  for (const string& endpoint : endpoints.bindEndpoints("telemetry")) {
+    cout << "[SYSTEM] ZMQ PUB at " << endpoint << "\n";
+  }
+
+  /* Meter driver: anh thanh ghi khai bao truoc de song lau hon driver */
+  vector<unique_ptr<RegisterMirror> > mirrors;
+  vector<DeviceEntry> devices;
+  bool gateway = false;
+  if (!createDevices(devices, &gateway)) {
+    cerr << "[FATAL] Cannot load config\n";
+    zmq_close(publisher);
     return 1;
   }
 
-  cout << "[SYSTEM] ZMQ PUB at port 5555\n";
+  /* Nap lai cau hinh khi file doi, khong dung bus (chi che do mot dong ho) */
+  ConfigWatcher watcher;
+  if (!gateway) {
+    MeterDriver* meter = devices.front().driver.get();
+    if (!watcher.watch(METER_CONFIG_FILE,
+                       [meter](const MeterConfig& updated) {
+                         meter->reload(updated);
+                       }) ||
+        !watcher.start()) {
+      cerr << "[WARN] Khong theo doi duoc " << METER_CONFIG_FILE
+           << ", doi cau hinh can khoi dong lai\n";
+    }
+  }
 
-  /* Meter driver */
-  unique_ptr<MeterDriver> driver(new MeterDriver(config));
-  Vu
-      /* Start threads */
-      thread t_poll(pollingThread, driver.get(), publisher,
-                    config.poll_interval_ms);
+  /* Anh thanh ghi + Modbus TCP slave cuc bo */
+  MirrorServer::Options mirror_options;
+  mirror_options.port = MIRROR_PORT;
+  MirrorServer mirror_server(mirror_options);
+  vector<RegisterMirror*> device_mirrors;
+  size_t mirrored = 0;
+  for (const DeviceEntry& device : devices) {
+    const MeterConfig& config = device.driver->current()->config;
+    unique_ptr<RegisterMirror> mirror(
+        new RegisterMirror(MIRROR_STATUS_ADDRESS));
+    if (!mirror_server.addMirror(config.slave_id, mirror.get())) {
+      cerr << "[WARN] Thiet bi " << config.device_id
+           << " khong co anh Modbus TCP (unit " << config.slave_id << ")\n";
+      device_mirrors.push_back(nullptr);
+      continue;
+    }
+    RegisterMirror* target = mirror.get();
+    device.driver->setBlockObserver(
+        [target](const ReadBlock& block, const uint16_t* words) {
+          target->update(block, words);
+        });
+    device_mirrors.push_back(target);
+    mirrors.push_back(move(mirror));
+    ++mirrored;
+  }
+  atomic<bool> mirror_stop(false);
+  thread t_mirror;
+  if (mirrored > 0 && mirror_server.open()) {
+    cout << "[SYSTEM] Modbus TCP mirror at port " << MIRROR_PORT << ", "
+         << mirrored << " unit\n";
+    t_mirror = thread([&mirror_server, &mirror_stop]() {
+      mirror_server.run(mirror_stop);
+    });
+  } else {
+    cerr << "[WARN] Khong mo duoc Modbus TCP mirror, chi publish qua ZMQ\n";
+  }
 
-  thread t_ctrl(controlThread, driver.get(), context);
+  /* Moi bus mot scheduler; task cua thiet bi cung bus lech pha deu */
+  map<string, vector<size_t> > by_bus;
+  for (size_t i = 0; i < devices.size(); ++i) {
+    by_bus[devices[i].bus].push_back(i);
+  }
+  vector<unique_ptr<PollScheduler> > schedulers;
+  vector<string> scheduler_buses;
+  vector<unique_ptr<DevicePoller> > pollers;
+  for (const auto& bus : by_bus) {
+    schedulers.emplace_back(new PollScheduler());
+    scheduler_buses.push_back(bus.first);
+    for (size_t slot = 0; slot < bus.second.size(); ++slot) {
+      const size_t index = bus.second[slot];
+      MeterDriver* meter = devices[index].driver.get();
+      const string checkpoint =
+          gateway ? "rollup_checkpoint_" +
+                        meter->current()->config.device_id + ".bin"
+                  : ROLLUP_CHECKPOINT_FILE;
+      pollers.emplace_back(new DevicePoller(meter, device_mirrors[index],
+                                            publisher, checkpoint));
+      pollers.back()->schedule(schedulers.back().get(),
+                               static_cast<double>(slot) / bus.second.size());
+    }
+  }
+
+  // So lieu truyen thong cua ca tien trinh: mot task tren scheduler dau tien
+  MetricsReport metrics;
+  schedulers.front()->addTask(
+      "metrics", chrono::milliseconds(METRICS_INTERVAL_MS),
+      [&metrics, publisher]() {
+        metrics.update();
+        const string json = metrics.json();
+        publishBytes(publisher, METRICS_TOPIC, json.data(), json.size());
+        if (!metrics.writePrometheusFile(METRICS_PROM_FILE)) {
+          cerr << "[METRICS] Khong ghi duoc " << METRICS_PROM_FILE << endl;
+        }
+      });
+
+  /* Start threads */
+  vector<thread> t_polls;
+  for (size_t i = 0; i < schedulers.size(); ++i) {
+    t_polls.emplace_back(pollingThread, schedulers[i].get(),
+                         scheduler_buses[i]);
+  }
+
+  thread t_ctrl(controlThread, &schedulers, &endpoints);
 
   /* Wait threads */
-  t_poll.join();
+  for (thread& t_poll : t_polls) t_poll.join();
   t_ctrl.join();
+  mirror_stop = true;
+  if (t_mirror.joinable()) t_mirror.join();
 
   /* Cleanup */
+  for (const auto& poller : pollers) poller->saveCheckpoint();
+  for (const DeviceEntry& device : devices) {
+    device.driver->setBlockObserver(MeterDriver::BlockObserver());
+  }
+  watcher.stop();
   zmq_close(publisher);
-  zmq_ctx_destroy(context);
+  // Context thuoc endpoints, duoc huy khi thoat main
 
   cout << "[SYSTEM] Exit\n";
   return 0;
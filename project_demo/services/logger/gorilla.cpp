@@ -0,0 +1,215 @@
+#include "gorilla.h"
+
+#include <cstring>
+
+namespace gorilla {
+
+namespace {
+
+std::uint64_t toBits(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double fromBits(std::uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+int leadingZeros(std::uint64_t x) {
+  int n = 0;
+  while (n < 64 && !(x & (1ull << (63 - n)))) ++n;
+  return n;
+}
+
+int trailingZeros(std::uint64_t x) {
+  int n = 0;
+  while (n < 64 && !(x & (1ull << n))) ++n;
+  return n;
+}
+
+// Mo rong dau cho so bu hai bits bit
+std::int64_t signExtend(std::uint64_t value, int bits) {
+  const std::uint64_t sign = 1ull << (bits - 1);
+  return static_cast<std::int64_t>((value ^ sign) - sign);
+}
+
+}  // namespace
+
+void BitWriter::write(std::uint64_t value, int bits) {
+  while (bits > 0) {
+    if (bits_ % 8 == 0) bytes_.push_back(0);
+    const int free_bits = 8 - static_cast<int>(bits_ % 8);
+    const int take = bits < free_bits ? bits : free_bits;
+    const std::uint8_t chunk = static_cast<std::uint8_t>(
+        (value >> (bits - take)) & ((1u << take) - 1));
+    bytes_.back() |= static_cast<std::uint8_t>(chunk << (free_bits - take));
+    bits -= take;
+    bits_ += take;
+  }
+}
+
+void BitWriter::clear() {
+  bytes_.clear();
+  bits_ = 0;
+}
+
+BitReader::BitReader(const std::uint8_t* data, std::size_t size)
+    : data_(data), size_bits_(size * 8) {}
+
+bool BitReader::read(int bits, std::uint64_t* value) {
+  if (pos_ + static_cast<std::size_t>(bits) > size_bits_) return false;
+  std::uint64_t result = 0;
+  while (bits > 0) {
+    const int available = 8 - static_cast<int>(pos_ % 8);
+    const int take = bits < available ? bits : available;
+    const std::uint8_t byte = data_[pos_ / 8];
+    result = (result << take) |
+             ((byte >> (available - take)) & ((1u << take) - 1));
+    bits -= take;
+    pos_ += take;
+  }
+  *value = result;
+  return true;
+}
+
+/**
+ * @brief Thêm một điểm vào chunk
+ * @param timestamp Thời điểm (ms), lớn hơn điểm trước
+ * @param value Giá trị kênh
+ */
+void ChunkEncoder::append(std::int64_t timestamp, double value) {
+  const std::uint64_t bits = toBits(value);
+
+  if (count_ == 0) {
+    writer_.write(static_cast<std::uint64_t>(timestamp), 64);
+    writer_.write(bits, 64);
+    first_time_ = prev_time_ = timestamp;
+    prev_delta_ = 0;
+    prev_bits_ = bits;
+    prev_leading_ = -1;
+    ++count_;
+    return;
+  }
+
+  // Timestamp: delta-of-delta
+  const std::int64_t delta = timestamp - prev_time_;
+  const std::int64_t dod = delta - prev_delta_;
+  const std::uint64_t udod = static_cast<std::uint64_t>(dod);
+  if (dod == 0) {
+    writer_.write(0x0, 1);
+  } else if (dod >= -64 && dod <= 63) {
+    writer_.write(0x2, 2);
+    writer_.write(udod & 0x7F, 7);
+  } else if (dod >= -256 && dod <= 255) {
+    writer_.write(0x6, 3);
+    writer_.write(udod & 0x1FF, 9);
+  } else if (dod >= -2048 && dod <= 2047) {
+    writer_.write(0xE, 4);
+    writer_.write(udod & 0xFFF, 12);
+  } else {
+    writer_.write(0xF, 4);
+    writer_.write(udod & 0xFFFFFFFFull, 32);
+  }
+  prev_delta_ = delta;
+  prev_time_ = timestamp;
+
+  // Gia tri: XOR voi gia tri truoc
+  const std::uint64_t x = bits ^ prev_bits_;
+  prev_bits_ = bits;
+  if (x == 0) {
+    writer_.write(0x0, 1);
+  } else {
+    int leading = leadingZeros(x);
+    const int trailing = trailingZeros(x);
+    if (leading > 31) leading = 31;  // chi co 5 bit
+
+    if (prev_leading_ >= 0 && leading >= prev_leading_ &&
+        trailing >= prev_trailing_) {
+      writer_.write(0x2, 2);
+      writer_.write(x >> prev_trailing_, 64 - prev_leading_ - prev_trailing_);
+    } else {
+      const int significant = 64 - leading - trailing;
+      writer_.write(0x3, 2);
+      writer_.write(static_cast<std::uint64_t>(leading), 5);
+      writer_.write(static_cast<std::uint64_t>(significant - 1), 6);
+      writer_.write(x >> trailing, significant);
+      prev_leading_ = leading;
+      prev_trailing_ = trailing;
+    }
+  }
+  ++count_;
+}
+
+void ChunkEncoder::clear() {
+  writer_.clear();
+  count_ = 0;
+  first_time_ = prev_time_ = prev_delta_ = 0;
+  prev_bits_ = 0;
+  prev_leading_ = -1;
+  prev_trailing_ = 0;
+}
+
+ChunkDecoder::ChunkDecoder(const std::uint8_t* data, std::size_t size,
+                           std::uint32_t count)
+    : reader_(data, size), remaining_(count) {}
+
+bool ChunkDecoder::next(std::int64_t* timestamp, double* value) {
+  if (remaining_ == 0) return false;
+  std::uint64_t v = 0;
+
+  if (first_) {
+    std::uint64_t t = 0;
+    if (!reader_.read(64, &t) || !reader_.read(64, &v)) return false;
+    first_ = false;
+    prev_time_ = static_cast<std::int64_t>(t);
+    prev_bits_ = v;
+    --remaining_;
+    *timestamp = prev_time_;
+    *value = fromBits(prev_bits_);
+    return true;
+  }
+
+  // Tien to timestamp: toi da 4 bit '1' lien tiep
+  int ones = 0;
+  for (; ones < 4; ++ones) {
+    if (!reader_.read(1, &v)) return false;
+    if (v == 0) break;
+  }
+  static const int kDodBits[] = {0, 7, 9, 12, 32};
+  std::int64_t dod = 0;
+  if (ones > 0) {
+    if (!reader_.read(kDodBits[ones], &v)) return false;
+    dod = signExtend(v, kDodBits[ones]);
+  }
+  prev_delta_ += dod;
+  prev_time_ += prev_delta_;
+
+  if (!reader_.read(1, &v)) return false;
+  if (v == 1) {
+    std::uint64_t control = 0;
+    if (!reader_.read(1, &control)) return false;
+    if (control == 1) {
+      std::uint64_t leading = 0;
+      std::uint64_t significant = 0;
+      if (!reader_.read(5, &leading) || !reader_.read(6, &significant)) {
+        return false;
+      }
+      prev_leading_ = static_cast<int>(leading);
+      prev_trailing_ = 64 - prev_leading_ - static_cast<int>(significant + 1);
+      if (prev_trailing_ < 0) return false;
+    }
+    const int significant = 64 - prev_leading_ - prev_trailing_;
+    if (!reader_.read(significant, &v)) return false;
+    prev_bits_ ^= v << prev_trailing_;
+  }
+
+  --remaining_;
+  *timestamp = prev_time_;
+  *value = fromBits(prev_bits_);
+  return true;
+}
+
+}  // namespace gorilla
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Nen chuoi (timestamp, value) kieu Gorilla:
+//   - diem dau: timestamp 64 bit, value 64 bit (bit pattern cua double)
+//   - timestamp: delta-of-delta D = (t - t_prev) - (t_prev - t_prev2)
+//       '0' D = 0 | '10' 7 bit | '110' 9 bit | '1110' 12 bit | '1111' 32 bit
+//   - value: x = bits ^ bits_prev
+//       '0' x = 0 | '10' phan co nghia nam trong cua so leading/trailing cu
+//       | '11' leading 5 bit, (do dai - 1) 6 bit, phan co nghia
+// Voi du lieu 1 s deu va gia tri thay doi cham, trung binh ~1-2 byte/diem.
+namespace gorilla {
+
+class BitWriter {
+ public:
+  void write(std::uint64_t value, int bits);
+  void clear();
+
+  const std::vector<std::uint8_t>& bytes() const { return bytes_; }
+  std::size_t bitCount() const { return bits_; }
+
+ private:
+  std::vector<std::uint8_t> bytes_;
+  std::size_t bits_ = 0;
+};
+
+class BitReader {
+ public:
+  BitReader(const std::uint8_t* data, std::size_t size);
+
+  // false neu doc vuot cuoi buffer
+  bool read(int bits, std::uint64_t* value);
+
+ private:
+  const std::uint8_t* data_;
+  std::size_t size_bits_;
+  std::size_t pos_ = 0;
+};
+
+/**
+ * @brief Bo nen mot chunk cua mot kenh
+ *
+ * Timestamp phai tang dan (caller loai diem lui thoi gian truoc khi goi).
+ */
+class ChunkEncoder {
+ public:
+  void append(std::int64_t timestamp, double value);
+  void clear();
+
+  std::uint32_t count() const { return count_; }
+  std::int64_t firstTime() const { return first_time_; }
+  std::int64_t lastTime() const { return prev_time_; }
+  const std::vector<std::uint8_t>& bytes() const { return writer_.bytes(); }
+
+ private:
+  BitWriter writer_;
+  std::uint32_t count_ = 0;
+  std::int64_t first_time_ = 0;
+  std::int64_t prev_time_ = 0;
+  std::int64_t prev_delta_ = 0;
+  std::uint64_t prev_bits_ = 0;
+  int prev_leading_ = -1;  // -1: chua co cua so
+  int prev_trailing_ = 0;
+};
+
+/**
+ * @brief Giai nen tuan tu mot chunk co count diem
+ */
+class ChunkDecoder {
+ public:
+  ChunkDecoder(const std::uint8_t* data, std::size_t size,
+               std::uint32_t count);
+
+  // false khi het diem hoac du lieu hong
+  bool next(std::int64_t* timestamp, double* value);
+
+ private:
+  BitReader reader_;
+  std::uint32_t remaining_;
+  bool first_ = true;
+  std::int64_t prev_time_ = 0;
+  std::int64_t prev_delta_ = 0;
+  std::uint64_t prev_bits_ = 0;
+  int prev_leading_ = 0;
+  int prev_trailing_ = 0;
+};
+
+}  // namespace gorilla
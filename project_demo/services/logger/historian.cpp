@@ -0,0 +1,427 @@
+#include "historian.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "segment_log.h"
+
+namespace {
+
+const std::size_t kChunkHeader = 32;
+const std::uint32_t kMaxChunkSize = 1024 * 1024;
+
+void putU32(std::uint8_t* out, std::uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+void putI64(std::uint8_t* out, std::int64_t value) {
+  const std::uint64_t bits = static_cast<std::uint64_t>(value);
+  for (int i = 0; i < 8; ++i) {
+    out[i] = static_cast<std::uint8_t>(bits >> (8 * i));
+  }
+}
+
+std::uint32_t getU32(const std::uint8_t* in) {
+  std::uint32_t value = 0;
+  for (int i = 3; i >= 0; --i) value = (value << 8) | in[i];
+  return value;
+}
+
+std::int64_t getI64(const std::uint8_t* in) {
+  std::uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) value = (value << 8) | in[i];
+  return static_cast<std::int64_t>(value);
+}
+
+bool readAt(int fd, std::uint8_t* data, std::size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t rc = ::pread(fd, data, size, offset);
+    if (rc < 0 && errno == EINTR) continue;
+    if (rc <= 0) return false;
+    data += rc;
+    size -= static_cast<std::size_t>(rc);
+    offset += rc;
+  }
+  return true;
+}
+
+bool writeAll(int fd, const std::uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t rc = ::write(fd, data, size);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += rc;
+    size -= static_cast<std::size_t>(rc);
+  }
+  return true;
+}
+
+}  // namespace
+
+Historian::Historian(const Options& options) : options_(options) {}
+
+Historian::~Historian() { close(); }
+
+std::string Historian::dataPath(std::uint32_t file) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%08u.chk", file);
+  return options_.dir + "/" + name;
+}
+
+/**
+ * @brief Mở historian: nạp tên kênh, dựng lại index từ header các chunk
+ */
+bool Historian::open() {
+  ::mkdir(options_.dir.c_str(), 0755);
+  if (!loadChannels()) return false;
+
+  DIR* dir = ::opendir(options_.dir.c_str());
+  if (dir == nullptr) {
+    std::cerr << "[FAIL] Khong mo duoc thu muc historian " << options_.dir
+              << std::endl;
+    return false;
+  }
+  while (struct dirent* entry = ::readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name.size() != 12 || name.compare(8, 4, ".chk") != 0) continue;
+    files_[static_cast<std::uint32_t>(
+        std::strtoul(name.substr(0, 8).c_str(), nullptr, 10))] = 0;
+  }
+  ::closedir(dir);
+
+  for (auto& pair : files_) {
+    if (!scanFile(pair.first)) return false;
+  }
+
+  const std::uint32_t active = files_.empty() ? 0 : files_.rbegin()->first;
+  if (!openDataFile(active)) return false;
+
+  const Stats current = stats();
+  std::cout << "[INFO] Historian: " << channels_.size() << " kenh, "
+            << current.chunks << " chunk, " << current.disk_bytes
+            << " byte tren dia" << std::endl;
+  return true;
+}
+
+void Historian::close() {
+  for (std::uint32_t i = 0; i < channels_.size(); ++i) seal(i);
+  flush();
+  if (data_fd_ >= 0) {
+    ::close(data_fd_);
+    data_fd_ = -1;
+  }
+}
+
+bool Historian::loadChannels() {
+  channels_.clear();
+  by_name_.clear();
+  std::FILE* file = std::fopen((options_.dir + "/channels").c_str(), "r");
+  if (file == nullptr) return true;  // historian moi
+
+  char line[512];
+  while (std::fgets(line, sizeof(line), file) != nullptr) {
+    std::string name(line);
+    while (!name.empty() && (name.back() == '\n' || name.back() == '\r')) {
+      name.pop_back();
+    }
+    if (name.empty()) continue;
+    by_name_[name] = static_cast<std::uint32_t>(channels_.size());
+    channels_.push_back(Channel());
+    channels_.back().name = name;
+  }
+  std::fclose(file);
+  return true;
+}
+
+/**
+ * @brief Đọc header của mọi chunk trong file để dựng index thưa
+ *
+ * File cuối (đang ghi dở khi mất điện) được kiểm tra crc từng chunk và cắt bỏ
+ * phần đuôi hỏng.
+ */
+bool Historian::scanFile(std::uint32_t file) {
+  const bool last = file == files_.rbegin()->first;
+  int fd = ::open(dataPath(file).c_str(), last ? O_RDWR : O_RDONLY);
+  if (fd < 0) return false;
+
+  std::uint64_t offset = 0;
+  std::uint8_t header[kChunkHeader];
+  std::vector<std::uint8_t> data;
+  while (readAt(fd, header, kChunkHeader, static_cast<off_t>(offset))) {
+    ChunkRef ref;
+    ref.file = file;
+    ref.offset = offset;
+    ref.size = getU32(header);
+    const std::uint32_t channel = getU32(header + 8);
+    ref.count = getU32(header + 12);
+    ref.first = getI64(header + 16);
+    ref.last = getI64(header + 24);
+    if (ref.size > kMaxChunkSize || channel >= channels_.size()) break;
+    if (last) {
+      data.resize(ref.size);
+      if (!readAt(fd, data.data(), ref.size,
+                  static_cast<off_t>(offset + kChunkHeader)) ||
+          recordCrc32(data.data(), data.size()) != getU32(header + 4)) {
+        break;
+      }
+    }
+    channels_[channel].chunks.push_back(ref);
+    offset += kChunkHeader + ref.size;
+  }
+
+  struct stat st;
+  if (last && ::fstat(fd, &st) == 0 &&
+      static_cast<std::uint64_t>(st.st_size) > offset) {
+    std::cerr << "[WARN] Cat " << (st.st_size - offset) << " byte hong o cuoi "
+              << dataPath(file) << std::endl;
+    if (::ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+      std::cerr << "[WARN] ftruncate that bai: " << std::strerror(errno)
+                << std::endl;
+    }
+  }
+  ::close(fd);
+  files_[file] = offset;
+  return true;
+}
+
+bool Historian::openDataFile(std::uint32_t file) {
+  if (data_fd_ >= 0) {
+    ::fdatasync(data_fd_);
+    ::close(data_fd_);
+  }
+  data_fd_ = ::open(dataPath(file).c_str(), O_WRONLY | O_CREAT | O_APPEND,
+                    0644);
+  if (data_fd_ < 0) {
+    std::cerr << "[FAIL] Khong mo duoc " << dataPath(file) << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+  data_file_ = file;
+  data_size_ = files_[file];
+  return true;
+}
+
+/**
+ * @brief Lấy id kênh theo tên, kênh mới được ghi thêm vào file "channels"
+ */
+int Historian::channelId(const std::string& name) {
+  std::map<std::string, std::uint32_t>::const_iterator it =
+      by_name_.find(name);
+  if (it != by_name_.end()) return static_cast<int>(it->second);
+
+  const std::string path = options_.dir + "/channels";
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) return -1;
+  const std::string line = name + "\n";
+  const bool ok =
+      writeAll(fd, reinterpret_cast<const std::uint8_t*>(line.data()),
+               line.size()) &&
+      ::fdatasync(fd) == 0;
+  ::close(fd);
+  if (!ok) return -1;
+
+  const std::uint32_t id = static_cast<std::uint32_t>(channels_.size());
+  by_name_[name] = id;
+  channels_.push_back(Channel());
+  channels_.back().name = name;
+  return static_cast<int>(id);
+}
+
+void Historian::append(int channel, std::int64_t time_ms, double value) {
+  if (channel < 0 || static_cast<std::size_t>(channel) >= channels_.size()) {
+    return;
+  }
+  Channel& target = channels_[channel];
+
+  // Chuoi phai tang dan de index tim nhi phan duoc
+  const bool has_last = target.open.count() > 0 || !target.chunks.empty();
+  const std::int64_t last = target.open.count() > 0
+                                ? target.open.lastTime()
+                                : has_last ? target.chunks.back().last : 0;
+  if (has_last && time_ms <= last) {
+    ++rejected_;
+    return;
+  }
+
+  if (target.open.count() > 0 &&
+      (target.open.count() >= options_.chunk_points ||
+       time_ms - target.open.firstTime() >= options_.chunk_span_ms)) {
+    seal(static_cast<std::uint32_t>(channel));
+  }
+  target.open.append(time_ms, value);
+  ++points_;
+}
+
+/**
+ * @brief Đóng chunk đang mở của kênh và ghi vào file dữ liệu (chưa fsync)
+ */
+void Historian::seal(std::uint32_t channel) {
+  Channel& target = channels_[channel];
+  if (target.open.count() == 0 || data_fd_ < 0) return;
+
+  const std::vector<std::uint8_t>& data = target.open.bytes();
+  if (data_size_ > 0 && data_size_ + kChunkHeader + data.size() >
+                            options_.file_bytes) {
+    if (!openDataFile(data_file_ + 1)) return;
+    enforceQuota();
+  }
+
+  ChunkRef ref;
+  ref.file = data_file_;
+  ref.offset = data_size_;
+  ref.size = static_cast<std::uint32_t>(data.size());
+  ref.count = target.open.count();
+  ref.first = target.open.firstTime();
+  ref.last = target.open.lastTime();
+
+  std::uint8_t header[kChunkHeader];
+  putU32(header, ref.size);
+  putU32(header + 4, recordCrc32(data.data(), data.size()));
+  putU32(header + 8, channel);
+  putU32(header + 12, ref.count);
+  putI64(header + 16, ref.first);
+  putI64(header + 24, ref.last);
+  if (!writeAll(data_fd_, header, kChunkHeader) ||
+      !writeAll(data_fd_, data.data(), data.size())) {
+    std::cerr << "[FAIL] Ghi chunk " << target.name
+              << " that bai: " << std::strerror(errno) << std::endl;
+    // Cat phan ghi do de lan thu lai nam dung data_size_ (ref.offset)
+    if (::ftruncate(data_fd_, static_cast<off_t>(data_size_)) != 0) {
+      std::cerr << "[FAIL] Khong cat duoc chunk ghi do: "
+                << std::strerror(errno) << std::endl;
+    }
+    return;  // giu chunk mo, thu lai lan sau
+  }
+
+  data_size_ += kChunkHeader + data.size();
+  files_[data_file_] = data_size_;
+  target.chunks.push_back(ref);
+  target.open.clear();
+  dirty_ = true;
+}
+
+void Historian::flush() {
+  if (dirty_ && data_fd_ >= 0) ::fdatasync(data_fd_);
+  dirty_ = false;
+}
+
+/**
+ * @brief Xóa file dữ liệu cũ nhất (và mục index của nó) khi vượt quota
+ */
+void Historian::enforceQuota() {
+  std::uint64_t total = 0;
+  for (const auto& pair : files_) total += pair.second;
+
+  while (total > options_.quota_bytes && files_.size() > 1) {
+    const std::uint32_t victim = files_.begin()->first;
+    total -= files_.begin()->second;
+    files_.erase(files_.begin());
+    ::unlink(dataPath(victim).c_str());
+
+    // Chunk cua file cu nhat luon nam o dau index moi kenh
+    for (Channel& channel : channels_) {
+      std::vector<ChunkRef>::iterator end = channel.chunks.begin();
+      while (end != channel.chunks.end() && end->file == victim) ++end;
+      channel.chunks.erase(channel.chunks.begin(), end);
+    }
+    std::cout << "[INFO] Historian vuot quota, xoa " << dataPath(victim)
+              << std::endl;
+  }
+}
+
+bool Historian::readChunk(const ChunkRef& ref,
+                          std::vector<std::uint8_t>* data) {
+  int fd = ::open(dataPath(ref.file).c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  std::uint8_t header[kChunkHeader];
+  data->resize(ref.size);
+  const bool ok =
+      readAt(fd, header, kChunkHeader, static_cast<off_t>(ref.offset)) &&
+      readAt(fd, data->data(), ref.size,
+             static_cast<off_t>(ref.offset + kChunkHeader)) &&
+      recordCrc32(data->data(), data->size()) == getU32(header + 4);
+  ::close(fd);
+  return ok;
+}
+
+/**
+ * @brief Truy vấn điểm của kênh trong khoảng thời gian
+ *
+ * Tìm nhị phân chunk đầu tiên có t_last >= from_ms, giải nén tuần tự tới khi
+ * gặp chunk có t_first > to_ms, sau đó xét chunk đang mở trong RAM.
+ */
+bool Historian::query(const std::string& name, std::int64_t from_ms,
+                      std::int64_t to_ms, std::size_t max_points,
+                      std::vector<Point>* points) {
+  points->clear();
+  std::map<std::string, std::uint32_t>::const_iterator it =
+      by_name_.find(name);
+  if (it == by_name_.end()) return false;
+  const Channel& channel = channels_[it->second];
+
+  std::vector<ChunkRef>::const_iterator chunk = std::lower_bound(
+      channel.chunks.begin(), channel.chunks.end(), from_ms,
+      [](const ChunkRef& ref, std::int64_t t) { return ref.last < t; });
+
+  std::vector<std::uint8_t> data;
+  Point point;
+  for (; chunk != channel.chunks.end() && chunk->first <= to_ms &&
+         points->size() < max_points;
+       ++chunk) {
+    if (!readChunk(*chunk, &data)) {
+      std::cerr << "[WARN] Chunk hong: " << name << " @" << chunk->first
+                << std::endl;
+      continue;
+    }
+    gorilla::ChunkDecoder decoder(data.data(), data.size(), chunk->count);
+    while (points->size() < max_points &&
+           decoder.next(&point.time_ms, &point.value)) {
+      if (point.time_ms > to_ms) break;
+      if (point.time_ms >= from_ms) points->push_back(point);
+    }
+  }
+
+  if (channel.open.count() > 0 && channel.open.firstTime() <= to_ms &&
+      channel.open.lastTime() >= from_ms) {
+    gorilla::ChunkDecoder decoder(channel.open.bytes().data(),
+                                  channel.open.bytes().size(),
+                                  channel.open.count());
+    while (points->size() < max_points &&
+           decoder.next(&point.time_ms, &point.value)) {
+      if (point.time_ms > to_ms) break;
+      if (point.time_ms >= from_ms) points->push_back(point);
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> Historian::channels() const {
+  std::vector<std::string> names;
+  names.reserve(channels_.size());
+  for (const Channel& channel : channels_) names.push_back(channel.name);
+  return names;
+}
+
+Historian::Stats Historian::stats() const {
+  Stats stats;
+  stats.points = points_;
+  stats.rejected = rejected_;
+  for (const Channel& channel : channels_) {
+    stats.chunks += channel.chunks.size();
+  }
+  for (const auto& pair : files_) stats.disk_bytes += pair.second;
+  return stats;
+}
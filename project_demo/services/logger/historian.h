@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gorilla.h"
+
+/**
+ * @brief Historian cuc bo: luu chuoi thoi gian theo kenh, nen kieu Gorilla
+ *
+ * Moi kenh ("device_id/tag") co mot chunk mo trong RAM; chunk duoc dong khi
+ * du chunk_points diem hoac dai qua chunk_span_ms, roi append vao file du lieu
+ * hien tai (<seq>.chk), fdatasync gom lai trong flush(). Moi chunk tren dia:
+ *
+ *   len u32 | crc32 u32 | channel u32 | count u32 | t_first i64 | t_last i64
+ *   | du lieu gorilla (len byte)
+ *
+ * Index thua (mot muc/chunk: khoang thoi gian + vi tri) nam trong RAM, duoc
+ * dung lai luc mo bang cach chi doc header cac chunk. Truy van khoang thoi
+ * gian tim nhi phan tren index cua kenh va chi giai nen cac chunk giao voi
+ * khoang do. Ten kenh luu trong file "channels". Vuot quota thi xoa file du
+ * lieu cu nhat.
+ *
+ * Khong thread-safe: goi tu mot thread (vong lap chinh cua logger).
+ */
+class Historian {
+ public:
+  struct Options {
+    std::string dir;
+    std::uint32_t chunk_points = 900;              // 15 phut du lieu 1 s
+    std::int64_t chunk_span_ms = 15 * 60 * 1000;
+    std::uint64_t file_bytes = 8 * 1024 * 1024;
+    std::uint64_t quota_bytes = 256ull * 1024 * 1024;
+  };
+
+  struct Point {
+    std::int64_t time_ms;
+    double value;
+  };
+
+  struct Stats {
+    std::uint64_t points = 0;
+    std::uint64_t rejected = 0;  // diem lui thoi gian
+    std::uint64_t chunks = 0;    // chunk da dong trong index
+    std::uint64_t disk_bytes = 0;
+  };
+
+  explicit Historian(const Options& options);
+  ~Historian();
+
+  Historian(const Historian&) = delete;
+  Historian& operator=(const Historian&) = delete;
+
+  bool open();
+  // Dong moi chunk dang mo va ghi xuong flash
+  void close();
+
+  // Id cua kenh, tao moi (va luu ten) neu chua co; -1 neu loi
+  int channelId(const std::string& name);
+
+  // Them mot diem; diem co timestamp <= diem truoc cua kenh bi loai
+  void append(int channel, std::int64_t time_ms, double value);
+
+  // fdatasync file du lieu de cac chunk da dong tro thanh ben vung; goi
+  // dinh ky
+  void flush();
+
+  // Diem cua kenh trong [from_ms, to_ms], toi da max_points diem.
+  // false neu kenh khong ton tai.
+  bool query(const std::string& name, std::int64_t from_ms,
+             std::int64_t to_ms, std::size_t max_points,
+             std::vector<Point>* points);
+
+  std::vector<std::string> channels() const;
+  Stats stats() const;
+
+ private:
+  struct ChunkRef {
+    std::uint32_t file;
+    std::uint64_t offset;
+    std::uint32_t size;  // kich thuoc du lieu gorilla
+    std::uint32_t count;
+    std::int64_t first;
+    std::int64_t last;
+  };
+
+  struct Channel {
+    std::string name;
+    gorilla::ChunkEncoder open;  // chunk dang ghi
+    std::vector<ChunkRef> chunks;  // da dong, tang dan theo thoi gian
+  };
+
+  std::string dataPath(std::uint32_t file) const;
+  bool loadChannels();
+  bool scanFile(std::uint32_t file);
+  void seal(std::uint32_t channel);
+  bool openDataFile(std::uint32_t file);
+  void enforceQuota();
+  bool readChunk(const ChunkRef& ref, std::vector<std::uint8_t>* data);
+
+  Options options_;
+  std::vector<Channel> channels_;
+  std::map<std::string, std::uint32_t> by_name_;
+  std::map<std::uint32_t, std::uint64_t> files_;  // seq -> kich thuoc
+  int data_fd_ = -1;
+  std::uint32_t data_file_ = 0;
+  std::uint64_t data_size_ = 0;
+  bool dirty_ = false;  // co chunk chua fdatasync
+  std::uint64_t points_ = 0;
+  std::uint64_t rejected_ = 0;
+};
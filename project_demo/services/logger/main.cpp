@@ -1,43 +1,350 @@
-#include <string.h>
-#include <unistd.h>
+// Service logger: luu telemetry xuong flash (store-and-forward) va cho
+// consumer (bridge/cloud) doc lai theo cursor khi ket noi lai; dong thoi giai
+// ma frame va luu vao historian de dashboard cuc bo truy van theo thoi gian.
+//
+// Giao thuc replay (REQ/REP, moi request la mot chuoi ASCII):
+//   "READ <cursor> <max>" -> [next_cursor][topic][payload][topic][payload]...
+//   "ACK <cursor>"        -> "OK" | "ERR"
+//   "STAT"                -> thong ke dang text
+//
+// Giao thuc historian (REQ/REP):
+//   "QUERY <kenh> <from_ms> <to_ms> [max]"
+//       -> {"channel":"...","points":[[t_ms,value],...]}
+//   "CHANNELS" -> ["device/tag",...]
+//   "STAT"     -> thong ke dang text
+#include <signal.h>
+#include <sys/stat.h>
 #include <zmq.h>
 
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
 
-int main() {
-  void* context = zmq_ctx_new();
-  if (!context) {
-    std::cerr << "Failed to create ZMQ context\n";
-    return -1;
+#include "historian.h"
+#include "store_forward.h"
+#include "telemetry.h"
+#include "transport/zmq/endpoint_registry.h"
+
+using namespace std;
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int) { g_stop = 1; }
+
+// Bang endpoint (endpoint_registry.h); thieu file thi dung tcp 5555/5557/5558
+const char kProcessName[] = "logger";
+const char kEndpointsFile[] = "endpoints.json";
+
+void addDefaultEndpoints(transport::EndpointRegistry& endpoints) {
+  transport::EndpointRegistry::Service telemetry;
+  telemetry.host = "127.0.0.1";  // IP -> tcp, nhu dia chi cu
+  telemetry.port = 5555;
+  endpoints.add("telemetry", telemetry);
+  transport::EndpointRegistry::Service replay;
+  replay.process = kProcessName;
+  replay.port = 5557;
+  endpoints.add("logger_replay", replay);
+  transport::EndpointRegistry::Service query = replay;
+  query.port = 5558;
+  endpoints.add("logger_query", query);
+}
+
+// Bind REP theo ten dich vu, nullptr neu khong bind duoc dia chi nao
+void* bindService(const transport::EndpointRegistry& endpoints,
+                  const string& name) {
+  void* socket = zmq_socket(endpoints.rawContext(), ZMQ_REP);
+  if (!endpoints.bind(socket, name)) {
+    cerr << "[FATAL] Khong bind duoc dich vu " << name << endl;
+    zmq_close(socket);
+    return nullptr;
+  }
+  return socket;
+}
+
+// Nhan mot phan cua message nhieu phan, tra ve false neu loi
+bool recvPart(void* socket, vector<uint8_t>& part, bool* more) {
+  zmq_msg_t msg;
+  zmq_msg_init(&msg);
+  if (zmq_msg_recv(&msg, socket, 0) < 0) {
+    zmq_msg_close(&msg);
+    return false;
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(zmq_msg_data(&msg));
+  part.assign(data, data + zmq_msg_size(&msg));
+  *more = zmq_msg_more(&msg) != 0;
+  zmq_msg_close(&msg);
+  return true;
+}
+
+void sendText(void* socket, const string& text, int flags) {
+  zmq_send(socket, text.data(), text.size(), flags);
+}
+
+// Xu ly mot request replay va gui reply
+void handleReplay(void* socket, StoreForward& store, const string& request) {
+  unsigned long long cursor = 0;
+  unsigned int max_records = 0;
+
+  if (sscanf(request.c_str(), "READ %llu %u", &cursor, &max_records) == 2) {
+    if (max_records == 0 || max_records > 1000) max_records = 1000;
+    vector<StoreForward::Record> records;
+    uint64_t next = cursor;
+    store.read(cursor, max_records, &records, &next);
+
+    sendText(socket, to_string(next), records.empty() ? 0 : ZMQ_SNDMORE);
+    for (size_t i = 0; i < records.size(); ++i) {
+      const bool last = i + 1 == records.size();
+      sendText(socket, records[i].topic, ZMQ_SNDMORE);
+      zmq_send(socket, records[i].payload.data(), records[i].payload.size(),
+               last ? 0 : ZMQ_SNDMORE);
+    }
+    return;
+  }
+
+  if (sscanf(request.c_str(), "ACK %llu", &cursor) == 1) {
+    sendText(socket, store.ack(cursor) ? "OK" : "ERR", 0);
+    return;
+  }
+
+  if (request == "STAT") {
+    const StoreForward::Stats stats = store.stats();
+    sendText(socket,
+             "enqueued=" + to_string(stats.enqueued) +
+                 " dropped=" + to_string(stats.dropped) +
+                 " commits=" + to_string(stats.commits) +
+                 " lost_bytes=" + to_string(stats.lost_bytes) +
+                 " durable=" + to_string(stats.durable_offset) +
+                 " acked=" + to_string(stats.acked_offset) +
+                 " disk_bytes=" + to_string(stats.disk_bytes),
+             0);
+    return;
+  }
+
+  sendText(socket, "ERR", 0);
+}
+
+// Xu ly mot request historian va gui reply JSON
+void handleQuery(void* socket, Historian& historian, const string& request) {
+  char name[256];
+  long long from_ms = 0;
+  long long to_ms = 0;
+  unsigned int max_points = 0;
+
+  const int fields = sscanf(request.c_str(), "QUERY %255s %lld %lld %u", name,
+                            &from_ms, &to_ms, &max_points);
+  if (fields >= 3) {
+    if (fields < 4 || max_points == 0 || max_points > 100000) {
+      max_points = 100000;
+    }
+    vector<Historian::Point> points;
+    if (!historian.query(name, from_ms, to_ms, max_points, &points)) {
+      sendText(socket, "{\"error\":\"unknown channel\"}", 0);
+      return;
+    }
+
+    string json = "{\"channel\":\"" + string(name) + "\",\"points\":[";
+    json.reserve(json.size() + points.size() * 24);
+    char item[64];
+    for (size_t i = 0; i < points.size(); ++i) {
+      snprintf(item, sizeof(item), "%s[%lld,%.10g]", i == 0 ? "" : ",",
+               static_cast<long long>(points[i].time_ms), points[i].value);
+      json += item;
+    }
+    json += "]}";
+    sendText(socket, json, 0);
+    return;
   }
 
-  void* publisher = zmq_socket(context, ZMQ_PUB);
-  if (!publisher) {
-    std::cerr << "Failed to create ZMQ socket\n";
-    zmq_ctx_term(context);
-    return -1;
+  if (request == "CHANNELS") {
+    string json = "[";
+    const vector<string> names = historian.channels();
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (i > 0) json += ",";
+      json += "\"" + names[i] + "\"";
+    }
+    json += "]";
+    sendText(socket, json, 0);
+    return;
   }
 
-  // Bind to a TCP port
-  int rc = zmq_bind(publisher, "tcp://*:5555");
-  if (rc != 0) {
-    std::cerr << "Failed to bind socket: " << zmq_strerror(errno) << "\n";
-    zmq_close(publisher);
-    zmq_ctx_term(context);
-    return -1;
+  if (request == "STAT") {
+    const Historian::Stats stats = historian.stats();
+    sendText(socket,
+             "points=" + to_string(stats.points) +
+                 " rejected=" + to_string(stats.rejected) +
+                 " chunks=" + to_string(stats.chunks) +
+                 " disk_bytes=" + to_string(stats.disk_bytes),
+             0);
+    return;
   }
 
-  std::cout << "ZMQ Publisher started. Sending messages...\n";
+  sendText(socket, "{\"error\":\"bad request\"}", 0);
+}
 
-  while (1) {
-    const char* msg = "Hello RK3506 ZMQ!";
-    zmq_send(publisher, msg, strlen(msg), 0);
-    std::cout << "Sent: " << msg << std::endl;
-    sleep(1);
+/**
+ * @brief Giai ma frame telemetry va dua gia tri vao historian
+ *
+ * Id kenh cua moi schema duoc tra mot lan khi nhan schema, sau do moi frame
+ * chi con append theo chi so tag.
+ */
+class HistorianFeed {
+ public:
+  explicit HistorianFeed(Historian& historian) : historian_(historian) {}
+
+  void onMessage(const vector<uint8_t>& payload) {
+    const uint8_t kind = telemetry::frameKind(payload.data(), payload.size());
+    if (kind == telemetry::kKindSchema) {
+      telemetry::Schema schema;
+      if (!telemetry::decodeSchema(payload.data(), payload.size(), &schema) ||
+          channels_.count(schema.id)) {
+        return;
+      }
+      decoder_.addSchema(schema);
+      vector<int>& ids = channels_[schema.id];
+      for (const telemetry::TagInfo& tag : schema.tags) {
+        ids.push_back(historian_.channelId(schema.device_id + "/" + tag.name));
+      }
+      return;
+    }
+    if (kind != telemetry::kKindData) return;
+
+    if (decoder_.decode(payload.data(), payload.size(), &frame_) !=
+        telemetry::Decoder::kOk) {
+      return;
+    }
+    const vector<int>& ids = channels_[frame_.schema_id];
+    const int64_t time_ms = frame_.timestamp_us / 1000;
+    for (size_t i = 0; i < ids.size() && i < frame_.values.size(); ++i) {
+      if (frame_.good[i]) historian_.append(ids[i], time_ms, frame_.values[i]);
+    }
   }
 
-  zmq_close(publisher);
-  zmq_ctx_term(context);
+ private:
+  Historian& historian_;
+  telemetry::Decoder decoder_;
+  telemetry::Frame frame_;
+  map<uint32_t, vector<int> > channels_;  // schema_id -> id kenh theo tag
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  transport::EndpointRegistry endpoints(kProcessName);
+  if (!endpoints.loadFromJson(kEndpointsFile)) {
+    addDefaultEndpoints(endpoints);
+    cerr << "[WARN] Khong doc duoc " << kEndpointsFile
+         << ", dung endpoint mac dinh" << endl;
+  }
+  const string source =
+      argc > 1 ? argv[1] : endpoints.connectEndpoint("telemetry");
+  const string data_dir = argc > 2 ? argv[2] : "/userdata/logger";
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  mkdir(data_dir.c_str(), 0755);
+
+  StoreForward::Options options;
+  options.log.dir = data_dir + "/queue";
+  StoreForward store(options);
+  if (!store.start()) return 1;
+
+  Historian::Options history_options;
+  history_options.dir = data_dir + "/history";
+  Historian historian(history_options);
+  if (!historian.open()) return 1;
+  HistorianFeed feed(historian);
+
+  void* subscriber = zmq_socket(endpoints.rawContext(), ZMQ_SUB);
+  // Khong de ZMQ tu bo message khi logger ghi cham: bo dem cua SUB lon hon
+  // mot lo commit
+  int hwm = 100000;
+  zmq_setsockopt(subscriber, ZMQ_RCVHWM, &hwm, sizeof(hwm));
+  zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "telemetry/", 10);
+  if (zmq_connect(subscriber, source.c_str()) != 0) {
+    cerr << "[FATAL] Khong ket noi duoc " << source << endl;
+    zmq_close(subscriber);  // socket mo chan huy context cua endpoints
+    return 1;
+  }
+
+  void* replay = bindService(endpoints, "logger_replay");
+  void* query = replay ? bindService(endpoints, "logger_query") : nullptr;
+  if (query == nullptr) {
+    if (replay) zmq_close(replay);
+    zmq_close(subscriber);
+    return 1;
+  }
+  cout << "[INFO] Logger: nghe " << source << endl;
+  const char* services[] = {"logger_replay", "logger_query"};
+  for (const char* service : services) {
+    for (const string& endpoint : endpoints.bindEndpoints(service)) {
+      cout << "[INFO] " << service << " tai " << endpoint << endl;
+    }
+  }
+
+  vector<uint8_t> topic;
+  vector<uint8_t> payload;
+  vector<uint8_t> request;
+  chrono::steady_clock::time_point last_flush = chrono::steady_clock::now();
+
+  while (!g_stop) {
+    zmq_pollitem_t items[] = {{subscriber, 0, ZMQ_POLLIN, 0},
+                              {replay, 0, ZMQ_POLLIN, 0},
+                              {query, 0, ZMQ_POLLIN, 0}};
+    if (zmq_poll(items, 3, 500) < 0) continue;  // EINTR khi co tin hieu
+
+    // Uu tien rut het SUB truoc: enqueue chi copy vao RAM nen rat nhanh
+    if (items[0].revents & ZMQ_POLLIN) {
+      bool more = false;
+      while (recvPart(subscriber, topic, &more)) {
+        if (more && recvPart(subscriber, payload, &more) && !more) {
+          store.enqueue(string(topic.begin(), topic.end()), payload.data(),
+                        payload.size());
+          feed.onMessage(payload);
+        }
+        while (more) recvPart(subscriber, payload, &more);  // bo phan thua
+
+        int events = 0;
+        size_t events_size = sizeof(events);
+        zmq_getsockopt(subscriber, ZMQ_EVENTS, &events, &events_size);
+        if (!(events & ZMQ_POLLIN)) break;
+      }
+    }
+
+    if (items[1].revents & ZMQ_POLLIN) {
+      bool more = false;
+      if (recvPart(replay, request, &more)) {
+        while (more) recvPart(replay, payload, &more);
+        handleReplay(replay, store, string(request.begin(), request.end()));
+      }
+    }
+
+    if (items[2].revents & ZMQ_POLLIN) {
+      bool more = false;
+      if (recvPart(query, request, &more)) {
+        while (more) recvPart(query, payload, &more);
+        handleQuery(query, historian, string(request.begin(), request.end()));
+      }
+    }
+
+    // Chunk historian da dong duoc fdatasync gom moi giay
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (now - last_flush >= chrono::seconds(1)) {
+      historian.flush();
+      last_flush = now;
+    }
+  }
 
+  cout << "[INFO] Logger dung, ghi not bo dem xuong flash" << endl;
+  store.stop();
+  historian.close();
+  zmq_close(subscriber);
+  zmq_close(replay);
+  zmq_close(query);
   return 0;
 }
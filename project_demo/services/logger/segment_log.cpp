@@ -0,0 +1,359 @@
+#include "segment_log.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const std::size_t kRecordHeader = 8;
+// Record lon hon gioi han nay coi nhu du lieu hong
+const std::uint32_t kMaxRecordSize = 16 * 1024 * 1024;
+
+void putU32(std::uint8_t* out, std::uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+std::uint32_t getU32(const std::uint8_t* in) {
+  return static_cast<std::uint32_t>(in[0]) |
+         (static_cast<std::uint32_t>(in[1]) << 8) |
+         (static_cast<std::uint32_t>(in[2]) << 16) |
+         (static_cast<std::uint32_t>(in[3]) << 24);
+}
+
+bool writeAll(int fd, const std::uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t rc = ::write(fd, data, size);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += rc;
+    size -= static_cast<std::size_t>(rc);
+  }
+  return true;
+}
+
+bool readAt(int fd, std::uint8_t* data, std::size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t rc = ::pread(fd, data, size, offset);
+    if (rc < 0 && errno == EINTR) continue;
+    if (rc <= 0) return false;
+    data += rc;
+    size -= static_cast<std::size_t>(rc);
+    offset += rc;
+  }
+  return true;
+}
+
+struct CrcTable {
+  std::uint32_t entry[256];
+};
+
+CrcTable buildCrcTable() {
+  CrcTable table;
+  for (std::uint32_t i = 0; i < 256; ++i) {
+    std::uint32_t c = i;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    table.entry[i] = c;
+  }
+  return table;
+}
+
+}  // namespace
+
+bool syncDirectory(const std::string& dir) {
+  const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  const bool ok = fd >= 0 && ::fsync(fd) == 0;
+  if (!ok) {
+    std::cerr << "[FAIL] Khong fsync duoc thu muc " << dir << ": "
+              << std::strerror(errno) << std::endl;
+  }
+  if (fd >= 0) ::close(fd);
+  return ok;
+}
+
+std::uint32_t recordCrc32(const std::uint8_t* data, std::size_t size) {
+  // Static cuc bo khoi tao mot lan, an toan giua thread ghi va thread doc
+  static const CrcTable table = buildCrcTable();
+
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (std::size_t i = 0; i < size; ++i) {
+    crc = table.entry[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+SegmentLog::SegmentLog(const Options& options) : options_(options) {}
+
+SegmentLog::~SegmentLog() { close(); }
+
+std::string SegmentLog::pathOf(std::uint64_t base) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%020llu.seg",
+                static_cast<unsigned long long>(base));
+  return options_.dir + "/" + name;
+}
+
+/**
+ * @brief Mở log: quét thư mục, khôi phục segment cuối và mở nó để ghi tiếp
+ * @return false nếu không tạo/đọc được thư mục
+ */
+bool SegmentLog::open() {
+  recordCrc32(nullptr, 0);  // tao bang crc truoc khi co thread doc
+  ::mkdir(options_.dir.c_str(), 0755);
+
+  DIR* dir = ::opendir(options_.dir.c_str());
+  if (dir == nullptr) {
+    std::cerr << "[FAIL] Khong mo duoc thu muc log " << options_.dir << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  segments_.clear();
+  while (struct dirent* entry = ::readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name.size() != 24 || name.compare(20, 4, ".seg") != 0) continue;
+
+    Segment segment;
+    segment.base = std::strtoull(name.substr(0, 20).c_str(), nullptr, 10);
+    struct stat st;
+    if (::stat(pathOf(segment.base).c_str(), &st) != 0) continue;
+    segment.size = static_cast<std::uint64_t>(st.st_size);
+    segments_[segment.base] = segment;
+  }
+  ::closedir(dir);
+
+  if (segments_.empty()) return openActive(0, 0);
+
+  // Chi segment cuoi co the bi ghi do
+  Segment& last = segments_.rbegin()->second;
+  last.size = recover(pathOf(last.base));
+  return openActive(last.base, last.size);
+}
+
+/**
+ * @brief Kiểm tra crc từng record của segment, cắt bỏ phần cuối hỏng
+ * @return Kích thước hợp lệ của segment
+ */
+std::uint64_t SegmentLog::recover(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDWR);
+  if (fd < 0) return 0;
+
+  std::uint64_t valid = 0;
+  std::vector<std::uint8_t> data;
+  std::uint8_t header[kRecordHeader];
+  while (readAt(fd, header, kRecordHeader, static_cast<off_t>(valid))) {
+    const std::uint32_t size = getU32(header);
+    if (size > kMaxRecordSize) break;
+    data.resize(size);
+    if (!readAt(fd, data.data(), size,
+                static_cast<off_t>(valid + kRecordHeader)) ||
+        recordCrc32(data.data(), size) != getU32(header + 4)) {
+      break;
+    }
+    valid += kRecordHeader + size;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && static_cast<std::uint64_t>(st.st_size) > valid) {
+    std::cerr << "[WARN] Cat " << (st.st_size - valid)
+              << " byte hong o cuoi " << path << std::endl;
+    if (::ftruncate(fd, static_cast<off_t>(valid)) != 0) {
+      std::cerr << "[WARN] ftruncate that bai: " << std::strerror(errno)
+                << std::endl;
+    }
+  }
+  ::close(fd);
+  return valid;
+}
+
+bool SegmentLog::openActive(std::uint64_t base, std::uint64_t size) {
+  if (active_fd_ >= 0) ::close(active_fd_);
+
+  active_fd_ =
+      ::open(pathOf(base).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (active_fd_ < 0) {
+    std::cerr << "[FAIL] Khong mo duoc segment " << pathOf(base) << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+  // Segment moi: entry trong thu muc phai ben truoc khi record trong no
+  // duoc tinh la ben vung
+  if (size == 0 && !syncDirectory(options_.dir)) {
+    ::close(active_fd_);
+    active_fd_ = -1;
+    return false;
+  }
+
+  active_base_ = base;
+  end_offset_ = base + size;
+  Segment& segment = segments_[base];
+  segment.base = base;
+  segment.size = size;
+  return true;
+}
+
+void SegmentLog::close() {
+  if (active_fd_ >= 0) {
+    ::fdatasync(active_fd_);
+    ::close(active_fd_);
+    active_fd_ = -1;
+  }
+}
+
+bool SegmentLog::append(const std::uint8_t* data, std::size_t size,
+                        std::uint64_t* offset) {
+  if (active_fd_ < 0 || size > kMaxRecordSize) return false;
+
+  // Segment day: fsync roi mo segment moi bat dau tu end_offset_
+  if (end_offset_ > active_base_ &&
+      end_offset_ - active_base_ + kRecordHeader + size >
+          options_.segment_bytes) {
+    if (!sync()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!openActive(end_offset_, 0)) return false;
+  }
+
+  std::uint8_t header[kRecordHeader];
+  putU32(header, static_cast<std::uint32_t>(size));
+  putU32(header + 4, recordCrc32(data, size));
+  if (!writeAll(active_fd_, header, kRecordHeader) ||
+      !writeAll(active_fd_, data, size)) {
+    std::cerr << "[FAIL] Ghi log that bai: " << std::strerror(errno)
+              << std::endl;
+    // Cat phan da ghi do (VD ENOSPC giua chung) de record sau nam dung
+    // end_offset_ va recover() khong gap CRC sai
+    if (::ftruncate(active_fd_, end_offset_ - active_base_) != 0) {
+      std::cerr << "[FAIL] Khong cat duoc record ghi do: "
+                << std::strerror(errno) << std::endl;
+    }
+    return false;
+  }
+
+  if (offset != nullptr) *offset = end_offset_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  end_offset_ += kRecordHeader + size;
+  segments_[active_base_].size = end_offset_ - active_base_;
+  return true;
+}
+
+bool SegmentLog::sync() {
+  if (active_fd_ < 0) return false;
+  return ::fdatasync(active_fd_) == 0;
+}
+
+std::size_t SegmentLog::read(std::uint64_t cursor, std::size_t max_records,
+                             std::uint64_t limit,
+                             std::vector<std::vector<std::uint8_t> >* records,
+                             std::uint64_t* next) {
+  records->clear();
+  *next = cursor;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (segments_.empty()) return 0;
+  if (cursor < segments_.begin()->first) cursor = segments_.begin()->first;
+  if (limit > end_offset_) limit = end_offset_;
+
+  while (records->size() < max_records && cursor < limit) {
+    // Segment chua cursor: base lon nhat <= cursor
+    std::map<std::uint64_t, Segment>::iterator it =
+        segments_.upper_bound(cursor);
+    if (it == segments_.begin()) break;
+    --it;
+    const Segment segment = it->second;
+    if (cursor >= segment.base + segment.size) {
+      // Cuoi segment: sang segment ke tiep
+      std::map<std::uint64_t, Segment>::iterator following = std::next(it);
+      if (following == segments_.end()) break;
+      cursor = following->first;
+      continue;
+    }
+
+    lock.unlock();
+    int fd = ::open(pathOf(segment.base).c_str(), O_RDONLY);
+    bool ok = fd >= 0;
+    while (ok && records->size() < max_records && cursor < limit &&
+           cursor < segment.base + segment.size) {
+      std::uint8_t header[kRecordHeader];
+      const off_t position = static_cast<off_t>(cursor - segment.base);
+      ok = readAt(fd, header, kRecordHeader, position);
+      if (!ok) break;
+      const std::uint32_t size = getU32(header);
+      std::vector<std::uint8_t> data(size);
+      ok = size <= kMaxRecordSize &&
+           readAt(fd, data.data(), size, position + kRecordHeader) &&
+           recordCrc32(data.data(), size) == getU32(header + 4);
+      if (!ok) break;
+      records->push_back(std::move(data));
+      cursor += kRecordHeader + size;
+    }
+    if (fd >= 0) ::close(fd);
+    lock.lock();
+    if (!ok) {
+      // Segment bi xoa (quota) hoac hong trong luc doc
+      std::cerr << "[WARN] Doc log loi tai offset " << cursor << std::endl;
+      break;
+    }
+  }
+
+  *next = cursor;
+  return records->size();
+}
+
+std::uint64_t SegmentLog::enforceQuota(std::uint64_t keep_from) {
+  std::uint64_t dropped_unacked = 0;
+  std::vector<std::uint64_t> victims;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint64_t total = 0;
+    for (const auto& pair : segments_) total += pair.second.size;
+
+    for (std::map<std::uint64_t, Segment>::iterator it = segments_.begin();
+         it != segments_.end() && total > options_.quota_bytes;) {
+      if (it->first == active_base_) break;
+      const Segment& segment = it->second;
+      const std::uint64_t end = segment.base + segment.size;
+      if (end > keep_from) {
+        dropped_unacked += end - std::max(keep_from, segment.base);
+      }
+      total -= segment.size;
+      victims.push_back(segment.base);
+      it = segments_.erase(it);
+    }
+  }
+
+  for (std::uint64_t base : victims) ::unlink(pathOf(base).c_str());
+  return dropped_unacked;
+}
+
+std::uint64_t SegmentLog::beginOffset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.empty() ? end_offset_ : segments_.begin()->first;
+}
+
+std::uint64_t SegmentLog::endOffset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return end_offset_;
+}
+
+std::uint64_t SegmentLog::diskBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::uint64_t total = 0;
+  for (const auto& pair : segments_) total += pair.second.size;
+  return total;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Log append-only tren flash, chia thanh cac file segment
+ *
+ * Moi record: [len u32][crc32 u32][data], little-endian. Vi tri cua record la
+ * offset toan cuc (byte) tinh tu luc tao log; file segment dat ten theo
+ * offset cua record dau tien (vd 00000000000004194304.seg). Khi mo lai, cac
+ * record o cuoi segment moi nhat bi ghi do (mat dien giua chung) duoc phat
+ * hien bang crc va cat bo. Khi tong dung luong vuot quota, segment cu nhat bi
+ * xoa.
+ *
+ * append()/sync() chi goi tu mot thread ghi; read(), enforceQuota() va
+ * cac ham truy van co the goi tu thread khac.
+ */
+class SegmentLog {
+ public:
+  struct Options {
+    std::string dir;
+    std::size_t segment_bytes = 4 * 1024 * 1024;
+    std::uint64_t quota_bytes = 256ull * 1024 * 1024;
+  };
+
+  explicit SegmentLog(const Options& options);
+  ~SegmentLog();
+
+  SegmentLog(const SegmentLog&) = delete;
+  SegmentLog& operator=(const SegmentLog&) = delete;
+
+  // Quet cac segment co san, khoi phuc phan cuoi bi hong
+  bool open();
+  void close();
+
+  // Ghi them record (chua fsync), offset nhan vi tri cua record
+  bool append(const std::uint8_t* data, std::size_t size,
+              std::uint64_t* offset);
+  // fdatasync segment dang ghi: moi record da append tro thanh ben vung
+  bool sync();
+
+  // Doc toi da max_records record tu cursor, khong vuot qua limit (offset
+  // da fsync). next nhan cursor ke tiep. Cursor nam trong segment da bi xoa
+  // duoc chuyen toi record cu nhat con lai.
+  std::size_t read(std::uint64_t cursor, std::size_t max_records,
+                   std::uint64_t limit,
+                   std::vector<std::vector<std::uint8_t> >* records,
+                   std::uint64_t* next);
+
+  // Xoa segment cu de tong dung luong <= quota. Uu tien giu lai cac
+  // segment tu keep_from tro di; tra ve so byte chua ack bi xoa.
+  std::uint64_t enforceQuota(std::uint64_t keep_from);
+
+  std::uint64_t beginOffset() const;
+  std::uint64_t endOffset() const;
+  std::uint64_t diskBytes() const;
+
+ private:
+  struct Segment {
+    std::uint64_t base;
+    std::uint64_t size;
+  };
+
+  std::string pathOf(std::uint64_t base) const;
+  bool openActive(std::uint64_t base, std::uint64_t size);
+  std::uint64_t recover(const std::string& path);
+
+  Options options_;
+  mutable std::mutex mutex_;  // bao ve segments_ khi doc tu thread khac
+  std::map<std::uint64_t, Segment> segments_;
+  int active_fd_ = -1;
+  std::uint64_t active_base_ = 0;
+  std::uint64_t end_offset_ = 0;
+};
+
+// CRC-32 (IEEE 802.3) dung cho record cua log
+std::uint32_t recordCrc32(const std::uint8_t* data, std::size_t size);
+
+// fsync thu muc de file vua tao/doi ten trong do con sau khi mat dien
+// (fdatasync cua file khong ghi entry cua thu muc)
+bool syncDirectory(const std::string& dir);
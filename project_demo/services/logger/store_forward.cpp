@@ -0,0 +1,218 @@
+#include "store_forward.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+StoreForward::StoreForward(const Options& options)
+    : options_(options), log_(options.log) {
+  if (options_.cursor_file.empty()) {
+    options_.cursor_file = options_.log.dir + "/cursor";
+  }
+}
+
+StoreForward::~StoreForward() { stop(); }
+
+/**
+ * @brief Mở log trên flash, nạp cursor đã ack và chạy thread ghi
+ */
+bool StoreForward::start() {
+  if (!log_.open()) return false;
+  durable_ = log_.endOffset();
+  loadCursor();
+
+  std::cout << "[INFO] Store-and-forward: " << options_.log.dir << ", "
+            << log_.diskBytes() << " byte tren dia, cursor " << acked_.load()
+            << "/" << durable_.load() << std::endl;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_ = true;
+  writer_ = std::thread(&StoreForward::writerLoop, this);
+  return true;
+}
+
+/**
+ * @brief Dừng thread ghi; phần còn trong bộ đệm được ghi và fsync trước
+ */
+void StoreForward::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) return;
+    running_ = false;
+  }
+  cv_.notify_one();
+  if (writer_.joinable()) writer_.join();
+  log_.close();
+}
+
+/**
+ * @brief Đóng gói message vào bộ đệm RAM, không chạm tới đĩa
+ * @return false nếu bộ đệm đầy (thread ghi không theo kịp) hoặc topic quá dài
+ */
+bool StoreForward::enqueue(const std::string& topic,
+                           const std::uint8_t* payload, std::size_t size) {
+  if (topic.size() > 255) return false;
+  const std::size_t record_size = 1 + topic.size() + size;
+
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ ||
+        pending_.size() + record_size > options_.max_pending_bytes) {
+      ++dropped_;
+      return false;
+    }
+    pending_.push_back(static_cast<std::uint8_t>(topic.size()));
+    pending_.insert(pending_.end(), topic.begin(), topic.end());
+    pending_.insert(pending_.end(), payload, payload + size);
+    pending_sizes_.push_back(record_size);
+    // Chi danh thuc khi lo vua du lon, con lai de thread ghi tu tinh gio
+    wake = pending_.size() >= options_.commit_bytes &&
+           pending_.size() - record_size < options_.commit_bytes;
+  }
+  ++enqueued_;
+  if (wake) cv_.notify_one();
+  return true;
+}
+
+/**
+ * @brief Vòng lặp ghi: gom bộ đệm thành lô, append và fdatasync một lần
+ *
+ * Bộ đệm được hoán đổi (swap) với lô cục bộ nên thread nhận chỉ bị chặn trong
+ * lúc swap, không phải trong lúc ghi/fsync.
+ */
+void StoreForward::writerLoop() {
+  std::vector<std::uint8_t> batch;
+  std::vector<std::size_t> sizes;
+  const std::chrono::milliseconds interval(options_.commit_interval_ms);
+
+  bool running = true;
+  while (running) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, interval, [this] {
+        return !running_ || pending_.size() >= options_.commit_bytes;
+      });
+      batch.swap(pending_);
+      sizes.swap(pending_sizes_);
+      running = running_;
+    }
+    if (sizes.empty()) continue;
+
+    const std::uint8_t* cursor = batch.data();
+    std::uint64_t failed = 0;
+    for (std::size_t size : sizes) {
+      if (!log_.append(cursor, size, nullptr)) ++failed;
+      cursor += size;
+    }
+    // Record append loi khong bao gio toi consumer: tinh vao dropped
+    dropped_ += failed;
+    const bool synced = log_.sync();
+    if (failed > 0 || !synced) {
+      std::cerr << "[FAIL] Ghi lo " << sizes.size() << " message xuong flash"
+                << " khong tron ven, mat " << failed << " message"
+                << std::endl;
+    }
+    // Chi tinh la ben khi fdatasync thanh cong
+    if (synced) durable_ = log_.endOffset();
+    ++commits_;
+
+    const std::uint64_t lost = log_.enforceQuota(acked_.load());
+    if (lost > 0) {
+      lost_bytes_ += lost;
+      std::cerr << "[WARN] Vuot quota dia, xoa " << lost
+                << " byte chua duoc consumer ack" << std::endl;
+    }
+
+    batch.clear();
+    sizes.clear();
+  }
+}
+
+/**
+ * @brief Đọc lại message đã bền vững (đã fsync) bắt đầu từ cursor
+ * @param records Nhận danh sách topic/payload
+ * @param next Nhận cursor kế tiếp để gửi lại trong lần đọc sau
+ */
+std::size_t StoreForward::read(std::uint64_t cursor, std::size_t max_records,
+                               std::vector<Record>* records,
+                               std::uint64_t* next) {
+  records->clear();
+  std::vector<std::vector<std::uint8_t> > raw;
+  log_.read(cursor, max_records, durable_.load(), &raw, next);
+
+  for (const std::vector<std::uint8_t>& data : raw) {
+    if (data.empty() || 1u + data[0] > data.size()) continue;
+    Record record;
+    record.topic.assign(reinterpret_cast<const char*>(&data[1]), data[0]);
+    record.payload.assign(data.begin() + 1 + data[0], data.end());
+    records->push_back(std::move(record));
+  }
+  return records->size();
+}
+
+/**
+ * @brief Ghi nhận consumer đã xử lý xong mọi message trước cursor
+ * @return false nếu không lưu được cursor ra file
+ */
+bool StoreForward::ack(std::uint64_t cursor) {
+  std::lock_guard<std::mutex> lock(ack_mutex_);
+  if (cursor > durable_.load()) cursor = durable_.load();
+  if (cursor <= acked_.load()) return true;
+  if (!saveCursor(cursor)) return false;
+  acked_ = cursor;
+  return true;
+}
+
+StoreForward::Stats StoreForward::stats() const {
+  Stats stats;
+  stats.enqueued = enqueued_.load();
+  stats.dropped = dropped_.load();
+  stats.commits = commits_.load();
+  stats.lost_bytes = lost_bytes_.load();
+  stats.durable_offset = durable_.load();
+  stats.acked_offset = acked_.load();
+  stats.disk_bytes = log_.diskBytes();
+  return stats;
+}
+
+void StoreForward::loadCursor() {
+  std::FILE* file = std::fopen(options_.cursor_file.c_str(), "r");
+  if (file == nullptr) return;
+  unsigned long long value = 0;
+  if (std::fscanf(file, "%llu", &value) == 1) {
+    acked_ = value > durable_.load() ? durable_.load() : value;
+  }
+  std::fclose(file);
+}
+
+/**
+ * @brief Lưu cursor theo kiểu ghi file tạm + fsync + rename để không bao giờ
+ * còn lại file cursor ghi dở; fsync thư mục để rename không mất khi mất điện
+ */
+bool StoreForward::saveCursor(std::uint64_t cursor) {
+  const std::string tmp = options_.cursor_file + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  char text[32];
+  const int length = std::snprintf(text, sizeof(text), "%llu\n",
+                                   static_cast<unsigned long long>(cursor));
+  const bool ok = ::write(fd, text, length) == length && ::fdatasync(fd) == 0;
+  ::close(fd);
+  if (!ok || std::rename(tmp.c_str(), options_.cursor_file.c_str()) != 0) {
+    std::cerr << "[WARN] Khong luu duoc cursor: " << std::strerror(errno)
+              << std::endl;
+    return false;
+  }
+  const std::string::size_type slash = options_.cursor_file.rfind('/');
+  return syncDirectory(slash == std::string::npos
+                           ? std::string(".")
+                           : options_.cursor_file.substr(0, slash + 1));
+}
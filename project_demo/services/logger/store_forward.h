@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "segment_log.h"
+
+/**
+ * @brief Hang doi store-and-forward: luu moi message nhan duoc xuong flash va
+ * cho consumer doc lai theo cursor khi ket noi lai
+ *
+ * enqueue() chi copy message vao bo dem trong RAM (khong I/O), thread ghi
+ * rieng gom cac message thanh mot lo, append vao SegmentLog va fdatasync mot
+ * lan cho ca lo (group commit). Consumer chi doc duoc phan da fsync; cursor
+ * da ack duoc luu ra file de sau khi khoi dong lai van tiep tuc dung cho.
+ */
+class StoreForward {
+ public:
+  struct Options {
+    SegmentLog::Options log;
+    std::string cursor_file;             // rong -> <dir>/cursor
+    int commit_interval_ms = 200;        // thoi gian toi da cho mot lo
+    std::size_t commit_bytes = 256 * 1024;  // lo du lon thi ghi ngay
+    std::size_t max_pending_bytes = 8 * 1024 * 1024;  // vuot -> bo message
+  };
+
+  // Message doc lai tu log
+  struct Record {
+    std::string topic;
+    std::vector<std::uint8_t> payload;
+  };
+
+  struct Stats {
+    std::uint64_t enqueued = 0;
+    std::uint64_t dropped = 0;          // bo dem RAM day hoac ghi flash loi
+    std::uint64_t commits = 0;          // so lan fdatasync
+    std::uint64_t lost_bytes = 0;       // du lieu chua ack bi xoa do quota
+    std::uint64_t durable_offset = 0;
+    std::uint64_t acked_offset = 0;
+    std::uint64_t disk_bytes = 0;
+  };
+
+  explicit StoreForward(const Options& options);
+  ~StoreForward();
+
+  StoreForward(const StoreForward&) = delete;
+  StoreForward& operator=(const StoreForward&) = delete;
+
+  bool start();
+  void stop();
+
+  // Goi tu thread nhan; false neu bo dem day (message bi bo)
+  bool enqueue(const std::string& topic, const std::uint8_t* payload,
+               std::size_t size);
+
+  // Doc toi da max_records message da ben vung tu cursor
+  std::size_t read(std::uint64_t cursor, std::size_t max_records,
+                   std::vector<Record>* records, std::uint64_t* next);
+
+  // Consumer da xu ly xong moi message truoc cursor
+  bool ack(std::uint64_t cursor);
+  std::uint64_t ackedCursor() const { return acked_.load(); }
+
+  Stats stats() const;
+
+ private:
+  void writerLoop();
+  void loadCursor();
+  bool saveCursor(std::uint64_t cursor);
+
+  Options options_;
+  SegmentLog log_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::uint8_t> pending_;  // cac record da dong goi, noi lien
+  std::vector<std::size_t> pending_sizes_;
+  bool running_ = false;
+  std::thread writer_;
+
+  std::mutex ack_mutex_;
+  std::atomic<std::uint64_t> durable_{0};
+  std::atomic<std::uint64_t> acked_{0};
+  std::atomic<std::uint64_t> enqueued_{0};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::atomic<std::uint64_t> commits_{0};
+  std::atomic<std::uint64_t> lost_bytes_{0};
+};
@@ -0,0 +1,654 @@
+#include "gateway.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+// Chu ky kiem tra co dung khi khong co su kien
+const int kStopCheckMs = 200;
+// Do dai header MBAP (transaction, protocol, length, unit)
+const int kMbapLength = 7;
+
+bool isException(int error) {
+  return error > MODBUS_ENOBASE &&
+         error < MODBUS_ENOBASE + MODBUS_EXCEPTION_MAX;
+}
+
+// Chi cac function doc moi giu duoc cache cua unit
+bool isRead(std::uint8_t function) {
+  return function == MODBUS_FC_READ_COILS ||
+         function == MODBUS_FC_READ_DISCRETE_INPUTS ||
+         function == MODBUS_FC_READ_HOLDING_REGISTERS ||
+         function == MODBUS_FC_READ_INPUT_REGISTERS;
+}
+
+bool sameRange(const GatewayRequest& a, const GatewayRequest& b) {
+  return a.address == b.address && a.quantity == b.quantity;
+}
+
+}  // namespace
+
+/* ================== READ CACHE ================== */
+bool ReadCache::lookup(std::uint8_t unit, std::uint8_t function,
+                       std::uint16_t address, std::uint16_t quantity,
+                       Clock::time_point now, std::uint16_t* dest) const {
+  if (!enabled()) return false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::uint32_t, std::vector<Entry> >::const_iterator it =
+      entries_.find(key(unit, function));
+  if (it == entries_.end()) return false;
+
+  // Lan doc moi nhat duoc them sau cung
+  for (auto entry = it->second.rbegin(); entry != it->second.rend(); ++entry) {
+    if (now - entry->at >= ttl_) continue;
+    if (address < entry->address ||
+        address + quantity > entry->address + entry->values.size()) {
+      continue;
+    }
+    std::copy(entry->values.begin() + (address - entry->address),
+              entry->values.begin() + (address - entry->address) + quantity,
+              dest);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Thêm một lần đọc, bỏ các lần đọc hết hạn hoặc nằm trọn trong nó
+ */
+void ReadCache::insert(std::uint8_t unit, std::uint8_t function,
+                       std::uint16_t address, const std::uint16_t* values,
+                       int quantity, Clock::time_point now) {
+  if (!enabled()) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Entry>& entries = entries_[key(unit, function)];
+  const int end = address + quantity;
+  entries.erase(
+      std::remove_if(entries.begin(), entries.end(),
+                     [&](const Entry& entry) {
+                       return now - entry.at >= ttl_ ||
+                              (entry.address >= address &&
+                               entry.address + static_cast<int>(
+                                                   entry.values.size()) <=
+                                   end);
+                     }),
+      entries.end());
+  if (entries.size() >= kMaxEntries) entries.erase(entries.begin());
+
+  Entry entry;
+  entry.address = address;
+  entry.values.assign(values, values + quantity);
+  entry.at = now;
+  entries.push_back(std::move(entry));
+}
+
+void ReadCache::invalidate(std::uint8_t unit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(entries_.lower_bound(key(unit, 0)),
+                 entries_.upper_bound(key(unit, 0xFF)));
+}
+
+/* ================== BUS PORT ================== */
+BusPort::BusPort(const BusConfig& config,
+                 std::shared_ptr<BusExecutor> executor, const Options& options,
+                 Completion done)
+    : config_(config),
+      executor_(executor),
+      options_(options),
+      done_(done),
+      cache_(std::chrono::milliseconds(options.cache_ttl_ms)),
+      requests_(0),
+      cache_hits_(0),
+      coalesced_(0),
+      transactions_(0),
+      errors_(0),
+      busy_(0) {}
+
+BusPort::~BusPort() {
+  if (executor_) executor_->stop();
+}
+
+BusPort::Stats BusPort::stats() const {
+  Stats stats;
+  stats.requests = requests_.load();
+  stats.cache_hits = cache_hits_.load();
+  stats.coalesced = coalesced_.load();
+  stats.transactions = transactions_.load();
+  stats.errors = errors_.load();
+  stats.busy = busy_.load();
+  return stats;
+}
+
+/**
+ * @brief Nhận request từ front-end: trả từ cache, hoặc xếp hàng chờ bus
+ *
+ * Request đầu tiên của một lô mở cửa sổ gom và đẩy một job drain() lên
+ * thread của bus; các request tới sau chỉ nối vào hàng đợi.
+ * @return false nếu hàng đợi đã đủ max_pending (request không bị lấy đi)
+ */
+bool BusPort::submit(GatewayRequest&& request) {
+  ++requests_;
+  if (request.coalescable() && cache_.enabled()) {
+    std::uint16_t values[MODBUS_MAX_READ_REGISTERS];
+    if (cache_.lookup(request.unit, request.function(), request.address,
+                      request.quantity, ReadCache::Clock::now(), values)) {
+      ++cache_hits_;
+      replyValues(request, values);
+      return true;
+    }
+  }
+
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() >= options_.max_pending) {
+      ++busy_;
+      return false;
+    }
+    pending_.push_back(std::move(request));
+    if (!scheduled_) {
+      scheduled_ = true;
+      window_end_ = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(options_.window_ms);
+      schedule = true;
+    }
+  }
+  if (!schedule) return true;
+
+  if (!executor_ ||
+      !executor_->post([this](modbus_t* ctx) { drain(ctx); })) {
+    std::vector<GatewayRequest> orphans;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      orphans.swap(pending_);
+      scheduled_ = false;
+    }
+    for (const GatewayRequest& orphan : orphans) {
+      replyException(orphan, MODBUS_EXCEPTION_GATEWAY_PATH);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Chạy trên thread của bus: chờ hết cửa sổ gom rồi xử lý từng lô
+ *
+ * Lô được tách tại các request không gom được (ghi, function khác) để giữ
+ * thứ tự giữa ghi và đọc. Lặp tới khi hàng đợi rỗng.
+ */
+void BusPort::drain(modbus_t* ctx) {
+  std::chrono::steady_clock::time_point window_end;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    window_end = window_end_;
+  }
+  std::this_thread::sleep_until(window_end);
+
+  std::vector<GatewayRequest> batch;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_.empty()) {
+        scheduled_ = false;
+        return;
+      }
+      batch.swap(pending_);
+    }
+
+    Iterator it = batch.begin();
+    while (it != batch.end()) {
+      if (!it->coalescable()) {
+        forward(ctx, *it);
+        ++it;
+        continue;
+      }
+      Iterator end = it;
+      while (end != batch.end() && end->coalescable()) ++end;
+      handleReads(ctx, it, end);
+      it = end;
+    }
+    batch.clear();
+  }
+}
+
+void BusPort::handleReads(modbus_t* ctx, Iterator first, Iterator last) {
+  // Lo truoc co the vua doc dung vung nay
+  std::vector<GatewayRequest*> reads;
+  const ReadCache::Clock::time_point now = ReadCache::Clock::now();
+  for (Iterator it = first; it != last; ++it) {
+    std::uint16_t values[MODBUS_MAX_READ_REGISTERS];
+    if (cache_.lookup(it->unit, it->function(), it->address, it->quantity,
+                      now, values)) {
+      ++cache_hits_;
+      replyValues(*it, values);
+    } else {
+      reads.push_back(&*it);
+    }
+  }
+
+  std::stable_sort(reads.begin(), reads.end(),
+                   [](const GatewayRequest* a, const GatewayRequest* b) {
+                     return std::make_tuple(a->unit, a->function(),
+                                            a->address, a->quantity) <
+                            std::make_tuple(b->unit, b->function(),
+                                            b->address, b->quantity);
+                   });
+
+  // Gop vung trung hoac ke nhau, mien la ca vung con doc duoc mot lan
+  std::vector<GatewayRequest*> span;
+  int span_end = 0;
+  for (GatewayRequest* request : reads) {
+    const int end = request->address + request->quantity;
+    if (!span.empty() && span.front()->unit == request->unit &&
+        span.front()->function() == request->function() &&
+        request->address <= span_end &&
+        std::max(span_end, end) - span.front()->address <=
+            MODBUS_MAX_READ_REGISTERS) {
+      span.push_back(request);
+      span_end = std::max(span_end, end);
+      continue;
+    }
+    if (!span.empty()) readSpan(ctx, span);
+    span.assign(1, request);
+    span_end = end;
+  }
+  if (!span.empty()) readSpan(ctx, span);
+}
+
+void BusPort::readSpan(modbus_t* ctx,
+                       const std::vector<GatewayRequest*>& members) {
+  const GatewayRequest& head = *members.front();
+  int end = 0;
+  bool distinct = false;
+  for (const GatewayRequest* member : members) {
+    end = std::max(end, member->address + member->quantity);
+    distinct = distinct || !sameRange(*member, head);
+  }
+  const int quantity = end - head.address;
+
+  std::uint16_t values[MODBUS_MAX_READ_REGISTERS];
+  modbus_set_slave(ctx, head.unit);
+  ++transactions_;
+  const int rc =
+      head.function() == MODBUS_FC_READ_HOLDING_REGISTERS
+          ? modbus_read_registers(ctx, head.address, quantity, values)
+          : modbus_read_input_registers(ctx, head.address, quantity, values);
+  const int error = errno;
+
+  if (rc == quantity) {
+    if (members.size() > 1) coalesced_ += members.size();
+    cache_.insert(head.unit, head.function(), head.address, values, quantity,
+                  ReadCache::Clock::now());
+    for (const GatewayRequest* member : members) {
+      replyValues(*member, values + (member->address - head.address));
+    }
+    return;
+  }
+
+  // Vung gop co the trum thanh ghi slave khong co: doc lai tung vung rieng
+  if (distinct && isException(error)) {
+    std::vector<GatewayRequest*> group;
+    for (GatewayRequest* member : members) {
+      if (!group.empty() && !sameRange(*member, *group.front())) {
+        readSpan(ctx, group);
+        group.clear();
+      }
+      group.push_back(member);
+    }
+    readSpan(ctx, group);
+    return;
+  }
+
+  ++errors_;
+  if (!isException(error)) modbus_flush(ctx);
+  const int code = isException(error) ? error - MODBUS_ENOBASE
+                                      : MODBUS_EXCEPTION_GATEWAY_TARGET;
+  for (const GatewayRequest* member : members) replyException(*member, code);
+}
+
+/**
+ * @brief Chuyển nguyên văn một request không gom được và trả lại PDU của slave
+ */
+void BusPort::forward(modbus_t* ctx, const GatewayRequest& request) {
+  std::uint8_t raw[MODBUS_MAX_PDU_LENGTH + 1];
+  raw[0] = request.unit;
+  std::memcpy(raw + 1, request.pdu.data(), request.pdu.size());
+
+  modbus_set_slave(ctx, request.unit);
+  ++transactions_;
+  std::uint8_t rsp[MODBUS_MAX_ADU_LENGTH];
+  int rc = modbus_send_raw_request(ctx, raw,
+                                   static_cast<int>(request.pdu.size()) + 1);
+  if (rc != -1) rc = modbus_receive_confirmation(ctx, rsp);
+  // Ghi (hoac function khong ro) co the doi gia tri da cache cua unit
+  if (!isRead(request.function())) cache_.invalidate(request.unit);
+
+  const int header = modbus_get_header_length(ctx);
+  const int checksum = config_.type == BusConfig::Type::kRtu ? 2 : 0;
+  if (rc < header + checksum + 1) {
+    ++errors_;
+    modbus_flush(ctx);
+    replyException(request, MODBUS_EXCEPTION_GATEWAY_TARGET);
+    return;
+  }
+  reply(request, std::vector<std::uint8_t>(rsp + header, rsp + rc - checksum));
+}
+
+void BusPort::reply(const GatewayRequest& request,
+                    std::vector<std::uint8_t>&& pdu) {
+  GatewayResponse response;
+  response.client = request.client;
+  response.transaction = request.transaction;
+  response.unit = request.unit;
+  response.pdu = std::move(pdu);
+  done_(std::move(response));
+}
+
+void BusPort::replyValues(const GatewayRequest& request,
+                          const std::uint16_t* values) {
+  std::vector<std::uint8_t> pdu;
+  pdu.reserve(2 + request.quantity * 2);
+  pdu.push_back(request.function());
+  pdu.push_back(static_cast<std::uint8_t>(request.quantity * 2));
+  for (int i = 0; i < request.quantity; ++i) {
+    pdu.push_back(static_cast<std::uint8_t>(values[i] >> 8));
+    pdu.push_back(static_cast<std::uint8_t>(values[i] & 0xFF));
+  }
+  reply(request, std::move(pdu));
+}
+
+void BusPort::replyException(const GatewayRequest& request, int code) {
+  std::vector<std::uint8_t> pdu(2);
+  pdu[0] = static_cast<std::uint8_t>(request.function() | 0x80);
+  pdu[1] = static_cast<std::uint8_t>(code);
+  reply(request, std::move(pdu));
+}
+
+/* ================== GATEWAY SERVER ================== */
+GatewayServer::GatewayServer(const Options& options)
+    : options_(options),
+      ctx_(modbus_new_tcp(options.host.c_str(), options.port)),
+      server_fd_(-1),
+      event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  std::fill(routes_, routes_ + 256, nullptr);
+}
+
+GatewayServer::~GatewayServer() {
+  for (const Client& client : clients_) close(client.fd);
+  if (server_fd_ != -1) close(server_fd_);
+  if (event_fd_ != -1) close(event_fd_);
+  // Socket cua ctx la client accept cuoi cung: da dong o tren
+  if (ctx_ != nullptr) modbus_free(ctx_);
+}
+
+bool GatewayServer::addRoute(const std::vector<int>& units, BusPort* port) {
+  for (int unit : units) {
+    if (unit < 1 || unit > 255 || routes_[unit] != nullptr) {
+      std::cerr << "ERROR: Unit " << unit << " khong hop le hoac da co tuyen"
+                << std::endl;
+      return false;
+    }
+    routes_[unit] = port;
+  }
+  return true;
+}
+
+bool GatewayServer::open() {
+  if (ctx_ == nullptr || event_fd_ == -1) {
+    std::cerr << "[FAIL] Khong tao duoc context/eventfd cho gateway"
+              << std::endl;
+    return false;
+  }
+  server_fd_ = modbus_tcp_listen(ctx_, options_.max_clients);
+  if (server_fd_ == -1) {
+    std::cerr << "[FAIL] Khong listen duoc " << options_.host << ":"
+              << options_.port << ": " << modbus_strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void GatewayServer::run(const std::atomic<bool>& stop) {
+  std::vector<pollfd> fds;
+  while (!stop.load()) {
+    fds.clear();
+    fds.push_back(pollfd{server_fd_, POLLIN, 0});
+    fds.push_back(pollfd{event_fd_, POLLIN, 0});
+    for (const Client& client : clients_) {
+      const short events = client.tx_offset < client.tx.size()
+                               ? static_cast<short>(POLLIN | POLLOUT)
+                               : static_cast<short>(POLLIN);
+      fds.push_back(pollfd{client.fd, events, 0});
+    }
+
+    const int rc = poll(fds.data(), fds.size(), kStopCheckMs);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "[FAIL] poll: " << std::strerror(errno) << std::endl;
+      return;
+    }
+    if (rc == 0) continue;
+
+    for (std::size_t i = 0; i < clients_.size(); ++i) {
+      Client& client = clients_[i];
+      const short revents = fds[i + 2].revents;
+      if ((revents & POLLOUT) && !flush(client)) client.broken = true;
+      if (!client.broken && (revents & (POLLIN | POLLHUP | POLLERR)) &&
+          !receive(client)) {
+        client.broken = true;
+      }
+    }
+    if (fds[1].revents & POLLIN) {
+      std::uint64_t count;
+      if (read(event_fd_, &count, sizeof(count)) > 0) deliver();
+    }
+    // Duyet nguoc de xoa client khong lam lech chi so cac client con lai
+    for (std::size_t i = clients_.size(); i-- > 0;) {
+      if (clients_[i].broken) closeClient(i);
+    }
+    if (fds[0].revents & POLLIN) acceptClient();
+  }
+}
+
+void GatewayServer::complete(GatewayResponse&& response) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_.push_back(std::move(response));
+  }
+  const std::uint64_t one = 1;
+  if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    std::cerr << "[WARN] Khong danh thuc duoc gateway" << std::endl;
+  }
+}
+
+void GatewayServer::acceptClient() {
+  const int fd = modbus_tcp_accept(ctx_, &server_fd_);
+  if (fd == -1) return;
+  if (static_cast<int>(clients_.size()) >= options_.max_clients) {
+    std::cerr << "[WARN] Gateway da du " << options_.max_clients
+              << " client, tu choi ket noi moi" << std::endl;
+    close(fd);
+    return;
+  }
+  const int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    std::cerr << "[WARN] Khong dat duoc socket client khong chan: "
+              << std::strerror(errno) << std::endl;
+    close(fd);
+    return;
+  }
+  // Moi request mot tra loi nho, Nagle se giu cac tra loi sau lai
+  const int enable = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+  Client client;
+  client.fd = fd;
+  client.id = next_client_++;
+  client.tx_offset = 0;
+  client.broken = false;
+  clients_.push_back(client);
+}
+
+/**
+ * @brief Đọc hết dữ liệu sẵn có của client và xử lý các frame MBAP đủ
+ * @return false nếu client đã đóng kết nối hoặc gửi frame hỏng
+ *
+ * Phần cuối chưa đủ một frame được giữ lại tới lần poll sau.
+ */
+bool GatewayServer::receive(Client& client) {
+  std::uint8_t buffer[4096];
+  for (;;) {
+    const ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) return false;
+    client.rx.insert(client.rx.end(), buffer, buffer + n);
+    if (static_cast<std::size_t>(n) < sizeof(buffer)) break;
+  }
+
+  std::size_t offset = 0;
+  while (client.rx.size() - offset >= static_cast<std::size_t>(kMbapLength)) {
+    const std::uint8_t* adu = client.rx.data() + offset;
+    const int protocol = (adu[2] << 8) | adu[3];
+    const int length = (adu[4] << 8) | adu[5];  // unit + PDU
+    // PDU it nhat co function, ADU khong qua MODBUS_TCP_MAX_ADU_LENGTH
+    if (protocol != 0 || length < 2 ||
+        length + kMbapLength - 1 > MODBUS_TCP_MAX_ADU_LENGTH) {
+      return false;
+    }
+    const std::size_t total =
+        static_cast<std::size_t>(kMbapLength - 1 + length);
+    if (client.rx.size() - offset < total) break;
+    handleRequest(client, adu, static_cast<int>(total));
+    offset += total;
+  }
+  client.rx.erase(client.rx.begin(), client.rx.begin() + offset);
+  return !client.broken;
+}
+
+/**
+ * @brief Chuyển một request đủ frame tới bus theo unit ID
+ *
+ * Unit không có tuyến, vùng đọc sai hoặc hàng đợi của bus đã đầy được trả
+ * exception ngay.
+ */
+void GatewayServer::handleRequest(Client& client, const std::uint8_t* adu,
+                                  int length) {
+  GatewayRequest request;
+  request.client = client.id;
+  request.transaction = static_cast<std::uint16_t>((adu[0] << 8) | adu[1]);
+  request.unit = adu[6];
+  request.pdu.assign(adu + kMbapLength, adu + length);
+
+  BusPort* port = routes_[request.unit];
+  int code = port == nullptr ? MODBUS_EXCEPTION_GATEWAY_PATH : 0;
+  if (code == 0 && request.coalescable()) {
+    if (request.pdu.size() < 5) {
+      code = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+    } else {
+      request.address =
+          static_cast<std::uint16_t>((request.pdu[1] << 8) | request.pdu[2]);
+      request.quantity =
+          static_cast<std::uint16_t>((request.pdu[3] << 8) | request.pdu[4]);
+      if (request.quantity < 1 ||
+          request.quantity > MODBUS_MAX_READ_REGISTERS ||
+          request.address + request.quantity > 0x10000) {
+        code = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+      }
+    }
+  }
+
+  if (code == 0 && !port->submit(std::move(request))) {
+    code = MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY;
+  }
+  if (code != 0) {
+    GatewayResponse response;
+    response.transaction = request.transaction;
+    response.unit = request.unit;
+    response.pdu.push_back(
+        static_cast<std::uint8_t>(request.function() | 0x80));
+    response.pdu.push_back(static_cast<std::uint8_t>(code));
+    sendResponse(client, response);
+  }
+}
+
+void GatewayServer::deliver() {
+  std::vector<GatewayResponse> completed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed.swap(completed_);
+  }
+  for (const GatewayResponse& response : completed) {
+    // Client da dong trong luc cho bus: bo tra loi
+    for (Client& client : clients_) {
+      if (client.id == response.client) {
+        if (!client.broken) sendResponse(client, response);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Xếp trả lời vào bộ đệm gửi của client rồi gửi phần socket nhận
+ *
+ * Client để tồn quá kMaxTxBacklog byte (không đọc trả lời) bị đánh dấu
+ * đóng thay vì giữ thread.
+ */
+void GatewayServer::sendResponse(Client& client,
+                                 const GatewayResponse& response) {
+  const std::size_t length = response.pdu.size() + 1;  // unit + PDU
+  if (client.tx.size() - client.tx_offset + kMbapLength - 1 + length >
+      kMaxTxBacklog) {
+    std::cerr << "[WARN] Client " << client.id
+              << " khong doc tra loi, ngat ket noi" << std::endl;
+    client.broken = true;
+    return;
+  }
+  const std::uint8_t header[kMbapLength] = {
+      static_cast<std::uint8_t>(response.transaction >> 8),
+      static_cast<std::uint8_t>(response.transaction & 0xFF),
+      0,
+      0,
+      static_cast<std::uint8_t>(length >> 8),
+      static_cast<std::uint8_t>(length & 0xFF),
+      response.unit};
+  client.tx.insert(client.tx.end(), header, header + kMbapLength);
+  client.tx.insert(client.tx.end(), response.pdu.begin(), response.pdu.end());
+  if (!flush(client)) client.broken = true;
+}
+
+// Gui phan tx con lai toi khi socket day; false neu client hong
+bool GatewayServer::flush(Client& client) {
+  while (client.tx_offset < client.tx.size()) {
+    const ssize_t n = send(client.fd, client.tx.data() + client.tx_offset,
+                           client.tx.size() - client.tx_offset, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (n <= 0) return false;
+    client.tx_offset += static_cast<std::size_t>(n);
+  }
+  client.tx.clear();
+  client.tx_offset = 0;
+  return true;
+}
+
+void GatewayServer::closeClient(std::size_t index) {
+  close(clients_[index].fd);
+  clients_.erase(clients_.begin() + index);
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <modbus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bus_executor.h"
+#include "meter_config.h"
+
+// Mot request Modbus TCP da tach MBAP, cho bus tra loi
+struct GatewayRequest {
+  // id ket noi TCP (khong dung fd: fd dong roi co the duoc cap lai)
+  std::uint64_t client = 0;
+  std::uint16_t transaction = 0;
+  std::uint8_t unit = 0;
+  std::vector<std::uint8_t> pdu;  // function + data nhu client gui
+  // Chi co nghia voi FC03/FC04 (doc duoc gom va cache)
+  std::uint16_t address = 0;
+  std::uint16_t quantity = 0;
+
+  std::uint8_t function() const { return pdu[0]; }
+  bool coalescable() const {
+    return pdu[0] == MODBUS_FC_READ_HOLDING_REGISTERS ||
+           pdu[0] == MODBUS_FC_READ_INPUT_REGISTERS;
+  }
+};
+
+// PDU tra loi (binh thuong hoac exception) cho mot request
+struct GatewayResponse {
+  std::uint64_t client = 0;
+  std::uint16_t transaction = 0;
+  std::uint8_t unit = 0;
+  std::vector<std::uint8_t> pdu;
+};
+
+/**
+ * @brief Cache ngan han cac lan doc FC03/FC04 theo (unit, function)
+ *
+ * Mot request duoc tra tu cache khi nam tron trong mot lan doc con han TTL.
+ * Lenh ghi toi unit xoa toan bo cache cua unit do. Dung tu thread front-end
+ * (tra cuu) va thread cua bus (them) nen co mutex rieng.
+ */
+class ReadCache {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit ReadCache(std::chrono::milliseconds ttl) : ttl_(ttl) {}
+
+  bool enabled() const { return ttl_.count() > 0; }
+
+  // true va chep gia tri vao dest neu [address, address + quantity) con han
+  bool lookup(std::uint8_t unit, std::uint8_t function, std::uint16_t address,
+              std::uint16_t quantity, Clock::time_point now,
+              std::uint16_t* dest) const;
+  void insert(std::uint8_t unit, std::uint8_t function, std::uint16_t address,
+              const std::uint16_t* values, int quantity, Clock::time_point now);
+  void invalidate(std::uint8_t unit);
+
+ private:
+  struct Entry {
+    std::uint16_t address;
+    std::vector<std::uint16_t> values;
+    Clock::time_point at;
+  };
+  // Moi khoa giu toi da chung nay lan doc (cu nhat bi bo)
+  static const std::size_t kMaxEntries = 32;
+
+  static std::uint32_t key(std::uint8_t unit, std::uint8_t function) {
+    return (static_cast<std::uint32_t>(unit) << 8) | function;
+  }
+
+  std::chrono::milliseconds ttl_;
+  mutable std::mutex mutex_;
+  std::map<std::uint32_t, std::vector<Entry> > entries_;
+};
+
+/**
+ * @brief Hang doi cua mot bus phia sau gateway, gom cac lan doc trung nhau
+ *
+ * Request tu moi client TCP vao cung mot hang doi. Request dau tien mo mot
+ * cua so (window_ms); het cua so, thread cua bus lay ca lo ra: cac lan doc
+ * FC03/FC04 lien tiep cung unit/function co vung trung hoac ke nhau duoc gop
+ * thanh mot transaction (toi da 125 thanh ghi), ket qua chia lai cho moi
+ * request. Lenh ghi va function khac duoc chuyen nguyen van, dung thu tu, va
+ * tach lo de client ghi roi doc thay gia tri moi. Request den trong luc bus
+ * dang ban duoc gom vao lo tiep theo; hang doi day (max_pending) thi submit()
+ * tu choi de front-end tra exception server busy, bo nho khong tang theo
+ * client gui don dap toi bus cham.
+ */
+class BusPort {
+ public:
+  typedef std::function<void(GatewayResponse&&)> Completion;
+
+  struct Options {
+    int window_ms = 5;
+    int cache_ttl_ms = 500;
+    // Request toi da cho bus (chua tinh lo bus dang xu ly)
+    std::size_t max_pending = 64;
+  };
+
+  struct Stats {
+    std::uint64_t requests = 0;
+    std::uint64_t cache_hits = 0;
+    // Request duoc tra loi bang transaction dung chung voi request khac
+    std::uint64_t coalesced = 0;
+    std::uint64_t transactions = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t busy = 0;  // bi tu choi vi hang doi day
+  };
+
+  // done duoc goi tren thread cua bus (hoac thread goi submit khi trung
+  // cache); phai nhanh va thread-safe
+  BusPort(const BusConfig& config, std::shared_ptr<BusExecutor> executor,
+          const Options& options, Completion done);
+  // Dung executor truoc: job drain() con lai chay xong khi port con song
+  ~BusPort();
+
+  BusPort(const BusPort&) = delete;
+  BusPort& operator=(const BusPort&) = delete;
+
+  const BusConfig& config() const { return config_; }
+  Stats stats() const;
+
+  // false (request giu nguyen) neu hang doi da du max_pending
+  bool submit(GatewayRequest&& request);
+
+ private:
+  typedef std::vector<GatewayRequest>::iterator Iterator;
+
+  void drain(modbus_t* ctx);
+  void handleReads(modbus_t* ctx, Iterator first, Iterator last);
+  // Mot lan doc cho cac request cung unit/function, vung lien nhau, da sap
+  // xep theo dia chi
+  void readSpan(modbus_t* ctx, const std::vector<GatewayRequest*>& members);
+  void forward(modbus_t* ctx, const GatewayRequest& request);
+  void reply(const GatewayRequest& request, std::vector<std::uint8_t>&& pdu);
+  void replyValues(const GatewayRequest& request,
+                   const std::uint16_t* values);
+  void replyException(const GatewayRequest& request, int code);
+
+  BusConfig config_;
+  std::shared_ptr<BusExecutor> executor_;
+  Options options_;
+  Completion done_;
+  ReadCache cache_;
+
+  std::mutex mutex_;
+  std::vector<GatewayRequest> pending_;
+  bool scheduled_ = false;  // da co job drain() tren bus
+  std::chrono::steady_clock::time_point window_end_;
+
+  std::atomic<std::uint64_t> requests_;
+  std::atomic<std::uint64_t> cache_hits_;
+  std::atomic<std::uint64_t> coalesced_;
+  std::atomic<std::uint64_t> transactions_;
+  std::atomic<std::uint64_t> errors_;
+  std::atomic<std::uint64_t> busy_;
+};
+
+/**
+ * @brief Front-end Modbus TCP cua gateway: nhieu client, dinh tuyen theo unit
+ *
+ * Mot thread poll() tren socket listen, cac client va mot eventfd. Socket
+ * client khong chan: byte nhan duoc gom vao bo dem rieng cua client, chi
+ * frame MBAP day du moi duoc chuyen toi BusPort theo unit ID, nen client gui
+ * nua frame khong giu thread. Tra loi tu thread cua bus quay lai qua hang
+ * doi + eventfd; phan socket chua nhan het cho POLLOUT, client de ton qua
+ * kMaxTxBacklog byte chua doc bi ngat. Unit khong co tuyen -> exception
+ * gateway path unavailable.
+ */
+class GatewayServer {
+ public:
+  struct Options {
+    std::string host = "0.0.0.0";
+    int port = 502;
+    int max_clients = 32;
+  };
+
+  explicit GatewayServer(const Options& options);
+  ~GatewayServer();
+
+  GatewayServer(const GatewayServer&) = delete;
+  GatewayServer& operator=(const GatewayServer&) = delete;
+
+  // Gan cac unit ID cho mot bus; false neu unit da co tuyen
+  bool addRoute(const std::vector<int>& units, BusPort* port);
+
+  bool open();
+  // Vong lap chinh, tra ve khi stop == true
+  void run(const std::atomic<bool>& stop);
+
+  // Goi tu thread cua bus
+  void complete(GatewayResponse&& response);
+
+ private:
+  struct Client {
+    int fd;
+    std::uint64_t id;
+    std::vector<std::uint8_t> rx;  // dau frame tiep theo, chua du mot ADU
+    std::vector<std::uint8_t> tx;  // tra loi socket chua nhan
+    std::size_t tx_offset;
+    bool broken;  // dong o cuoi vong poll
+  };
+  // Tra loi client duoc phep de ton truoc khi bi ngat
+  static const std::size_t kMaxTxBacklog = 64 * 1024;
+
+  void acceptClient();
+  bool receive(Client& client);
+  void handleRequest(Client& client, const std::uint8_t* adu, int length);
+  void deliver();
+  void sendResponse(Client& client, const GatewayResponse& response);
+  bool flush(Client& client);
+  void closeClient(std::size_t index);
+
+  Options options_;
+  modbus_t* ctx_;
+  int server_fd_;
+  int event_fd_;
+  std::uint64_t next_client_ = 1;
+  std::vector<Client> clients_;
+  BusPort* routes_[256];
+
+  std::mutex mutex_;
+  std::vector<GatewayResponse> completed_;
+};
@@ -0,0 +1,155 @@
+// Gateway Modbus TCP -> RS-485: nhieu client SCADA/HMI doc cung mot dong ho
+// ma bus chi chiu mot lan doc. Request cua moi client duoc xep hang theo bus,
+// lan doc trung/ke nhau trong cua so gom duoc gop thanh mot transaction, ket
+// qua chia lai cho moi client va giu trong cache ngan han.
+//
+//   mb_gateway [mb_gateway.json]
+//
+// Ctrl+C de dung; thong ke tung bus in ra khi thoat.
+#include <signal.h>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gateway.h"
+#include "meter_driver.h"
+
+using namespace std;
+
+namespace {
+
+atomic<bool> g_stop(false);
+
+void onSignal(int) { g_stop.store(true); }
+
+struct BusRoute {
+  BusConfig bus;
+  vector<int> units;
+};
+
+struct GatewaySettings {
+  GatewayServer::Options server;
+  BusPort::Options port;
+  vector<BusRoute> routes;
+};
+
+// { "listen": { "host": "0.0.0.0", "port": 502, "max_clients": 32 },
+//   "coalesce_window_ms": 5, "cache_ttl_ms": 500, "max_pending": 64,
+//   "buses": [ { "name": "rs485_1", "type": "rtu", "port": "/dev/ttyS3",
+//                "baudrate": 9600, "units": [1, 2, 3] } ] }
+bool loadSettings(const string& filename, GatewaySettings& settings) {
+  const string content = readFileToString(filename);
+  cJSON* root = content.empty() ? nullptr : cJSON_Parse(content.c_str());
+  if (root == nullptr) {
+    cerr << "ERROR: Khong doc duoc cau hinh " << filename << endl;
+    return false;
+  }
+
+  cJSON* listen = cJSON_GetObjectItemCaseSensitive(root, "listen");
+  if (cJSON_IsObject(listen)) {
+    cJSON* host = cJSON_GetObjectItemCaseSensitive(listen, "host");
+    cJSON* port = cJSON_GetObjectItemCaseSensitive(listen, "port");
+    cJSON* clients = cJSON_GetObjectItemCaseSensitive(listen, "max_clients");
+    if (cJSON_IsString(host)) settings.server.host = host->valuestring;
+    if (cJSON_IsNumber(port)) settings.server.port = port->valueint;
+    if (cJSON_IsNumber(clients)) {
+      settings.server.max_clients = clients->valueint;
+    }
+  }
+  cJSON* window = cJSON_GetObjectItemCaseSensitive(root, "coalesce_window_ms");
+  if (cJSON_IsNumber(window)) settings.port.window_ms = window->valueint;
+  cJSON* ttl = cJSON_GetObjectItemCaseSensitive(root, "cache_ttl_ms");
+  if (cJSON_IsNumber(ttl)) settings.port.cache_ttl_ms = ttl->valueint;
+  cJSON* pending = cJSON_GetObjectItemCaseSensitive(root, "max_pending");
+  bool ok = !cJSON_IsNumber(pending) || pending->valueint > 0;
+  if (ok && cJSON_IsNumber(pending)) {
+    settings.port.max_pending = static_cast<size_t>(pending->valueint);
+  }
+
+  ok = ok && settings.port.window_ms >= 0 &&
+       settings.port.cache_ttl_ms >= 0 && settings.server.max_clients > 0;
+  if (!ok) {
+    cerr << "ERROR: Cua so gom / TTL / max_pending / max_clients khong hop le"
+         << endl;
+  }
+
+  cJSON* buses = cJSON_GetObjectItemCaseSensitive(root, "buses");
+  for (cJSON* item = cJSON_IsArray(buses) ? buses->child : nullptr;
+       ok && item != nullptr; item = item->next) {
+    BusRoute route;
+    cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
+    route.bus.name = cJSON_IsString(name)
+                         ? name->valuestring
+                         : "bus" + to_string(settings.routes.size());
+    ok = route.bus.parseJson(item) && route.bus.validate();
+
+    cJSON* units = cJSON_GetObjectItemCaseSensitive(item, "units");
+    for (cJSON* unit = cJSON_IsArray(units) ? units->child : nullptr;
+         ok && unit != nullptr; unit = unit->next) {
+      if (cJSON_IsNumber(unit)) route.units.push_back(unit->valueint);
+    }
+    if (ok && route.units.empty()) {
+      cerr << "ERROR: Bus " << route.bus.name << " chua khai bao units"
+           << endl;
+      ok = false;
+    }
+    settings.routes.push_back(route);
+  }
+
+  cJSON_Delete(root);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const string config_file = argc > 1 ? argv[1] : "mb_gateway.json";
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  GatewaySettings settings;
+  if (!loadSettings(config_file, settings)) {
+    cerr << "[FATAL] Cau hinh gateway khong hop le" << endl;
+    return 1;
+  }
+
+  // server khai bao truoc: cac port (va job tren bus) huy truoc no
+  GatewayServer server(settings.server);
+  vector<unique_ptr<BusPort> > ports;
+  for (const BusRoute& route : settings.routes) {
+    shared_ptr<BusExecutor> executor = MeterDriver::openBus(route.bus);
+    if (!executor) {
+      // Van nhan tuyen: client nhan exception gateway path thay vi timeout
+      cerr << "[WARN] Bus " << route.bus.name
+           << " chua mo duoc, request toi bus se bi tu choi" << endl;
+    }
+    ports.emplace_back(new BusPort(
+        route.bus, executor, settings.port,
+        [&server](GatewayResponse&& response) {
+          server.complete(move(response));
+        }));
+    if (!server.addRoute(route.units, ports.back().get())) return 1;
+    cout << "[INFO] Bus " << route.bus.name << " (" << route.bus.key()
+         << "): " << route.units.size() << " unit" << endl;
+  }
+
+  if (!server.open()) return 1;
+  cout << "[INFO] Gateway listen " << settings.server.host << ":"
+       << settings.server.port << ", cua so gom " << settings.port.window_ms
+       << " ms, cache " << settings.port.cache_ttl_ms << " ms" << endl;
+
+  server.run(g_stop);
+
+  for (const auto& port : ports) {
+    const BusPort::Stats stats = port->stats();
+    cout << "[GATEWAY] " << port->config().name << ": " << stats.requests
+         << " request, " << stats.transactions << " transaction, "
+         << stats.coalesced << " gop, " << stats.cache_hits << " cache, "
+         << stats.errors << " loi, " << stats.busy << " busy" << endl;
+  }
+  return 0;
+}
@@ -1,8 +1,7 @@
 #include "mb_master.h"
 
 ModbusContextPtr ModbusMaster::create_rtu_ctx(const uint8_t port) {
-  modbus_t* ctx = modbus_new_rtu((port == 1) ? "/dev/ttyS3" : "/dev/ttyS4",
-                                 9600, 'N', 8, 1);
+  modbus_t* ctx = modbus_new_rtu(rtu_device(port), 9600, 'N', 8, 1);
 
   return ModbusContextPtr(ctx);
 }
@@ -13,6 +12,22 @@ ModbusContextPtr ModbusMaster::create_tcp_ctx(const std::string& ip,
   return ModbusContextPtr(ctx);
 }
 
+std::shared_ptr<BusExecutor> ModbusMaster::open_rtu_bus(const uint8_t port) {
+  return BusRegistry::instance().acquire(rtu_device(port), [this, port]() {
+    ModbusContextPtr ctx = create_rtu_ctx(port);
+    return connect(ctx.get()) ? std::move(ctx) : ModbusContextPtr();
+  });
+}
+
+std::shared_ptr<BusExecutor> ModbusMaster::open_tcp_bus(const std::string& ip,
+                                                        uint16_t port) {
+  std::string key = "tcp://" + ip + ":" + std::to_string(port);
+  return BusRegistry::instance().acquire(key, [this, &ip, port]() {
+    ModbusContextPtr ctx = create_tcp_ctx(ip, port);
+    return connect(ctx.get()) ? std::move(ctx) : ModbusContextPtr();
+  });
+}
+
 bool ModbusMaster::connect(modbus_t* ctx) {
   if (!ctx) return false;
   return modbus_connect(ctx) == 0;
@@ -28,7 +43,6 @@ int ModbusMaster::readInputRegisters(modbus_t* ctx, uint16_t addr, uint16_t qty,
                                      uint16_t* dest) {
   if (!ctx || !dest) return -1;
 
-  std::lock_guard<std::mutex> lock(bus_mutex_);
   return modbus_read_input_registers(ctx, addr, qty, dest);
 }
 
@@ -36,17 +50,67 @@ int ModbusMaster::readHoldingRegisters(modbus_t* ctx, uint16_t addr,
                                        uint16_t qty, uint16_t* dest) {
   if (!ctx || !dest) return -1;  // kiem tra ctx va dest NULL?
 
-  std::lock_guard<std::mutex> lock(bus_mutex_);
   return modbus_read_registers(ctx, addr, qty, dest);
 }
 
+int ModbusMaster::readPipelined(modbus_t* ctx,
+                                std::vector<PipelinedRead>& reads,
+                                int window) {
+  if (!ctx) return -1;
+  if (modbus_set_pipeline_window(ctx, window) == -1) return -1;
+
+  // tid -> vi tri trong reads cua cac request dang cho
+  std::vector<std::pair<int, size_t> > in_flight;
+  in_flight.reserve(static_cast<size_t>(window));
+
+  size_t next = 0;
+  int ok = 0;
+  while (next < reads.size() || !in_flight.empty()) {
+    // Lap day cua so truoc khi cho response
+    while (next < reads.size() &&
+           in_flight.size() < static_cast<size_t>(window)) {
+      PipelinedRead& read = reads[next];
+      read.rc = -1;
+      int tid = read.input ? modbus_pipeline_send_read_input_registers(
+                                 ctx, read.addr, read.qty, read.dest)
+                           : modbus_pipeline_send_read_registers(
+                                 ctx, read.addr, read.qty, read.dest);
+      if (tid == -1) break;
+      in_flight.push_back(std::make_pair(tid, next));
+      next++;
+    }
+    if (in_flight.empty()) {
+      next++;  // gui that bai (dest NULL, qty qua lon...), bo qua read nay
+      continue;
+    }
+
+    int tid = -1;
+    int rc = modbus_pipeline_receive(ctx, &tid);
+    if (tid == -1) {
+      // Timeout/mat ket noi: bo cac request dang cho, cac read con lai loi
+      modbus_pipeline_discard(ctx);
+      in_flight.clear();
+      if (rc == -1 && modbus_get_socket(ctx) < 0) break;
+      continue;
+    }
+
+    for (size_t i = 0; i < in_flight.size(); ++i) {
+      if (in_flight[i].first != tid) continue;
+      reads[in_flight[i].second].rc = rc;
+      if (rc != -1) ok++;
+      in_flight.erase(in_flight.begin() + i);
+      break;
+    }
+  }
+  return ok;
+}
+
 // ---------------- Write ----------------
 
 int ModbusMaster::writeSingleRegister(modbus_t* ctx, uint16_t addr,
                                       uint16_t value) {
   if (!ctx) return -1;
 
-  std::lock_guard<std::mutex> lock(bus_mutex_);
   return modbus_write_register(ctx, addr, value);
 }
 
@@ -54,6 +118,55 @@ int ModbusMaster::writeMultipleRegisters(modbus_t* ctx, uint16_t addr,
                                          uint16_t qty, const uint16_t* src) {
   if (!ctx || !src) return -1;
 
-  std::lock_guard<std::mutex> lock(bus_mutex_);
   return modbus_write_registers(ctx, addr, qty, src);
 }
+
+// ---------------- Bus executor ----------------
+// The caller's context is only touched by the bus thread, no lock needed.
+
+int ModbusMaster::readInputRegisters(BusExecutor& bus, uint8_t slaveId,
+                                     uint16_t addr, uint16_t qty,
+                                     uint16_t* dest) {
+  if (!dest) return -1;
+  return bus.call([=](modbus_t* ctx) {
+    setSlaveId(ctx, slaveId);
+    return readInputRegisters(ctx, addr, qty, dest);
+  });
+}
+
+int ModbusMaster::readHoldingRegisters(BusExecutor& bus, uint8_t slaveId,
+                                       uint16_t addr, uint16_t qty,
+                                       uint16_t* dest) {
+  if (!dest) return -1;
+  return bus.call([=](modbus_t* ctx) {
+    setSlaveId(ctx, slaveId);
+    return readHoldingRegisters(ctx, addr, qty, dest);
+  });
+}
+
+int ModbusMaster::writeSingleRegister(BusExecutor& bus, uint8_t slaveId,
+                                      uint16_t addr, uint16_t value) {
+  return bus.call([=](modbus_t* ctx) {
+    setSlaveId(ctx, slaveId);
+    return writeSingleRegister(ctx, addr, value);
+  });
+}
+
+int ModbusMaster::writeMultipleRegisters(BusExecutor& bus, uint8_t slaveId,
+                                         uint16_t addr, uint16_t qty,
+                                         const uint16_t* src) {
+  if (!src) return -1;
+  return bus.call([=](modbus_t* ctx) {
+    setSlaveId(ctx, slaveId);
+    return writeMultipleRegisters(ctx, addr, qty, src);
+  });
+}
+
+int ModbusMaster::readPipelined(BusExecutor& bus, uint8_t slaveId,
+                                std::vector<PipelinedRead>& reads,
+                                int window) {
+  return bus.call([&](modbus_t* ctx) {
+    setSlaveId(ctx, slaveId);
+    return readPipelined(ctx, reads, window);
+  });
+}
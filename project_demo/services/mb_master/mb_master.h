@@ -4,26 +4,25 @@
 
 #include <cstdint>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
-// Custom Deleter to automatically close and free context
-struct ModbusContextDeleter {
-  void operator()(modbus_t* ctx) const {
-    if (ctx) {
-      modbus_close(ctx);
-      modbus_free(ctx);
-    }
-  }
-};
+// ModbusContextPtr (close + free on destruction) and BusExecutor
+#include "bus_executor.h"
 
-using ModbusContextPtr = std::unique_ptr<modbus_t, ModbusContextDeleter>;
+// One read of a pipelined batch; rc receives the result of the read
+// (number of registers, or -1 on error/timeout).
+struct PipelinedRead {
+  bool input = false;  // FC04 instead of FC03
+  uint16_t addr = 0;
+  uint16_t qty = 0;
+  uint16_t* dest = nullptr;
+  int rc = -1;
+};
 
+// Each physical bus (RTU port or TCP endpoint) is owned by one BusExecutor
+// thread, so independent buses are never serialized against each other.
 class ModbusMaster {
- private:
-  std::mutex bus_mutex_;  // Protects bus access from multiple devices/threads
-
  public:
   ModbusMaster() = default;
   ~ModbusMaster() = default;
@@ -32,6 +31,12 @@ class ModbusMaster {
   ModbusContextPtr create_rtu_ctx(const uint8_t port);
   ModbusContextPtr create_tcp_ctx(const std::string& ip, uint16_t port);
 
+  // Connect the context and hand it to the executor of its bus. Devices on
+  // the same port/endpoint share the executor returned by BusRegistry.
+  std::shared_ptr<BusExecutor> open_rtu_bus(const uint8_t port);
+  std::shared_ptr<BusExecutor> open_tcp_bus(const std::string& ip,
+                                            uint16_t port);
+
   // Use reference or pointer for manipulation
   bool connect(modbus_t* ctx);
   void setSlaveId(modbus_t* ctx, uint8_t slaveId);
@@ -46,4 +51,29 @@ class ModbusMaster {
   int writeSingleRegister(modbus_t* ctx, uint16_t addr, uint16_t value);
   int writeMultipleRegisters(modbus_t* ctx, uint16_t addr, uint16_t qty,
                              const uint16_t* src);
+
+  // Modbus TCP only: keeps up to `window` requests in flight on the
+  // connection and completes them as responses arrive (matched by MBAP
+  // transaction ID). Returns the number of successful reads.
+  int readPipelined(modbus_t* ctx, std::vector<PipelinedRead>& reads,
+                    int window);
+
+  // Same operations executed on the bus thread (blocking the caller only).
+  // The slave ID is set per request since several devices share a bus.
+  int readInputRegisters(BusExecutor& bus, uint8_t slaveId, uint16_t addr,
+                         uint16_t qty, uint16_t* dest);
+  int readHoldingRegisters(BusExecutor& bus, uint8_t slaveId, uint16_t addr,
+                           uint16_t qty, uint16_t* dest);
+
+  int writeSingleRegister(BusExecutor& bus, uint8_t slaveId, uint16_t addr,
+                          uint16_t value);
+  int writeMultipleRegisters(BusExecutor& bus, uint8_t slaveId, uint16_t addr,
+                             uint16_t qty, const uint16_t* src);
+  int readPipelined(BusExecutor& bus, uint8_t slaveId,
+                    std::vector<PipelinedRead>& reads, int window);
+
+ private:
+  static const char* rtu_device(const uint8_t port) {
+    return (port == 1) ? "/dev/ttyS3" : "/dev/ttyS4";
+  }
 };
\ No newline at end of file
@@ -0,0 +1,205 @@
+// Simulator slave Modbus de do tai / benchmark khi khong co dong ho that:
+// moi bus RTU la mot cap pseudo-terminal (co symlink de dat vao serial_port
+// hoac gateway_config.json), moi server TCP listen tren mot cong. Slave tra
+// loi bang modbus_reply tren anh thanh ghi sinh tu waveform, co do tre va loi
+// (timeout, exception) gia lap.
+//
+//   mb_simulator [sim_config.json]
+//
+// Ctrl+C de dung; thong ke tung bus/slave in ra khi thoat.
+#include <signal.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sim_bus.h"
+#include "sim_slave.h"
+
+using namespace std;
+
+namespace {
+
+volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int) { g_stop = 1; }
+
+struct SimulatorConfig {
+  unsigned seed = 1;
+  map<string, SlaveProfilePtr> profiles;
+  vector<unique_ptr<RtuBusSim> > rtu_buses;
+  vector<unique_ptr<TcpServerSim> > tcp_servers;
+};
+
+// "slaves": [ { "slave_id": 1, "count": 30, "profile": "pm2200" } ]
+// count > 1: dai dia chi slave_id .. slave_id + count - 1 cung profile
+template <typename Bus>
+bool addSlaves(const cJSON* slaves, const SimulatorConfig& config, Bus& bus) {
+  if (!cJSON_IsArray(slaves)) return true;
+
+  for (cJSON* item = slaves->child; item != nullptr; item = item->next) {
+    cJSON* id = cJSON_GetObjectItemCaseSensitive(item, "slave_id");
+    cJSON* count = cJSON_GetObjectItemCaseSensitive(item, "count");
+    cJSON* profile = cJSON_GetObjectItemCaseSensitive(item, "profile");
+    map<string, SlaveProfilePtr>::const_iterator it =
+        cJSON_IsString(profile) ? config.profiles.find(profile->valuestring)
+                                : config.profiles.end();
+    if (!cJSON_IsNumber(id) || it == config.profiles.end()) {
+      cerr << "ERROR: " << bus.options().name
+           << ": slave can slave_id va profile da khai bao" << endl;
+      return false;
+    }
+    const int first = id->valueint;
+    const int total = cJSON_IsNumber(count) ? count->valueint : 1;
+    for (int slave_id = first; slave_id < first + total; ++slave_id) {
+      if (!bus.addSlave(slave_id, it->second)) {
+        cerr << "ERROR: " << bus.options().name << ": slave " << slave_id
+             << " khong hop le hoac bi trung" << endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool loadConfig(const string& filename, SimulatorConfig& config) {
+  const string content = readFileToString(filename);
+  cJSON* root = content.empty() ? nullptr : cJSON_Parse(content.c_str());
+  if (root == nullptr) {
+    cerr << "ERROR: Khong doc duoc cau hinh " << filename << endl;
+    return false;
+  }
+
+  bool ok = true;
+  cJSON* seed = cJSON_GetObjectItemCaseSensitive(root, "seed");
+  if (cJSON_IsNumber(seed)) {
+    config.seed = static_cast<unsigned>(seed->valueint);
+  }
+
+  cJSON* profiles = cJSON_GetObjectItemCaseSensitive(root, "profiles");
+  if (cJSON_IsObject(profiles)) {
+    for (cJSON* item = profiles->child; ok && item != nullptr;
+         item = item->next) {
+      shared_ptr<SlaveProfile> profile = make_shared<SlaveProfile>();
+      ok = profile->parseJson(item);
+      config.profiles[item->string] = profile;
+    }
+  }
+
+  // { "name": "bus1", "link": "/tmp/ttySIM3", "baudrate": 9600,
+  //   "parity": "N", "stop_bits": 1, "pace": true, "slaves": [...] }
+  cJSON* rtu = cJSON_GetObjectItemCaseSensitive(root, "rtu_buses");
+  if (ok && cJSON_IsArray(rtu)) {
+    for (cJSON* item = rtu->child; ok && item != nullptr; item = item->next) {
+      RtuBusSim::Options options;
+      cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
+      cJSON* link = cJSON_GetObjectItemCaseSensitive(item, "link");
+      cJSON* baud = cJSON_GetObjectItemCaseSensitive(item, "baudrate");
+      cJSON* parity = cJSON_GetObjectItemCaseSensitive(item, "parity");
+      cJSON* stop = cJSON_GetObjectItemCaseSensitive(item, "stop_bits");
+      cJSON* pace = cJSON_GetObjectItemCaseSensitive(item, "pace");
+      options.name = cJSON_IsString(name)
+                         ? name->valuestring
+                         : "rtu" + to_string(config.rtu_buses.size());
+      if (cJSON_IsString(link)) options.link_path = link->valuestring;
+      if (cJSON_IsNumber(baud)) options.baudrate = baud->valueint;
+      if (cJSON_IsString(parity) && parity->valuestring[0] != '\0') {
+        options.parity = parity->valuestring[0];
+      }
+      if (cJSON_IsNumber(stop)) options.stop_bits = stop->valueint;
+      if (cJSON_IsBool(pace)) options.pace = cJSON_IsTrue(pace);
+
+      unique_ptr<RtuBusSim> bus(new RtuBusSim(options));
+      ok = bus->open() &&
+           addSlaves(cJSON_GetObjectItemCaseSensitive(item, "slaves"), config,
+                     *bus);
+      config.rtu_buses.push_back(move(bus));
+    }
+  }
+
+  // { "name": "plc", "host": "127.0.0.1", "port": 1502, "slaves": [...] }
+  cJSON* tcp = cJSON_GetObjectItemCaseSensitive(root, "tcp_servers");
+  if (ok && cJSON_IsArray(tcp)) {
+    for (cJSON* item = tcp->child; ok && item != nullptr; item = item->next) {
+      TcpServerSim::Options options;
+      cJSON* name = cJSON_GetObjectItemCaseSensitive(item, "name");
+      cJSON* host = cJSON_GetObjectItemCaseSensitive(item, "host");
+      cJSON* port = cJSON_GetObjectItemCaseSensitive(item, "port");
+      options.name = cJSON_IsString(name)
+                         ? name->valuestring
+                         : "tcp" + to_string(config.tcp_servers.size());
+      if (cJSON_IsString(host)) options.host = host->valuestring;
+      if (cJSON_IsNumber(port)) options.port = port->valueint;
+
+      unique_ptr<TcpServerSim> server(new TcpServerSim(options));
+      ok = server->open() &&
+           addSlaves(cJSON_GetObjectItemCaseSensitive(item, "slaves"), config,
+                     *server);
+      config.tcp_servers.push_back(move(server));
+    }
+  }
+
+  cJSON_Delete(root);
+  return ok;
+}
+
+template <typename Bus>
+void printStats(const string& label, const Bus& bus) {
+  SimSlave::Stats total;
+  for (const auto& pair : bus.slaves()) {
+    const SimSlave::Stats& stats = pair.second->stats();
+    total.requests += stats.requests;
+    total.replies += stats.replies;
+    total.exceptions += stats.exceptions;
+    total.timeouts += stats.timeouts;
+  }
+  cout << "[SIM] " << label << " " << bus.options().name << ": "
+       << bus.slaves().size() << " slave, " << total.requests << " request, "
+       << total.replies << " reply, " << total.exceptions << " exception, "
+       << total.timeouts << " timeout" << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const string config_file = argc > 1 ? argv[1] : "sim_config.json";
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  SimulatorConfig config;
+  if (!loadConfig(config_file, config)) {
+    cerr << "[FATAL] Cau hinh simulator khong hop le" << endl;
+    return 1;
+  }
+
+  // Seed rieng cho tung bus: chay lai cung cau hinh cho cung chuoi loi/do tre
+  unsigned seed = config.seed;
+  for (const auto& bus : config.rtu_buses) {
+    bus->start(seed++);
+    cout << "[SIM] RTU " << bus->options().name << ": "
+         << bus->devicePath()
+         << (bus->options().link_path.empty()
+                 ? ""
+                 : " (" + bus->options().link_path + ")")
+         << ", " << bus->options().baudrate << " baud, "
+         << bus->slaves().size() << " slave" << endl;
+  }
+  for (const auto& server : config.tcp_servers) {
+    server->start(seed++);
+    cout << "[SIM] TCP " << server->options().name << ": "
+         << server->options().host << ":" << server->options().port << ", "
+         << server->slaves().size() << " slave" << endl;
+  }
+
+  while (!g_stop) usleep(200 * 1000);
+
+  for (const auto& bus : config.rtu_buses) bus->stop();
+  for (const auto& server : config.tcp_servers) server->stop();
+  for (const auto& bus : config.rtu_buses) printStats("RTU", *bus);
+  for (const auto& server : config.tcp_servers) printStats("TCP", *server);
+  return 0;
+}
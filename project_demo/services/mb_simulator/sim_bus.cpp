@@ -0,0 +1,441 @@
+#include "sim_bus.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Chu ky kiem tra co dung khi khong co request
+const int kStopCheckMs = 200;
+// Do dai header MBAP (transaction, protocol, length, unit)
+const int kMbapLength = 7;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+}  // namespace
+
+RtuBusSim::RtuBusSim(const Options& options)
+    : options_(options),
+      master_fd_(-1),
+      slave_fd_(-1),
+      ctx_(nullptr),
+      char_time_(0),
+      running_(false) {
+  pipe_fds_[0] = pipe_fds_[1] = -1;
+  // 1 start + 8 data + parity + stop
+  const int bits = 1 + 8 + (options_.parity != 'N' ? 1 : 0) +
+                   options_.stop_bits;
+  char_time_ = std::chrono::microseconds(
+      options_.baudrate > 0 ? bits * 1000000LL / options_.baudrate : 0);
+}
+
+RtuBusSim::~RtuBusSim() {
+  stop();
+  if (ctx_ != nullptr) {
+    modbus_set_socket(ctx_, -1);
+    modbus_free(ctx_);
+  }
+  for (int fd : {master_fd_, slave_fd_, pipe_fds_[0], pipe_fds_[1]}) {
+    if (fd >= 0) close(fd);
+  }
+  if (!options_.link_path.empty()) unlink(options_.link_path.c_str());
+}
+
+bool RtuBusSim::open() {
+  char name[64];
+  if (openpty(&master_fd_, &slave_fd_, name, nullptr, nullptr) < 0) {
+    std::cerr << "[FAIL] " << options_.name
+              << ": openpty loi: " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  device_path_ = name;
+
+  // Dong bo che do raw cho toi khi master tu cau hinh cong
+  struct termios tios;
+  if (tcgetattr(slave_fd_, &tios) == 0) {
+    cfmakeraw(&tios);
+    tcsetattr(slave_fd_, TCSANOW, &tios);
+  }
+
+  if (!options_.link_path.empty()) {
+    // Chi ghi de symlink cu, khong dung vao file/thiet bi that
+    struct stat st;
+    if (lstat(options_.link_path.c_str(), &st) == 0) {
+      if (!S_ISLNK(st.st_mode)) {
+        std::cerr << "[FAIL] " << options_.link_path
+                  << " da ton tai va khong phai symlink" << std::endl;
+        return false;
+      }
+      unlink(options_.link_path.c_str());
+    }
+    if (symlink(device_path_.c_str(), options_.link_path.c_str()) < 0) {
+      std::cerr << "[FAIL] Khong tao duoc symlink " << options_.link_path
+                << ": " << std::strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  // ctx chi dung de dung phan hoi (modbus_reply), khong bao gio connect:
+  // socket cua no la dau ghi cua pipe
+  if (pipe2(pipe_fds_, O_NONBLOCK | O_CLOEXEC) < 0) {
+    std::cerr << "[FAIL] pipe2 loi: " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  ctx_ = modbus_new_rtu(device_path_.c_str(), options_.baudrate,
+                        options_.parity, 8, options_.stop_bits);
+  if (ctx_ == nullptr) {
+    std::cerr << "[FAIL] Khong the tao Modbus context: "
+              << modbus_strerror(errno) << std::endl;
+    return false;
+  }
+  modbus_set_socket(ctx_, pipe_fds_[1]);
+  return true;
+}
+
+bool RtuBusSim::addSlave(int slave_id, SlaveProfilePtr profile) {
+  if (running_.load() || slave_id < 1 || slave_id > 247 ||
+      slaves_.count(slave_id)) {
+    return false;
+  }
+  slaves_[slave_id].reset(new SimSlave(slave_id, profile));
+  return true;
+}
+
+bool RtuBusSim::start(std::uint32_t seed) {
+  if (ctx_ == nullptr || running_.exchange(true)) return false;
+  worker_ = std::thread(&RtuBusSim::run, this, seed);
+  return true;
+}
+
+void RtuBusSim::stop() {
+  running_.store(false);
+  if (worker_.joinable()) worker_.join();
+}
+
+/**
+ * @brief Đọc một frame: chờ byte đầu, kết thúc khi im lặng quá t3.5
+ *
+ * CRC được cập nhật theo từng đoạn nhận được; frame đúng (kể cả 2 byte CRC)
+ * cho *crc == 0.
+ * @return Số byte, 0 nếu hết thời gian chờ (để kiểm tra cờ dừng)
+ */
+int RtuBusSim::readFrame(std::uint8_t* frame, int max_length,
+                         std::chrono::steady_clock::time_point* first_byte,
+                         std::uint16_t* crc) {
+  pollfd pfd = {master_fd_, POLLIN, 0};
+  if (poll(&pfd, 1, kStopCheckMs) <= 0 || !(pfd.revents & POLLIN)) {
+    // POLLHUP khi chua co master nao mo cong: tranh vong lap ban
+    if (pfd.revents & POLLHUP) usleep(kStopCheckMs * 1000);
+    return 0;
+  }
+  *first_byte = std::chrono::steady_clock::now();
+
+  // Khoang lang t3.5, toi thieu 2 ms vi lich cua kernel
+  const int gap_ms = std::max<int>(
+      2, static_cast<int>((char_time_.count() * 7 / 2 + 999) / 1000));
+  int length = 0;
+  for (;;) {
+    std::uint8_t chunk[MODBUS_RTU_MAX_ADU_LENGTH];
+    const ssize_t n = read(master_fd_, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    // Frame qua dai: bo phan thua, CRC se sai va frame bi bo qua
+    const int copy = std::min<int>(static_cast<int>(n), max_length - length);
+    std::memcpy(frame + length, chunk, copy);
+    *crc = modbus_rtu_crc16_update(*crc, chunk, copy);
+    length += copy;
+    if (poll(&pfd, 1, gap_ms) <= 0 || !(pfd.revents & POLLIN)) break;
+  }
+  return length;
+}
+
+void RtuBusSim::writePaced(const std::uint8_t* data, int length) {
+  if (!options_.pace || char_time_.count() == 0) {
+    int sent = 0;
+    while (sent < length) {
+      const ssize_t n = write(master_fd_, data + sent, length - sent);
+      if (n <= 0) return;
+      sent += static_cast<int>(n);
+    }
+    return;
+  }
+
+  // Ghi cac byte da toi luot theo dong ho ky tu, ngu toi byte tiep theo
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  int sent = 0;
+  while (sent < length) {
+    const std::int64_t elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    const int due = std::min<int>(
+        length, static_cast<int>(elapsed / char_time_.count()) + 1);
+    if (due > sent) {
+      const ssize_t n = write(master_fd_, data + sent, due - sent);
+      if (n <= 0) return;
+      sent += static_cast<int>(n);
+    }
+    if (sent < length) {
+      std::this_thread::sleep_until(start + char_time_ * sent);
+    }
+  }
+}
+
+void RtuBusSim::run(std::uint32_t seed) {
+  std::mt19937 rng(seed);
+  const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  std::uint8_t frame[MODBUS_RTU_MAX_ADU_LENGTH];
+  std::uint8_t response[MODBUS_RTU_MAX_ADU_LENGTH];
+
+  while (running_.load()) {
+    std::chrono::steady_clock::time_point first_byte;
+    std::uint16_t crc = MODBUS_RTU_CRC16_INIT;
+    const int length = readFrame(frame, sizeof(frame), &first_byte, &crc);
+    // Slave that bo qua frame sai CRC (nhieu, va cham tren bus)
+    if (length < 4 || crc != 0) continue;
+
+    const int slave_id = frame[0];
+    if (slave_id == MODBUS_BROADCAST_ADDRESS) {
+      // Broadcast: moi slave thuc hien lenh ghi, khong ai tra loi
+      for (auto& pair : slaves_) {
+        modbus_set_slave(ctx_, pair.first);
+        modbus_reply(ctx_, frame, length, pair.second->mapping());
+      }
+      continue;
+    }
+    std::map<int, std::unique_ptr<SimSlave> >::iterator it =
+        slaves_.find(slave_id);
+    if (it == slaves_.end()) continue;
+    SimSlave& slave = *it->second;
+
+    std::chrono::microseconds latency;
+    const SimSlave::Action action = slave.decide(rng, &latency);
+    // Thoi gian truyen request tren day + do tre xu ly cua slave
+    std::chrono::steady_clock::time_point reply_at = first_byte + latency;
+    if (options_.pace) reply_at += char_time_ * length;
+    std::this_thread::sleep_until(reply_at);
+    if (action == SimSlave::Action::kTimeout) continue;
+
+    modbus_set_slave(ctx_, slave_id);
+    if (action == SimSlave::Action::kException) {
+      modbus_reply_exception(ctx_, frame,
+                             slave.profile().faults.exception_code);
+    } else {
+      slave.refresh(secondsSince(epoch), rng);
+      modbus_reply(ctx_, frame, length, slave.mapping());
+    }
+
+    const ssize_t n = read(pipe_fds_[0], response, sizeof(response));
+    if (n > 0) writePaced(response, static_cast<int>(n));
+  }
+}
+
+TcpServerSim::TcpServerSim(const Options& options)
+    : options_(options), ctx_(nullptr), server_fd_(-1), running_(false) {}
+
+TcpServerSim::~TcpServerSim() {
+  stop();
+  if (server_fd_ >= 0) close(server_fd_);
+  if (ctx_ != nullptr) {
+    modbus_set_socket(ctx_, -1);
+    modbus_free(ctx_);
+  }
+}
+
+bool TcpServerSim::open() {
+  ctx_ = modbus_new_tcp(options_.host.c_str(), options_.port);
+  if (ctx_ == nullptr) {
+    std::cerr << "[FAIL] Khong the tao Modbus context: "
+              << modbus_strerror(errno) << std::endl;
+    return false;
+  }
+  server_fd_ = modbus_tcp_listen(ctx_, options_.max_clients);
+  if (server_fd_ < 0) {
+    std::cerr << "[FAIL] " << options_.name << ": khong listen duoc "
+              << options_.host << ":" << options_.port << ": "
+              << modbus_strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool TcpServerSim::addSlave(int unit_id, SlaveProfilePtr profile) {
+  if (running_.load() || unit_id < 0 || unit_id > 255 ||
+      slaves_.count(unit_id)) {
+    return false;
+  }
+  slaves_[unit_id].reset(new SimSlave(unit_id, profile));
+  return true;
+}
+
+bool TcpServerSim::start(std::uint32_t seed) {
+  if (server_fd_ < 0 || running_.exchange(true)) return false;
+  worker_ = std::thread(&TcpServerSim::run, this, seed);
+  return true;
+}
+
+void TcpServerSim::stop() {
+  running_.store(false);
+  if (worker_.joinable()) worker_.join();
+}
+
+void TcpServerSim::run(std::uint32_t seed) {
+  std::mt19937 rng(seed);
+  const Clock::time_point epoch = Clock::now();
+  std::vector<pollfd> fds;
+
+  while (running_.load()) {
+    fds.clear();
+    fds.push_back(pollfd{server_fd_, POLLIN, 0});
+    for (const Client& client : clients_) {
+      fds.push_back(pollfd{client.fd, POLLIN, 0});
+    }
+
+    // Thuc day dung han tra loi som nhat
+    int timeout_ms = kStopCheckMs;
+    for (const PendingReply& reply : pending_) {
+      const long long wait_ms =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              reply.due - Clock::now() + std::chrono::microseconds(999))
+              .count();
+      timeout_ms = static_cast<int>(
+          std::max(0LL, std::min<long long>(timeout_ms, wait_ms)));
+    }
+
+    const int count = poll(fds.data(), fds.size(), timeout_ms);
+    if (count < 0 && errno != EINTR) {
+      std::cerr << "[FAIL] " << options_.name
+                << ": poll loi: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    if (count > 0) {
+      // Duyet nguoc de xoa client khong lam lech chi so cac client con lai
+      for (std::size_t i = clients_.size(); i-- > 0;) {
+        if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+            !receive(clients_[i], rng)) {
+          close(clients_[i].fd);
+          clients_.erase(clients_.begin() + i);
+        }
+      }
+      if (fds[0].revents & POLLIN) acceptClient();
+    }
+    sendDue(Clock::now(), secondsSince(epoch), rng);
+  }
+
+  for (const Client& client : clients_) close(client.fd);
+  clients_.clear();
+  pending_.clear();
+}
+
+void TcpServerSim::acceptClient() {
+  const int fd = modbus_tcp_accept(ctx_, &server_fd_);
+  if (fd < 0) return;
+  if (static_cast<int>(clients_.size()) >= options_.max_clients) {
+    close(fd);
+    return;
+  }
+  Client client;
+  client.fd = fd;
+  client.id = next_client_++;
+  clients_.push_back(client);
+}
+
+/**
+ * @brief Đọc dữ liệu sẵn có của client, lên lịch trả lời cho mỗi frame đủ
+ * @return false nếu client đóng kết nối hoặc gửi rác
+ *
+ * Slave chọn hành động và độ trễ ngay khi nhận; timeout thì bỏ request.
+ */
+bool TcpServerSim::receive(Client& client, std::mt19937& rng) {
+  std::uint8_t buffer[1024];
+  for (;;) {
+    const ssize_t n = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) return false;
+    client.rx.insert(client.rx.end(), buffer, buffer + n);
+    if (static_cast<std::size_t>(n) < sizeof(buffer)) break;
+  }
+
+  const Clock::time_point now = Clock::now();
+  std::size_t offset = 0;
+  while (client.rx.size() - offset >= static_cast<std::size_t>(kMbapLength)) {
+    const std::uint8_t* adu = client.rx.data() + offset;
+    const int protocol = (adu[2] << 8) | adu[3];
+    const int length = (adu[4] << 8) | adu[5];  // unit + PDU
+    if (protocol != 0 || length < 2 ||
+        length + kMbapLength - 1 > MODBUS_TCP_MAX_ADU_LENGTH) {
+      return false;
+    }
+    const int total = kMbapLength - 1 + length;
+    if (client.rx.size() - offset < static_cast<std::size_t>(total)) break;
+
+    PendingReply reply;
+    reply.due = now;
+    reply.client = client.id;
+    reply.slave = nullptr;
+    reply.action = SimSlave::Action::kException;
+    reply.query.assign(adu, adu + total);
+    offset += total;
+
+    std::map<int, std::unique_ptr<SimSlave> >::iterator it =
+        slaves_.find(adu[kMbapLength - 1]);
+    if (it != slaves_.end()) {
+      std::chrono::microseconds latency;
+      reply.slave = it->second.get();
+      reply.action = reply.slave->decide(rng, &latency);
+      if (reply.action == SimSlave::Action::kTimeout) continue;
+      reply.due = now + latency;
+    }
+    pending_.push_back(std::move(reply));
+  }
+  client.rx.erase(client.rx.begin(), client.rx.begin() + offset);
+  return true;
+}
+
+void TcpServerSim::sendDue(Clock::time_point now, double t_s,
+                           std::mt19937& rng) {
+  for (std::size_t i = 0; i < pending_.size();) {
+    PendingReply& reply = pending_[i];
+    if (reply.due > now) {
+      ++i;
+      continue;
+    }
+    // Client da dong trong luc cho: bo tra loi
+    for (const Client& client : clients_) {
+      if (client.id != reply.client) continue;
+      modbus_set_socket(ctx_, client.fd);
+      const int length = static_cast<int>(reply.query.size());
+      if (reply.slave == nullptr) {
+        modbus_reply_exception(ctx_, reply.query.data(),
+                               MODBUS_EXCEPTION_GATEWAY_TARGET);
+      } else if (reply.action == SimSlave::Action::kException) {
+        modbus_reply_exception(ctx_, reply.query.data(),
+                               reply.slave->profile().faults.exception_code);
+      } else {
+        reply.slave->refresh(t_s, rng);
+        modbus_reply(ctx_, reply.query.data(), length,
+                     reply.slave->mapping());
+      }
+      break;
+    }
+    pending_[i] = std::move(pending_.back());
+    pending_.pop_back();
+  }
+}
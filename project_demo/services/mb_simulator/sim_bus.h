@@ -0,0 +1,148 @@
+#pragma once
+
+#include <modbus.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim_slave.h"
+
+/**
+ * @brief Bus RS-485 gia lap tren mot cap pseudo-terminal (openpty)
+ *
+ * Phia master (MeterDriver, ModbusMaster) mo duong dan pts (hoac symlink
+ * link_path) nhu mot cong serial binh thuong. Thread cua bus doc frame tu
+ * phia con lai (ket thuc frame khi im lang qua t3.5), kiem tra CRC, chon slave
+ * theo dia chi va tra loi bang modbus_reply tren anh thanh ghi cua slave do.
+ * Nhieu slave cung mot bus nhu day RS-485 that; dia chi la khong ton tai thi
+ * im lang.
+ *
+ * Pty khong co toc do baud: khi pace = true, thoi gian truyen request duoc
+ * tinh vao do tre va phan hoi duoc ghi tung byte theo thoi gian mot ky tu.
+ */
+class RtuBusSim {
+ public:
+  struct Options {
+    std::string name;
+    std::string link_path;  // symlink toi pts (rong = khong tao)
+    int baudrate = 9600;
+    char parity = 'N';
+    int stop_bits = 1;
+    bool pace = true;
+  };
+
+  explicit RtuBusSim(const Options& options);
+  ~RtuBusSim();
+
+  RtuBusSim(const RtuBusSim&) = delete;
+  RtuBusSim& operator=(const RtuBusSim&) = delete;
+
+  // Tao pty va symlink; false neu loi
+  bool open();
+  // Goi truoc start()
+  bool addSlave(int slave_id, SlaveProfilePtr profile);
+
+  bool start(std::uint32_t seed);
+  void stop();
+
+  const Options& options() const { return options_; }
+  // Duong dan phia master (/dev/pts/N)
+  const std::string& devicePath() const { return device_path_; }
+  const std::map<int, std::unique_ptr<SimSlave> >& slaves() const {
+    return slaves_;
+  }
+
+ private:
+  void run(std::uint32_t seed);
+  int readFrame(std::uint8_t* frame, int max_length,
+                std::chrono::steady_clock::time_point* first_byte,
+                std::uint16_t* crc);
+  void writePaced(const std::uint8_t* data, int length);
+
+  Options options_;
+  int master_fd_;  // phia simulator cua pty
+  int slave_fd_;   // giu mo de pty khong bi hang-up khi master dong cong
+  int pipe_fds_[2];  // modbus_reply ghi vao day, roi duoc pace ra pty
+  modbus_t* ctx_;
+  std::string device_path_;
+  std::chrono::microseconds char_time_;
+  std::map<int, std::unique_ptr<SimSlave> > slaves_;
+  std::atomic<bool> running_;
+  std::thread worker_;
+};
+
+/**
+ * @brief Slave Modbus TCP gia lap: mot cong listen, nhieu client dong thoi
+ *
+ * Mot thread poll() tren socket listen va moi client. Request duoc phan
+ * theo unit ID toi slave tuong ung (unit khong ton tai -> exception gateway
+ * target). Moi request co han tra loi rieng (now + do tre slave chon) thay
+ * vi ngu tren thread: do tre cua slave nay khong cong vao tra loi cua client
+ * khac, phan bo do tre dung ca khi nhieu client cung ket noi.
+ */
+class TcpServerSim {
+ public:
+  struct Options {
+    std::string name;
+    std::string host = "127.0.0.1";
+    int port = 1502;
+    int max_clients = 64;
+  };
+
+  explicit TcpServerSim(const Options& options);
+  ~TcpServerSim();
+
+  TcpServerSim(const TcpServerSim&) = delete;
+  TcpServerSim& operator=(const TcpServerSim&) = delete;
+
+  bool open();
+  bool addSlave(int unit_id, SlaveProfilePtr profile);
+
+  bool start(std::uint32_t seed);
+  void stop();
+
+  const Options& options() const { return options_; }
+  const std::map<int, std::unique_ptr<SimSlave> >& slaves() const {
+    return slaves_;
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Client {
+    int fd;
+    std::uint64_t id;
+    std::vector<std::uint8_t> rx;  // dau frame tiep theo, chua du mot ADU
+  };
+  // Tra loi dang cho toi han (do tre gia lap)
+  struct PendingReply {
+    Clock::time_point due;
+    std::uint64_t client;
+    SimSlave* slave;  // nullptr: exception gateway target
+    SimSlave::Action action;
+    std::vector<std::uint8_t> query;
+  };
+
+  void run(std::uint32_t seed);
+  void acceptClient();
+  bool receive(Client& client, std::mt19937& rng);
+  void sendDue(Clock::time_point now, double t_s, std::mt19937& rng);
+
+  Options options_;
+  modbus_t* ctx_;
+  int server_fd_;
+  std::map<int, std::unique_ptr<SimSlave> > slaves_;
+  // Chi thread cua server dung
+  std::vector<Client> clients_;
+  std::vector<PendingReply> pending_;
+  std::uint64_t next_client_ = 1;
+  std::atomic<bool> running_;
+  std::thread worker_;
+};
@@ -0,0 +1,309 @@
+#include "sim_slave.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+double numberOr(const cJSON* object, const char* name, double fallback) {
+  cJSON* item = cJSON_GetObjectItemCaseSensitive(object, name);
+  return cJSON_IsNumber(item) ? item->valuedouble : fallback;
+}
+
+}  // namespace
+
+/**
+ * @brief Lấy một độ trễ theo phân bố đã cấu hình
+ */
+std::chrono::microseconds LatencyModel::sample(std::mt19937& rng) const {
+  double ms = mean_ms;
+  switch (kind) {
+    case Kind::kFixed:
+      break;
+    case Kind::kUniform: {
+      std::uniform_real_distribution<double> dist(mean_ms - spread_ms,
+                                                  mean_ms + spread_ms);
+      ms = dist(rng);
+      break;
+    }
+    case Kind::kNormal: {
+      std::normal_distribution<double> dist(mean_ms, spread_ms);
+      ms = dist(rng);
+      break;
+    }
+    case Kind::kExponential: {
+      if (mean_ms > 0.0) {
+        std::exponential_distribution<double> dist(1.0 / mean_ms);
+        ms = dist(rng);
+      }
+      break;
+    }
+  }
+  ms = std::min(std::max(ms, 0.0), max_ms);
+  return std::chrono::microseconds(static_cast<std::int64_t>(ms * 1000.0));
+}
+
+/**
+ * @brief { "distribution": "fixed|uniform|normal|exponential", "mean_ms": 15,
+ *          "spread_ms": 5, "max_ms": 2000 }
+ */
+bool LatencyModel::parseJson(const cJSON* object) {
+  if (!cJSON_IsObject(object)) return true;
+
+  cJSON* dist = cJSON_GetObjectItemCaseSensitive(object, "distribution");
+  if (cJSON_IsString(dist)) {
+    const std::string name = dist->valuestring;
+    if (name == "fixed") {
+      kind = Kind::kFixed;
+    } else if (name == "uniform") {
+      kind = Kind::kUniform;
+    } else if (name == "normal") {
+      kind = Kind::kNormal;
+    } else if (name == "exponential") {
+      kind = Kind::kExponential;
+    } else {
+      std::cerr << "ERROR: Phan bo do tre khong hop le: " << name
+                << std::endl;
+      return false;
+    }
+  }
+  mean_ms = numberOr(object, "mean_ms", mean_ms);
+  spread_ms = numberOr(object, "spread_ms", spread_ms);
+  max_ms = numberOr(object, "max_ms", max_ms);
+  return mean_ms >= 0.0 && spread_ms >= 0.0 && max_ms >= 0.0;
+}
+
+/**
+ * @brief { "timeout_rate": 0.01, "exception_rate": 0.005,
+ *          "exception_code": 6 }
+ */
+bool FaultModel::parseJson(const cJSON* object) {
+  if (!cJSON_IsObject(object)) return true;
+
+  timeout_rate = numberOr(object, "timeout_rate", timeout_rate);
+  exception_rate = numberOr(object, "exception_rate", exception_rate);
+  exception_code = static_cast<int>(
+      numberOr(object, "exception_code", exception_code));
+  if (timeout_rate < 0.0 || exception_rate < 0.0 ||
+      timeout_rate + exception_rate > 1.0 || exception_code < 1 ||
+      exception_code > 0xFF) {
+    std::cerr << "ERROR: Cau hinh loi gia lap khong hop le" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+double Waveform::valueAt(double t_s, double* state,
+                         std::mt19937& rng) const {
+  switch (shape) {
+    case Shape::kConstant:
+      return offset;
+    case Shape::kSine:
+      return offset + amplitude * std::sin(2.0 * kPi * t_s / period_s);
+    case Shape::kRamp: {
+      const double cycles = t_s / period_s;
+      return offset + amplitude * (cycles - std::floor(cycles));
+    }
+    case Shape::kRandomWalk: {
+      std::normal_distribution<double> dist(0.0, step);
+      *state = std::min(std::max(*state + dist(rng), -amplitude), amplitude);
+      return offset + *state;
+    }
+    case Shape::kCounter:
+      return offset + step * t_s;
+  }
+  return offset;
+}
+
+/**
+ * @brief Mã hóa giá trị thành các word Modbus, ngược với DecodeProgram
+ *
+ * Số big-endian (word đầu là word cao) rồi đảo thứ tự word / byte theo
+ * order, nên MeterDriver cấu hình cùng type/order đọc lại đúng giá trị.
+ */
+void Waveform::encode(double value, std::uint16_t* words) const {
+  const double raw = scale != 0.0 ? value / scale : value;
+  const int count = wordsForType(type);
+
+  std::uint64_t bits = 0;
+  switch (type) {
+    case DataType::kFloat32: {
+      const float f = static_cast<float>(raw);
+      std::uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      bits = u;
+      break;
+    }
+    case DataType::kFloat64:
+      std::memcpy(&bits, &raw, sizeof(bits));
+      break;
+    default:
+      // Kieu nguyen: lam tron, bu 2 cho so am, cat theo so word
+      bits = static_cast<std::uint64_t>(std::llround(raw));
+      break;
+  }
+
+  const bool swap_words =
+      order == WordOrder::kCDAB || order == WordOrder::kDCBA;
+  const bool swap_bytes =
+      order == WordOrder::kBADC || order == WordOrder::kDCBA;
+  for (int i = 0; i < count; ++i) {
+    std::uint16_t word =
+        static_cast<std::uint16_t>(bits >> (16 * (count - 1 - i)));
+    if (swap_bytes) {
+      word = static_cast<std::uint16_t>((word >> 8) | (word << 8));
+    }
+    words[swap_words ? count - 1 - i : i] = word;
+  }
+}
+
+/**
+ * @brief { "address": 4012, "type": "uint16", "order": "ABCD",
+ *          "shape": "sine", "offset": 230, "amplitude": 5, "period_s": 60,
+ *          "step": 0, "scale": 1 }
+ */
+bool Waveform::parseJson(const cJSON* object) {
+  cJSON* addr = cJSON_GetObjectItemCaseSensitive(object, "address");
+  if (!cJSON_IsNumber(addr)) {
+    std::cerr << "ERROR: Waveform thieu address" << std::endl;
+    return false;
+  }
+  address = static_cast<std::uint16_t>(addr->valueint);
+
+  cJSON* type_item = cJSON_GetObjectItemCaseSensitive(object, "type");
+  if (cJSON_IsString(type_item) &&
+      !parseDataType(type_item->valuestring, &type)) {
+    std::cerr << "ERROR: Kieu du lieu khong hop le: " << type_item->valuestring
+              << std::endl;
+    return false;
+  }
+  cJSON* order_item = cJSON_GetObjectItemCaseSensitive(object, "order");
+  if (cJSON_IsString(order_item) &&
+      !parseWordOrder(order_item->valuestring, &order)) {
+    std::cerr << "ERROR: Thu tu byte khong hop le: "
+              << order_item->valuestring << std::endl;
+    return false;
+  }
+
+  cJSON* shape_item = cJSON_GetObjectItemCaseSensitive(object, "shape");
+  if (cJSON_IsString(shape_item)) {
+    const std::string name = shape_item->valuestring;
+    if (name == "constant") {
+      shape = Shape::kConstant;
+    } else if (name == "sine") {
+      shape = Shape::kSine;
+    } else if (name == "ramp") {
+      shape = Shape::kRamp;
+    } else if (name == "random_walk") {
+      shape = Shape::kRandomWalk;
+    } else if (name == "counter") {
+      shape = Shape::kCounter;
+    } else {
+      std::cerr << "ERROR: Dang song khong hop le: " << name << std::endl;
+      return false;
+    }
+  }
+
+  offset = numberOr(object, "offset", offset);
+  amplitude = numberOr(object, "amplitude", amplitude);
+  period_s = numberOr(object, "period_s", period_s);
+  step = numberOr(object, "step", step);
+  scale = numberOr(object, "scale", scale);
+  if (period_s <= 0.0 || step < 0.0) {
+    std::cerr << "ERROR: Waveform " << address
+              << " can period_s duong va step khong am" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief { "start_address": 4000, "count": 300, "latency": {...},
+ *          "faults": {...}, "registers": [ waveform, ... ] }
+ */
+bool SlaveProfile::parseJson(const cJSON* object) {
+  start_address =
+      static_cast<int>(numberOr(object, "start_address", start_address));
+  count = static_cast<int>(numberOr(object, "count", count));
+  if (start_address < 0 || count < 1 || start_address + count > 65536) {
+    std::cerr << "ERROR: Vung thanh ghi gia lap khong hop le" << std::endl;
+    return false;
+  }
+  if (!latency.parseJson(
+          cJSON_GetObjectItemCaseSensitive(object, "latency")) ||
+      !faults.parseJson(cJSON_GetObjectItemCaseSensitive(object, "faults"))) {
+    return false;
+  }
+
+  cJSON* registers = cJSON_GetObjectItemCaseSensitive(object, "registers");
+  if (cJSON_IsArray(registers)) {
+    for (cJSON* item = registers->child; item != nullptr; item = item->next) {
+      Waveform wave;
+      if (!wave.parseJson(item)) return false;
+      if (wave.address < start_address ||
+          wave.address + wordsForType(wave.type) > start_address + count) {
+        std::cerr << "ERROR: Waveform " << wave.address
+                  << " nam ngoai vung thanh ghi gia lap" << std::endl;
+        return false;
+      }
+      waveforms.push_back(wave);
+    }
+  }
+  return true;
+}
+
+SimSlave::SimSlave(int slave_id, SlaveProfilePtr profile)
+    : id_(slave_id),
+      profile_(profile),
+      mapping_(modbus_mapping_new_start_address(
+          0, 0, 0, 0, profile->start_address, profile->count,
+          profile->start_address, profile->count)),
+      walk_state_(profile->waveforms.size(), 0.0) {
+  if (mapping_ == nullptr) {
+    throw std::runtime_error("Khong cap phat duoc modbus_mapping cho slave " +
+                             std::to_string(slave_id));
+  }
+}
+
+SimSlave::~SimSlave() { modbus_mapping_free(mapping_); }
+
+SimSlave::Action SimSlave::decide(std::mt19937& rng,
+                                  std::chrono::microseconds* latency) {
+  ++stats_.requests;
+  *latency = profile_->latency.sample(rng);
+
+  const FaultModel& faults = profile_->faults;
+  if (faults.timeout_rate > 0.0 || faults.exception_rate > 0.0) {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    const double roll = dist(rng);
+    if (roll < faults.timeout_rate) {
+      ++stats_.timeouts;
+      return Action::kTimeout;
+    }
+    if (roll < faults.timeout_rate + faults.exception_rate) {
+      ++stats_.exceptions;
+      return Action::kException;
+    }
+  }
+  ++stats_.replies;
+  return Action::kReply;
+}
+
+void SimSlave::refresh(double t_s, std::mt19937& rng) {
+  const std::vector<Waveform>& waves = profile_->waveforms;
+  for (std::size_t i = 0; i < waves.size(); ++i) {
+    const Waveform& wave = waves[i];
+    const std::size_t index = wave.address - profile_->start_address;
+    const double value = wave.valueAt(t_s, &walk_state_[i], rng);
+    wave.encode(value, mapping_->tab_registers + index);
+    std::copy(mapping_->tab_registers + index,
+              mapping_->tab_registers + index + wordsForType(wave.type),
+              mapping_->tab_input_registers + index);
+  }
+}
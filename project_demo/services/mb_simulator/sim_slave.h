@@ -0,0 +1,129 @@
+#pragma once
+
+#include <modbus.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "meter_config.h"
+
+/**
+ * @brief Phan bo do tre phan hoi cua slave gia lap (tinh tu luc nhan xong
+ *        request toi luc bat dau gui phan hoi)
+ *
+ * kFixed: mean_ms. kUniform: mean_ms +- spread_ms. kNormal: do lech chuan
+ * spread_ms. kExponential: trung binh mean_ms (duoi dai, giong slave thinh
+ * thoang ban). Ket qua luon duoc cat trong [0, max_ms].
+ */
+struct LatencyModel {
+  enum class Kind { kFixed, kUniform, kNormal, kExponential };
+
+  Kind kind = Kind::kFixed;
+  double mean_ms = 0.0;
+  double spread_ms = 0.0;
+  double max_ms = 2000.0;
+
+  std::chrono::microseconds sample(std::mt19937& rng) const;
+  bool parseJson(const cJSON* object);
+};
+
+// Loi gia lap, tinh theo ty le tren moi request
+struct FaultModel {
+  double timeout_rate = 0.0;    // khong tra loi
+  double exception_rate = 0.0;  // tra ve exception_code
+  int exception_code = MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY;
+
+  bool parseJson(const cJSON* object);
+};
+
+/**
+ * @brief Bo sinh gia tri cho mot diem do, ma hoa vao thanh ghi dung theo
+ *        type/order giong cau hinh cua MeterDriver
+ *
+ *   constant    : offset
+ *   sine        : offset + amplitude * sin(2*pi*t / period_s)
+ *   ramp        : offset + amplitude * phan le cua (t / period_s)
+ *   random_walk : buoc ngau nhien do lech chuan step, giu trong
+ *                 offset +- amplitude
+ *   counter     : offset + step * t (bo dem nang luong tang dan)
+ *
+ * Thanh ghi tho = gia tri / scale.
+ */
+struct Waveform {
+  enum class Shape { kConstant, kSine, kRamp, kRandomWalk, kCounter };
+
+  std::uint16_t address = 0;
+  DataType type = DataType::kUint16;
+  WordOrder order = WordOrder::kABCD;
+  Shape shape = Shape::kConstant;
+  double offset = 0.0;
+  double amplitude = 0.0;
+  double period_s = 60.0;
+  double step = 0.0;
+  double scale = 1.0;
+
+  // state: trang thai rieng cua tung slave (random_walk)
+  double valueAt(double t_s, double* state, std::mt19937& rng) const;
+  void encode(double value, std::uint16_t* words) const;
+  bool parseJson(const cJSON* object);
+};
+
+/**
+ * @brief Mo ta mot loai thiet bi gia lap, dung chung cho nhieu slave
+ */
+struct SlaveProfile {
+  int start_address = 0;
+  int count = 0;  // so thanh ghi (holding va input dung chung gia tri)
+  LatencyModel latency;
+  FaultModel faults;
+  std::vector<Waveform> waveforms;
+
+  bool parseJson(const cJSON* object);
+};
+
+typedef std::shared_ptr<const SlaveProfile> SlaveProfilePtr;
+
+/**
+ * @brief Mot slave gia lap: anh thanh ghi (modbus_mapping_t) va quyet dinh
+ *        cach tra loi tung request
+ *
+ * Khong thread-safe: moi slave thuoc ve thread cua bus/server chua no.
+ */
+class SimSlave {
+ public:
+  enum class Action { kReply, kException, kTimeout };
+
+  struct Stats {
+    std::uint64_t requests = 0;
+    std::uint64_t replies = 0;
+    std::uint64_t exceptions = 0;
+    std::uint64_t timeouts = 0;
+  };
+
+  SimSlave(int slave_id, SlaveProfilePtr profile);
+  ~SimSlave();
+
+  SimSlave(const SimSlave&) = delete;
+  SimSlave& operator=(const SimSlave&) = delete;
+
+  int id() const { return id_; }
+  const SlaveProfile& profile() const { return *profile_; }
+  modbus_mapping_t* mapping() { return mapping_; }
+  const Stats& stats() const { return stats_; }
+
+  // Chon hanh dong cho request tiep theo theo FaultModel, va do tre
+  Action decide(std::mt19937& rng, std::chrono::microseconds* latency);
+
+  // Cap nhat thanh ghi tu cac waveform tai thoi diem t_s (giay tu luc chay)
+  void refresh(double t_s, std::mt19937& rng);
+
+ private:
+  int id_;
+  SlaveProfilePtr profile_;
+  modbus_mapping_t* mapping_;
+  std::vector<double> walk_state_;
+  Stats stats_;
+};
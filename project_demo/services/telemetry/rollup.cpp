@@ -0,0 +1,212 @@
+#include "rollup.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace telemetry {
+
+namespace {
+
+const char kCheckpointMagic[4] = {'R', 'U', 'C', '1'};
+const char* const kSuffixes[] = {".min", ".max", ".avg", ".last", ".count"};
+const std::size_t kStatsPerTag = 5;
+
+std::int64_t floorTo(std::int64_t time_ms, std::int64_t period_ms) {
+  std::int64_t start = time_ms - time_ms % period_ms;
+  if (start > time_ms) start -= period_ms;  // time_ms am
+  return start;
+}
+
+}  // namespace
+
+std::vector<Resolution> defaultResolutions() {
+  std::vector<Resolution> resolutions;
+  resolutions.push_back(Resolution{"1m", 60 * 1000});
+  resolutions.push_back(Resolution{"15m", 15 * 60 * 1000});
+  resolutions.push_back(Resolution{"1h", 60 * 60 * 1000});
+  return resolutions;
+}
+
+std::string rollupTopic(const std::string& resolution,
+                        const std::string& device_id) {
+  return "rollup/" + resolution + "/" + device_id;
+}
+
+std::string rollupSchemaTopic(const std::string& resolution,
+                              const std::string& device_id) {
+  return "rollup/schema/" + resolution + "/" + device_id;
+}
+
+/**
+ * @brief Dựng schema tổng hợp và cấp phát bộ tích lũy cho mọi độ phân giải
+ * @param schema Bảng tag của driver (để biết tag thuộc block nào)
+ * @param wire_schema Schema truyền của frame thô; min/max/last giữ cùng kiểu
+ *                    truyền, avg luôn float64, count là số nguyên
+ */
+RollupStage::RollupStage(const SampleSchema& schema, const Schema& wire_schema,
+                         const std::vector<Resolution>& resolutions)
+    : source_id_(wire_schema.id) {
+  tag_blocks_.resize(schema.size());
+  for (std::size_t tag = 0; tag < schema.size(); ++tag) {
+    tag_blocks_[tag] = schema.blockOf(tag);
+  }
+
+  schema_.device_id = wire_schema.device_id;
+  std::vector<std::string> names;
+  for (const TagInfo& source : wire_schema.tags) {
+    for (std::size_t stat = 0; stat < kStatsPerTag; ++stat) {
+      TagInfo tag = source;
+      tag.name = source.name + kSuffixes[stat];
+      if (stat == 2) {
+        tag.wire = WireType::kFloat64;
+        tag.scale = 1.0;
+        tag.offset = 0.0;
+      } else if (stat == 4) {
+        tag.wire = WireType::kScaled;
+        tag.scale = 1.0;
+        tag.offset = 0.0;
+      }
+      schema_.tags.push_back(tag);
+      names.push_back(tag.name);
+    }
+  }
+  schema_.id = schemaId(schema_);
+
+  SampleSchemaPtr output_schema = std::make_shared<SampleSchema>(
+      schema_.device_id, names, std::vector<std::uint16_t>(names.size(), 0),
+      1);
+  windows_.resize(resolutions.size());
+  for (std::size_t w = 0; w < resolutions.size(); ++w) {
+    windows_[w].resolution = resolutions[w];
+    windows_[w].stats.assign(schema.size(), Stat());
+    windows_[w].output.reset(output_schema);
+  }
+}
+
+/**
+ * @brief Chuyển cửa sổ nếu time_ms đã sang cửa sổ mới
+ * @return true nếu cửa sổ cũ có dữ liệu và output vừa được điền
+ *
+ * Timestamp lùi (đồng hồ bị chỉnh) được cộng vào cửa sổ hiện tại.
+ */
+bool RollupStage::roll(Window& window, std::int64_t time_ms) {
+  const std::int64_t start = floorTo(time_ms, window.resolution.period_ms);
+  if (window.start_ms < 0) {
+    window.start_ms = start;
+    return false;
+  }
+  if (start <= window.start_ms) return false;
+
+  bool any = false;
+  Sample& output = window.output;
+  for (std::size_t tag = 0; tag < window.stats.size(); ++tag) {
+    Stat& stat = window.stats[tag];
+    const std::size_t base = tag * kStatsPerTag;
+    const bool good = stat.count > 0;
+    for (std::size_t i = 0; i < kStatsPerTag; ++i) {
+      output.setGood(base + i, good);
+    }
+    if (good) {
+      output.values[base] = stat.min;
+      output.values[base + 1] = stat.max;
+      output.values[base + 2] = stat.sum / stat.count;
+      output.values[base + 3] = stat.last;
+      output.values[base + 4] = stat.count;
+      any = true;
+    }
+    stat.count = 0;
+  }
+  output.block_time_us[0] = window.start_ms * 1000;
+  window.start_ms = start;
+  return any;
+}
+
+void RollupStage::add(Window& window, std::size_t tag, double value) {
+  Stat& stat = window.stats[tag];
+  if (stat.count == 0) {
+    stat.min = stat.max = value;
+    stat.sum = 0.0;
+  } else {
+    if (value < stat.min) stat.min = value;
+    if (value > stat.max) stat.max = value;
+  }
+  stat.sum += value;
+  stat.last = value;
+  ++stat.count;
+}
+
+/**
+ * @brief Ghi trạng thái tích lũy ra file (tạm + fsync + rename)
+ *
+ * Chỉ dùng trên cùng máy nên ghi thẳng biểu diễn nhị phân của Stat.
+ */
+bool RollupStage::saveCheckpoint(const std::string& path) const {
+  const std::string tmp = path + ".tmp";
+  std::FILE* file = std::fopen(tmp.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  const std::uint32_t count = static_cast<std::uint32_t>(windows_.size());
+  bool ok = std::fwrite(kCheckpointMagic, 1, 4, file) == 4 &&
+            std::fwrite(&source_id_, sizeof(source_id_), 1, file) == 1 &&
+            std::fwrite(&count, sizeof(count), 1, file) == 1;
+  for (const Window& window : windows_) {
+    const std::uint32_t tags = static_cast<std::uint32_t>(window.stats.size());
+    ok = ok &&
+         std::fwrite(&window.resolution.period_ms,
+                     sizeof(window.resolution.period_ms), 1, file) == 1 &&
+         std::fwrite(&window.start_ms, sizeof(window.start_ms), 1, file) == 1 &&
+         std::fwrite(&tags, sizeof(tags), 1, file) == 1 &&
+         std::fwrite(window.stats.data(), sizeof(Stat), tags, file) == tags;
+  }
+  ok = std::fflush(file) == 0 && ok;
+  ok = fdatasync(fileno(file)) == 0 && ok;
+  ok = std::fclose(file) == 0 && ok;
+  return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * @brief Nạp trạng thái tích lũy đã lưu
+ * @return false nếu không có file, file hỏng hoặc thuộc schema/cấu hình khác
+ */
+bool RollupStage::loadCheckpoint(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) return false;
+
+  char magic[4];
+  std::uint32_t source_id = 0;
+  std::uint32_t count = 0;
+  bool ok = std::fread(magic, 1, 4, file) == 4 &&
+            std::memcmp(magic, kCheckpointMagic, 4) == 0 &&
+            std::fread(&source_id, sizeof(source_id), 1, file) == 1 &&
+            std::fread(&count, sizeof(count), 1, file) == 1 &&
+            source_id == source_id_ && count == windows_.size();
+
+  std::vector<std::int64_t> starts(windows_.size(), -1);
+  std::vector<std::vector<Stat> > stats(windows_.size());
+  for (std::size_t w = 0; ok && w < windows_.size(); ++w) {
+    std::int64_t period_ms = 0;
+    std::uint32_t tags = 0;
+    ok = std::fread(&period_ms, sizeof(period_ms), 1, file) == 1 &&
+         std::fread(&starts[w], sizeof(starts[w]), 1, file) == 1 &&
+         std::fread(&tags, sizeof(tags), 1, file) == 1 &&
+         period_ms == windows_[w].resolution.period_ms &&
+         tags == windows_[w].stats.size();
+    if (!ok) break;
+    stats[w].resize(tags);
+    ok = std::fread(stats[w].data(), sizeof(Stat), tags, file) == tags;
+  }
+  std::fclose(file);
+  if (!ok) return false;
+
+  // Chi ap dung khi ca file hop le
+  for (std::size_t w = 0; w < windows_.size(); ++w) {
+    windows_[w].start_ms = starts[w];
+    windows_[w].stats.swap(stats[w]);
+  }
+  return true;
+}
+
+}  // namespace telemetry
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sample.h"
+#include "telemetry.h"
+
+// Tong hop theo cua so thoi gian (min/max/avg/last/count) tren luong Sample.
+//
+// Cua so canh theo epoch (1m: hh:mm:00, 15m: hh:00/15/30/45, 1h: hh:00). Moi
+// do phan giai co mot bo tich luy O(1) cho moi tag; khi timestamp cua mot
+// block vuot qua cuoi cua so, cua so dong va duoc xuat thanh frame telemetry
+// binh thuong (kind = data, khong delta) voi schema rieng:
+//   <tag>.min, <tag>.max, <tag>.avg, <tag>.last, <tag>.count
+// tren topic rollup/<ten>/<device_id>, schema tren rollup/schema/<ten>/<id>.
+// Consumer dung lai telemetry::Decoder de giai ma.
+namespace telemetry {
+
+struct Resolution {
+  std::string name;  // "1m", "15m", "1h"
+  std::int64_t period_ms;
+};
+
+// 1m, 15m, 1h
+std::vector<Resolution> defaultResolutions();
+
+std::string rollupTopic(const std::string& resolution,
+                        const std::string& device_id);
+std::string rollupSchemaTopic(const std::string& resolution,
+                              const std::string& device_id);
+
+/**
+ * @brief Bo tong hop nhieu do phan giai cho mot thiet bi
+ *
+ * update() chi cong cac block co timestamp moi (block vua duoc doc), nen goi
+ * sau moi readPollClass() khong dem trung tag cua lop chu ky khac. Khong cap
+ * phat trong update(); cac Sample dau ra duoc cap phat mot lan.
+ */
+class RollupStage {
+ public:
+  RollupStage(const SampleSchema& schema, const Schema& wire_schema,
+              const std::vector<Resolution>& resolutions);
+
+  std::size_t resolutionCount() const { return windows_.size(); }
+  const Resolution& resolution(std::size_t index) const {
+    return windows_[index].resolution;
+  }
+  // Schema truyen cua frame tong hop (giong nhau cho moi do phan giai)
+  const Schema& schema() const { return schema_; }
+
+  /**
+   * @brief Cong sample vao moi cua so
+   * @param on_close Goi voi (chi so do phan giai, sample tong hop) cho moi
+   *                 cua so vua dong, truoc khi cong gia tri moi
+   */
+  template <typename Handler>
+  void update(const Sample& sample, Handler on_close);
+
+  // Luu/nap trang thai tich luy (ghi file tam + rename). Checkpoint cua
+  // schema khac (cau hinh doi) bi bo qua.
+  bool saveCheckpoint(const std::string& path) const;
+  bool loadCheckpoint(const std::string& path);
+
+ private:
+  struct Stat {
+    double min;
+    double max;
+    double sum;
+    double last;
+    std::uint32_t count;
+  };
+
+  struct Window {
+    Resolution resolution;
+    std::int64_t start_ms = -1;  // -1: chua mo
+    std::vector<Stat> stats;
+    Sample output;
+  };
+
+  // Dong cua so chua timestamp cu, mo cua so moi chua time_ms; tra ve true
+  // neu output vua duoc dien
+  bool roll(Window& window, std::int64_t time_ms);
+  void add(Window& window, std::size_t tag, double value);
+
+  std::uint32_t source_id_;
+  std::vector<std::uint16_t> tag_blocks_;
+  std::vector<std::int64_t> seen_us_;  // timestamp block da cong
+  std::vector<std::uint8_t> fresh_;    // block moi trong lan update nay
+  Schema schema_;
+  std::vector<Window> windows_;
+};
+
+template <typename Handler>
+void RollupStage::update(const Sample& sample, Handler on_close) {
+  const std::size_t blocks = sample.block_time_us.size();
+  if (seen_us_.size() != blocks) {
+    seen_us_.assign(blocks, 0);
+    fresh_.assign(blocks, 0);
+  }
+
+  // Block moi doc: timestamp khac lan truoc
+  std::int64_t latest_us = 0;
+  for (std::size_t block = 0; block < blocks; ++block) {
+    const std::int64_t time_us = sample.block_time_us[block];
+    fresh_[block] = time_us != 0 && time_us != seen_us_[block];
+    if (!fresh_[block]) continue;
+    seen_us_[block] = time_us;
+    if (time_us > latest_us) latest_us = time_us;
+  }
+  if (latest_us == 0) return;
+
+  // Dong cac cua so da qua truoc khi cong gia tri moi
+  for (std::size_t w = 0; w < windows_.size(); ++w) {
+    if (roll(windows_[w], latest_us / 1000)) on_close(w, windows_[w].output);
+  }
+
+  const std::size_t tags =
+      tag_blocks_.size() < sample.size() ? tag_blocks_.size() : sample.size();
+  for (std::size_t tag = 0; tag < tags; ++tag) {
+    const std::uint16_t block = tag_blocks_[tag];
+    if (block >= blocks || !fresh_[block] || !sample.good(tag)) continue;
+    for (Window& window : windows_) add(window, tag, sample.values[tag]);
+  }
+}
+
+}  // namespace telemetry
@@ -0,0 +1,518 @@
+#include "telemetry.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace telemetry {
+
+namespace {
+
+const std::size_t kHeaderSize = 2 + 1 + 1 + 1 + 4 + 4 + 8 + 2;
+
+void putU8(Payload& out, std::uint8_t value) { out.push_back(value); }
+
+void putU16(Payload& out, std::uint16_t value) {
+  out.push_back(static_cast<std::uint8_t>(value));
+  out.push_back(static_cast<std::uint8_t>(value >> 8));
+}
+
+void putU32(Payload& out, std::uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+void putU64(Payload& out, std::uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+void putF32(Payload& out, float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putU32(out, bits);
+}
+
+void putF64(Payload& out, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  putU64(out, bits);
+}
+
+void putVarint(Payload& out, std::int64_t value) {
+  // zigzag: so am nho cung chi ton it byte
+  std::uint64_t zigzag = (static_cast<std::uint64_t>(value) << 1) ^
+                         static_cast<std::uint64_t>(value >> 63);
+  while (zigzag >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(zigzag | 0x80));
+    zigzag >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(zigzag));
+}
+
+void putString(Payload& out, const std::string& text) {
+  const std::size_t size = text.size() < 255 ? text.size() : 255;
+  putU8(out, static_cast<std::uint8_t>(size));
+  out.insert(out.end(), text.begin(), text.begin() + size);
+}
+
+// Doc tuan tu tu buffer, ok() = false khi doc qua cuoi
+class Reader {
+ public:
+  Reader(const std::uint8_t* data, std::size_t size)
+      : data_(data), size_(size), pos_(0), ok_(true) {}
+
+  bool ok() const { return ok_; }
+  bool atEnd() const { return pos_ == size_; }
+
+  std::uint64_t fixed(int bytes) {
+    if (!need(bytes)) return 0;
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      value |= static_cast<std::uint64_t>(data_[pos_ + i]) << (8 * i);
+    }
+    pos_ += bytes;
+    return value;
+  }
+
+  float f32() {
+    std::uint32_t bits = static_cast<std::uint32_t>(fixed(4));
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  double f64() {
+    std::uint64_t bits = fixed(8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  std::int64_t varint() {
+    std::uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (!need(1)) return 0;
+      std::uint8_t byte = data_[pos_++];
+      zigzag |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return static_cast<std::int64_t>(zigzag >> 1) ^
+               -static_cast<std::int64_t>(zigzag & 1);
+      }
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  std::string string() {
+    std::size_t size = static_cast<std::size_t>(fixed(1));
+    if (!need(size)) return std::string();
+    std::string text(reinterpret_cast<const char*>(data_ + pos_), size);
+    pos_ += size;
+    return text;
+  }
+
+  const std::uint8_t* bytes(std::size_t size) {
+    if (!need(size)) return nullptr;
+    const std::uint8_t* ptr = data_ + pos_;
+    pos_ += size;
+    return ptr;
+  }
+
+ private:
+  bool need(std::size_t bytes) {
+    if (!ok_ || size_ - pos_ < bytes) {
+      ok_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  const std::uint8_t* data_;
+  std::size_t size_;
+  std::size_t pos_;
+  bool ok_;
+};
+
+void putHeader(Payload& out, std::uint8_t kind, std::uint8_t flags,
+               std::uint32_t schema_id, std::uint32_t seq,
+               std::int64_t timestamp_us, std::uint16_t count) {
+  putU8(out, 'M');
+  putU8(out, 'T');
+  putU8(out, kVersion);
+  putU8(out, kind);
+  putU8(out, flags);
+  putU32(out, schema_id);
+  putU32(out, seq);
+  putU64(out, static_cast<std::uint64_t>(timestamp_us));
+  putU16(out, count);
+}
+
+std::uint32_t fnv1a(const std::uint8_t* data, std::size_t size) {
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Noi dung schema (khong gom header), dung chung cho ma hoa va tinh id
+void putSchemaBody(Payload& out, const Schema& schema) {
+  putString(out, schema.device_id);
+  for (const TagInfo& tag : schema.tags) {
+    putString(out, tag.name);
+    putU8(out, static_cast<std::uint8_t>(tag.wire));
+    putF64(out, tag.scale);
+    putF64(out, tag.offset);
+  }
+}
+
+std::int64_t quantize(const TagInfo& tag, double value) {
+  return static_cast<std::int64_t>(
+      std::llround((value - tag.offset) / tag.scale));
+}
+
+}  // namespace
+
+std::string dataTopic(const std::string& device_id) {
+  return "telemetry/" + device_id;
+}
+
+std::string schemaTopic(const std::string& device_id) {
+  return "telemetry/schema/" + device_id;
+}
+
+/**
+ * @brief Tạo schema truyền từ bảng tag của driver và cấu hình thanh ghi
+ *
+ * Tag số nguyên được truyền dạng scaled (varint của giá trị thô), nên với
+ * chế độ delta các bộ đếm năng lượng chỉ tốn 1-2 byte mỗi frame. Tag float
+ * giữ nguyên độ chính xác của kiểu gốc.
+ */
+Schema makeSchema(const SampleSchema& sample_schema, const MeterConfig& config) {
+  Schema schema;
+  schema.device_id = sample_schema.deviceId();
+
+  for (std::size_t i = 0; i < sample_schema.size(); ++i) {
+    TagInfo tag;
+    tag.name = sample_schema.name(i);
+    tag.wire = WireType::kFloat64;
+    tag.scale = 1.0;
+    tag.offset = 0.0;
+
+    std::map<std::string, RegisterConfig>::const_iterator it =
+        config.registers->find(tag.name);
+    if (it != config.registers->end()) {
+      const RegisterConfig& reg = it->second;
+      if (reg.type == DataType::kFloat32) {
+        tag.wire = WireType::kFloat32;
+      } else if (reg.type != DataType::kFloat64 && reg.scale != 0.0) {
+        tag.wire = WireType::kScaled;
+        tag.scale = reg.scale;
+        tag.offset = reg.offset;
+      }
+    }
+    schema.tags.push_back(tag);
+  }
+
+  schema.id = schemaId(schema);
+  return schema;
+}
+
+std::vector<Deadband> makeDeadbands(const SampleSchema& sample_schema,
+                                    const MeterConfig& config) {
+  std::vector<Deadband> deadbands(sample_schema.size());
+  for (std::size_t i = 0; i < sample_schema.size(); ++i) {
+    std::map<std::string, RegisterConfig>::const_iterator it =
+        config.registers->find(sample_schema.name(i));
+    if (it == config.registers->end()) continue;
+    deadbands[i].absolute = it->second.deadband;
+    deadbands[i].percent = it->second.deadband_pct;
+  }
+  return deadbands;
+}
+
+std::uint32_t schemaId(const Schema& schema) {
+  Payload body;
+  putSchemaBody(body, schema);
+  return fnv1a(body.data(), body.size());
+}
+
+void encodeSchema(const Schema& schema, Payload& out) {
+  out.clear();
+  putHeader(out, kKindSchema, 0, schema.id, 0, 0,
+            static_cast<std::uint16_t>(schema.tags.size()));
+  putSchemaBody(out, schema);
+}
+
+bool decodeSchema(const std::uint8_t* data, std::size_t size, Schema* schema) {
+  Reader reader(data, size);
+  if (reader.fixed(1) != 'M' || reader.fixed(1) != 'T' ||
+      reader.fixed(1) != kVersion || reader.fixed(1) != kKindSchema) {
+    return false;
+  }
+  reader.fixed(1);  // flags
+  Schema result;
+  result.id = static_cast<std::uint32_t>(reader.fixed(4));
+  reader.fixed(4);  // seq
+  reader.fixed(8);  // timestamp
+  std::size_t count = static_cast<std::size_t>(reader.fixed(2));
+
+  result.device_id = reader.string();
+  for (std::size_t i = 0; i < count && reader.ok(); ++i) {
+    TagInfo tag;
+    tag.name = reader.string();
+    std::uint8_t wire = static_cast<std::uint8_t>(reader.fixed(1));
+    if (wire < 1 || wire > 3) return false;
+    tag.wire = static_cast<WireType>(wire);
+    tag.scale = reader.f64();
+    tag.offset = reader.f64();
+    result.tags.push_back(tag);
+  }
+  if (!reader.ok() || !reader.atEnd()) return false;
+
+  *schema = result;
+  return true;
+}
+
+Encoder::Encoder(const Schema& schema, bool delta,
+                 std::uint32_t keyframe_interval)
+    : schema_(schema),
+      delta_(delta),
+      keyframe_interval_(keyframe_interval > 0 ? keyframe_interval : 1),
+      prev_(schema.tags.size(), 0),
+      anchored_(schema.tags.size(), 0) {}
+
+void Encoder::setExceptionReporting(const std::vector<Deadband>& deadbands,
+                                    std::int64_t max_silence_us) {
+  const std::size_t count = schema_.tags.size();
+  sparse_ = true;
+  deadbands_ = deadbands;
+  deadbands_.resize(count);
+  max_silence_us_ = max_silence_us;
+  sent_value_.assign(count, 0.0);
+  sent_good_.assign(count, 0);
+  sent_time_us_.assign(count, 0);
+  present_.assign(count, 1);
+  force_keyframe_ = true;
+}
+
+/**
+ * @brief Mã hóa một Sample thành frame dữ liệu
+ * @param sample Sample cùng bảng tag với schema
+ * @param out Buffer đích, được ghi lại từ đầu
+ * @return false nếu ở chế độ report-by-exception và không tag nào cần gửi
+ *
+ * Tag scaled chỉ được gửi dạng hiệu số khi đã có giá trị gốc kể từ keyframe
+ * gần nhất (anchored); decoder theo dõi cùng quy tắc nên hai bên luôn khớp.
+ * Ở chế độ report-by-exception, tag được gửi khi quality đổi, giá trị lệch
+ * khỏi lần gửi trước quá deadband hoặc đã im lặng quá max_silence; frame
+ * định kỳ (keyframe_interval) vẫn gửi đầy đủ.
+ */
+bool Encoder::encode(const Sample& sample, Payload& out) {
+  const std::size_t count =
+      sample.size() < schema_.tags.size() ? sample.size() : schema_.tags.size();
+  const bool periodic = force_keyframe_ || seq_ % keyframe_interval_ == 0;
+  const bool keyframe = !delta_ || periodic;
+  const bool sparse = sparse_ && !periodic;
+
+  std::int64_t timestamp_us = 0;
+  for (std::int64_t block_time : sample.block_time_us) {
+    if (block_time > timestamp_us) timestamp_us = block_time;
+  }
+
+  out.clear();
+  if (sparse_) {
+    bool any = false;
+    for (std::size_t tag = 0; tag < count; ++tag) {
+      const bool good = sample.good(tag);
+      const double value = sample.values[tag];
+      bool send = !sparse || good != (sent_good_[tag] != 0);
+      if (!send && good) {
+        const Deadband& band = deadbands_[tag];
+        const double diff = std::fabs(value - sent_value_[tag]);
+        double threshold = band.percent / 100.0 * std::fabs(sent_value_[tag]);
+        if (band.absolute > threshold) threshold = band.absolute;
+        send = threshold > 0.0 ? diff > threshold : value != sent_value_[tag];
+      }
+      if (!send && max_silence_us_ > 0) {
+        send = timestamp_us - sent_time_us_[tag] >= max_silence_us_;
+      }
+      present_[tag] = send;
+      if (!send) continue;
+      any = true;
+      sent_good_[tag] = good;
+      sent_time_us_[tag] = timestamp_us;
+      if (good) sent_value_[tag] = value;
+    }
+    if (!any) return false;
+  }
+  force_keyframe_ = false;
+
+  std::uint8_t flags = 0;
+  if (delta_) flags |= kFlagDelta;
+  if (keyframe) flags |= kFlagKeyframe;
+  if (sparse) flags |= kFlagSparse;
+
+  putHeader(out, kKindData, flags, schema_.id, seq_++, timestamp_us,
+            static_cast<std::uint16_t>(count));
+
+  // Bitmask present (chi frame sparse) va quality: 8 tag moi byte
+  if (sparse) {
+    for (std::size_t base = 0; base < count; base += 8) {
+      std::uint8_t bits = 0;
+      for (std::size_t bit = 0; bit < 8 && base + bit < count; ++bit) {
+        if (present_[base + bit]) bits |= 1u << bit;
+      }
+      putU8(out, bits);
+    }
+  }
+  for (std::size_t base = 0; base < count; base += 8) {
+    std::uint8_t bits = 0;
+    for (std::size_t bit = 0; bit < 8 && base + bit < count; ++bit) {
+      if (sample.good(base + bit)) bits |= 1u << bit;
+    }
+    putU8(out, bits);
+  }
+
+  if (keyframe) anchored_.assign(anchored_.size(), 0);
+
+  for (std::size_t tag = 0; tag < count; ++tag) {
+    if (!sample.good(tag) || (sparse && !present_[tag])) continue;
+    const TagInfo& info = schema_.tags[tag];
+    const double value = sample.values[tag];
+
+    switch (info.wire) {
+      case WireType::kFloat32:
+        putF32(out, static_cast<float>(value));
+        break;
+      case WireType::kFloat64:
+        putF64(out, value);
+        break;
+      case WireType::kScaled: {
+        const std::int64_t scaled = quantize(info, value);
+        putVarint(out, delta_ && anchored_[tag] ? scaled - prev_[tag] : scaled);
+        prev_[tag] = scaled;
+        anchored_[tag] = 1;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void Decoder::addSchema(const Schema& schema) {
+  // Schema duoc nhac lai dinh ky; cung id thi cung noi dung, giu trang thai
+  if (states_.count(schema.id)) return;
+  State& state = states_[schema.id];
+  state.schema = schema;
+  state.synced = false;
+  state.prev.assign(schema.tags.size(), 0);
+  state.anchored.assign(schema.tags.size(), 0);
+}
+
+const Schema* Decoder::findSchema(std::uint32_t id) const {
+  std::map<std::uint32_t, State>::const_iterator it = states_.find(id);
+  return it != states_.end() ? &it->second.schema : nullptr;
+}
+
+Decoder::Result Decoder::decode(const std::uint8_t* data, std::size_t size,
+                                Frame* frame) {
+  if (size < kHeaderSize) return kMalformed;
+
+  Reader reader(data, size);
+  if (reader.fixed(1) != 'M' || reader.fixed(1) != 'T' ||
+      reader.fixed(1) != kVersion || reader.fixed(1) != kKindData) {
+    return kMalformed;
+  }
+  const std::uint8_t flags = static_cast<std::uint8_t>(reader.fixed(1));
+  frame->schema_id = static_cast<std::uint32_t>(reader.fixed(4));
+  frame->seq = static_cast<std::uint32_t>(reader.fixed(4));
+  frame->timestamp_us = static_cast<std::int64_t>(reader.fixed(8));
+  const std::size_t count = static_cast<std::size_t>(reader.fixed(2));
+  frame->delta = (flags & kFlagDelta) != 0;
+  frame->keyframe = (flags & kFlagKeyframe) != 0;
+  frame->sparse = (flags & kFlagSparse) != 0;
+
+  std::map<std::uint32_t, State>::iterator it = states_.find(frame->schema_id);
+  if (it == states_.end()) return kUnknownSchema;
+  State& state = it->second;
+  if (count != state.schema.tags.size()) return kMalformed;
+
+  // Frame delta chi giai ma duoc khi khong mat frame nao ke tu keyframe
+  if (frame->delta && !frame->keyframe &&
+      (!state.synced || frame->seq != state.last_seq + 1)) {
+    state.synced = false;
+    return kNeedKeyframe;
+  }
+
+  const std::uint8_t* present =
+      frame->sparse ? reader.bytes((count + 7) / 8) : nullptr;
+  const std::uint8_t* quality = reader.bytes((count + 7) / 8);
+  if (quality == nullptr) return kMalformed;
+
+  frame->present.assign(count, 1);
+  frame->good.assign(count, 0);
+  frame->values.assign(count, 0.0);
+  if (frame->keyframe) state.anchored.assign(count, 0);
+
+  for (std::size_t tag = 0; tag < count; ++tag) {
+    if (present != nullptr && ((present[tag >> 3] >> (tag & 7)) & 1) == 0) {
+      frame->present[tag] = 0;
+      continue;
+    }
+    if (((quality[tag >> 3] >> (tag & 7)) & 1) == 0) continue;
+    const TagInfo& info = state.schema.tags[tag];
+
+    switch (info.wire) {
+      case WireType::kFloat32:
+        frame->values[tag] = reader.f32();
+        break;
+      case WireType::kFloat64:
+        frame->values[tag] = reader.f64();
+        break;
+      case WireType::kScaled: {
+        std::int64_t scaled = reader.varint();
+        if (frame->delta && state.anchored[tag]) scaled += state.prev[tag];
+        state.prev[tag] = scaled;
+        state.anchored[tag] = 1;
+        frame->values[tag] =
+            static_cast<double>(scaled) * info.scale + info.offset;
+        break;
+      }
+    }
+    frame->good[tag] = 1;
+  }
+
+  if (!reader.ok() || !reader.atEnd()) {
+    state.synced = false;
+    return kMalformed;
+  }
+
+  state.synced = true;
+  state.last_seq = frame->seq;
+  return kOk;
+}
+
+std::string toJson(const Schema& schema, const Frame& frame) {
+  std::ostringstream ss;
+  ss.precision(10);
+  ss << "{ \"device\": \"" << schema.device_id << "\", \"schema\": "
+     << schema.id << ", \"seq\": " << frame.seq
+     << ", \"ts_us\": " << frame.timestamp_us << ", \"data\": { ";
+
+  bool first = true;
+  for (std::size_t tag = 0; tag < frame.values.size(); ++tag) {
+    if (!frame.good[tag]) continue;
+    if (!first) ss << ", ";
+    ss << "\"" << schema.tags[tag].name << "\": " << frame.values[tag];
+    first = false;
+  }
+  ss << " } }";
+  return ss.str();
+}
+
+}  // namespace telemetry
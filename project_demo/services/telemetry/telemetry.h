@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "meter_config.h"
+#include "sample.h"
+
+// Dinh dang frame telemetry nhi phan (little-endian):
+//
+//   'M' 'T' | version u8 | kind u8 | flags u8 | schema_id u32 | seq u32
+//   | timestamp_us i64 | count u16 | quality (count + 7) / 8 byte | values
+//
+// kind = 1 (data): values chi gom cac tag co bit quality = 1, theo thu tu tag.
+//   float32 -> 4 byte, float64 -> 8 byte, scaled -> varint zigzag cua
+//   round((v - offset) / scale); o che do delta (flags bit 0) gia tri scaled
+//   la hieu so voi lan gui truoc, keyframe (flags bit 1) luon gui tuyet doi.
+//   Frame sparse (flags bit 2, report-by-exception): truoc bitmask quality co
+//   them bitmask present cung do dai; chi tag co bit present = 1 (gia tri
+//   vuot deadband, quality doi hoac qua max_silence) co mat trong frame, tag
+//   vang mat giu gia tri lan truoc. Keyframe luon day du.
+// kind = 2 (schema): device_id, danh sach tag (ten, kieu truyen, scale,
+//   offset). Duoc publish tren topic rieng va nhac lai dinh ky de subscriber
+//   moi vao van giai ma duoc (thay cho retained message).
+namespace telemetry {
+
+typedef std::vector<std::uint8_t> Payload;
+
+const std::uint8_t kVersion = 1;
+const std::uint8_t kKindData = 1;
+const std::uint8_t kKindSchema = 2;
+const std::uint8_t kFlagDelta = 0x01;
+const std::uint8_t kFlagKeyframe = 0x02;
+const std::uint8_t kFlagSparse = 0x04;
+
+// Kieu truyen cua mot tag
+enum class WireType : std::uint8_t { kFloat32 = 1, kFloat64 = 2, kScaled = 3 };
+
+struct TagInfo {
+  std::string name;
+  WireType wire;
+  double scale;
+  double offset;
+};
+
+struct Schema {
+  std::uint32_t id = 0;  // FNV-1a cua noi dung schema
+  std::string device_id;
+  std::vector<TagInfo> tags;
+};
+
+// Deadband cua mot tag: gia tri moi duoc gui khi lech so voi lan gui truoc
+// qua max(absolute, percent% * |gia tri truoc|); ca hai bang 0 -> gui moi
+// khi gia tri thay doi
+struct Deadband {
+  double absolute = 0.0;
+  double percent = 0.0;
+};
+
+// Loai frame (kKindData/kKindSchema), 0 neu khong phai frame telemetry
+inline std::uint8_t frameKind(const std::uint8_t* data, std::size_t size) {
+  if (size < 4 || data[0] != 'M' || data[1] != 'T' || data[2] != kVersion) {
+    return 0;
+  }
+  return data[3];
+}
+
+// Topic du lieu va topic schema cua mot thiet bi
+std::string dataTopic(const std::string& device_id);
+std::string schemaTopic(const std::string& device_id);
+
+// Schema tu bang tag cua driver: tag so nguyen -> scaled, float -> float
+Schema makeSchema(const SampleSchema& sample_schema, const MeterConfig& config);
+
+// Deadband cua tung tag theo thu tu cua schema, lay tu cau hinh thanh ghi
+std::vector<Deadband> makeDeadbands(const SampleSchema& sample_schema,
+                                    const MeterConfig& config);
+
+// Ma bam (FNV-1a) cua noi dung schema, dung lam Schema::id
+std::uint32_t schemaId(const Schema& schema);
+
+void encodeSchema(const Schema& schema, Payload& out);
+bool decodeSchema(const std::uint8_t* data, std::size_t size, Schema* schema);
+
+/**
+ * @brief Ma hoa Sample thanh frame nhi phan
+ *
+ * out duoc clear() roi ghi lai, dung lai cung mot buffer thi sau frame dau
+ * tien khong con cap phat. O che do delta cu keyframe_interval frame co mot
+ * keyframe de subscriber moi vao hoac mat frame dong bo lai.
+ *
+ * Sau setExceptionReporting() encoder chi gui tag thay doi (frame sparse) va
+ * encode() tra ve false khi khong co tag nao can gui.
+ */
+class Encoder {
+ public:
+  Encoder(const Schema& schema, bool delta,
+          std::uint32_t keyframe_interval = 100);
+
+  // false: khong co gi de gui (che do report-by-exception), out rong
+  bool encode(const Sample& sample, Payload& out);
+
+  // Bat report-by-exception: deadbands theo thu tu tag, max_silence_us > 0
+  // thi tag khong doi van duoc gui lai sau chung ay thoi gian (heartbeat)
+  void setExceptionReporting(const std::vector<Deadband>& deadbands,
+                             std::int64_t max_silence_us);
+
+  // Frame ke tiep la keyframe (vd sau khi publish lai schema)
+  void forceKeyframe() { force_keyframe_ = true; }
+
+  const Schema& schema() const { return schema_; }
+  std::uint32_t sequence() const { return seq_; }
+
+ private:
+  Schema schema_;
+  bool delta_;
+  std::uint32_t keyframe_interval_;
+  std::uint32_t seq_ = 0;
+  bool force_keyframe_ = true;
+  std::vector<std::int64_t> prev_;    // gia tri scaled lan gui truoc
+  std::vector<std::uint8_t> anchored_;  // tag da co gia tri goc tu keyframe
+
+  // Report-by-exception
+  bool sparse_ = false;
+  std::vector<Deadband> deadbands_;
+  std::int64_t max_silence_us_ = 0;
+  std::vector<double> sent_value_;       // gia tri lan gui truoc
+  std::vector<std::uint8_t> sent_good_;  // quality lan gui truoc
+  std::vector<std::int64_t> sent_time_us_;
+  std::vector<std::uint8_t> present_;
+};
+
+// Frame da giai ma; values chi co nghia voi tag co good[tag] = 1. Voi frame
+// sparse, tag co present[tag] = 0 khong doi so voi frame truoc (good = 0).
+struct Frame {
+  std::uint32_t schema_id = 0;
+  std::uint32_t seq = 0;
+  std::int64_t timestamp_us = 0;
+  bool delta = false;
+  bool keyframe = false;
+  bool sparse = false;
+  std::vector<std::uint8_t> present;
+  std::vector<std::uint8_t> good;
+  std::vector<double> values;
+};
+
+/**
+ * @brief Giai ma frame du lieu, giu trang thai delta cho moi schema
+ */
+class Decoder {
+ public:
+  enum Result { kOk, kUnknownSchema, kMalformed, kNeedKeyframe };
+
+  // Them/cap nhat schema (tu topic schema)
+  void addSchema(const Schema& schema);
+  const Schema* findSchema(std::uint32_t id) const;
+
+  Result decode(const std::uint8_t* data, std::size_t size, Frame* frame);
+
+ private:
+  struct State {
+    Schema schema;
+    bool synced = false;
+    std::uint32_t last_seq = 0;
+    std::vector<std::int64_t> prev;
+    std::vector<std::uint8_t> anchored;
+  };
+  std::map<std::uint32_t, State> states_;
+};
+
+// Hien thi frame duoi dang JSON, chi danh cho cong cu debug
+std::string toJson(const Schema& schema, const Frame& frame);
+
+}  // namespace telemetry
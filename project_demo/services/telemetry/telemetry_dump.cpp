@@ -0,0 +1,84 @@
+// Cong cu debug: subscribe telemetry nhi phan va in ra JSON
+#include <zmq.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "telemetry.h"
+
+using namespace std;
+
+namespace {
+
+// Nhan mot phan cua message nhieu phan, tra ve false neu loi
+bool recvPart(void* socket, vector<uint8_t>& part, bool* more) {
+  zmq_msg_t msg;
+  zmq_msg_init(&msg);
+  if (zmq_msg_recv(&msg, socket, 0) < 0) {
+    zmq_msg_close(&msg);
+    return false;
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(zmq_msg_data(&msg));
+  part.assign(data, data + zmq_msg_size(&msg));
+  *more = zmq_msg_more(&msg) != 0;
+  zmq_msg_close(&msg);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const string endpoint = argc > 1 ? argv[1] : "tcp://localhost:5555";
+
+  void* context = zmq_ctx_new();
+  void* subscriber = zmq_socket(context, ZMQ_SUB);
+  if (zmq_connect(subscriber, endpoint.c_str()) != 0) {
+    cerr << "[FATAL] Khong ket noi duoc " << endpoint << endl;
+    return 1;
+  }
+  zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, "telemetry/", 10);
+  cout << "[DUMP] Dang nghe " << endpoint << endl;
+
+  telemetry::Decoder decoder;
+  telemetry::Frame frame;
+  vector<uint8_t> topic;
+  vector<uint8_t> payload;
+
+  for (;;) {
+    bool more = false;
+    if (!recvPart(subscriber, topic, &more)) break;
+    if (!more) continue;  // frame telemetry luon co 2 phan: topic + payload
+    if (!recvPart(subscriber, payload, &more)) break;
+
+    const uint8_t kind = telemetry::frameKind(payload.data(), payload.size());
+    if (kind == telemetry::kKindSchema) {
+      telemetry::Schema schema;
+      if (telemetry::decodeSchema(payload.data(), payload.size(), &schema)) {
+        decoder.addSchema(schema);
+      }
+      continue;
+    }
+    if (kind != telemetry::kKindData) continue;
+
+    switch (decoder.decode(payload.data(), payload.size(), &frame)) {
+      case telemetry::Decoder::kOk:
+        cout << telemetry::toJson(*decoder.findSchema(frame.schema_id), frame)
+             << " (" << payload.size() << " bytes)" << endl;
+        break;
+      case telemetry::Decoder::kUnknownSchema:
+        cout << "[DUMP] Cho schema " << frame.schema_id << endl;
+        break;
+      case telemetry::Decoder::kNeedKeyframe:
+        cout << "[DUMP] Mat frame, cho keyframe" << endl;
+        break;
+      case telemetry::Decoder::kMalformed:
+        cerr << "[WARN] Frame loi (" << payload.size() << " bytes)" << endl;
+        break;
+    }
+  }
+
+  zmq_close(subscriber);
+  zmq_ctx_destroy(context);
+  return 0;
+}
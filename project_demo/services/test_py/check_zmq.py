@@ -3,9 +3,11 @@ import zmq
 context = zmq.Context()
 subscriber = context.socket(zmq.SUB)
 subscriber.connect("tcp://192.168.137.57:5555")  # IP của board
-subscriber.setsockopt_string(zmq.SUBSCRIBE, "")
+subscriber.setsockopt_string(zmq.SUBSCRIBE, "telemetry/")
 
+# Frame telemetry là nhị phân (services/telemetry/telemetry.h),
+# dùng telemetry_dump để xem dạng JSON
 print("Waiting for data from RK3506...")
 while True:
-    message = subscriber.recv_string()
-    print(f"Received: {message}")
+    topic, payload = subscriber.recv_multipart()
+    print(f"Received: {topic.decode()} ({len(payload)} bytes) {payload.hex()}")
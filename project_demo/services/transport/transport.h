@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace transport {
@@ -12,15 +15,67 @@ class Transport {
   typedef std::function<void(const std::string& channel, const Payload& data)>
       MessageHandler;
 
+  // Vung byte chi doc tro thang vao bo dem nhan (thay string_view/span cua
+  // C++17). owner giu bo dem song: handler can dung data sau khi callback tra
+  // ve thi giu lai mot ban sao cua owner, khong can copy byte.
+  struct Span {
+    const uint8_t* data;
+    std::size_t size;
+    std::shared_ptr<const void> owner;
+
+    std::string str() const {
+      return std::string(reinterpret_cast<const char*>(data), size);
+    }
+  };
+  typedef std::function<void(const Span& channel, const Span& data)>
+      SpanHandler;
+
   virtual ~Transport() = default;
   virtual bool open() = 0;
   virtual void close() = 0;
 
   // message sending
   virtual bool send(const std::string& channel, const Payload& data) = 0;
+  // Chuyen quyen so huu data cho transport (khong copy neu transport ho tro);
+  // mac dinh gui nhu ban copy
+  virtual bool send(const std::string& channel, Payload&& data) {
+    const Payload& copy = data;
+    return send(channel, copy);
+  }
+  // Gui ngay cac tin transport dang gom (neu co)
+  virtual bool flush() { return true; }
   virtual bool subscribe(const std::string& channel) = 0;
   virtual bool unsubscribe(const std::string& channel) = 0;
   // callback registration
   virtual void setMessageHandler(MessageHandler handler) = 0;
+  // Uu tien hon MessageHandler khi da dang ky. Mac dinh: chuyen qua
+  // MessageHandler, owner giu mot ban copy cua tin. nullptr chi go
+  // SpanHandler da dang ky (bo chuyen thanh no-op), khong dung toi
+  // MessageHandler do nguoi dung dat
+  virtual void setSpanHandler(SpanHandler handler) {
+    if (!handler) {
+      span_handler_.reset();
+      return;
+    }
+    span_handler_ = std::make_shared<const SpanHandler>(std::move(handler));
+    // weak_ptr: thread nhan khong giu handler sau khi da go
+    std::weak_ptr<const SpanHandler> weak = span_handler_;
+    setMessageHandler([weak](const std::string& channel, const Payload& data) {
+      const std::shared_ptr<const SpanHandler> handler = weak.lock();
+      if (!handler) return;
+      std::shared_ptr<const std::pair<std::string, Payload> > owner =
+          std::make_shared<std::pair<std::string, Payload> >(channel, data);
+      const Span channel_span = {
+          reinterpret_cast<const uint8_t*>(owner->first.data()),
+          owner->first.size(), owner};
+      const Span data_span = {owner->second.data(), owner->second.size(),
+                              owner};
+      (*handler)(channel_span, data_span);
+    });
+  }
+
+ private:
+  // SpanHandler cua bo chuyen mac dinh
+  std::shared_ptr<const SpanHandler> span_handler_;
 };
-}  // namespace transport
\ No newline at end of file
+}  // namespace transport
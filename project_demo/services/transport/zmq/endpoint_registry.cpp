@@ -0,0 +1,206 @@
+#include "endpoint_registry.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <zmq.hpp>
+
+#include "cJSON.h"
+
+namespace transport {
+
+namespace {
+
+const char kDefaultIpcDir[] = "/tmp/iot_gateway";
+
+std::string localHostName() {
+  char name[256] = {0};
+  if (gethostname(name, sizeof(name) - 1) != 0) return "localhost";
+  return name;
+}
+
+}  // namespace
+
+EndpointRegistry::EndpointRegistry(const std::string& process,
+                                   const std::string& host)
+    : process_(process),
+      host_(host.empty() ? localHostName() : host),
+      ipc_dir_(kDefaultIpcDir),
+      context_(std::make_shared<zmq::context_t>(1)) {}
+
+EndpointRegistry::~EndpointRegistry() = default;
+
+/**
+ * @brief Tải bảng dịch vụ từ file JSON
+ * @param filename Đường dẫn tệp JSON
+ * @return true nếu đọc được file và mọi dịch vụ hợp lệ
+ */
+bool EndpointRegistry::loadFromJson(const std::string& filename) {
+  std::ifstream file(filename.c_str());
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string json_content = buffer.str();
+  if (json_content.empty()) {
+    std::cerr << "ERROR: Khong the doc file hoac file rong: " << filename
+              << std::endl;
+    return false;
+  }
+
+  cJSON* root = cJSON_Parse(json_content.c_str());
+  if (root == nullptr) {
+    const char* error_ptr = cJSON_GetErrorPtr();
+    if (error_ptr != nullptr) {
+      std::cerr << "ERROR: Loi phan tich JSON truoc: " << error_ptr
+                << std::endl;
+    }
+    return false;
+  }
+
+  bool success = true;
+  const cJSON* ipc_dir = cJSON_GetObjectItemCaseSensitive(root, "ipc_dir");
+  if (cJSON_IsString(ipc_dir)) ipc_dir_ = ipc_dir->valuestring;
+
+  const cJSON* json_services =
+      cJSON_GetObjectItemCaseSensitive(root, "services");
+  if (!cJSON_IsObject(json_services)) {
+    std::cerr << "ERROR: Thieu muc 'services' trong " << filename << std::endl;
+    success = false;
+  } else {
+    for (const cJSON* item = json_services->child; item != nullptr;
+         item = item->next) {
+      const cJSON* host = cJSON_GetObjectItemCaseSensitive(item, "host");
+      const cJSON* process = cJSON_GetObjectItemCaseSensitive(item, "process");
+      const cJSON* port = cJSON_GetObjectItemCaseSensitive(item, "port");
+      Service service;
+      if (cJSON_IsString(host)) service.host = host->valuestring;
+      if (cJSON_IsString(process)) service.process = process->valuestring;
+      if (cJSON_IsNumber(port)) service.port = port->valueint;
+      if (service.port < 0 || service.port > 65535 ||
+          (!isLocalHost(service.host) && service.port == 0)) {
+        std::cerr << "ERROR: Dich vu '" << item->string
+                  << "' o may khac phai co port tcp hop le" << std::endl;
+        success = false;
+        continue;
+      }
+      services_[item->string] = service;
+    }
+  }
+  cJSON_Delete(root);
+
+  if (success) {
+    std::cout << "[INFO] Tai bang endpoint: " << services_.size()
+              << " dich vu, ipc_dir " << ipc_dir_ << std::endl;
+  }
+  return success;
+}
+
+void EndpointRegistry::add(const std::string& name, const Service& service) {
+  services_[name] = service;
+}
+
+bool EndpointRegistry::isLocalHost(const std::string& host) const {
+  return host.empty() || host == "localhost" || host == host_;
+}
+
+EndpointRegistry::Scheme EndpointRegistry::schemeFor(
+    const std::string& name) const {
+  std::map<std::string, Service>::const_iterator it = services_.find(name);
+  if (it == services_.end()) return kUnknown;
+  if (!isLocalHost(it->second.host)) return kTcp;
+  return it->second.process == process_ ? kInproc : kIpc;
+}
+
+std::string EndpointRegistry::connectEndpoint(const std::string& name) const {
+  switch (schemeFor(name)) {
+    case kInproc:
+      return "inproc://" + name;
+    case kIpc:
+      return "ipc://" + ipc_dir_ + "/" + name;
+    case kTcp: {
+      const Service& service = services_.find(name)->second;
+      return "tcp://" + service.host + ":" + std::to_string(service.port);
+    }
+    default:
+      return "";
+  }
+}
+
+std::vector<std::string> EndpointRegistry::bindEndpoints(
+    const std::string& name) const {
+  std::vector<std::string> endpoints;
+  std::map<std::string, Service>::const_iterator it = services_.find(name);
+  if (it == services_.end()) return endpoints;
+  const Service& service = it->second;
+  if (isLocalHost(service.host)) {
+    if (service.process == process_) endpoints.push_back("inproc://" + name);
+    endpoints.push_back("ipc://" + ipc_dir_ + "/" + name);
+  }
+  if (service.port > 0) {
+    endpoints.push_back("tcp://*:" + std::to_string(service.port));
+  }
+  return endpoints;
+}
+
+/**
+ * @brief Bind socket vào mọi địa chỉ của dịch vụ
+ * @return true nếu bind được ít nhất một địa chỉ
+ *
+ * Địa chỉ lỗi chỉ được báo log: dịch vụ vẫn chạy với các kênh còn lại.
+ */
+bool EndpointRegistry::bind(void* socket, const std::string& name) const {
+  const std::vector<std::string> endpoints = bindEndpoints(name);
+  if (endpoints.empty()) {
+    std::cerr << "ERROR: Dich vu '" << name << "' chua khai bao" << std::endl;
+    return false;
+  }
+  if (mkdir(ipc_dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "[WARN] Khong tao duoc " << ipc_dir_ << ": "
+              << std::strerror(errno) << std::endl;
+  }
+  int bound = 0;
+  for (const std::string& endpoint : endpoints) {
+    if (zmq_bind(socket, endpoint.c_str()) == 0) {
+      ++bound;
+    } else {
+      std::cerr << "[WARN] Khong bind duoc " << endpoint << ": "
+                << zmq_strerror(zmq_errno()) << std::endl;
+    }
+  }
+  return bound > 0;
+}
+
+bool EndpointRegistry::connect(void* socket, const std::string& name) const {
+  const std::string endpoint = connectEndpoint(name);
+  if (endpoint.empty()) {
+    std::cerr << "ERROR: Dich vu '" << name << "' chua khai bao" << std::endl;
+    return false;
+  }
+  if (zmq_connect(socket, endpoint.c_str()) != 0) {
+    std::cerr << "[FAIL] Khong connect duoc " << endpoint << ": "
+              << zmq_strerror(zmq_errno()) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void* EndpointRegistry::rawContext() const { return context_->handle(); }
+
+const char* EndpointRegistry::schemeName(Scheme scheme) {
+  switch (scheme) {
+    case kInproc:
+      return "inproc";
+    case kIpc:
+      return "ipc";
+    case kTcp:
+      return "tcp";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace transport
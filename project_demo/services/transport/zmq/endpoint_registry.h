@@ -0,0 +1,89 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zmq {
+class context_t;
+}
+
+namespace transport {
+
+/**
+ * @brief Bang ten logic cua dich vu -> dia chi ZMQ, chon kenh re nhat
+ *
+ * Moi dich vu khai bao may (host) va tien trinh (process) bind no. Phia
+ * connect tu tien trinh `process` tren may `host` nhan:
+ *   - inproc://<ten>          cung tien trinh (dung chung context())
+ *   - ipc://<ipc_dir>/<ten>   cung may, khac tien trinh
+ *   - tcp://<host>:<port>     may khac
+ * Host "" hoac "localhost" hoac trung host cua registry la may nay; dia chi
+ * IP luon duoc coi la may khac (dat host 127.0.0.1 de ep dung tcp).
+ *
+ * Phia bind nen bind moi dia chi cua bindEndpoints() de ca ba loai client
+ * cung ket noi duoc. inproc chi dung duoc khi hai dau tao socket tu cung
+ * context(): moi socket cua tien trinh nen tao tu context nay.
+ */
+class EndpointRegistry {
+ public:
+  enum Scheme { kInproc, kIpc, kTcp, kUnknown };
+
+  struct Service {
+    std::string host;     // may chay dich vu, "" = may nay
+    std::string process;  // tien trinh bind dich vu
+    int port = 0;         // cong tcp cho may khac, 0 = chi trong may
+  };
+
+  // process: ten tien trinh nay; host "" = gethostname()
+  explicit EndpointRegistry(const std::string& process,
+                            const std::string& host = "");
+  ~EndpointRegistry();
+
+  EndpointRegistry(const EndpointRegistry&) = delete;
+  EndpointRegistry& operator=(const EndpointRegistry&) = delete;
+
+  /**
+   * @brief Nap "ipc_dir" va "services" tu file JSON
+   *
+   *   {"ipc_dir": "/tmp/iot_gateway",
+   *    "services": {"telemetry": {"process": "modbus_app", "port": 5555}}}
+   *
+   * Dich vu da co duoc ghi de.
+   */
+  bool loadFromJson(const std::string& filename);
+
+  void add(const std::string& name, const Service& service);
+  void setIpcDir(const std::string& dir) { ipc_dir_ = dir; }
+
+  Scheme schemeFor(const std::string& name) const;
+  // Dia chi connect toi dich vu, "" neu chua khai bao
+  std::string connectEndpoint(const std::string& name) const;
+  // Moi dia chi dich vu phai bind: inproc (neu la tien trinh nay), ipc (neu
+  // la may nay), tcp://*:<port> (neu co port)
+  std::vector<std::string> bindEndpoints(const std::string& name) const;
+
+  // Bind/connect socket (API C) theo ten dich vu; false neu dich vu chua
+  // khai bao hoac moi dia chi deu loi. bind() tao ipc_dir khi can.
+  bool bind(void* socket, const std::string& name) const;
+  bool connect(void* socket, const std::string& name) const;
+
+  // Context dung chung cho moi socket cua tien trinh (bat buoc cho inproc).
+  // Huy registry cho toi khi moi socket tao tu context da zmq_close.
+  std::shared_ptr<zmq::context_t> context() const { return context_; }
+  void* rawContext() const;
+
+  static const char* schemeName(Scheme scheme);
+
+ private:
+  bool isLocalHost(const std::string& host) const;
+
+  std::string process_;
+  std::string host_;
+  std::string ipc_dir_;
+  std::map<std::string, Service> services_;
+  std::shared_ptr<zmq::context_t> context_;
+};
+
+}  // namespace transport
@@ -1,24 +1,89 @@
 // common/src/zmq_transport.cpp
 #include "zmq.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <vector>
 #include <zmq.hpp>
 
 namespace transport {
 
+namespace {
+
+// Duoi nguong nay copy vao message re hon mot lan cap phat cho bo dem so huu
+// va free callback chay tren I/O thread cua ZMQ
+const std::size_t kZeroCopyMinBytes = 64;
+
+// Goi tu I/O thread cua ZMQ khi message cuoi cung tham chieu bo dem duoc huy
+void freePayload(void* /*data*/, void* hint) {
+  delete static_cast<Transport::Payload*>(hint);
+}
+
+// Topic cua batch = prefix + hau to nay; kenh cua nguoi dung khong duoc ket
+// thuc bang hau to nay
+const char kBatchSuffix[] = "$batch";
+const std::size_t kBatchSuffixLength = sizeof(kBatchSuffix) - 1;
+
+// Moi tin trong batch: do dai kenh (2 byte LE), do dai data (4 byte LE),
+// kenh, data
+const std::size_t kEntryHeaderBytes = 6;
+
+// Prefix gom batch: topic den het dau '/' dau tien ("telemetry/dev1" ->
+// "telemetry/"), topic khong co '/' -> ""
+std::size_t prefixLength(const std::string& topic) {
+  const std::size_t slash = topic.find('/');
+  return slash == std::string::npos ? 0 : slash + 1;
+}
+
+std::string batchTopic(const std::string& topic) {
+  return topic.substr(0, prefixLength(topic)) + kBatchSuffix;
+}
+
+bool isBatchTopic(const zmq::message_t& topic) {
+  return topic.size() >= kBatchSuffixLength &&
+         std::memcmp(topic.data<char>() + topic.size() - kBatchSuffixLength,
+                     kBatchSuffix, kBatchSuffixLength) == 0;
+}
+
+void appendEntry(Transport::Payload& out, const std::string& channel,
+                 const uint8_t* data, std::size_t size) {
+  const std::size_t at = out.size();
+  out.resize(at + kEntryHeaderBytes + channel.size() + size);
+  uint8_t* entry = &out[at];
+  entry[0] = static_cast<uint8_t>(channel.size());
+  entry[1] = static_cast<uint8_t>(channel.size() >> 8);
+  for (int i = 0; i < 4; ++i) {
+    entry[2 + i] = static_cast<uint8_t>(size >> (8 * i));
+  }
+  std::memcpy(entry + kEntryHeaderBytes, channel.data(), channel.size());
+  if (size > 0) {
+    std::memcpy(entry + kEntryHeaderBytes + channel.size(), data, size);
+  }
+}
+
+}  // namespace
+
 class ZmqTransport::Impl {
  public:
-  Impl(const std::string& pub_addr, const std::string& sub_addr)
+  typedef std::chrono::steady_clock Clock;
+
+  Impl(const std::shared_ptr<zmq::context_t>& context,
+       const std::string& pub_addr, const std::string& sub_addr,
+       const BatchOptions& batch)
       : pub_addr_(pub_addr),
         sub_addr_(sub_addr),
-        context_(1),
-        pub_socket_(context_, zmq::socket_type::pub),
-        sub_socket_(context_, zmq::socket_type::sub),
-        running_(false) {}
+        batch_(batch),
+        context_(context ? context : std::make_shared<zmq::context_t>(1)),
+        pub_socket_(*context_, zmq::socket_type::pub),
+        sub_socket_(*context_, zmq::socket_type::sub),
+        running_(false),
+        subscriptions_(std::make_shared<std::vector<std::string> >()) {}
 
   ~Impl() { shutdown(); }
 
@@ -38,6 +103,10 @@ class ZmqTransport::Impl {
       running_ = true;
       // 3. Chạy thread nhận tin
       worker_thread_ = std::thread(&Impl::receiveLoop, this);
+      // 4. Thread gửi batch đã chờ đủ max_latency_us
+      if (batch_.enabled && batch_.max_latency_us > 0) {
+        flush_thread_ = std::thread(&Impl::flushLoop, this);
+      }
 
       return true;
     } catch (const zmq::error_t& e) {
@@ -47,28 +116,69 @@ class ZmqTransport::Impl {
   }
 
   void shutdown() {
-    running_ = false;
+    {
+      // Doi running_ duoi lock de flushLoop khong lo mat notify
+      std::lock_guard<std::mutex> lock(pub_mutex_);
+      running_ = false;
+    }
+    flush_cv_.notify_all();
+    if (flush_thread_.joinable()) {
+      flush_thread_.join();
+    }
     if (worker_thread_.joinable()) {
       worker_thread_.join();
     }
-    // Context ZMQ tự hủy khi destructor được gọi
+    // Batch còn dở được gửi nốt trước khi socket bị hủy
+    flush();
+    // Context ZMQ tự hủy khi transport cuối cùng dùng nó bị hủy
   }
 
   bool publish(const std::string& topic, const Payload& data) {
     // Bảo vệ socket PUB vì có thể nhiều thread trong service cùng gọi send
     std::lock_guard<std::mutex> lock(pub_mutex_);
-    try {
-      // Gửi Topic trước (SNDMORE)
-      pub_socket_.send(zmq::buffer(topic), zmq::send_flags::sndmore);
-      // Gửi Data sau
-      pub_socket_.send(zmq::buffer(data), zmq::send_flags::none);
-      return true;
-    } catch (const zmq::error_t& e) {
-      std::cerr << "[ZMQ] Publish Error: " << e.what() << std::endl;
-      return false;
+    // Chua open() hoac da close(): tin vao batch se khong bao gio duoc gui
+    if (!running_) return false;
+    if (batch_.enabled) {
+      return enqueue(topic, data.data(), data.size());
     }
+    return sendCopy(topic, data.data(), data.size());
+  }
+
+  /**
+   * @brief Gửi payload mà không copy: vector được chuyển vào message ZMQ và
+   *        giải phóng qua free callback khi ZMQ gửi xong
+   *
+   * Payload nhỏ hơn kZeroCopyMinBytes vẫn đi đường copy vì rẻ hơn; ở chế độ
+   * batch payload luôn được chép vào batch.
+   */
+  bool publish(const std::string& topic, Payload&& data) {
+    if (batch_.enabled || data.size() < kZeroCopyMinBytes) {
+      const Payload& copy = data;
+      return publish(topic, copy);
+    }
+    std::unique_ptr<Payload> owned(new Payload(std::move(data)));
+    std::lock_guard<std::mutex> lock(pub_mutex_);
+    if (!running_) return false;
+    return sendOwned(topic, std::move(owned));
   }
 
+  // Gửi ngay mọi batch đang chờ
+  bool flush() {
+    std::lock_guard<std::mutex> lock(pub_mutex_);
+    bool ok = true;
+    for (Batch& batch : batches_) {
+      ok = flushBatch(batch) && ok;
+    }
+    return ok;
+  }
+
+  /**
+   * @brief Đăng ký topic và topic batch cùng prefix
+   *
+   * Batch mang tin của cả prefix nên tin trong batch được lọc lại theo danh
+   * sách đăng ký ở thread nhận; danh sách được thay bằng bản mới (copy on
+   * write) để thread nhận chỉ copy shared_ptr.
+   */
   bool subscribe(const std::string& topic) {
     // Socket SUB không thread-safe, nhưng hàm setsockopt có thể thread-safe
     // tùy implementation. Tốt nhất nên lock hoặc chỉ gọi khi init.
@@ -78,27 +188,166 @@ class ZmqTransport::Impl {
     // NHƯNG để đơn giản cho wrapper này, ta giả định sub chỉ gọi lúc init.
     try {
       sub_socket_.set(zmq::sockopt::subscribe, topic);
-      return true;
+      sub_socket_.set(zmq::sockopt::subscribe, batchTopic(topic));
     } catch (...) {
       return false;
     }
+    std::lock_guard<std::mutex> lock(cb_mutex_);
+    std::shared_ptr<std::vector<std::string> > updated =
+        std::make_shared<std::vector<std::string> >(*subscriptions_);
+    updated->push_back(topic);
+    subscriptions_ = updated;
+    return true;
   }
 
   bool unsubscribe(const std::string& topic) {
     try {
       sub_socket_.set(zmq::sockopt::unsubscribe, topic);
-      return true;
+      sub_socket_.set(zmq::sockopt::unsubscribe, batchTopic(topic));
     } catch (...) {
       return false;
     }
+    std::lock_guard<std::mutex> lock(cb_mutex_);
+    std::shared_ptr<std::vector<std::string> > updated =
+        std::make_shared<std::vector<std::string> >(*subscriptions_);
+    std::vector<std::string>::iterator it =
+        std::find(updated->begin(), updated->end(), topic);
+    if (it != updated->end()) updated->erase(it);
+    subscriptions_ = updated;
+    return true;
   }
 
   void setHandler(MessageHandler handler) {
+    std::shared_ptr<const MessageHandler> shared;
+    if (handler) shared = std::make_shared<MessageHandler>(std::move(handler));
+    std::lock_guard<std::mutex> lock(cb_mutex_);
+    handler_ = shared;
+  }
+
+  void setSpanHandler(SpanHandler handler) {
+    std::shared_ptr<const SpanHandler> shared;
+    if (handler) shared = std::make_shared<SpanHandler>(std::move(handler));
     std::lock_guard<std::mutex> lock(cb_mutex_);
-    handler_ = handler;
+    span_handler_ = shared;
   }
 
  private:
+  // Batch cua mot prefix topic
+  struct Batch {
+    std::string topic;          // prefix + kBatchSuffix
+    std::size_t prefix_length;
+    Payload buffer;             // cac tin da dong goi
+    Clock::time_point deadline; // thoi diem phai gui, tinh tu tin dau tien
+  };
+
+  // Cac ham send*/enqueue/flushBatch goi khi da giu pub_mutex_
+  bool sendCopy(const std::string& topic, const uint8_t* data,
+                std::size_t size) {
+    try {
+      // Gửi Topic trước (SNDMORE)
+      pub_socket_.send(zmq::buffer(topic), zmq::send_flags::sndmore);
+      // Gửi Data sau
+      pub_socket_.send(zmq::buffer(data, size), zmq::send_flags::none);
+      return true;
+    } catch (const zmq::error_t& e) {
+      std::cerr << "[ZMQ] Publish Error: " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  bool sendOwned(const std::string& topic, std::unique_ptr<Payload> owned) {
+    try {
+      zmq::message_t message(owned->data(), owned->size(), &freePayload,
+                             owned.get());
+      // Tu day message so huu bo dem, ke ca khi send nem loi
+      owned.release();
+
+      pub_socket_.send(zmq::buffer(topic), zmq::send_flags::sndmore);
+      pub_socket_.send(message, zmq::send_flags::none);
+      return true;
+    } catch (const zmq::error_t& e) {
+      std::cerr << "[ZMQ] Publish Error: " << e.what() << std::endl;
+      return false;
+    }
+  }
+
+  /**
+   * @brief Thêm một tin vào batch của prefix topic, gửi batch khi đầy
+   *
+   * Tin không vừa một batch được gửi riêng sau khi gửi batch cùng prefix
+   * để giữ thứ tự trong prefix.
+   */
+  bool enqueue(const std::string& topic, const uint8_t* data,
+               std::size_t size) {
+    const std::size_t prefix = prefixLength(topic);
+    Batch* batch = nullptr;
+    for (Batch& candidate : batches_) {
+      if (candidate.prefix_length == prefix &&
+          topic.compare(0, prefix, candidate.topic, 0, prefix) == 0) {
+        batch = &candidate;
+        break;
+      }
+    }
+    if (batch == nullptr) {
+      Batch fresh = {batchTopic(topic), prefix, Payload(), Clock::time_point()};
+      batches_.push_back(fresh);
+      batch = &batches_.back();
+    }
+
+    const std::size_t entry = kEntryHeaderBytes + topic.size() + size;
+    if (entry > batch_.max_bytes || topic.size() > 0xFFFF) {
+      const bool flushed = flushBatch(*batch);
+      return sendCopy(topic, data, size) && flushed;
+    }
+    bool ok = true;
+    if (batch->buffer.size() + entry > batch_.max_bytes) {
+      ok = flushBatch(*batch);
+    }
+    if (batch->buffer.empty()) {
+      batch->buffer.reserve(batch_.max_bytes);
+      batch->deadline =
+          Clock::now() + std::chrono::microseconds(batch_.max_latency_us);
+      // Chi can danh thuc flushLoop khi tu khong co batch nao sang co:
+      // han cua batch moi khong som hon han cac batch dang cho
+      if (pending_batches_++ == 0) flush_cv_.notify_one();
+    }
+    appendEntry(batch->buffer, topic, data, size);
+    if (batch->buffer.size() >= batch_.max_bytes) {
+      ok = flushBatch(*batch) && ok;
+    }
+    return ok;
+  }
+
+  bool flushBatch(Batch& batch) {
+    if (batch.buffer.empty()) return true;
+    --pending_batches_;
+    std::unique_ptr<Payload> owned(new Payload());
+    owned->swap(batch.buffer);
+    return sendOwned(batch.topic, std::move(owned));
+  }
+
+  // Gửi các batch đã chờ tới hạn; ngủ tới hạn gần nhất
+  void flushLoop() {
+    std::unique_lock<std::mutex> lock(pub_mutex_);
+    while (running_) {
+      if (pending_batches_ == 0) {
+        flush_cv_.wait(lock);
+        continue;
+      }
+      const Clock::time_point now = Clock::now();
+      Clock::time_point next = Clock::time_point::max();
+      for (Batch& batch : batches_) {
+        if (batch.buffer.empty()) continue;
+        if (batch.deadline <= now) {
+          flushBatch(batch);
+        } else {
+          next = std::min(next, batch.deadline);
+        }
+      }
+      if (next != Clock::time_point::max()) flush_cv_.wait_until(lock, next);
+    }
+  }
+
   void receiveLoop() {
     while (running_) {
       // Polling với timeout 100ms để check biến running_
@@ -111,31 +360,46 @@ class ZmqTransport::Impl {
     }
   }
 
+  /**
+   * @brief Nhận một tin (topic + payload) và gọi handler
+   *
+   * SpanHandler nhận Span trỏ thẳng vào zmq::message_t, không copy. Cặp
+   * message được dùng lại cho tin sau nếu handler không giữ owner, nên lúc
+   * ổn định không có cấp phát nào ngoài của chính ZMQ.
+   */
   void processMessage() {
     try {
-      zmq::message_t topic_msg, data_msg;
+      if (!received_ || received_.use_count() != 1) {
+        received_ = std::make_shared<Received>();
+      }
+      Received& received = *received_;
 
       // Đọc topic
-      auto res = sub_socket_.recv(topic_msg, zmq::recv_flags::none);
+      auto res = sub_socket_.recv(received.topic, zmq::recv_flags::none);
       if (!res) return;
 
       // Đọc payload nếu có
-      if (topic_msg.more()) {
-        sub_socket_.recv(data_msg, zmq::recv_flags::none);
+      if (received.topic.more()) {
+        sub_socket_.recv(received.data, zmq::recv_flags::none);
+      } else {
+        received.data.rebuild();
       }
 
-      std::string topic(static_cast<char*>(topic_msg.data()), topic_msg.size());
-      Payload data(static_cast<uint8_t*>(data_msg.data()),
-                   static_cast<uint8_t*>(data_msg.data()) + data_msg.size());
-
-      // Gọi callback an toàn
-      MessageHandler callback;
+      // Gọi callback an toàn: chỉ copy shared_ptr dưới lock
+      Handlers handlers;
+      std::shared_ptr<const std::vector<std::string> > subscriptions;
       {
         std::lock_guard<std::mutex> lock(cb_mutex_);
-        callback = handler_;
+        handlers.span = span_handler_;
+        handlers.message = handler_;
+        subscriptions = subscriptions_;
       }
-      if (callback) {
-        callback(topic, data);
+      if (isBatchTopic(received.topic)) {
+        deliverBatch(handlers, *subscriptions);
+      } else {
+        deliver(handlers, received.topic.data<uint8_t>(),
+                received.topic.size(), received.data.data<uint8_t>(),
+                received.data.size());
       }
 
     } catch (const std::exception& e) {
@@ -143,23 +407,105 @@ class ZmqTransport::Impl {
     }
   }
 
+  struct Handlers {
+    std::shared_ptr<const SpanHandler> span;
+    std::shared_ptr<const MessageHandler> message;
+  };
+
+  void deliver(const Handlers& handlers, const uint8_t* channel,
+               std::size_t channel_size, const uint8_t* data,
+               std::size_t size) {
+    if (handlers.span) {
+      const Span channel_span = {channel, channel_size, received_};
+      const Span data_span = {data, size, received_};
+      (*handlers.span)(channel_span, data_span);
+    } else if (handlers.message) {
+      // API cu nhan std::string/Payload nen van phai copy
+      std::string topic(reinterpret_cast<const char*>(channel), channel_size);
+      Payload payload(data, data + size);
+      (*handlers.message)(topic, payload);
+    }
+  }
+
+  /**
+   * @brief Tách batch và giao từng tin cho handler như tin gửi lẻ
+   *
+   * Batch chứa tin của cả prefix nên chỉ tin có kênh khớp một topic đã
+   * subscribe mới được giao. Batch hỏng: bỏ phần còn lại.
+   */
+  void deliverBatch(const Handlers& handlers,
+                    const std::vector<std::string>& subscriptions) {
+    const uint8_t* entry = received_->data.data<uint8_t>();
+    const uint8_t* end = entry + received_->data.size();
+    while (entry != end) {
+      if (static_cast<std::size_t>(end - entry) < kEntryHeaderBytes) break;
+      const std::size_t channel_size = entry[0] | (entry[1] << 8);
+      std::size_t size = 0;
+      for (int i = 0; i < 4; ++i) {
+        size |= static_cast<std::size_t>(entry[2 + i]) << (8 * i);
+      }
+      const std::size_t left = end - entry - kEntryHeaderBytes;
+      if (channel_size > left || size > left - channel_size) break;
+
+      const uint8_t* channel = entry + kEntryHeaderBytes;
+      for (const std::string& topic : subscriptions) {
+        if (topic.size() <= channel_size &&
+            std::memcmp(channel, topic.data(), topic.size()) == 0) {
+          deliver(handlers, channel, channel_size, channel + channel_size,
+                  size);
+          break;
+        }
+      }
+      entry = channel + channel_size + size;
+    }
+    if (entry != end) {
+      std::cerr << "[ZMQ] Batch Error: frame hong, bo "
+                << (end - entry) << " byte" << std::endl;
+    }
+  }
+
   std::string pub_addr_, sub_addr_;
-  zmq::context_t context_;
+  const BatchOptions batch_;
+  // Rieng cua transport, hoac dung chung (EndpointRegistry) de dung inproc
+  std::shared_ptr<zmq::context_t> context_;
   zmq::socket_t pub_socket_;
   zmq::socket_t sub_socket_;
 
   std::atomic<bool> running_;
   std::thread worker_thread_;
+  std::thread flush_thread_;
+
+  std::mutex pub_mutex_;  // Lock cho socket gửi và các batch
+  std::condition_variable flush_cv_;
+  std::vector<Batch> batches_;
+  std::size_t pending_batches_ = 0;  // so batch khac rong
+
+  std::mutex cb_mutex_;   // Lock cho callback handler và danh sách đăng ký
+  std::shared_ptr<const MessageHandler> handler_;
+  std::shared_ptr<const SpanHandler> span_handler_;
+  std::shared_ptr<const std::vector<std::string> > subscriptions_;
 
-  std::mutex pub_mutex_;  // Lock cho socket gửi
-  std::mutex cb_mutex_;   // Lock cho callback handler
-  MessageHandler handler_;
+  // Hai frame cua tin dang xu ly; chi thread nhan dung
+  struct Received {
+    zmq::message_t topic;
+    zmq::message_t data;
+  };
+  std::shared_ptr<Received> received_;
 };
 
 // --- Phần Wrapper chuyển tiếp gọi vào Impl ---
 
 ZmqTransport::ZmqTransport(const std::string& pub, const std::string& sub)
-    : impl_(std::make_unique<Impl>(pub, sub)) {}
+    : impl_(new Impl(nullptr, pub, sub, BatchOptions())) {}
+
+ZmqTransport::ZmqTransport(const std::string& pub, const std::string& sub,
+                           const BatchOptions& batch)
+    : impl_(new Impl(nullptr, pub, sub, batch)) {}
+
+ZmqTransport::ZmqTransport(const std::shared_ptr<zmq::context_t>& context,
+                           const std::string& pub, const std::string& sub,
+                           const BatchOptions& batch)
+    : impl_(new Impl(context, pub, sub, batch)) {}
 
 ZmqTransport::~ZmqTransport() = default;
 
@@ -168,6 +514,10 @@ void ZmqTransport::close() { impl_->shutdown(); }
 bool ZmqTransport::send(const std::string& t, const Payload& d) {
   return impl_->publish(t, d);
 }
+bool ZmqTransport::send(const std::string& t, Payload&& d) {
+  return impl_->publish(t, std::move(d));
+}
+bool ZmqTransport::flush() { return impl_->flush(); }
 bool ZmqTransport::subscribe(const std::string& t) {
   return impl_->subscribe(t);
 }
@@ -175,5 +525,6 @@ bool ZmqTransport::unsubscribe(const std::string& t) {
   return impl_->unsubscribe(t);
 }
 void ZmqTransport::setMessageHandler(MessageHandler h) { impl_->setHandler(h); }
+void ZmqTransport::setSpanHandler(SpanHandler h) { impl_->setSpanHandler(h); }
 
 }  // namespace transport
\ No newline at end of file
@@ -2,26 +2,57 @@
 #include "../transport.h"
 
 // common/include/zmq_transport.h
+#include <cstddef>
 #include <memory>
 #include <string>
 
+namespace zmq {
+class context_t;
+}
+
 namespace transport {
 
 class ZmqTransport : public Transport {
  public:
+  // Che do batch: tin cung prefix topic (den '/' dau tien, VD "telemetry/")
+  // duoc dong goi vao mot frame tren topic "<prefix>$batch" thay vi hai frame
+  // moi tin. Batch duoc gui khi dat max_bytes, khi tin dau tien da cho
+  // max_latency_us (<= 0: chi theo kich thuoc va flush()), hoac khi goi
+  // flush(). ZmqTransport o ben nhan tu tach batch va giao tung tin cho
+  // handler nhu tin le; subscriber ZMQ tran thi thay frame batch.
+  struct BatchOptions {
+    bool enabled = false;
+    std::size_t max_bytes = 16 * 1024;
+    int max_latency_us = 2000;
+  };
+
   // endpoint_pub: Địa chỉ để publish tin (VD: "tcp://*:5555" hoặc connect tới
   // broker) endpoint_sub: Địa chỉ để subscribe tin (VD: "tcp://localhost:5556")
   ZmqTransport(const std::string& endpoint_pub,
                const std::string& endpoint_sub);
+  ZmqTransport(const std::string& endpoint_pub,
+               const std::string& endpoint_sub, const BatchOptions& batch);
+  // Dung context chung (VD EndpointRegistry::context()) de connect inproc://
+  // toi socket khac trong tien trinh
+  ZmqTransport(const std::shared_ptr<zmq::context_t>& context,
+               const std::string& endpoint_pub,
+               const std::string& endpoint_sub, const BatchOptions& batch);
   ~ZmqTransport() override;
 
   bool open() override;
   void close() override;
 
+  // false khi chua open() hoac sau close()
   bool send(const std::string& topic, const Payload& data) override;
+  // Payload tu 64 byte duoc chuyen vao message ZMQ, khong copy
+  bool send(const std::string& topic, Payload&& data) override;
+  // Gui ngay cac batch dang cho
+  bool flush() override;
   bool subscribe(const std::string& topic) override;
   bool unsubscribe(const std::string& topic) override;
   void setMessageHandler(MessageHandler handler) override;
+  // Span tro vao zmq::message_t; owner giu message song sau callback
+  void setSpanHandler(SpanHandler handler) override;
 
  private:
   class Impl;